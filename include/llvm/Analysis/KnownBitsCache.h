@@ -0,0 +1,113 @@
+//===- llvm/Analysis/KnownBitsCache.h - Known bits of a function -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the KnownBitsCache class, which holds the known bits and
+// number of sign bits of every integer and pointer instruction of a function.
+// While a cache is active, ComputeMaskedBits and ComputeNumSignBits answer from
+// it instead of recursing, so their answers no longer stop at a fixed depth
+// and repeated queries on the same value are cheap.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ANALYSIS_KNOWNBITSCACHE_H
+#define LLVM_ANALYSIS_KNOWNBITSCACHE_H
+
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/ValueMap.h"
+
+namespace llvm {
+  class BasicBlock;
+  class DataLayout;
+  class Function;
+  class Instruction;
+  class PHINode;
+  class Value;
+
+/// KnownBitsCache - The known bits of the instructions of one function.
+///
+/// compute() fills the cache with a forward pass over the reachable blocks in
+/// reverse post order.  Each instruction is analyzed with ComputeMaskedBits and
+/// ComputeNumSignBits, which find the facts about its operands in the cache.
+/// A loop phi starts out with what its incoming values from outside the loop
+/// say, and the pass is repeated until the phis no longer change; a phi that
+/// keeps changing is widened to its low known bits.
+///
+/// A client that rewrites instructions in place must call update() on them.
+/// Deleted instructions drop out of the cache by themselves, and instructions
+/// without an entry are analyzed the usual way.
+class KnownBitsCache {
+public:
+  explicit KnownBitsCache(const DataLayout *TD);
+  ~KnownBitsCache();
+
+  /// compute - Analyze the reachable instructions of F, forgetting whatever
+  /// was known before.
+  void compute(Function &F);
+
+  /// getKnownBits - If V has an entry of the width of KnownZero, set
+  /// KnownZero and KnownOne from it and return true.
+  bool getKnownBits(const Value *V, APInt &KnownZero, APInt &KnownOne) const;
+
+  /// getNumSignBits - Return the number of sign bits of V, or 0 if it has no
+  /// entry.
+  unsigned getNumSignBits(const Value *V) const;
+
+  /// update - I and the instructions that feed only it may have been
+  /// rewritten in place.  Analyze them again and let the users of I pick up
+  /// what can now be proven about them.
+  void update(Instruction *I);
+
+  /// refineUsers - More may be known about V than before, for instance
+  /// because its alignment went up.  Let V and the instructions computed from
+  /// it pick that up.
+  void refineUsers(Value *V);
+
+  /// forget - Drop the entry of V, whose value has changed.
+  void forget(const Value *V) { Entries.erase(V); }
+
+  /// getActive - Return the cache ComputeMaskedBits and ComputeNumSignBits use
+  /// on this thread, if any.
+  static KnownBitsCache *getActive();
+
+  /// setActive - Make C, which may be null, the cache of this thread.  A cache
+  /// stops being active when it is destroyed.
+  static void setActive(KnownBitsCache *C);
+
+private:
+  struct Entry {
+    APInt KnownZero, KnownOne;
+    unsigned NumSignBits;
+  };
+
+  /// The value an entry is about is not replaced by the value that takes
+  /// over its uses: what is known about the two need not be the same.
+  struct EntryMapConfig : public ValueMapConfig<const Value*> {
+    enum { FollowRAUW = false };
+  };
+  typedef ValueMap<const Value*, Entry, EntryMapConfig> EntryMapType;
+
+  bool isTracked(const Value *V) const;
+  Entry analyze(Instruction *I);
+  bool analyzePHI(PHINode *PN, bool Optimistic, bool Widen);
+  bool refine(Instruction *I);
+  void refineUsersOf(Value *V);
+  bool runPass(ArrayRef<BasicBlock*> Blocks, unsigned Pass, bool Optimistic);
+
+  const DataLayout *TD;
+  EntryMapType Entries;
+
+  /// Computing - The instruction being analyzed; its own entry is stale
+  /// while it is.
+  const Value *Computing;
+};
+
+} // End llvm namespace
+
+#endif
@@ -0,0 +1,77 @@
+/*===-- LAMPProfileDataTypes.h - LAMP profile file layout -------*- C -*-===*\
+|*
+|*                     The LLVM Compiler Infrastructure
+|*
+|* This file is distributed under the University of Illinois Open Source
+|* License. See LICENSE.TXT for details.
+|*
+|*===----------------------------------------------------------------------===*|
+|*
+|* This file defines the on-disk layout of the binary LAMP memory dependence
+|* profile.  It is shared by the LAMP runtime, the LAMPLoadProfile pass and
+|* llvm-lamp-prof, and must be a C header because the runtime is written in C.
+|*
+|* A binary profile is laid out as:
+|*
+|*   LAMPProfileHeader
+|*   LAMPDepRecord      Records[NumRecords]  sorted by (LoopId, SrcId, DstId)
+|*   LAMPLoopIndexEntry Loops[NumLoops]      sorted by LoopId
+|*
+|* All fields are stored in the byte order of the host that wrote the file.
+|* Readers detect a foreign byte order through the Version field and reject
+|* the file.  Every section starts on an 8 byte boundary so that the whole
+|* file can be mapped and used in place.
+|*
+\*===----------------------------------------------------------------------===*/
+
+#ifndef LLVM_ANALYSIS_LAMPPROFILEDATATYPES_H
+#define LLVM_ANALYSIS_LAMPPROFILEDATATYPES_H
+
+#include "llvm/Support/DataTypes.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define LAMP_PROFILE_MAGIC "LAMPPROF"
+#define LAMP_PROFILE_MAGIC_SIZE 8
+#define LAMP_PROFILE_VERSION 1
+
+/* The text profile written by older runtimes starts with this banner. */
+#define LAMP_TEXT_PROFILE_BANNER "BEGIN Memory Profile"
+
+typedef struct LAMPProfileHeader {
+  char Magic[LAMP_PROFILE_MAGIC_SIZE]; /* LAMP_PROFILE_MAGIC, no terminator */
+  uint32_t Version;                    /* LAMP_PROFILE_VERSION             */
+  uint32_t HeaderSize;                 /* sizeof(LAMPProfileHeader)        */
+  uint64_t NumRecords;
+  uint64_t RecordsOffset;              /* File offset of Records[0]        */
+  uint64_t NumLoops;
+  uint64_t LoopIndexOffset;            /* File offset of Loops[0]          */
+} LAMPProfileHeader;
+
+/* One observed memory dependence from instruction SrcId to DstId inside the
+ * loop LoopId.  Ids are the LAMP instruction and loop ids assigned by the
+ * LAMP instrumentation passes.
+ */
+typedef struct LAMPDepRecord {
+  uint32_t LoopId;
+  uint32_t SrcId;
+  uint32_t DstId;
+  uint32_t CrossIter;                  /* Non-zero for loop-carried deps   */
+  uint64_t Count;                      /* Number of times it manifested    */
+} LAMPDepRecord;
+
+/* Records[FirstRecord, FirstRecord + NumRecords) all belong to LoopId. */
+typedef struct LAMPLoopIndexEntry {
+  uint32_t LoopId;
+  uint32_t Reserved;
+  uint64_t FirstRecord;
+  uint64_t NumRecords;
+} LAMPLoopIndexEntry;
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* LLVM_ANALYSIS_LAMPPROFILEDATATYPES_H */
@@ -0,0 +1,88 @@
+//===- LAMPProfileReader.h - Read LAMP dependence profiles ------*- C++ -*-===//
+//
+//                      The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The LAMPProfileReader class gives access to the memory dependence records
+// of a LAMP profile.  Binary profiles (see LAMPProfileDataTypes.h) are mapped
+// and used in place; the legacy text format is parsed into the same record
+// layout so that clients never have to care which one was on disk.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ANALYSIS_LAMPPROFILEREADER_H
+#define LLVM_ANALYSIS_LAMPPROFILEREADER_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Analysis/LAMPProfileDataTypes.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+class MemoryBuffer;
+class raw_ostream;
+
+class LAMPProfileReader {
+  OwningPtr<MemoryBuffer> Buffer;
+  ArrayRef<LAMPDepRecord> Records;
+  ArrayRef<LAMPLoopIndexEntry> Loops;
+
+  // Storage for profiles that could not be used in place (text profiles).
+  std::vector<LAMPDepRecord> OwnedRecords;
+  std::vector<LAMPLoopIndexEntry> OwnedLoops;
+  bool Binary;
+
+  LAMPProfileReader() : Binary(false) {}
+  bool readBinary(std::string &ErrMsg);
+  bool readText(std::string &ErrMsg);
+  void adoptOwnedRecords();
+
+public:
+  ~LAMPProfileReader();
+
+  /// Create - Open and validate the profile in Filename.  Returns null and
+  /// fills in ErrMsg if the file is missing or malformed.
+  static LAMPProfileReader *Create(StringRef Filename, std::string &ErrMsg);
+
+  /// isBinary - Return true if the profile was read from the binary format.
+  bool isBinary() const { return Binary; }
+
+  /// getRecords - All records, sorted by (LoopId, SrcId, DstId).
+  ArrayRef<LAMPDepRecord> getRecords() const { return Records; }
+
+  /// getLoops - The loop index, sorted by LoopId.
+  ArrayRef<LAMPLoopIndexEntry> getLoops() const { return Loops; }
+
+  /// getLoopRecords - The records observed in the loop LoopId.
+  ArrayRef<LAMPDepRecord> getLoopRecords(unsigned LoopId) const;
+
+  /// lookup - Find the record for the dependence SrcId -> DstId in LoopId, or
+  /// return null if it was never observed.
+  const LAMPDepRecord *lookup(unsigned LoopId, unsigned SrcId,
+                              unsigned DstId) const;
+};
+
+/// SortLAMPDepRecords - Sort Records into the order used by binary profiles.
+void SortLAMPDepRecords(std::vector<LAMPDepRecord> &Records);
+
+/// BuildLAMPLoopIndex - Compute the loop index of the sorted Records.
+void BuildLAMPLoopIndex(ArrayRef<LAMPDepRecord> Records,
+                        std::vector<LAMPLoopIndexEntry> &Loops);
+
+/// WriteLAMPBinaryProfile - Emit Records, which must already be sorted, as a
+/// binary profile.
+void WriteLAMPBinaryProfile(raw_ostream &OS, ArrayRef<LAMPDepRecord> Records);
+
+/// WriteLAMPTextProfile - Emit Records in the legacy text format.
+void WriteLAMPTextProfile(raw_ostream &OS, ArrayRef<LAMPDepRecord> Records);
+
+} // End llvm namespace
+
+#endif
@@ -15,6 +15,7 @@
 #ifndef LLVM_ANALYSIS_LAZYVALUEINFO_H
 #define LLVM_ANALYSIS_LAZYVALUEINFO_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/Pass.h"
 
 namespace llvm {
@@ -22,6 +23,7 @@ namespace llvm {
   class DataLayout;
   class TargetLibraryInfo;
   class Value;
+  template<typename T> class SmallVectorImpl;
   
 /// LazyValueInfo - This pass computes, caches, and vends lazy value constraint
 /// information.
@@ -61,6 +63,37 @@ public:
   /// constant on the specified edge.  Return null if not.
   Constant *getConstantOnEdge(Value *V, BasicBlock *FromBB, BasicBlock *ToBB);
   
+  /// EdgeQuery - The value V on the CFG edge from FromBB to ToBB.
+  struct EdgeQuery {
+    Value *V;
+    BasicBlock *FromBB, *ToBB;
+    EdgeQuery(Value *V, BasicBlock *FromBB, BasicBlock *ToBB)
+      : V(V), FromBB(FromBB), ToBB(ToBB) {}
+  };
+
+  /// PredicateQuery - The comparison of V with the constant C on the CFG
+  /// edge from FromBB to ToBB.  Pred is a CmpInst predicate.
+  struct PredicateQuery : public EdgeQuery {
+    unsigned Pred;
+    Constant *C;
+    PredicateQuery(unsigned Pred, Value *V, Constant *C, BasicBlock *FromBB,
+                   BasicBlock *ToBB)
+      : EdgeQuery(V, FromBB, ToBB), Pred(Pred), C(C) {}
+  };
+
+  /// getConstantsOnEdges - Answer getConstantOnEdge for each of Queries,
+  /// appending the answers to Results in the same order.  The block values
+  /// the queries need are solved in a single worklist, and the value on an
+  /// edge that is asked about more than once is only computed once.
+  void getConstantsOnEdges(ArrayRef<EdgeQuery> Queries,
+                           SmallVectorImpl<Constant*> &Results);
+
+  /// getPredicatesOnEdges - Answer getPredicateOnEdge for each of Queries in
+  /// the same way, which is much cheaper than one query at a time when many
+  /// constants are compared with the same value.
+  void getPredicatesOnEdges(ArrayRef<PredicateQuery> Queries,
+                            SmallVectorImpl<Tristate> &Results);
+
   /// threadEdge - Inform the analysis cache that we have threaded an edge from
   /// PredBB to OldSucc to be from PredBB to NewSucc instead.
   void threadEdge(BasicBlock *PredBB, BasicBlock *OldSucc, BasicBlock *NewSucc);
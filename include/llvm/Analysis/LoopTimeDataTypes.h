@@ -0,0 +1,69 @@
+/*===-- LoopTimeDataTypes.h - Loop timing profile file layout ---*- C -*-===*\
+|*
+|*                     The LLVM Compiler Infrastructure
+|*
+|* This file is distributed under the University of Illinois Open Source
+|* License. See LICENSE.TXT for details.
+|*
+|*===----------------------------------------------------------------------===*|
+|*
+|* This file defines the on-disk layout of the loop timing profile written by
+|* the looptime runtime for loops instrumented by -myunroll.  It is shared by
+|* the runtime and the LoopTimeProfileReader, and must be a C header because
+|* the runtime is written in C.
+|*
+|* Every run of an instrumented program appends one block to the file:
+|*
+|*   LoopTimeHeader
+|*   LoopTimeRecord Records[NumRecords]    sorted by LoopId
+|*
+|* so a file collected over several unroll factors holds one block per run.
+|* Durations are in timer ticks; CyclesPerSecond converts them to time.  All
+|* fields are stored in the byte order of the host that wrote the file.
+|*
+\*===----------------------------------------------------------------------===*/
+
+#ifndef LLVM_ANALYSIS_LOOPTIMEDATATYPES_H
+#define LLVM_ANALYSIS_LOOPTIMEDATATYPES_H
+
+#include "llvm/Support/DataTypes.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define LOOPTIME_MAGIC "LOOPTIME"
+#define LOOPTIME_MAGIC_SIZE 8
+#define LOOPTIME_VERSION 1
+
+/* Bucket i of a histogram counts invocations that took [2^i, 2^(i+1))
+ * ticks; bucket 0 also counts invocations that took no measurable time.
+ */
+#define LOOPTIME_NUM_BUCKETS 64
+
+typedef struct LoopTimeHeader {
+  char Magic[LOOPTIME_MAGIC_SIZE];     /* LOOPTIME_MAGIC, no terminator     */
+  uint32_t Version;                    /* LOOPTIME_VERSION                  */
+  uint32_t HeaderSize;                 /* sizeof(LoopTimeHeader)            */
+  uint64_t ProgramId;                  /* Module hash passed to printFinally */
+  uint64_t CopyCount;                  /* Unroll factor passed to setCopyCount */
+  uint64_t CyclesPerSecond;            /* Timer frequency                   */
+  uint64_t TimerOverhead;              /* Ticks already subtracted per sample */
+  uint64_t NumRecords;
+} LoopTimeHeader;
+
+typedef struct LoopTimeRecord {
+  uint64_t LoopId;                     /* ProgramId * 100 + loop index, as in
+                                          loop_features.txt                 */
+  uint64_t Invocations;
+  uint64_t TotalTicks;
+  uint64_t MinTicks;
+  uint64_t MaxTicks;
+  uint64_t Histogram[LOOPTIME_NUM_BUCKETS];
+} LoopTimeRecord;
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* LLVM_ANALYSIS_LOOPTIMEDATATYPES_H */
@@ -0,0 +1,60 @@
+//===- LoopTimeProfileReader.h - Read loop timing profiles ------*- C++ -*-===//
+//
+//                      The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The LoopTimeProfileReader class reads the loop timing profile written by
+// the looptime runtime (see LoopTimeDataTypes.h).  A file holds one block per
+// run of the instrumented program; each block is exposed as a LoopTimeRun.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ANALYSIS_LOOPTIMEPROFILEREADER_H
+#define LLVM_ANALYSIS_LOOPTIMEPROFILEREADER_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Analysis/LoopTimeDataTypes.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+/// LoopTimeRun - The statistics of one run of an instrumented program.
+struct LoopTimeRun {
+  LoopTimeHeader Header;
+  std::vector<LoopTimeRecord> Records;
+
+  /// getSeconds - Convert a tick count of this run to seconds.
+  double getSeconds(uint64_t Ticks) const {
+    return Header.CyclesPerSecond ? (double)Ticks / Header.CyclesPerSecond
+                                  : 0.0;
+  }
+
+  /// lookup - Find the record for LoopId, or return null.
+  const LoopTimeRecord *lookup(uint64_t LoopId) const;
+};
+
+class LoopTimeProfileReader {
+  std::vector<LoopTimeRun> Runs;
+
+  LoopTimeProfileReader() {}
+  bool read(StringRef Data, std::string &ErrMsg);
+
+public:
+  /// Create - Read every run in Filename.  Files written on a host of the
+  /// other byte order are converted.  Returns null and fills in ErrMsg if the
+  /// file is missing or malformed.
+  static LoopTimeProfileReader *Create(StringRef Filename,
+                                       std::string &ErrMsg);
+
+  ArrayRef<LoopTimeRun> getRuns() const { return Runs; }
+};
+
+} // End llvm namespace
+
+#endif
@@ -0,0 +1,237 @@
+//===- llvm/Analysis/MemorySSA.h - Memory SSA form --------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the MemorySSA analysis pass, which puts the memory
+// operations of a function into SSA form: every instruction that writes
+// memory is a MemoryDef, every instruction that only reads it is a
+// MemoryUse, and blocks where different memory states meet get a
+// MemoryPhi.  Each use and def points at the access that defines the memory
+// state it sees, so the memory operations form a use-def graph much like the
+// one of SSA values, and finding what a load depends on is a walk up that
+// graph rather than a scan over the instructions of the function.
+//
+// All of memory is a single variable here; the defining access of a load is
+// the closest write of anything.  getClobberingMemoryAccess walks from there
+// to the closest write that may actually modify the loaded location, asking
+// alias analysis at each def, and remembers the answer.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ANALYSIS_MEMORYSSA_H
+#define LLVM_ANALYSIS_MEMORYSSA_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Pass.h"
+
+namespace llvm {
+
+class BasicBlock;
+class DominatorTree;
+class Instruction;
+class MemoryPhi;
+class raw_ostream;
+
+/// MemoryAccess - A point in the memory use-def graph: a MemoryUse,
+/// MemoryDef or MemoryPhi.
+class MemoryAccess {
+public:
+  enum AccessKind { UseKind, DefKind, PhiKind };
+
+  typedef SmallPtrSet<MemoryAccess*, 4>::const_iterator user_iterator;
+
+  AccessKind getKind() const { return Kind; }
+
+  /// getBlock - Return the block the access is in, or null for the def that
+  /// stands for the memory state on entry to the function.
+  BasicBlock *getBlock() const { return Block; }
+
+  /// The accesses whose defining access, or incoming value, this is.  They
+  /// come in no particular order.
+  user_iterator user_begin() const { return Users.begin(); }
+  user_iterator user_end() const { return Users.end(); }
+  bool user_empty() const { return Users.empty(); }
+
+  void print(raw_ostream &OS) const;
+
+protected:
+  MemoryAccess(AccessKind K, BasicBlock *BB) : Kind(K), Block(BB), ID(0) {}
+
+private:
+  friend class MemorySSA;
+
+  void printID(raw_ostream &OS) const;
+
+  AccessKind Kind;
+  BasicBlock *Block;
+  /// ID - The number defs and phis are printed with; 0 for the live on entry
+  /// def.
+  unsigned ID;
+  SmallPtrSet<MemoryAccess*, 4> Users;
+};
+
+/// MemoryUseOrDef - The access of an instruction.
+class MemoryUseOrDef : public MemoryAccess {
+public:
+  /// getMemoryInst - Return the instruction, or null for the def that stands
+  /// for the memory state on entry to the function.
+  Instruction *getMemoryInst() const { return MemoryInst; }
+
+  /// getDefiningAccess - Return the def or phi that defines the memory state
+  /// this access sees.
+  MemoryAccess *getDefiningAccess() const { return DefiningAccess; }
+
+  static inline bool classof(const MemoryAccess *A) {
+    return A->getKind() != PhiKind;
+  }
+
+protected:
+  MemoryUseOrDef(AccessKind K, Instruction *I, MemoryAccess *Def,
+                 BasicBlock *BB)
+    : MemoryAccess(K, BB), MemoryInst(I), DefiningAccess(Def), Clobber(0),
+      ClobberGeneration(0) {}
+
+private:
+  friend class MemorySSA;
+
+  Instruction *MemoryInst;
+  MemoryAccess *DefiningAccess;
+  /// Clobber - The last answer of getClobberingMemoryAccess, valid while
+  /// ClobberGeneration is the generation of the MemorySSA.
+  MemoryAccess *Clobber;
+  unsigned ClobberGeneration;
+};
+
+/// MemoryUse - The access of an instruction that reads memory but does not
+/// write it.
+class MemoryUse : public MemoryUseOrDef {
+public:
+  MemoryUse(Instruction *I, MemoryAccess *Def, BasicBlock *BB)
+    : MemoryUseOrDef(UseKind, I, Def, BB) {}
+
+  static inline bool classof(const MemoryAccess *A) {
+    return A->getKind() == UseKind;
+  }
+};
+
+/// MemoryDef - The access of an instruction that may write memory, or that
+/// must stay ordered with the writes around it, such as a volatile load.
+class MemoryDef : public MemoryUseOrDef {
+public:
+  MemoryDef(Instruction *I, MemoryAccess *Def, BasicBlock *BB)
+    : MemoryUseOrDef(DefKind, I, Def, BB) {}
+
+  static inline bool classof(const MemoryAccess *A) {
+    return A->getKind() == DefKind;
+  }
+};
+
+/// MemoryPhi - The memory state at the start of a block whose predecessors
+/// leave memory in different states.  There is one incoming value for each
+/// reachable predecessor edge.
+class MemoryPhi : public MemoryAccess {
+public:
+  explicit MemoryPhi(BasicBlock *BB) : MemoryAccess(PhiKind, BB) {}
+
+  unsigned getNumIncomingValues() const { return Incoming.size(); }
+  BasicBlock *getIncomingBlock(unsigned i) const { return Incoming[i].first; }
+  MemoryAccess *getIncomingValue(unsigned i) const {
+    return Incoming[i].second;
+  }
+
+  static inline bool classof(const MemoryAccess *A) {
+    return A->getKind() == PhiKind;
+  }
+
+private:
+  friend class MemorySSA;
+
+  SmallVector<std::pair<BasicBlock*, MemoryAccess*>, 4> Incoming;
+};
+
+/// MemorySSA - Builds the memory use-def graph of a function and answers
+/// clobber queries on it.  Only reachable blocks have accesses.
+///
+/// Passes that delete memory instructions while they use the graph must tell
+/// it with removeMemoryAccess.  New memory instructions get no access; the
+/// passes that use the graph fall back to other means for them.
+class MemorySSA : public FunctionPass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  MemorySSA();
+  ~MemorySSA();
+
+  /// getMemoryAccess - Return the use or def of I, or null if I does not
+  /// touch memory, is in an unreachable block, or is newer than the graph.
+  MemoryUseOrDef *getMemoryAccess(const Instruction *I) const {
+    return Accesses.lookup(I);
+  }
+
+  /// getMemoryPhi - Return the phi at the start of BB, if it has one.
+  MemoryPhi *getMemoryPhi(const BasicBlock *BB) const {
+    return Phis.lookup(BB);
+  }
+
+  /// getLiveOnEntryDef - Return the def that stands for the memory state on
+  /// entry to the function; accesses with nothing above them are defined by
+  /// it.
+  MemoryDef *getLiveOnEntryDef() const { return LiveOnEntry; }
+
+  bool isLiveOnEntryDef(const MemoryAccess *A) const {
+    return A == LiveOnEntry;
+  }
+
+  /// getClobberingMemoryAccess - Return the closest access above the load or
+  /// store I whose instruction may modify the location I accesses, or the
+  /// live on entry def if nothing does or I is an invariant load.  The walk
+  /// goes through a phi when the same clobber is found along all of its
+  /// incoming values; otherwise it returns the phi.  A walk that takes more
+  /// than -memoryssa-walk-limit steps stops at the access it has reached.
+  /// For other instructions this is the defining access.  Returns null if I
+  /// has no access.
+  MemoryAccess *getClobberingMemoryAccess(Instruction *I);
+
+  /// removeMemoryAccess - Forget the access of I, which is about to be
+  /// deleted.  The users of a def are handed its defining access.
+  void removeMemoryAccess(Instruction *I);
+
+  virtual bool runOnFunction(Function &F);
+  virtual void releaseMemory();
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const;
+  virtual void print(raw_ostream &OS, const Module *M = 0) const;
+
+private:
+  void placePhis(Function &F);
+  void renamePass();
+  void removeTrivialPhis();
+  void numberAccesses(Function &F);
+  void replaceAllUsesWith(MemoryAccess *From, MemoryAccess *To,
+                          SmallVectorImpl<MemoryPhi*> &ChangedPhis);
+  MemoryAccess *findClobber(MemoryAccess *Start,
+                            const AliasAnalysis::Location &Loc,
+                            DenseMap<const MemoryPhi*, unsigned> &Active,
+                            DenseMap<const MemoryPhi*, MemoryAccess*> &Done,
+                            unsigned &Steps, unsigned &MinCut);
+
+  AliasAnalysis *AA;
+  DominatorTree *DT;
+  Function *Fn;
+  MemoryDef *LiveOnEntry;
+  DenseMap<const Instruction*, MemoryUseOrDef*> Accesses;
+  DenseMap<const BasicBlock*, MemoryPhi*> Phis;
+  /// Generation - Bumped when a def goes away, which makes every remembered
+  /// clobber stale.
+  unsigned Generation;
+};
+
+} // End llvm namespace
+
+#endif
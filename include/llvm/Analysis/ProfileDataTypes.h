@@ -29,7 +29,9 @@ enum ProfilingType {
   EdgeInfo      = 4,   /* Edge profiling information      */
   PathInfo      = 5,   /* Path profiling information      */
   BBTraceInfo   = 6,   /* Basic block trace information   */
-  OptEdgeInfo   = 7    /* Edge profiling information, optimal version */
+  OptEdgeInfo   = 7,   /* Edge profiling information, optimal version */
+  EdgeInfo64    = 8,   /* Edge profiling information, 64-bit counters */
+  OptEdgeInfo64 = 9    /* Optimal edge profiling, 64-bit counters     */
 };
 
 #if defined(__cplusplus)
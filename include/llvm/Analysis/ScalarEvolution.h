@@ -791,6 +791,17 @@ namespace llvm {
     /// disconnect it from a def-use chain linking it to a loop.
     void forgetValue(Value *V);
 
+    /// releaseLoopNest - With -scev-sparse, drop what is known about the
+    /// values and loops of the outermost loop L, which no client will ask
+    /// about again.  If the caches then take more than -scev-cache-limit,
+    /// empty them completely; every SCEV handed out so far is then freed.
+    /// The loop pass manager calls this when it is done with a loop nest.
+    void releaseLoopNest(const Loop *L);
+
+    /// getMemoryFootprint - Return the number of bytes the SCEVs and the
+    /// caches about them take.
+    size_t getMemoryFootprint() const;
+
     /// GetMinTrailingZeros - Determine the minimum number of zero bits that S
     /// is guaranteed to end in (at every loop iteration).  It is, at the same
     /// time, the minimum number of times S is divisible by 2.  For example,
@@ -889,6 +900,26 @@ namespace llvm {
     /// values that have been allocated. This is used by releaseMemory
     /// to locate them all and call their destructors.
     SCEVUnknown *FirstUnknown;
+
+    /// PeakFootprint - The largest footprint seen on the current function,
+    /// measured when a loop nest is released and at the end.
+    size_t PeakFootprint;
+
+    /// NumNestsReleased, NumCacheResets - What releaseLoopNest did on the
+    /// current function.
+    unsigned NumNestsReleased, NumCacheResets;
+
+    /// LoopRelevance - Memoized isLoopRelevant results for instructions
+    /// outside of loops.
+    DenseMap<const Instruction *, bool> LoopRelevance;
+
+    /// isLoopRelevant - Return true if I is in a loop, uses a value computed
+    /// in one, or feeds, directly or through other instructions, one that
+    /// is.  With -scev-sparse, only such instructions are analyzed.
+    bool isLoopRelevant(const Instruction *I);
+
+    /// clearCaches - Free every SCEV and everything known about them.
+    void clearCaches();
   };
 }
 
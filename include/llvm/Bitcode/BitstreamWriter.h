@@ -267,6 +267,24 @@ public:
     BlockScope.pop_back();
   }
 
+  /// EmitEncodedBlock - Emit a block that another stream has already encoded.
+  /// Block holds what that stream emitted from EnterSubblock(BlockID,
+  /// CodeLen) to the matching ExitBlock, starting at its outermost level on a
+  /// 32-bit boundary.  The other stream must have the same BLOCKINFO_BLOCK
+  /// abbreviations as this one; see CopyBlockInfoRecords.
+  void EmitEncodedBlock(unsigned BlockID, unsigned CodeLen, StringRef Block) {
+    assert(Block.size() >= 8 && (Block.size() & 3) == 0 &&
+           "Not an encoded block!");
+    // The copy starts with a header word that was encoded for the code width
+    // of the other stream; emit the header for this one and take everything
+    // from the block size word on.
+    EmitCode(bitc::ENTER_SUBBLOCK);
+    EmitVBR(BlockID, bitc::BlockIDWidth);
+    EmitVBR(CodeLen, bitc::CodeLenWidth);
+    FlushToWord();
+    Out.append(Block.begin() + 4, Block.end());
+  }
+
   //===--------------------------------------------------------------------===//
   // Record Emission
   //===--------------------------------------------------------------------===//
@@ -540,6 +558,26 @@ public:
 
     return Info.Abbrevs.size()-1+bitc::FIRST_APPLICATION_ABBREV;
   }
+
+  /// CopyBlockInfoRecords - Give this stream the BLOCKINFO_BLOCK abbreviations
+  /// of Other without emitting them, so that blocks written here can be
+  /// moved into Other with EmitEncodedBlock.  The abbreviations are copied
+  /// rather than shared, so the two streams may be used on different threads.
+  void CopyBlockInfoRecords(const BitstreamWriter &Other) {
+    for (unsigned i = 0, e = static_cast<unsigned>(
+           Other.BlockInfoRecords.size()); i != e; ++i) {
+      const BlockInfo &From = Other.BlockInfoRecords[i];
+      BlockInfo &Info = getOrCreateBlockInfo(From.BlockID);
+      for (unsigned j = 0, je = static_cast<unsigned>(From.Abbrevs.size());
+           j != je; ++j) {
+        const BitCodeAbbrev *Abbv = From.Abbrevs[j];
+        BitCodeAbbrev *Copy = new BitCodeAbbrev();
+        for (unsigned k = 0, ke = Abbv->getNumOperandInfos(); k != ke; ++k)
+          Copy->Add(Abbv->getOperandInfo(k));
+        Info.Abbrevs.push_back(Copy);
+      }
+    }
+  }
 };
 
 
@@ -54,7 +54,17 @@ public:
   ///
   virtual void Dematerialize(GlobalValue *) {}
 
-  /// MaterializeModule - make sure the entire Module has been completely read.
+  /// MaterializeMetadata - make sure the named metadata of the module, and
+  /// the metadata it refers to, has been read.  Materializers that read
+  /// metadata lazily only read what the materialized functions refer to until
+  /// this is called.  On error, this returns true and fills in the optional
+  /// string with information about the problem.  If successful, this returns
+  /// false.
+  ///
+  virtual bool MaterializeMetadata(std::string *ErrInfo = 0) { return false; }
+
+  /// MaterializeModule - make sure the entire Module has been completely read,
+  /// including its metadata.
   /// On error, this returns true and fills in the optional string with
   /// information about the problem.  If successful, this returns false.
   ///
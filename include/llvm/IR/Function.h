@@ -86,6 +86,7 @@ private:
   mutable ArgumentListType ArgumentList;  ///< The formal arguments
   ValueSymbolTable *SymTab;               ///< Symbol table of args/instructions
   AttributeSet AttributeSets;             ///< Parameter attributes
+  mutable unsigned ModificationEpoch;     ///< 0 if a new epoch is due
 
   // HasLazyArguments is stored in Value::SubclassData.
   /*bool HasLazyArguments;*/
@@ -397,6 +398,19 @@ public:
   size_t arg_size() const;
   bool arg_empty() const;
 
+  /// getModificationEpoch - Return a number that identifies the current
+  /// state of the body of this function.  A new, never before used number is
+  /// returned after the function is marked modified.  Pass managers that
+  /// cache function analyses reuse them while the epoch is unchanged.
+  unsigned getModificationEpoch() const;
+
+  /// markModified - Start a new modification epoch.  This happens when basic
+  /// blocks or instructions are added or removed and when a pass reports
+  /// that it changed the function.  Clients that change the function in
+  /// other ways outside of a pass (e.g. by setting operands or attributes of
+  /// callees) must call it themselves.
+  void markModified() { ModificationEpoch = 0; }
+
   /// viewCFG - This function is meant for use from the debugger.  You can just
   /// say 'call F->viewCFG()' and a ghostview window should pop up from the
   /// program, displaying the CFG of the current function with the code for each
@@ -78,7 +78,7 @@ public:
                  bool isExternallyInitialized = false);
 
   ~GlobalVariable() {
-    NumOperands = 1; // FIXME: needed by operator delete
+    NumUserOperands = 1; // FIXME: needed by operator delete
   }
 
   /// Provide fast operand accessors
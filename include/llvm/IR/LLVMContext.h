@@ -92,6 +92,21 @@ public:
   void emitError(const Instruction *I, const Twine &ErrorStr);
   void emitError(const Twine &ErrorStr);
 
+  /// SharedScope - While one of these is alive, several threads may use the
+  /// context at once, as the workers of -pass-threads and -bitcode-threads
+  /// do.  Create it on the thread that starts the workers, before starting
+  /// them, and destroy it once they have finished.  LLVM must already be
+  /// multithreaded.  Outside of such scopes the context skips some of its
+  /// locks, so it must not be shared then.
+  class SharedScope {
+    LLVMContext &Context;
+    SharedScope(const SharedScope &) LLVM_DELETED_FUNCTION;
+    void operator=(const SharedScope &) LLVM_DELETED_FUNCTION;
+  public:
+    explicit SharedScope(LLVMContext &Context);
+    ~SharedScope();
+  };
+
 private:
   LLVMContext(LLVMContext&) LLVM_DELETED_FUNCTION;
   void operator=(LLVMContext&) LLVM_DELETED_FUNCTION;
@@ -457,6 +457,14 @@ public:
   /// materialized lazily.  If !isDematerializable(), this method is a noop.
   void Dematerialize(GlobalValue *GV);
 
+  /// MaterializeMetadata - Make sure the named metadata has been read.  A
+  /// module loaded lazily from bitcode may have no named metadata until this
+  /// is called, and only the metadata its materialized functions refer to.
+  /// If the module is corrupt, this returns true and fills in the optional
+  /// string with information about the problem.  If successful, this returns
+  /// false.
+  bool MaterializeMetadata(std::string *ErrInfo = 0);
+
   /// MaterializeAll - Make sure all GlobalValues in this Module are fully read.
   /// If the module is corrupt, this returns true and fills in the optional
   /// string with information about the problem.  If successful, this returns
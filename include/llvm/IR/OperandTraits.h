@@ -82,9 +82,8 @@ struct VariadicOperandTraits {
 /// HungoffOperandTraits - determine the allocation regime of the Use array
 /// when it is not a prefix to the User object, but allocated at an unrelated
 /// heap address.
-/// Assumes that the User subclass that is determined by this traits class
-/// has an OperandList member of type User::op_iterator. [Note: this is now
-/// trivially satisfied, because User has that member for historic reasons.]
+/// The User keeps the pointer to the Use array in front of itself, and finds
+/// it there when HasHungOffUses is set.
 ///
 /// This is the traits class that is needed when the Use array must be
 /// resizable.
@@ -92,10 +91,10 @@ struct VariadicOperandTraits {
 template <unsigned MINARITY = 1>
 struct HungoffOperandTraits {
   static Use *op_begin(User* U) {
-    return U->OperandList;
+    return U->getHungOffOperands();
   }
   static Use *op_end(User* U) {
-    return U->OperandList + U->getNumOperands();
+    return U->getHungOffOperands() + U->getNumOperands();
   }
   static unsigned operands(const User *U) {
     return U->getNumOperands();
@@ -0,0 +1,39 @@
+//===-- llvm/IR/StructuralHash.h - Stable hashes of IR ----------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares functions that add the structure of a function or of a
+// global declaration to an MD5 digest.  The digest does not depend on where
+// the IR lives in memory, on the order of unrelated globals or on the numbering
+// of metadata, so it can key an on-disk cache that outlives the process.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_IR_STRUCTURALHASH_H
+#define LLVM_IR_STRUCTURALHASH_H
+
+namespace llvm {
+
+class Function;
+class GlobalValue;
+class MD5;
+
+/// hashFunction - Add F to Hash: its signature, attributes, value names and
+/// body including metadata, and the declarations of the globals it refers
+/// to, see hashGlobalDeclaration.  Two functions with the same hash print
+/// the same way, and function passes treat them the same way.
+void hashFunction(const Function &F, MD5 &Hash);
+
+/// hashGlobalDeclaration - Add to Hash what the code referring to GV may
+/// depend on: its name, type, linkage and attributes, and the initializer of
+/// a constant together with the declarations of the globals it refers to.
+void hashGlobalDeclaration(const GlobalValue &GV, MD5 &Hash);
+
+} // End llvm namespace
+
+#endif
@@ -72,7 +72,7 @@ private:
 
   /// Destructor - Only for zap()
   ~Use() {
-    if (Val) removeFromList();
+    if (Val) removeFromVal();
   }
 
   enum PrevPtrTag { zeroDigitTag
@@ -144,6 +144,16 @@ private:
     if (Next) Next->setPrev(StrippedPrev);
   }
 
+  /// addToSharedList, removeFromSharedList - Like addToList and
+  /// removeFromList, for the use lists of values that are not local to a
+  /// function.  These hold the lock of Val's use list while LLVM is
+  /// multithreaded, see SharedUseListGuard.
+  void addToSharedList(Use **List);
+  void removeFromSharedList();
+
+  /// removeFromVal - Remove this use from the use list of Val.
+  inline void removeFromVal();
+
   friend class Value;
 };
 
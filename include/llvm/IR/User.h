@@ -32,35 +32,63 @@ struct OperandTraits;
 
 class User : public Value {
   User(const User &) LLVM_DELETED_FUNCTION;
-  void *operator new(size_t) LLVM_DELETED_FUNCTION;
   template <unsigned>
   friend struct HungoffOperandTraits;
   virtual void anchor();
-protected:
-  /// OperandList - This is a pointer to the array of Uses for this User.
-  /// For nodes of fixed arity (e.g. a binary operator) this array will live
-  /// prefixed to some derived class instance.  For nodes of resizable variable
-  /// arity (e.g. PHINodes, SwitchInst etc.), this memory will be dynamically
-  /// allocated and should be destroyed by the classes' virtual dtor.
-  Use *OperandList;
-
-  /// NumOperands - The number of values used by this User.
-  ///
-  unsigned NumOperands;
 
+  /// getHungOffOperands - The pointer to the Use array of a User with hung-off
+  /// uses, which lives just before the User.
+  Use *&getHungOffOperands() {
+    return *(reinterpret_cast<Use **>(this) - 1);
+  }
+  Use *getHungOffOperands() const {
+    return *(reinterpret_cast<Use *const *>(this) - 1);
+  }
+
+protected:
+  // The array of Uses of a User is not pointed to from the User.  For nodes of
+  // fixed arity (e.g. a binary operator) the array lives right before the
+  // derived class instance, so that it ends where the User begins.  For nodes
+  // of resizable variable arity (e.g. PHINodes, SwitchInst etc.), the memory
+  // is dynamically allocated by allocHungoffUses, handed to the User with
+  // setHungOffOperands and should be destroyed by the classes' virtual dtor;
+  // the only pointer to it is kept in front of the User, so such classes must
+  // be allocated with the single argument operator new below.  The number of Uses is kept in
+  // Value::NumUserOperands.
+
+  /// operator new - Allocate a User with room for Us co-allocated Uses.
   void *operator new(size_t s, unsigned Us);
-  User(Type *ty, unsigned vty, Use *OpList, unsigned NumOps)
-    : Value(ty, vty), OperandList(OpList), NumOperands(NumOps) {}
+  /// operator new - Allocate a User whose Uses will be hung off it.
+  void *operator new(size_t s);
+  /// User - The Use * argument is ignored; it used to be the operand list,
+  /// which is now found from NumOps.
+  User(Type *ty, unsigned vty, Use *, unsigned NumOps)
+    : Value(ty, vty) {
+    NumUserOperands = NumOps;
+    HasHungOffUses = false;
+  }
   Use *allocHungoffUses(unsigned) const;
   void dropHungoffUses() {
-    Use::zap(OperandList, OperandList + NumOperands, true);
-    OperandList = 0;
-    // Reset NumOperands so User::operator delete() does the right thing.
-    NumOperands = 0;
+    Use::zap(op_begin(), op_end(), true);
+    getHungOffOperands() = 0;
+    // Reset the count so that ~User does not zap the Uses again.
+    NumUserOperands = 0;
+  }
+  /// setHungOffOperands - Make Ops, which allocHungoffUses returned, the
+  /// operand list of this User.  The old list is left to the caller.
+  void setHungOffOperands(Use *Ops) {
+    HasHungOffUses = true;
+    getHungOffOperands() = Ops;
+  }
+  /// setNumHungOffUseOperands - Change the number of operands of this User,
+  /// which must have hung-off uses with room for them.
+  void setNumHungOffUseOperands(unsigned NumOps) {
+    assert(HasHungOffUses && "Must have hung-off uses to change the count!");
+    NumUserOperands = NumOps;
   }
 public:
   ~User() {
-    Use::zap(OperandList, OperandList + NumOperands);
+    Use::zap(op_begin(), op_end());
   }
   /// operator delete - free memory allocated for User and Use objects
   void operator delete(void *Usr);
@@ -85,27 +113,38 @@ protected:
     return OpFrom<Idx>(this);
   }
 public:
+  /// getOperandList - The array of Uses of this User.
+  const Use *getOperandList() const {
+    return HasHungOffUses ? getHungOffOperands()
+                          : reinterpret_cast<const Use *>(this) -
+                              NumUserOperands;
+  }
+  Use *getOperandList() {
+    return const_cast<Use *>(
+      static_cast<const User *>(this)->getOperandList());
+  }
+
   Value *getOperand(unsigned i) const {
-    assert(i < NumOperands && "getOperand() out of range!");
-    return OperandList[i];
+    assert(i < NumUserOperands && "getOperand() out of range!");
+    return getOperandList()[i];
   }
   void setOperand(unsigned i, Value *Val) {
-    assert(i < NumOperands && "setOperand() out of range!");
+    assert(i < NumUserOperands && "setOperand() out of range!");
     assert((!isa<Constant>((const Value*)this) ||
             isa<GlobalValue>((const Value*)this)) &&
            "Cannot mutate a constant with setOperand!");
-    OperandList[i] = Val;
+    getOperandList()[i] = Val;
   }
   const Use &getOperandUse(unsigned i) const {
-    assert(i < NumOperands && "getOperandUse() out of range!");
-    return OperandList[i];
+    assert(i < NumUserOperands && "getOperandUse() out of range!");
+    return getOperandList()[i];
   }
   Use &getOperandUse(unsigned i) {
-    assert(i < NumOperands && "getOperandUse() out of range!");
-    return OperandList[i];
+    assert(i < NumUserOperands && "getOperandUse() out of range!");
+    return getOperandList()[i];
   }
 
-  unsigned getNumOperands() const { return NumOperands; }
+  unsigned getNumOperands() const { return NumUserOperands; }
 
   // ---------------------------------------------------------------------------
   // Operand Iterator interface...
@@ -113,10 +152,14 @@ public:
   typedef Use*       op_iterator;
   typedef const Use* const_op_iterator;
 
-  inline op_iterator       op_begin()       { return OperandList; }
-  inline const_op_iterator op_begin() const { return OperandList; }
-  inline op_iterator       op_end()         { return OperandList+NumOperands; }
-  inline const_op_iterator op_end()   const { return OperandList+NumOperands; }
+  inline op_iterator       op_begin()       { return getOperandList(); }
+  inline const_op_iterator op_begin() const { return getOperandList(); }
+  inline op_iterator op_end() {
+    return getOperandList() + NumUserOperands;
+  }
+  inline const_op_iterator op_end() const {
+    return getOperandList() + NumUserOperands;
+  }
 
   /// Convenience iterator for directly iterating over the Values in the
   /// OperandList
@@ -43,6 +43,56 @@ class MDNode;
 class Type;
 class StringRef;
 
+/// SharedUseListGuard - While a SharedUseListGuard for V is alive, no other
+/// thread adds a use to V or removes one from it.  This only locks if V has a
+/// shared use list (see Value::hasSharedUseList) and LLVM is multithreaded.
+///
+/// With -pass-threads the passes of different functions run concurrently and
+/// add and remove uses of the same constants and globals, so a function pass
+/// that walks the use list of such a value must hold a guard for it.  The
+/// queries on Value (hasOneUse, hasNUses, getNumUses, ...) take one
+/// themselves.  The guard must not be held across anything that may create,
+/// destroy or replace constants, and function passes must not replace or
+/// destroy shared values at all, see FunctionLocalScope.
+class SharedUseListGuard {
+  const Value *Locked;
+
+  SharedUseListGuard(const SharedUseListGuard &) LLVM_DELETED_FUNCTION;
+  void operator=(const SharedUseListGuard &) LLVM_DELETED_FUNCTION;
+public:
+  explicit SharedUseListGuard(const Value *V);
+  ~SharedUseListGuard();
+};
+
+/// FunctionLocalScope - While a FunctionLocalScope is alive, the calling
+/// thread may only change IR that is local to the functions it works on.
+/// Replacing a value with a shared use list or destroying dead constants on
+/// such a thread is a fatal error, since other threads may be using those
+/// values.  The -pass-threads workers run their functions in one.
+class FunctionLocalScope {
+  FunctionLocalScope(const FunctionLocalScope &) LLVM_DELETED_FUNCTION;
+  void operator=(const FunctionLocalScope &) LLVM_DELETED_FUNCTION;
+public:
+  FunctionLocalScope();
+  virtual ~FunctionLocalScope();
+
+  /// isActive - Return true if the calling thread is in a
+  /// FunctionLocalScope.
+  static bool isActive();
+
+  /// orderGlobalCreation - Called before a global is added to a module.  If
+  /// the calling thread is in a FunctionLocalScope, this waits until the
+  /// scope allows the thread to add globals, so that they are added in the
+  /// same order and get the same names as in a serial run.  It must not be
+  /// called with the context lock held.
+  static void orderGlobalCreation();
+
+protected:
+  /// waitToCreateGlobals - Block until the thread may add globals.  The
+  /// default does not wait.
+  virtual void waitToCreateGlobals();
+};
+
 //===----------------------------------------------------------------------===//
 //                                 Value Class
 //===----------------------------------------------------------------------===//
@@ -76,6 +126,15 @@ private:
   /// This field is initialized to zero by the ctor.
   unsigned short SubclassData;
 
+protected:
+  /// NumUserOperands - The number of operands of a User.  It lives here
+  /// rather than in User because Value has room for it.  HasHungOffUses tells
+  /// whether the operands of the User live in an array of their own rather
+  /// than right before it.
+  unsigned NumUserOperands : 31;
+  unsigned HasHungOffUses : 1;
+
+private:
   Type *VTy;
   Use *UseList;
 
@@ -156,6 +215,8 @@ public:
   /// traversing the whole use list.
   ///
   bool hasOneUse() const {
+    if (hasSharedUseList())
+      return hasNUses(1);
     const_use_iterator I = use_begin(), E = use_end();
     if (I == E) return false;
     return ++I == E;
@@ -177,9 +238,22 @@ public:
   /// to check for specific values.
   unsigned getNumUses() const;
 
+  /// hasSharedUseList - Return true if this value can be used by several
+  /// functions, whose passes may add and remove its uses concurrently, that
+  /// is, if it is not an argument, a basic block or an instruction.
+  bool hasSharedUseList() const {
+    return SubclassID != ArgumentVal && SubclassID != BasicBlockVal &&
+           SubclassID < InstructionVal;
+  }
+
   /// addUse - This method should only be used by the Use class.
   ///
-  void addUse(Use &U) { U.addToList(&UseList); }
+  void addUse(Use &U) {
+    if (hasSharedUseList())
+      U.addToSharedList(&UseList);
+    else
+      U.addToList(&UseList);
+  }
 
   /// An enumeration for keeping track of the concrete subclass of Value that
   /// is actually instantiated. Values of this enumeration are kept in the 
@@ -334,8 +408,15 @@ inline raw_ostream &operator<<(raw_ostream &OS, const Value &V) {
   return OS;
 }
   
+void Use::removeFromVal() {
+  if (Val->hasSharedUseList())
+    removeFromSharedList();
+  else
+    removeFromList();
+}
+
 void Use::set(Value *V) {
-  if (Val) removeFromList();
+  if (Val) removeFromVal();
   Val = V;
   if (V) V->addUse(*this);
 }
@@ -92,6 +92,9 @@ namespace {
       (void) llvm::createLICMPass();
         (void) llvm::createSLICMPass();
         (void) llvm::createMyUnrollPass();
+      (void) llvm::createLAMPProfilerPass();
+      (void) llvm::createLAMPLoopProfilerPass();
+      (void) llvm::createLAMPInitPass();
       (void) llvm::createLazyValueInfoPass();
       (void) llvm::createLoopExtractorPass();
       (void) llvm::createLoopSimplifyPass();
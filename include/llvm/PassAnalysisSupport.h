@@ -155,6 +155,15 @@ public:
     AnalysisImpls.clear();
   }
 
+  /// removeAnalysisImplsOf - Forget that P implements any analysis.
+  void removeAnalysisImplsOf(Pass *P) {
+    for (unsigned i = 0; i != AnalysisImpls.size(); )
+      if (AnalysisImpls[i].second == P)
+        AnalysisImpls.erase(AnalysisImpls.begin() + i);
+      else
+        ++i;
+  }
+
   // getAnalysisIfAvailable - Return analysis result or null if it doesn't exist
   Pass *getAnalysisIfAvailable(AnalysisID ID, bool Direction) const;
 
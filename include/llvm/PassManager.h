@@ -59,6 +59,12 @@ public:
   /// whether any of the passes modifies the module, and if so, return true.
   bool run(Module &M);
 
+  /// setAnalysisCaching - When enabled, the results of function analyses
+  /// such as DominatorTree, LoopInfo and ScalarEvolution are kept for every
+  /// function between calls to run, and reused as long as the function is
+  /// not modified (see Function::getModificationEpoch).
+  void setAnalysisCaching(bool Enable);
+
 private:
   /// PassManagerImpl_New is the actual class. PassManager is just the
   /// wraper to publish simple pass manager interface
@@ -94,6 +100,11 @@ public:
   ///
   bool doFinalization();
 
+  /// setAnalysisCaching - When enabled, the results of function analyses are
+  /// kept for every function between calls to run, see
+  /// PassManager::setAnalysisCaching.
+  void setAnalysisCaching(bool Enable);
+
 private:
   FunctionPassManagerImpl *FPM;
   Module *M;
@@ -224,6 +224,11 @@ public:
   void dumpPasses() const;
   void dumpArguments() const;
 
+  /// setAnalysisCaching - Keep the results of function analyses between runs
+  /// of this manager, see FPPassManager::getCachedAnalysis.
+  void setAnalysisCaching(bool Enable);
+  bool isAnalysisCachingEnabled() const { return CacheAnalyses; }
+
   // Active Pass Managers
   PMStack activeStack;
 
@@ -251,6 +256,10 @@ private:
   SmallVector<ImmutablePass *, 8> ImmutablePasses;
 
   DenseMap<Pass *, AnalysisUsage *> AnUsageMap;
+
+  /// CacheAnalyses - True if function analyses outlive the runs of this
+  /// manager.
+  bool CacheAnalyses;
 };
 
 
@@ -288,6 +297,10 @@ public:
   void freePass(Pass *P, StringRef Msg,
                 enum PassDebuggingString);
 
+  /// Remove P and the interfaces it implements from the available analyses
+  /// without releasing its memory.
+  void removeAvailableAnalysis(Pass *P);
+
   /// Add pass P into the PassVector. Update
   /// AvailableAnalysis appropriately if ProcessAnalysis is true.
   void add(Pass *P, bool ProcessAnalysis = true);
@@ -324,6 +337,19 @@ public:
   /// implementations it needs.
   void initializeAnalysisImpl(Pass *P);
 
+  /// getPassRunCount - Return the number of pass runs the pass managers have
+  /// started, counted by initializeAnalysisImpl.  Analyses that keep results
+  /// across queries, but cannot see every in-place change a pass makes, drop
+  /// them when this moves on.
+  static unsigned getPassRunCount();
+
+  /// clearAnalysisImpls - Forget the implementations that the passes of this
+  /// manager, and of the managers it contains, were given.
+  void clearAnalysisImpls();
+
+  /// removeAnalysisImplsOf - Like clearAnalysisImpls, but only forget P.
+  void removeAnalysisImplsOf(Pass *P);
+
   /// Find the pass that implements Analysis AID. If desired pass is not found
   /// then return NULL.
   Pass *findAnalysisPass(AnalysisID AID, bool Direction);
@@ -409,7 +435,8 @@ class FPPassManager : public ModulePass, public PMDataManager {
 public:
   static char ID;
   explicit FPPassManager()
-  : ModulePass(ID), PMDataManager() { }
+  : ModulePass(ID), PMDataManager(), Original(0) { }
+  ~FPPassManager();
 
   /// run - Execute all of the passes scheduled for execution.  Keep track of
   /// whether any of the passes modifies the module, and if so, return true.
@@ -461,6 +488,86 @@ public:
   virtual PassManagerType getPassManagerType() const {
     return PMT_FunctionPassManager;
   }
+
+private:
+  /// canRunInParallel - Return true if runOnModule may hand the functions of
+  /// the module to the -pass-threads worker threads.
+  bool canRunInParallel(Module &M) const;
+
+  /// runOnModuleInParallel - Run the passes on the functions of M on the
+  /// worker threads, each of which owns a replica of this manager.
+  bool runOnModuleInParallel(Module &M);
+
+  /// createReplica - Create a manager that runs fresh copies of the passes
+  /// of this manager, for use by one worker thread.
+  FPPassManager *createReplica(Module &M);
+
+  /// removeDeadReplicaPasses - The replica counterpart of removeDeadPasses:
+  /// free the copies of the passes whose last user is OriginalP.
+  void removeDeadReplicaPasses(Pass *OriginalP, StringRef Msg);
+
+  /// Replicas - The replicas of this manager, one per worker thread.
+  SmallVector<FPPassManager *, 8> Replicas;
+
+  /// Original - In a replica, the manager it copies, null otherwise.
+  FPPassManager *Original;
+
+  /// ReplicaOf - In a replica, maps each pass of Original to its copy.
+  DenseMap<Pass *, Pass *> ReplicaOf;
+
+  /// CachedAnalysis - The instance of a function analysis that is kept for
+  /// one function, and the modification epoch of the function for which
+  /// its result is known to be current, or zero if it is stale.
+  struct CachedAnalysis {
+    Pass *Position;  // The pass of this manager it stands in for.
+    FunctionPass *P;
+    unsigned Epoch;
+    bool HasRun;  // P holds a result to release before it runs again.
+    CachedAnalysis(Pass *Position, FunctionPass *P)
+      : Position(Position), P(P), Epoch(0), HasRun(false) {}
+    ~CachedAnalysis() {
+      if (HasRun)
+        P->releaseMemory();
+      delete P;
+    }
+  };
+  typedef SmallVector<CachedAnalysis *, 4> CachedAnalysisList;
+
+  /// isCacheableAnalysis - Return true if the result of P can be kept for a
+  /// function between runs.
+  bool isCacheableAnalysis(Pass *P) const;
+
+  /// getCachedAnalysis - Return the cached instance of the analysis FP for F,
+  /// creating it the first time.  Return null if FP is not cached.
+  CachedAnalysis *getCachedAnalysis(Function &F, FunctionPass *FP);
+
+  /// updateCachedAnalyses - Called after a pass ran on F: the analyses in
+  /// Live that it preserved are current for the new epoch of F, the others
+  /// are stale.
+  void updateCachedAnalyses(Function &F,
+                            SmallVectorImpl<CachedAnalysis *> &Live);
+
+  /// removeDeadCachedPasses - Like removeDeadPasses, except that the passes
+  /// whose results live in the cache are not released.
+  void removeDeadCachedPasses(Pass *P, Function &F,
+                              SmallVectorImpl<CachedAnalysis *> &Live);
+
+  /// releaseStaleCachedAnalyses - Release the results of the analyses of F
+  /// that are stale, together with the results that depend on them.
+  void releaseStaleCachedAnalyses(Function &F);
+
+  /// deleteCachedAnalyses - Delete the analyses of List, dependent ones
+  /// first.
+  void deleteCachedAnalyses(CachedAnalysisList &List);
+
+  /// pruneCachedAnalyses - Delete the cached analyses of the functions that
+  /// are no longer in M.
+  void pruneCachedAnalyses(Module &M);
+
+  /// CachedAnalyses - The cached analyses of each function, in the order
+  /// they were first run.
+  typedef DenseMap<Function *, CachedAnalysisList> CachedAnalysisMapTy;
+  CachedAnalysisMapTy CachedAnalyses;
 };
 
 Timer *getPassTimer(Pass *);
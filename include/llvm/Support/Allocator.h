@@ -180,6 +180,10 @@ public:
   
   /// Compute the total physical memory allocated by this allocator.
   size_t getTotalMemory() const;
+
+  /// getSlabBytesAllocated - Return the bytes of slab memory requested by all
+  /// BumpPtrAllocators so far.
+  static uint64_t getSlabBytesAllocated();
 };
 
 /// SpecificBumpPtrAllocator - Same as BumpPtrAllocator but allows only
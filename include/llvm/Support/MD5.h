@@ -0,0 +1,55 @@
+//===-- llvm/Support/MD5.h - MD5 message digest -----------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the MD5 class, an implementation of the MD5 message
+// digest of RFC 1321.  It gives keys that are stable between runs and hosts,
+// for example to name the entries of an on-disk cache; it is not meant for
+// security.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_MD5_H
+#define LLVM_SUPPORT_MD5_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+
+namespace llvm {
+
+class MD5 {
+  uint32_t A, B, C, D;
+  uint64_t Length;      // Bytes passed to update so far.
+  uint8_t Buffer[64];   // The start of a block that is not complete yet.
+
+public:
+  typedef uint8_t MD5Result[16];
+
+  MD5();
+
+  /// update - Add Data to the message.
+  void update(ArrayRef<uint8_t> Data);
+  void update(StringRef Str);
+
+  /// final - Finish the message and store its digest in Result.  The MD5
+  /// must not be updated afterwards.
+  void final(MD5Result &Result);
+
+  /// stringifyResult - Set Str to the 32 lower case hexadecimal digits of
+  /// Result.
+  static void stringifyResult(const MD5Result &Result, SmallString<32> &Str);
+
+private:
+  void processBlock(const uint8_t *Block);
+};
+
+}
+
+#endif
@@ -144,6 +144,11 @@ public:
   /// allocated space.
   static size_t GetMallocUsage();
 
+  /// This static function returns the most memory the process has had
+  /// resident at any one time, in bytes, or zero if the operating system does
+  /// not keep track of it.
+  static size_t GetPeakMemoryUsage();
+
   /// This static function will set \p user_time to the amount of CPU time
   /// spent in user (non-kernel) mode and \p sys_time to the amount of CPU
   /// time spent in system (kernel) mode.  If the operating system does not
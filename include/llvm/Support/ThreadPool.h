@@ -0,0 +1,53 @@
+//===-- llvm/Support/ThreadPool.h - A pool of worker threads ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the ThreadPool class, a fixed set of worker threads that
+// run queued tasks.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_THREADPOOL_H
+#define LLVM_SUPPORT_THREADPOOL_H
+
+#include "llvm/Support/Compiler.h"
+
+namespace llvm {
+
+class ThreadPoolImpl;
+
+/// ThreadPool - A fixed number of worker threads that run tasks in the order
+/// they are queued.  Where LLVM is built without thread support the tasks run
+/// on the calling thread as they are queued.
+class ThreadPool {
+  ThreadPoolImpl *Impl;
+
+  ThreadPool(const ThreadPool &) LLVM_DELETED_FUNCTION;
+  void operator=(const ThreadPool &) LLVM_DELETED_FUNCTION;
+public:
+  typedef void (*TaskFn)(void *);
+
+  /// ThreadPool - Start NumThreads worker threads (at least one).
+  explicit ThreadPool(unsigned NumThreads);
+
+  /// ~ThreadPool - Wait for the queued tasks, then stop the workers.
+  ~ThreadPool();
+
+  /// async - Queue a call to Fn(Arg).
+  void async(TaskFn Fn, void *Arg);
+
+  /// wait - Block until every queued task has finished.
+  void wait();
+
+  /// getNumThreads - Return the number of worker threads.
+  unsigned getNumThreads() const;
+};
+
+}
+
+#endif
@@ -73,7 +73,7 @@ public:
   ValueHandleBase(HandleBaseKind Kind, const ValueHandleBase &RHS)
     : PrevPair(0, Kind), Next(0), VP(RHS.VP) {
     if (isValid(VP.getPointer()))
-      AddToExistingUseList(RHS.getPrevPtr());
+      AddToUseListBefore(RHS);
   }
   ~ValueHandleBase() {
     if (isValid(VP.getPointer()))
@@ -92,7 +92,7 @@ public:
     if (VP.getPointer() == RHS.VP.getPointer()) return RHS.VP.getPointer();
     if (isValid(VP.getPointer())) RemoveFromUseList();
     VP.setPointer(RHS.VP.getPointer());
-    if (isValid(VP.getPointer())) AddToExistingUseList(RHS.getPrevPtr());
+    if (isValid(VP.getPointer())) AddToUseListBefore(RHS);
     return VP.getPointer();
   }
 
@@ -131,6 +131,10 @@ private:
   /// Node.
   void AddToExistingUseListAfter(ValueHandleBase *Node);
 
+  /// AddToUseListBefore - Add this ValueHandle to the use list for VP, just
+  /// before RHS, which must already be in it.
+  void AddToUseListBefore(const ValueHandleBase &RHS);
+
   /// AddToUseList - Add this ValueHandle to the use list for VP.
   void AddToUseList();
   /// RemoveFromUseList - Remove this ValueHandle from its current use list.
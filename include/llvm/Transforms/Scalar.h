@@ -22,6 +22,8 @@
 namespace llvm {
 
 class FunctionPass;
+class LoopPass;
+class ModulePass;
 class Pass;
 class GetElementPtrInst;
 class PassInfo;
@@ -118,6 +120,15 @@ Pass *createLICMPass();
     Pass *createSLICMPass();
 
     Pass *createMyUnrollPass();
+
+//===----------------------------------------------------------------------===//
+//
+// LAMP - Instrument loads, stores and loops for memory dependence profiling
+// with the LAMP runtime (runtime/liblamp).
+//
+FunctionPass *createLAMPProfilerPass();
+LoopPass *createLAMPLoopProfilerPass();
+ModulePass *createLAMPInitPass();
     
 //===----------------------------------------------------------------------===//
 //
@@ -13,9 +13,11 @@
 //
 //===----------------------------------------------------------------------===//
 
+#define DEBUG_TYPE "basicaa"
 #include "llvm/Analysis/Passes.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/CaptureTracking.h"
 #include "llvm/Analysis/InstructionSimplify.h"
@@ -32,12 +34,32 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Operator.h"
 #include "llvm/Pass.h"
+#include "llvm/PassManagers.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/GetElementPtrTypeIterator.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/ValueHandle.h"
 #include "llvm/Target/TargetLibraryInfo.h"
 #include <algorithm>
 using namespace llvm;
 
+static cl::opt<bool>
+EnableResultCache("basicaa-result-cache", cl::Hidden, cl::init(false),
+  cl::desc("Remember the results of alias queries on a function while a "
+           "pass runs"));
+
+static cl::opt<unsigned>
+ResultCacheLimit("basicaa-result-cache-limit", cl::Hidden, cl::init(8192),
+  cl::desc("The most alias results remembered for a function"));
+
+STATISTIC(NumResultCacheHits, "Number of alias queries answered from the "
+                              "result cache");
+STATISTIC(NumResultCacheMisses, "Number of alias queries not in the result "
+                                "cache");
+STATISTIC(NumResultCacheEvictions, "Number of cached alias results dropped "
+                                   "when a pointer changed");
+
 //===----------------------------------------------------------------------===//
 // Useful predicates
 //===----------------------------------------------------------------------===//
@@ -433,7 +455,8 @@ static void GetIndexDifference(SmallVectorImpl<VariableGEPIndex> &Dest,
 // BasicAliasAnalysis Pass
 //===----------------------------------------------------------------------===//
 
-#ifndef NDEBUG
+/// getParent - Return the function that V is local to, or null if it is not
+/// local to any.
 static const Function *getParent(const Value *V) {
   if (const Instruction *inst = dyn_cast<Instruction>(V))
     return inst->getParent()->getParent();
@@ -444,6 +467,7 @@ static const Function *getParent(const Value *V) {
   return NULL;
 }
 
+#ifndef NDEBUG
 static bool notDifferentParent(const Value *O1, const Value *O2) {
 
   const Function *F1 = getParent(O1);
@@ -457,7 +481,9 @@ namespace {
   /// BasicAliasAnalysis - This is the primary alias analysis implementation.
   struct BasicAliasAnalysis : public ImmutablePass, public AliasAnalysis {
     static char ID; // Class identification, replacement for typeinfo
-    BasicAliasAnalysis() : ImmutablePass(ID) {
+    BasicAliasAnalysis()
+      : ImmutablePass(ID), ResultCacheFunction(0), ResultCacheEpoch(0),
+        ResultCachePassRun(0) {
       initializeBasicAliasAnalysisPass(*PassRegistry::getPassRegistry());
     }
 
@@ -472,19 +498,41 @@ namespace {
 
     virtual AliasResult alias(const Location &LocA,
                               const Location &LocB) {
-      assert(AliasCache.empty() && "AliasCache must be cleared after use!");
       assert(notDifferentParent(LocA.Ptr, LocB.Ptr) &&
              "BasicAliasAnalysis doesn't support interprocedural queries.");
+
+      LocPair Locs(LocA, LocB);
+      if (Locs.first.Ptr > Locs.second.Ptr)
+        std::swap(Locs.first, Locs.second);
+      bool UseResultCache = useResultCache();
+      if (UseResultCache) {
+        useResultCacheFor(Locs);
+        ResultCacheTy::iterator I = ResultCache.find(Locs);
+        if (I != ResultCache.end()) {
+          ++NumResultCacheHits;
+          return I->second;
+        }
+        ++NumResultCacheMisses;
+      }
+
+      QueryState Q;
       AliasResult Alias = aliasCheck(LocA.Ptr, LocA.Size, LocA.TBAATag,
-                                     LocB.Ptr, LocB.Size, LocB.TBAATag);
-      // AliasCache rarely has more than 1 or 2 elements, always use
-      // shrink_and_clear so it quickly returns to the inline capacity of the
-      // SmallDenseMap if it ever grows larger.
-      // FIXME: This should really be shrink_to_inline_capacity_and_clear().
-      AliasCache.shrink_and_clear();
+                                     LocB.Ptr, LocB.Size, LocB.TBAATag, Q);
+
+      // Whether a local object escapes can change with any instruction of the
+      // function, so only remember the results that do not depend on it.
+      if (UseResultCache && (Alias == MayAlias || !Q.UsedCaptureInfo) &&
+          isStablePointer(Locs.first.Ptr) && isStablePointer(Locs.second.Ptr))
+        addToResultCache(Locs, Alias);
       return Alias;
     }
 
+    virtual void deleteValue(Value *V) {
+      if (useResultCache())
+        forgetResultsFor(V);
+      AliasAnalysis::deleteValue(V);
+    }
+
     virtual ModRefResult getModRefInfo(ImmutableCallSite CS,
                                        const Location &Loc);
 
@@ -517,13 +565,65 @@ namespace {
     }
     
   private:
-    // AliasCache - Track alias queries to guard against recursion.
     typedef std::pair<Location, Location> LocPair;
     typedef SmallDenseMap<LocPair, AliasResult, 8> AliasCacheTy;
-    AliasCacheTy AliasCache;
 
-    // Visited - Track instructions visited by pointsToConstantMemory.
-    SmallPtrSet<const Value*, 16> Visited;
+    /// QueryState - The state of one call to alias.  It lives on the stack
+    /// of the call, so queries made by different threads need no lock.
+    struct QueryState {
+      // AliasCache - Track alias queries to guard against recursion.
+      AliasCacheTy AliasCache;
+
+      // UsedCaptureInfo - Set when the query proved NoAlias because a local
+      // object does not escape.
+      bool UsedCaptureInfo;
+
+      QueryState() : UsedCaptureInfo(false) {}
+    };
+
+    /// ResultCacheVH - Drops the cached results for a pointer when it is
+    /// deleted or replaced.
+    class ResultCacheVH : public CallbackVH {
+      BasicAliasAnalysis *AA;
+      virtual void deleted();
+      virtual void allUsesReplacedWith(Value *New);
+    public:
+      ResultCacheVH(Value *V, BasicAliasAnalysis *AA = 0)
+        : CallbackVH(V), AA(AA) {}
+    };
+
+    // ResultCache - The results of earlier top-level queries on the function
+    // ResultCacheFunction, made by pass run ResultCachePassRun while the
+    // modification epoch of the function was ResultCacheEpoch.  Unlike
+    // AliasCache it lives across queries, but not across passes.  It is also
+    // cleared when the pass adds or removes instructions, and entries go
+    // away when one of their pointers is deleted or replaced.
+    typedef DenseMap<LocPair, AliasResult> ResultCacheTy;
+    ResultCacheTy ResultCache;
+    const Function *ResultCacheFunction;
+    unsigned ResultCacheEpoch;
+    unsigned ResultCachePassRun;
+
+    // ResultCacheHandles - A handle on each pointer in ResultCache, with the
+    // keys of the entries that pointer is part of.
+    typedef DenseMap<ResultCacheVH, SmallVector<LocPair, 2>,
+                     DenseMapInfo<Value *> > ResultCacheHandlesTy;
+    ResultCacheHandlesTy ResultCacheHandles;
+
+    /// useResultCache - Return true if ResultCache is in use.  The worker
+    /// threads of -pass-threads work on different functions, between which
+    /// the cache would only thrash, so it is left alone once LLVM is
+    /// multithreaded.  The handles still drop their entries, but those
+    /// callbacks are serialized by the lock of the context.
+    static bool useResultCache() {
+      return EnableResultCache && !llvm_is_multithreaded();
+    }
+
+    static bool isStablePointer(const Value *V);
+    void useResultCacheFor(const LocPair &Locs);
+    void addToResultCache(const LocPair &Locs, AliasResult Result);
+    void forgetResultsFor(const Value *V);
+    void clearResultCache();
 
     // aliasGEP - Provide a bunch of ad-hoc rules to disambiguate a GEP
     // instruction against another.
@@ -531,25 +631,26 @@ namespace {
                          const MDNode *V1TBAAInfo,
                          const Value *V2, uint64_t V2Size,
                          const MDNode *V2TBAAInfo,
-                         const Value *UnderlyingV1, const Value *UnderlyingV2);
+                         const Value *UnderlyingV1, const Value *UnderlyingV2,
+                         QueryState &Q);
 
     // aliasPHI - Provide a bunch of ad-hoc rules to disambiguate a PHI
     // instruction against another.
     AliasResult aliasPHI(const PHINode *PN, uint64_t PNSize,
                          const MDNode *PNTBAAInfo,
                          const Value *V2, uint64_t V2Size,
-                         const MDNode *V2TBAAInfo);
+                         const MDNode *V2TBAAInfo, QueryState &Q);
 
     /// aliasSelect - Disambiguate a Select instruction against another value.
     AliasResult aliasSelect(const SelectInst *SI, uint64_t SISize,
                             const MDNode *SITBAAInfo,
                             const Value *V2, uint64_t V2Size,
-                            const MDNode *V2TBAAInfo);
+                            const MDNode *V2TBAAInfo, QueryState &Q);
 
     AliasResult aliasCheck(const Value *V1, uint64_t V1Size,
                            const MDNode *V1TBAATag,
                            const Value *V2, uint64_t V2Size,
-                           const MDNode *V2TBAATag);
+                           const MDNode *V2TBAATag, QueryState &Q);
   };
 }  // End of anonymous namespace
 
@@ -568,20 +669,116 @@ ImmutablePass *llvm::createBasicAliasAnalysisPass() {
   return new BasicAliasAnalysis();
 }
 
+void BasicAliasAnalysis::ResultCacheVH::deleted() {
+  AA->forgetResultsFor(getValPtr());
+  // this now dangles!
+}
+
+void BasicAliasAnalysis::ResultCacheVH::allUsesReplacedWith(Value *) {
+  // Queries on the new value are cached under it, so the results for the old
+  // one will not be asked for again.
+  AA->forgetResultsFor(getValPtr());
+  // this now dangles!
+}
+
+/// isStablePointer - Return true if the results of queries on V may be
+/// cached.  A pass can redirect a PHI or select, or change a GEP's variable
+/// index, in place, without a value handle noticing, so pointers computed
+/// through any of these are not cached.
+bool BasicAliasAnalysis::isStablePointer(const Value *V) {
+  for (unsigned MaxLookup = 6; MaxLookup; --MaxLookup) {
+    if (isa<PHINode>(V) || isa<SelectInst>(V))
+      return false;
+    if (const GEPOperator *GEP = dyn_cast<GEPOperator>(V)) {
+      if (!GEP->hasAllConstantIndices())
+        return false;
+      V = GEP->getPointerOperand();
+    } else if (const Operator *Op = dyn_cast<Operator>(V)) {
+      if (Op->getOpcode() != Instruction::BitCast)
+        return true;
+      V = Op->getOperand(0);
+    } else if (const GlobalAlias *GA = dyn_cast<GlobalAlias>(V)) {
+      if (GA->mayBeOverridden())
+        return true;
+      V = GA->getAliasee();
+    } else {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// useResultCacheFor - Prepare ResultCache for a query on Locs: the cache only
+/// holds the results of one pass run on one state of one function at a time.
+void BasicAliasAnalysis::useResultCacheFor(const LocPair &Locs) {
+  const Function *F = getParent(Locs.first.Ptr);
+  if (!F)
+    F = getParent(Locs.second.Ptr);
+  if (!F)
+    return;
+  unsigned Epoch = F->getModificationEpoch();
+  unsigned PassRun = PMDataManager::getPassRunCount();
+  if (F != ResultCacheFunction || Epoch != ResultCacheEpoch ||
+      PassRun != ResultCachePassRun) {
+    clearResultCache();
+    ResultCacheFunction = F;
+    ResultCacheEpoch = Epoch;
+    ResultCachePassRun = PassRun;
+  }
+}
+
+void BasicAliasAnalysis::addToResultCache(const LocPair &Locs,
+                                          AliasResult Result) {
+  if (ResultCache.size() >= ResultCacheLimit)
+    clearResultCache();
+  if (!ResultCache.insert(std::make_pair(Locs, Result)).second)
+    return;
+  Value *Ptrs[] = { const_cast<Value *>(Locs.first.Ptr),
+                    const_cast<Value *>(Locs.second.Ptr) };
+  for (unsigned i = 0, e = Ptrs[0] == Ptrs[1] ? 1 : 2; i != e; ++i) {
+    ResultCacheHandlesTy::iterator H = ResultCacheHandles.find(Ptrs[i]);
+    if (H == ResultCacheHandles.end())
+      H = ResultCacheHandles.insert(
+            std::make_pair(ResultCacheVH(Ptrs[i], this),
+                           SmallVector<LocPair, 2>())).first;
+    H->second.push_back(Locs);
+  }
+}
+
+/// forgetResultsFor - Drop the cached results of the queries on V.  The keys
+/// left behind in the handle of the other pointer of each entry are harmless
+/// and go away with the next clear.
+void BasicAliasAnalysis::forgetResultsFor(const Value *V) {
+  ResultCacheHandlesTy::iterator H =
+    ResultCacheHandles.find(const_cast<Value *>(V));
+  if (H == ResultCacheHandles.end())
+    return;
+  SmallVector<LocPair, 2> Keys;
+  Keys.swap(H->second);
+  ResultCacheHandles.erase(H);
+  for (unsigned i = 0, e = Keys.size(); i != e; ++i)
+    if (ResultCache.erase(Keys[i]))
+      ++NumResultCacheEvictions;
+}
+
+void BasicAliasAnalysis::clearResultCache() {
+  ResultCache.clear();
+  ResultCacheHandles.clear();
+}
+
 /// pointsToConstantMemory - Returns whether the given pointer value
 /// points to memory that is local to the function, with global constants being
 /// considered local to all functions.
 bool
 BasicAliasAnalysis::pointsToConstantMemory(const Location &Loc, bool OrLocal) {
-  assert(Visited.empty() && "Visited must be cleared after use!");
-
+  // Track instructions visited by the walk.
+  SmallPtrSet<const Value *, 16> Visited;
   unsigned MaxLookup = 8;
   SmallVector<const Value *, 16> Worklist;
   Worklist.push_back(Loc.Ptr);
   do {
     const Value *V = GetUnderlyingObject(Worklist.pop_back_val(), TD);
     if (!Visited.insert(V)) {
-      Visited.clear();
       return AliasAnalysis::pointsToConstantMemory(Loc, OrLocal);
     }
 
@@ -595,7 +792,6 @@ BasicAliasAnalysis::pointsToConstantMemory(const Location &Loc, bool OrLocal) {
       // global to be marked constant in some modules and non-constant in
       // others.  GV may even be a declaration, not a definition.
       if (!GV->isConstant()) {
-        Visited.clear();
         return AliasAnalysis::pointsToConstantMemory(Loc, OrLocal);
       }
       continue;
@@ -613,7 +809,6 @@ BasicAliasAnalysis::pointsToConstantMemory(const Location &Loc, bool OrLocal) {
     if (const PHINode *PN = dyn_cast<PHINode>(V)) {
       // Don't bother inspecting phi nodes with many operands.
       if (PN->getNumIncomingValues() > MaxLookup) {
-        Visited.clear();
         return AliasAnalysis::pointsToConstantMemory(Loc, OrLocal);
       }
       for (unsigned i = 0, e = PN->getNumIncomingValues(); i != e; ++i)
@@ -622,12 +817,10 @@ BasicAliasAnalysis::pointsToConstantMemory(const Location &Loc, bool OrLocal) {
     }
 
     // Otherwise be conservative.
-    Visited.clear();
     return AliasAnalysis::pointsToConstantMemory(Loc, OrLocal);
 
   } while (!Worklist.empty() && --MaxLookup);
 
-  Visited.clear();
   return Worklist.empty();
 }
 
@@ -872,7 +1065,7 @@ BasicAliasAnalysis::aliasGEP(const GEPOperator *GEP1, uint64_t V1Size,
                              const Value *V2, uint64_t V2Size,
                              const MDNode *V2TBAAInfo,
                              const Value *UnderlyingV1,
-                             const Value *UnderlyingV2) {
+                             const Value *UnderlyingV2, QueryState &Q) {
   int64_t GEP1BaseOffset;
   SmallVector<VariableGEPIndex, 4> GEP1VariableIndices;
 
@@ -882,7 +1075,7 @@ BasicAliasAnalysis::aliasGEP(const GEPOperator *GEP1, uint64_t V1Size,
   if (const GEPOperator *GEP2 = dyn_cast<GEPOperator>(V2)) {
     // Do the base pointers alias?
     AliasResult BaseAlias = aliasCheck(UnderlyingV1, UnknownSize, 0,
-                                       UnderlyingV2, UnknownSize, 0);
+                                       UnderlyingV2, UnknownSize, 0, Q);
 
     // Check for geps of non-aliasing underlying pointers where the offsets are
     // identical.
@@ -890,7 +1083,7 @@ BasicAliasAnalysis::aliasGEP(const GEPOperator *GEP1, uint64_t V1Size,
       // Do the base pointers alias assuming type and size.
       AliasResult PreciseBaseAlias = aliasCheck(UnderlyingV1, V1Size,
                                                 V1TBAAInfo, UnderlyingV2,
-                                                V2Size, V2TBAAInfo);
+                                                V2Size, V2TBAAInfo, Q);
       if (PreciseBaseAlias == NoAlias) {
         // See if the computed offset from the common pointer tells us about the
         // relation of the resulting pointer.
@@ -953,7 +1146,7 @@ BasicAliasAnalysis::aliasGEP(const GEPOperator *GEP1, uint64_t V1Size,
       return MayAlias;
 
     AliasResult R = aliasCheck(UnderlyingV1, UnknownSize, 0,
-                               V2, V2Size, V2TBAAInfo);
+                               V2, V2Size, V2TBAAInfo, Q);
     if (R != MustAlias)
       // If V2 may alias GEP base pointer, conservatively returns MayAlias.
       // If V2 is known not to alias GEP base pointer, then the two values
@@ -1049,31 +1242,33 @@ AliasAnalysis::AliasResult
 BasicAliasAnalysis::aliasSelect(const SelectInst *SI, uint64_t SISize,
                                 const MDNode *SITBAAInfo,
                                 const Value *V2, uint64_t V2Size,
-                                const MDNode *V2TBAAInfo) {
+                                const MDNode *V2TBAAInfo, QueryState &Q) {
   // If the values are Selects with the same condition, we can do a more precise
   // check: just check for aliases between the values on corresponding arms.
   if (const SelectInst *SI2 = dyn_cast<SelectInst>(V2))
     if (SI->getCondition() == SI2->getCondition()) {
       AliasResult Alias =
         aliasCheck(SI->getTrueValue(), SISize, SITBAAInfo,
-                   SI2->getTrueValue(), V2Size, V2TBAAInfo);
+                   SI2->getTrueValue(), V2Size, V2TBAAInfo, Q);
       if (Alias == MayAlias)
         return MayAlias;
       AliasResult ThisAlias =
         aliasCheck(SI->getFalseValue(), SISize, SITBAAInfo,
-                   SI2->getFalseValue(), V2Size, V2TBAAInfo);
+                   SI2->getFalseValue(), V2Size, V2TBAAInfo, Q);
       return MergeAliasResults(ThisAlias, Alias);
     }
 
   // If both arms of the Select node NoAlias or MustAlias V2, then returns
   // NoAlias / MustAlias. Otherwise, returns MayAlias.
   AliasResult Alias =
-    aliasCheck(V2, V2Size, V2TBAAInfo, SI->getTrueValue(), SISize, SITBAAInfo);
+    aliasCheck(V2, V2Size, V2TBAAInfo, SI->getTrueValue(), SISize, SITBAAInfo,
+               Q);
   if (Alias == MayAlias)
     return MayAlias;
 
   AliasResult ThisAlias =
-    aliasCheck(V2, V2Size, V2TBAAInfo, SI->getFalseValue(), SISize, SITBAAInfo);
+    aliasCheck(V2, V2Size, V2TBAAInfo, SI->getFalseValue(), SISize, SITBAAInfo,
+               Q);
   return MergeAliasResults(ThisAlias, Alias);
 }
 
@@ -1083,7 +1278,7 @@ AliasAnalysis::AliasResult
 BasicAliasAnalysis::aliasPHI(const PHINode *PN, uint64_t PNSize,
                              const MDNode *PNTBAAInfo,
                              const Value *V2, uint64_t V2Size,
-                             const MDNode *V2TBAAInfo) {
+                             const MDNode *V2TBAAInfo, QueryState &Q) {
   // If the values are PHIs in the same block, we can do a more precise
   // as well as efficient check: just check for aliases between the values
   // on corresponding edges.
@@ -1101,16 +1296,16 @@ BasicAliasAnalysis::aliasPHI(const PHINode *PN, uint64_t PNSize,
       // that causes a MayAlias.
       // Pretend the phis do not alias.
       AliasResult Alias = NoAlias;
-      assert(AliasCache.count(Locs) &&
+      assert(Q.AliasCache.count(Locs) &&
              "There must exist an entry for the phi node");
-      AliasResult OrigAliasResult = AliasCache[Locs];
-      AliasCache[Locs] = NoAlias;
+      AliasResult OrigAliasResult = Q.AliasCache[Locs];
+      Q.AliasCache[Locs] = NoAlias;
 
       for (unsigned i = 0, e = PN->getNumIncomingValues(); i != e; ++i) {
         AliasResult ThisAlias =
           aliasCheck(PN->getIncomingValue(i), PNSize, PNTBAAInfo,
                      PN2->getIncomingValueForBlock(PN->getIncomingBlock(i)),
-                     V2Size, V2TBAAInfo);
+                     V2Size, V2TBAAInfo, Q);
         Alias = MergeAliasResults(ThisAlias, Alias);
         if (Alias == MayAlias)
           break;
@@ -1118,7 +1313,7 @@ BasicAliasAnalysis::aliasPHI(const PHINode *PN, uint64_t PNSize,
 
       // Reset if speculation failed.
       if (Alias != NoAlias)
-        AliasCache[Locs] = OrigAliasResult;
+        Q.AliasCache[Locs] = OrigAliasResult;
 
       return Alias;
     }
@@ -1138,7 +1333,7 @@ BasicAliasAnalysis::aliasPHI(const PHINode *PN, uint64_t PNSize,
   }
 
   AliasResult Alias = aliasCheck(V2, V2Size, V2TBAAInfo,
-                                 V1Srcs[0], PNSize, PNTBAAInfo);
+                                 V1Srcs[0], PNSize, PNTBAAInfo, Q);
   // Early exit if the check of the first PHI source against V2 is MayAlias.
   // Other results are not possible.
   if (Alias == MayAlias)
@@ -1150,7 +1345,7 @@ BasicAliasAnalysis::aliasPHI(const PHINode *PN, uint64_t PNSize,
     Value *V = V1Srcs[i];
 
     AliasResult ThisAlias = aliasCheck(V2, V2Size, V2TBAAInfo,
-                                       V, PNSize, PNTBAAInfo);
+                                       V, PNSize, PNTBAAInfo, Q);
     Alias = MergeAliasResults(ThisAlias, Alias);
     if (Alias == MayAlias)
       break;
@@ -1166,7 +1361,7 @@ AliasAnalysis::AliasResult
 BasicAliasAnalysis::aliasCheck(const Value *V1, uint64_t V1Size,
                                const MDNode *V1TBAAInfo,
                                const Value *V2, uint64_t V2Size,
-                               const MDNode *V2TBAAInfo) {
+                               const MDNode *V2TBAAInfo, QueryState &Q) {
   // If either of the memory references is empty, it doesn't matter what the
   // pointer values are.
   if (V1Size == 0 || V2Size == 0)
@@ -1225,10 +1420,11 @@ BasicAliasAnalysis::aliasCheck(const Value *V1, uint64_t V1Size,
     // temporary store the nocapture argument's value in a temporary memory
     // location if that memory location doesn't escape. Or it may pass a
     // nocapture value to other functions as long as they don't capture it.
-    if (isEscapeSource(O1) && isNonEscapingLocalObject(O2))
-      return NoAlias;
-    if (isEscapeSource(O2) && isNonEscapingLocalObject(O1))
+    if ((isEscapeSource(O1) && isNonEscapingLocalObject(O2)) ||
+        (isEscapeSource(O2) && isNonEscapingLocalObject(O1))) {
+      Q.UsedCaptureInfo = true;
       return NoAlias;
+    }
   }
 
   // If the size of one access is larger than the entire object on the other
@@ -1245,7 +1441,7 @@ BasicAliasAnalysis::aliasCheck(const Value *V1, uint64_t V1Size,
   if (V1 > V2)
     std::swap(Locs.first, Locs.second);
   std::pair<AliasCacheTy::iterator, bool> Pair =
-    AliasCache.insert(std::make_pair(Locs, MayAlias));
+    Q.AliasCache.insert(std::make_pair(Locs, MayAlias));
   if (!Pair.second)
     return Pair.first->second;
 
@@ -1258,8 +1454,9 @@ BasicAliasAnalysis::aliasCheck(const Value *V1, uint64_t V1Size,
     std::swap(V1TBAAInfo, V2TBAAInfo);
   }
   if (const GEPOperator *GV1 = dyn_cast<GEPOperator>(V1)) {
-    AliasResult Result = aliasGEP(GV1, V1Size, V1TBAAInfo, V2, V2Size, V2TBAAInfo, O1, O2);
-    if (Result != MayAlias) return AliasCache[Locs] = Result;
+    AliasResult Result = aliasGEP(GV1, V1Size, V1TBAAInfo, V2, V2Size,
+                                  V2TBAAInfo, O1, O2, Q);
+    if (Result != MayAlias) return Q.AliasCache[Locs] = Result;
   }
 
   if (isa<PHINode>(V2) && !isa<PHINode>(V1)) {
@@ -1269,8 +1466,8 @@ BasicAliasAnalysis::aliasCheck(const Value *V1, uint64_t V1Size,
   }
   if (const PHINode *PN = dyn_cast<PHINode>(V1)) {
     AliasResult Result = aliasPHI(PN, V1Size, V1TBAAInfo,
-                                  V2, V2Size, V2TBAAInfo);
-    if (Result != MayAlias) return AliasCache[Locs] = Result;
+                                  V2, V2Size, V2TBAAInfo, Q);
+    if (Result != MayAlias) return Q.AliasCache[Locs] = Result;
   }
 
   if (isa<SelectInst>(V2) && !isa<SelectInst>(V1)) {
@@ -1280,8 +1477,8 @@ BasicAliasAnalysis::aliasCheck(const Value *V1, uint64_t V1Size,
   }
   if (const SelectInst *S1 = dyn_cast<SelectInst>(V1)) {
     AliasResult Result = aliasSelect(S1, V1Size, V1TBAAInfo,
-                                     V2, V2Size, V2TBAAInfo);
-    if (Result != MayAlias) return AliasCache[Locs] = Result;
+                                     V2, V2Size, V2TBAAInfo, Q);
+    if (Result != MayAlias) return Q.AliasCache[Locs] = Result;
   }
 
   // If both pointers are pointing into the same object and one of them
@@ -1290,10 +1487,10 @@ BasicAliasAnalysis::aliasCheck(const Value *V1, uint64_t V1Size,
   if (TD && O1 == O2)
     if ((V1Size != UnknownSize && isObjectSize(O1, V1Size, *TD, *TLI)) ||
         (V2Size != UnknownSize && isObjectSize(O2, V2Size, *TD, *TLI)))
-      return AliasCache[Locs] = PartialAlias;
+      return Q.AliasCache[Locs] = PartialAlias;
 
   AliasResult Result =
     AliasAnalysis::alias(Location(V1, V1Size, V1TBAAInfo),
                          Location(V2, V2Size, V2TBAAInfo));
-  return AliasCache[Locs] = Result;
+  return Q.AliasCache[Locs] = Result;
 }
@@ -0,0 +1,306 @@
+//===- KnownBitsCache.cpp - Known bits of a function ----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the KnownBitsCache class.
+//
+// The facts of a loop are found by optimistic iteration: a loop phi is first
+// assumed to be no more than what its incoming values from outside the loop
+// say, the loop is analyzed under that assumption, and the phi is weakened to
+// what its incoming values then say, until nothing changes.  Only at that
+// point are the facts known to hold, so compute() does not return early.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "known-bits-cache"
+#include "llvm/Analysis/KnownBitsCache.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/ThreadLocal.h"
+#include <algorithm>
+using namespace llvm;
+
+STATISTIC(NumPasses, "Number of passes over functions to find known bits");
+STATISTIC(NumWidened, "Number of times a loop phi was widened");
+STATISTIC(NumNotConverged, "Number of functions analyzed without loop facts");
+
+/// MaxPasses - After this many passes, the loop phis are given up on and the
+/// function is analyzed once more without assumptions.
+static const unsigned MaxPasses = 8;
+
+/// WidenAfter - From this pass on, a loop phi that changes is widened rather
+/// than losing its known bits one at a time.
+static const unsigned WidenAfter = 2;
+
+static sys::ThreadLocal<const KnownBitsCache> ActiveCache;
+
+KnownBitsCache *KnownBitsCache::getActive() {
+  return const_cast<KnownBitsCache*>(ActiveCache.get());
+}
+
+void KnownBitsCache::setActive(KnownBitsCache *C) {
+  ActiveCache.set(C);
+}
+
+KnownBitsCache::KnownBitsCache(const DataLayout *td)
+  : TD(td), Computing(0) {
+}
+
+KnownBitsCache::~KnownBitsCache() {
+  if (getActive() == this)
+    setActive(0);
+}
+
+bool KnownBitsCache::isTracked(const Value *V) const {
+  if (!isa<Instruction>(V))
+    return false;
+  Type *Ty = V->getType();
+  return Ty->isIntegerTy() || (TD && Ty->isPointerTy());
+}
+
+bool KnownBitsCache::getKnownBits(const Value *V, APInt &KnownZero,
+                                  APInt &KnownOne) const {
+  if (V == Computing)
+    return false;
+  EntryMapType::const_iterator I = Entries.find(V);
+  if (I == Entries.end() ||
+      I->second.KnownZero.getBitWidth() != KnownZero.getBitWidth())
+    return false;
+  KnownZero = I->second.KnownZero;
+  KnownOne = I->second.KnownOne;
+  return true;
+}
+
+unsigned KnownBitsCache::getNumSignBits(const Value *V) const {
+  if (V == Computing)
+    return 0;
+  EntryMapType::const_iterator I = Entries.find(V);
+  return I == Entries.end() ? 0 : I->second.NumSignBits;
+}
+
+/// analyze - Run ComputeMaskedBits and ComputeNumSignBits on I, ignoring its
+/// own entry.
+KnownBitsCache::Entry KnownBitsCache::analyze(Instruction *I) {
+  Type *Ty = I->getType();
+  unsigned BitWidth = Ty->isPointerTy() ? TD->getPointerSizeInBits()
+                                        : Ty->getIntegerBitWidth();
+  Entry E;
+  E.KnownZero = APInt(BitWidth, 0);
+  E.KnownOne = APInt(BitWidth, 0);
+  Computing = I;
+  ComputeMaskedBits(I, E.KnownZero, E.KnownOne, TD);
+  E.NumSignBits = ComputeNumSignBits(I, TD);
+  Computing = 0;
+  return E;
+}
+
+/// analyzePHI - Find the facts of PN.  When Optimistic, incoming values that
+/// have not been analyzed yet are left out, which is what makes loop phis
+/// start out with the facts of the loop entry.  An existing entry is only
+/// ever weakened, and by more than needed if Widen.  Return true if another
+/// pass is needed for PN.
+bool KnownBitsCache::analyzePHI(PHINode *PN, bool Optimistic, bool Widen) {
+  Entry New = analyze(PN);
+  bool Incomplete = false;
+
+  if (Optimistic) {
+    unsigned BitWidth = New.KnownZero.getBitWidth();
+    APInt KnownZero = APInt::getAllOnesValue(BitWidth);
+    APInt KnownOne = APInt::getAllOnesValue(BitWidth);
+    unsigned NumSignBits = BitWidth;
+    bool Any = false;
+    for (unsigned i = 0, e = PN->getNumIncomingValues(); i != e; ++i) {
+      Value *V = PN->getIncomingValue(i);
+      if (V == PN)
+        continue;
+      APInt Zero(BitWidth, 0), One(BitWidth, 0);
+      unsigned SignBits;
+      if (isa<Instruction>(V)) {
+        // An instruction that has not been analyzed yet is on a back edge,
+        // or in a block that is never reached.
+        if (!getKnownBits(V, Zero, One)) {
+          Incomplete = true;
+          continue;
+        }
+        SignBits = getNumSignBits(V);
+      } else {
+        ComputeMaskedBits(V, Zero, One, TD);
+        SignBits = ComputeNumSignBits(V, TD);
+      }
+      KnownZero &= Zero;
+      KnownOne &= One;
+      NumSignBits = std::min(NumSignBits, SignBits);
+      Any = true;
+    }
+
+    // What the incoming values say goes on top of what ComputeMaskedBits
+    // found, unless the two disagree, which only a wrong assumption about a
+    // loop can cause.
+    if (Any && ((New.KnownZero | KnownZero) & (New.KnownOne | KnownOne)) == 0) {
+      New.KnownZero |= KnownZero;
+      New.KnownOne |= KnownOne;
+      New.NumSignBits = std::max(New.NumSignBits, NumSignBits);
+    }
+  }
+
+  EntryMapType::iterator It = Entries.find(PN);
+  if (It == Entries.end()) {
+    Entries[PN] = New;
+    return Incomplete;
+  }
+
+  Entry &Old = It->second;
+  New.KnownZero &= Old.KnownZero;
+  New.KnownOne &= Old.KnownOne;
+  New.NumSignBits = std::min(New.NumSignBits, Old.NumSignBits);
+  if (New.KnownZero == Old.KnownZero && New.KnownOne == Old.KnownOne &&
+      New.NumSignBits == Old.NumSignBits)
+    return false;
+
+  // Keep only the bits below the lowest one that changed.  Low bits hold
+  // still in loops that step by a multiple of a power of two, while the high
+  // ones would be lost one pass at a time.
+  if (Widen) {
+    APInt Changed = (New.KnownZero ^ Old.KnownZero) |
+                    (New.KnownOne ^ Old.KnownOne);
+    APInt Low = APInt::getLowBitsSet(Changed.getBitWidth(),
+                                     Changed.countTrailingZeros());
+    New.KnownZero &= Low;
+    New.KnownOne &= Low;
+    New.NumSignBits = 1;
+    ++NumWidened;
+  }
+  Old = New;
+  return true;
+}
+
+/// runPass - Analyze the instructions of Blocks in order.  Return true if a
+/// loop phi changed.
+bool KnownBitsCache::runPass(ArrayRef<BasicBlock*> Blocks, unsigned Pass,
+                             bool Optimistic) {
+  ++NumPasses;
+  bool Changed = false;
+  for (unsigned i = 0, e = Blocks.size(); i != e; ++i)
+    for (BasicBlock::iterator I = Blocks[i]->begin(), E = Blocks[i]->end();
+         I != E; ++I) {
+      if (!isTracked(I))
+        continue;
+      if (PHINode *PN = dyn_cast<PHINode>(I))
+        Changed |= analyzePHI(PN, Optimistic, Pass >= WidenAfter);
+      else
+        Entries[I] = analyze(I);
+    }
+  return Changed;
+}
+
+void KnownBitsCache::compute(Function &F) {
+  KnownBitsCache *Prev = getActive();
+  setActive(this);
+  Entries.clear();
+
+  ReversePostOrderTraversal<Function*> RPOT(&F);
+  SmallVector<BasicBlock*, 32> Blocks(RPOT.begin(), RPOT.end());
+
+  bool Converged = false;
+  for (unsigned Pass = 0; Pass != MaxPasses; ++Pass)
+    if (!runPass(Blocks, Pass, true)) {
+      Converged = true;
+      break;
+    }
+
+  // The assumptions about the loop phis still do not hold.  Analyze the
+  // function once more making none; a phi then only uses the entries of
+  // incoming values that dominate it.
+  if (!Converged) {
+    ++NumNotConverged;
+    Entries.clear();
+    runPass(Blocks, 0, false);
+  }
+
+  setActive(Prev);
+}
+
+/// refine - Analyze I again, keeping what was known about it before.  Return
+/// true if more is known now.
+bool KnownBitsCache::refine(Instruction *I) {
+  EntryMapType::iterator It = Entries.find(I);
+  if (It == Entries.end())
+    return false;
+  Entry New = analyze(I);
+  Entry &Old = It->second;
+  New.KnownZero |= Old.KnownZero;
+  New.KnownOne |= Old.KnownOne;
+  New.NumSignBits = std::max(New.NumSignBits, Old.NumSignBits);
+  if ((New.KnownZero & New.KnownOne) != 0 ||
+      (New.KnownZero == Old.KnownZero && New.KnownOne == Old.KnownOne &&
+       New.NumSignBits == Old.NumSignBits))
+    return false;
+  Old = New;
+  return true;
+}
+
+void KnownBitsCache::update(Instruction *I) {
+  KnownBitsCache *Prev = getActive();
+  setActive(this);
+
+  // Instructions with a single use are the only ones a rewrite of I may have
+  // changed along with it.  They form a tree above I; analyze it leaves
+  // first.
+  SmallVector<Instruction*, 8> Tree;
+  SmallPtrSet<Instruction*, 8> InTree;
+  Tree.push_back(I);
+  InTree.insert(I);
+  for (unsigned i = 0; i != Tree.size(); ++i)
+    for (User::op_iterator OI = Tree[i]->op_begin(), OE = Tree[i]->op_end();
+         OI != OE; ++OI)
+      if (Instruction *Op = dyn_cast<Instruction>(*OI))
+        if (Op->hasOneUse() && InTree.insert(Op))
+          Tree.push_back(Op);
+  for (unsigned i = Tree.size(); i != 0; --i) {
+    Instruction *T = Tree[i - 1];
+    Entries.erase(T);
+    if (isTracked(T))
+      Entries[T] = analyze(T);
+  }
+
+  // The users of I compute what they did before, so what was known about
+  // them still holds, but more may be known now.
+  refineUsersOf(I);
+
+  setActive(Prev);
+}
+
+void KnownBitsCache::refineUsers(Value *V) {
+  KnownBitsCache *Prev = getActive();
+  setActive(this);
+  if (Instruction *I = dyn_cast<Instruction>(V))
+    refine(I);
+  refineUsersOf(V);
+  setActive(Prev);
+}
+
+/// refineUsersOf - Refine the instructions that use V, and theirs in turn
+/// while more is found.  Facts only grow, so this ends.
+void KnownBitsCache::refineUsersOf(Value *V) {
+  SmallVector<Value*, 16> Worklist;
+  Worklist.push_back(V);
+  while (!Worklist.empty()) {
+    Value *Cur = Worklist.pop_back_val();
+    for (Value::use_iterator UI = Cur->use_begin(), UE = Cur->use_end();
+         UI != UE; ++UI)
+      if (Instruction *User = dyn_cast<Instruction>(*UI))
+        if (refine(User))
+          Worklist.push_back(User);
+  }
+}
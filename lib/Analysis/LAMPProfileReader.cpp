@@ -0,0 +1,279 @@
+//===- LAMPProfileReader.cpp - Read LAMP dependence profiles --------------===//
+//
+//                      The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the LAMPProfileReader class and the writers used by
+// llvm-lamp-prof to convert between the binary and text profile formats.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/LAMPProfileReader.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+#include <algorithm>
+#include <cstring>
+using namespace llvm;
+
+namespace {
+  struct DepRecordLess {
+    bool operator()(const LAMPDepRecord &LHS, const LAMPDepRecord &RHS) const {
+      if (LHS.LoopId != RHS.LoopId) return LHS.LoopId < RHS.LoopId;
+      if (LHS.SrcId != RHS.SrcId) return LHS.SrcId < RHS.SrcId;
+      if (LHS.DstId != RHS.DstId) return LHS.DstId < RHS.DstId;
+      return LHS.CrossIter < RHS.CrossIter;
+    }
+  };
+
+  struct LoopEntryLess {
+    bool operator()(const LAMPLoopIndexEntry &LHS, unsigned LoopId) const {
+      return LHS.LoopId < LoopId;
+    }
+  };
+}
+
+LAMPProfileReader::~LAMPProfileReader() {}
+
+LAMPProfileReader *LAMPProfileReader::Create(StringRef Filename,
+                                             std::string &ErrMsg) {
+  OwningPtr<LAMPProfileReader> Reader(new LAMPProfileReader());
+
+  // Profiles can be several gigabytes; don't ask for a null terminator so the
+  // file can be mapped instead of copied.
+  if (error_code ec = MemoryBuffer::getFile(Filename, Reader->Buffer, -1,
+                                            false)) {
+    ErrMsg = "Could not open " + Filename.str() + ": " + ec.message();
+    return 0;
+  }
+
+  StringRef Data = Reader->Buffer->getBuffer();
+  bool Failed;
+  if (Data.startswith(StringRef(LAMP_PROFILE_MAGIC, LAMP_PROFILE_MAGIC_SIZE)))
+    Failed = Reader->readBinary(ErrMsg);
+  else
+    Failed = Reader->readText(ErrMsg);
+  if (Failed) {
+    ErrMsg = Filename.str() + ": " + ErrMsg;
+    return 0;
+  }
+  return Reader.take();
+}
+
+/// readBinary - Validate the header of a binary profile and point Records and
+/// Loops into the mapped file.  Returns true on error.
+bool LAMPProfileReader::readBinary(std::string &ErrMsg) {
+  Binary = true;
+  const char *Start = Buffer->getBufferStart();
+  uint64_t Size = Buffer->getBufferSize();
+
+  if (Size < sizeof(LAMPProfileHeader)) {
+    ErrMsg = "truncated LAMP profile header";
+    return true;
+  }
+  const LAMPProfileHeader *Header =
+    reinterpret_cast<const LAMPProfileHeader *>(Start);
+  if (Header->Version != LAMP_PROFILE_VERSION ||
+      Header->HeaderSize != sizeof(LAMPProfileHeader)) {
+    ErrMsg = "unsupported LAMP profile version or byte order";
+    return true;
+  }
+
+  // Check each offset against the size before the section length against
+  // what is left after it, so that a huge offset cannot wrap around.
+  if (Header->RecordsOffset > Size || Header->LoopIndexOffset > Size ||
+      Header->NumRecords >
+        (Size - Header->RecordsOffset) / sizeof(LAMPDepRecord) ||
+      Header->NumLoops >
+        (Size - Header->LoopIndexOffset) / sizeof(LAMPLoopIndexEntry) ||
+      Header->RecordsOffset < sizeof(LAMPProfileHeader) ||
+      Header->LoopIndexOffset < sizeof(LAMPProfileHeader) ||
+      Header->RecordsOffset % 8 || Header->LoopIndexOffset % 8) {
+    ErrMsg = "corrupt LAMP profile section table";
+    return true;
+  }
+
+  // The sections can only be used in place if the buffer itself is suitably
+  // aligned, which both mapped and heap buffers are in practice.
+  if (reinterpret_cast<uintptr_t>(Start) % 8) {
+    const LAMPDepRecord *R =
+      reinterpret_cast<const LAMPDepRecord *>(Start + Header->RecordsOffset);
+    OwnedRecords.resize(Header->NumRecords);
+    if (!OwnedRecords.empty())
+      memcpy(&OwnedRecords[0], R, Header->NumRecords * sizeof(LAMPDepRecord));
+    adoptOwnedRecords();
+    return false;
+  }
+
+  Records = ArrayRef<LAMPDepRecord>(
+    reinterpret_cast<const LAMPDepRecord *>(Start + Header->RecordsOffset),
+    Header->NumRecords);
+  Loops = ArrayRef<LAMPLoopIndexEntry>(
+    reinterpret_cast<const LAMPLoopIndexEntry *>(Start +
+                                                 Header->LoopIndexOffset),
+    Header->NumLoops);
+
+  for (unsigned i = 0, e = Loops.size(); i != e; ++i)
+    if (Loops[i].FirstRecord > Records.size() ||
+        Loops[i].NumRecords > Records.size() - Loops[i].FirstRecord) {
+      ErrMsg = "corrupt LAMP profile loop index";
+      return true;
+    }
+  return false;
+}
+
+/// readText - Parse the legacy text profile.  The file starts with the
+/// "BEGIN Memory Profile" banner and is followed by six numbers per
+/// dependence: source id, cross-iteration flag, loop id, destination id,
+/// count and one trailing column that is not used.  Tokens containing ')'
+/// are annotations and are skipped, a leading '(' is ignored, and "END"
+/// terminates the profile.  Returns true on error.
+bool LAMPProfileReader::readText(std::string &ErrMsg) {
+  Binary = false;
+  StringRef Data = Buffer->getBuffer();
+
+  // Discard the banner ("BEGIN" "Memory" "Profile").
+  unsigned BannerWords = 0;
+  while (BannerWords != 3) {
+    std::pair<StringRef, StringRef> Split = getToken(Data);
+    if (Split.first.empty()) {
+      ErrMsg = "missing LAMP profile banner";
+      return true;
+    }
+    Data = Split.second;
+    ++BannerWords;
+  }
+
+  uint64_t Fields[6];
+  unsigned NumFields = 0;
+  while (true) {
+    std::pair<StringRef, StringRef> Split = getToken(Data);
+    StringRef Tok = Split.first;
+    Data = Split.second;
+    if (Tok.empty())
+      break;
+    if (Tok.find(')') != StringRef::npos)
+      continue;
+    if (Tok.startswith("("))
+      Tok = Tok.substr(1);
+    if (Tok.find("END") != StringRef::npos)
+      break;
+    if (Tok.empty())
+      continue;
+
+    unsigned long long Value;
+    if (Tok.getAsInteger(10, Value)) {
+      ErrMsg = "unexpected token '" + Tok.str() + "' in LAMP profile";
+      return true;
+    }
+    Fields[NumFields++] = Value;
+
+    // The record is complete once the count has been read; the sixth column
+    // only has to be consumed.
+    if (NumFields == 5) {
+      LAMPDepRecord R;
+      R.SrcId = Fields[0];
+      R.CrossIter = Fields[1];
+      R.LoopId = Fields[2];
+      R.DstId = Fields[3];
+      R.Count = Fields[4];
+      OwnedRecords.push_back(R);
+    } else if (NumFields == 6) {
+      NumFields = 0;
+    }
+  }
+
+  SortLAMPDepRecords(OwnedRecords);
+  adoptOwnedRecords();
+  return false;
+}
+
+void LAMPProfileReader::adoptOwnedRecords() {
+  BuildLAMPLoopIndex(OwnedRecords, OwnedLoops);
+  Records = OwnedRecords;
+  Loops = OwnedLoops;
+}
+
+ArrayRef<LAMPDepRecord>
+LAMPProfileReader::getLoopRecords(unsigned LoopId) const {
+  const LAMPLoopIndexEntry *I =
+    std::lower_bound(Loops.begin(), Loops.end(), LoopId, LoopEntryLess());
+  if (I == Loops.end() || I->LoopId != LoopId)
+    return ArrayRef<LAMPDepRecord>();
+  return Records.slice(I->FirstRecord, I->NumRecords);
+}
+
+const LAMPDepRecord *LAMPProfileReader::lookup(unsigned LoopId, unsigned SrcId,
+                                               unsigned DstId) const {
+  ArrayRef<LAMPDepRecord> InLoop = getLoopRecords(LoopId);
+  LAMPDepRecord Key;
+  Key.LoopId = LoopId;
+  Key.SrcId = SrcId;
+  Key.DstId = DstId;
+  Key.CrossIter = 0;
+  const LAMPDepRecord *I =
+    std::lower_bound(InLoop.begin(), InLoop.end(), Key, DepRecordLess());
+  if (I == InLoop.end() || I->SrcId != SrcId || I->DstId != DstId)
+    return 0;
+  return I;
+}
+
+void llvm::SortLAMPDepRecords(std::vector<LAMPDepRecord> &Records) {
+  std::stable_sort(Records.begin(), Records.end(), DepRecordLess());
+}
+
+void llvm::BuildLAMPLoopIndex(ArrayRef<LAMPDepRecord> Records,
+                              std::vector<LAMPLoopIndexEntry> &Loops) {
+  Loops.clear();
+  for (unsigned i = 0, e = Records.size(); i != e; ++i) {
+    if (Loops.empty() || Loops.back().LoopId != Records[i].LoopId) {
+      LAMPLoopIndexEntry Entry;
+      Entry.LoopId = Records[i].LoopId;
+      Entry.Reserved = 0;
+      Entry.FirstRecord = i;
+      Entry.NumRecords = 0;
+      Loops.push_back(Entry);
+    }
+    ++Loops.back().NumRecords;
+  }
+}
+
+void llvm::WriteLAMPBinaryProfile(raw_ostream &OS,
+                                  ArrayRef<LAMPDepRecord> Records) {
+  std::vector<LAMPLoopIndexEntry> Loops;
+  BuildLAMPLoopIndex(Records, Loops);
+
+  LAMPProfileHeader Header;
+  memcpy(Header.Magic, LAMP_PROFILE_MAGIC, LAMP_PROFILE_MAGIC_SIZE);
+  Header.Version = LAMP_PROFILE_VERSION;
+  Header.HeaderSize = sizeof(LAMPProfileHeader);
+  Header.NumRecords = Records.size();
+  Header.RecordsOffset = sizeof(LAMPProfileHeader);
+  Header.NumLoops = Loops.size();
+  Header.LoopIndexOffset = Header.RecordsOffset +
+                           Records.size() * sizeof(LAMPDepRecord);
+
+  OS.write(reinterpret_cast<const char *>(&Header), sizeof(Header));
+  if (!Records.empty())
+    OS.write(reinterpret_cast<const char *>(Records.data()),
+             Records.size() * sizeof(LAMPDepRecord));
+  if (!Loops.empty())
+    OS.write(reinterpret_cast<const char *>(&Loops[0]),
+             Loops.size() * sizeof(LAMPLoopIndexEntry));
+}
+
+void llvm::WriteLAMPTextProfile(raw_ostream &OS,
+                                ArrayRef<LAMPDepRecord> Records) {
+  OS << LAMP_TEXT_PROFILE_BANNER << '\n';
+  for (unsigned i = 0, e = Records.size(); i != e; ++i) {
+    const LAMPDepRecord &R = Records[i];
+    OS << R.SrcId << ' ' << R.CrossIter << ' ' << R.LoopId << ' '
+       << R.DstId << ' ' << R.Count << " 0\n";
+  }
+  OS << "END Memory Profile\n";
+}
@@ -14,8 +14,10 @@
 
 #define DEBUG_TYPE "lazy-value-info"
 #include "llvm/Analysis/LazyValueInfo.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Analysis/ConstantFolding.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/Constants.h"
@@ -391,6 +393,12 @@ namespace {
     /// getValueOnEdge - This is the query interface to determine the lattice
     /// value for the specified Value* that is true on the specified edge.
     LVILatticeVal getValueOnEdge(Value *V, BasicBlock *FromBB,BasicBlock *ToBB);
+
+    /// getValuesOnEdges - This is the batch query interface: append to
+    /// Results what getValueOnEdge would return for each of Queries, solving
+    /// the block values all of them need in one go.
+    void getValuesOnEdges(ArrayRef<LazyValueInfo::EdgeQuery> Queries,
+                          SmallVectorImpl<LVILatticeVal> &Results);
     
     /// threadEdge - This is the update interface to inform the cache that an
     /// edge from PredBB to OldSucc has been threaded to be from PredBB to
@@ -938,6 +946,47 @@ getValueOnEdge(Value *V, BasicBlock *FromBB, BasicBlock *ToBB) {
   return Result;
 }
 
+void LazyValueInfoCache::
+getValuesOnEdges(ArrayRef<LazyValueInfo::EdgeQuery> Queries,
+                 SmallVectorImpl<LVILatticeVal> &Results) {
+  DEBUG(dbgs() << "LVI Getting " << Queries.size() << " edge values\n");
+
+  // Look at each distinct edge once.  Those that cannot be answered from the
+  // cache leave the block value they need on BlockValueStack.  This is done
+  // back to front, so that the block values are solved in the order of the
+  // queries, and the answers are the same as those of one query at a time.
+  typedef std::pair<Value*, std::pair<BasicBlock*, BasicBlock*> > EdgeKeyTy;
+  DenseMap<EdgeKeyTy, unsigned> EdgeIndex;
+  SmallVector<LVILatticeVal, 16> EdgeVals;
+  SmallVector<unsigned, 16> Unsolved, QueryEdge(Queries.size());
+  for (unsigned i = Queries.size(); i != 0; --i) {
+    const LazyValueInfo::EdgeQuery &Q = Queries[i - 1];
+    std::pair<DenseMap<EdgeKeyTy, unsigned>::iterator, bool> Ins =
+      EdgeIndex.insert(std::make_pair(
+        std::make_pair(Q.V, std::make_pair(Q.FromBB, Q.ToBB)), EdgeVals.size()));
+    QueryEdge[i - 1] = Ins.first->second;
+    if (!Ins.second)
+      continue;
+    EdgeVals.push_back(LVILatticeVal());
+    if (!getEdgeValue(Q.V, Q.FromBB, Q.ToBB, EdgeVals.back()))
+      Unsolved.push_back(i - 1);
+  }
+
+  // Solve everything that was pushed with a single worklist, then pick up
+  // the values of the edges that had to wait for it.
+  solve();
+  for (unsigned i = 0, e = Unsolved.size(); i != e; ++i) {
+    const LazyValueInfo::EdgeQuery &Q = Queries[Unsolved[i]];
+    bool WasFastQuery = getEdgeValue(Q.V, Q.FromBB, Q.ToBB,
+                                     EdgeVals[QueryEdge[Unsolved[i]]]);
+    (void)WasFastQuery;
+    assert(WasFastQuery && "More work to do after problem solved?");
+  }
+
+  for (unsigned i = 0, e = Queries.size(); i != e; ++i)
+    Results.push_back(EdgeVals[QueryEdge[i]]);
+}
+
 void LazyValueInfoCache::threadEdge(BasicBlock *PredBB, BasicBlock *OldSucc,
                                     BasicBlock *NewSucc) {
   // When an edge in the graph has been threaded, values that we could not 
@@ -1046,12 +1095,9 @@ Constant *LazyValueInfo::getConstant(Value *V, BasicBlock *BB) {
   return 0;
 }
 
-/// getConstantOnEdge - Determine whether the specified value is known to be a
-/// constant on the specified edge.  Return null if not.
-Constant *LazyValueInfo::getConstantOnEdge(Value *V, BasicBlock *FromBB,
-                                           BasicBlock *ToBB) {
-  LVILatticeVal Result = getCache(PImpl).getValueOnEdge(V, FromBB, ToBB);
-  
+/// getConstantResult - Return the constant the lattice value Result of V
+/// pins V down to, or null if there is none.
+static Constant *getConstantResult(Value *V, const LVILatticeVal &Result) {
   if (Result.isConstant())
     return Result.getConstant();
   if (Result.isConstantRange()) {
@@ -1062,51 +1108,56 @@ Constant *LazyValueInfo::getConstantOnEdge(Value *V, BasicBlock *FromBB,
   return 0;
 }
 
-/// getPredicateOnEdge - Determine whether the specified value comparison
-/// with a constant is known to be true or false on the specified CFG edge.
-/// Pred is a CmpInst predicate.
-LazyValueInfo::Tristate
-LazyValueInfo::getPredicateOnEdge(unsigned Pred, Value *V, Constant *C,
-                                  BasicBlock *FromBB, BasicBlock *ToBB) {
+/// getConstantOnEdge - Determine whether the specified value is known to be a
+/// constant on the specified edge.  Return null if not.
+Constant *LazyValueInfo::getConstantOnEdge(Value *V, BasicBlock *FromBB,
+                                           BasicBlock *ToBB) {
   LVILatticeVal Result = getCache(PImpl).getValueOnEdge(V, FromBB, ToBB);
-  
+  return getConstantResult(V, Result);
+}
+
+/// getPredicateResult - Determine whether the comparison "V Pred C" is known
+/// to be true or false given the lattice value Result of V.
+static LazyValueInfo::Tristate
+getPredicateResult(unsigned Pred, Constant *C, const LVILatticeVal &Result,
+                   const DataLayout *TD, const TargetLibraryInfo *TLI) {
   // If we know the value is a constant, evaluate the conditional.
   Constant *Res = 0;
   if (Result.isConstant()) {
     Res = ConstantFoldCompareInstOperands(Pred, Result.getConstant(), C, TD,
                                           TLI);
     if (ConstantInt *ResCI = dyn_cast<ConstantInt>(Res))
-      return ResCI->isZero() ? False : True;
-    return Unknown;
+      return ResCI->isZero() ? LazyValueInfo::False : LazyValueInfo::True;
+    return LazyValueInfo::Unknown;
   }
   
   if (Result.isConstantRange()) {
     ConstantInt *CI = dyn_cast<ConstantInt>(C);
-    if (!CI) return Unknown;
+    if (!CI) return LazyValueInfo::Unknown;
     
     ConstantRange CR = Result.getConstantRange();
     if (Pred == ICmpInst::ICMP_EQ) {
       if (!CR.contains(CI->getValue()))
-        return False;
+        return LazyValueInfo::False;
       
       if (CR.isSingleElement() && CR.contains(CI->getValue()))
-        return True;
+        return LazyValueInfo::True;
     } else if (Pred == ICmpInst::ICMP_NE) {
       if (!CR.contains(CI->getValue()))
-        return True;
+        return LazyValueInfo::True;
       
       if (CR.isSingleElement() && CR.contains(CI->getValue()))
-        return False;
+        return LazyValueInfo::False;
     }
     
     // Handle more complex predicates.
     ConstantRange TrueValues =
         ICmpInst::makeConstantRange((ICmpInst::Predicate)Pred, CI->getValue());
     if (TrueValues.contains(CR))
-      return True;
+      return LazyValueInfo::True;
     if (TrueValues.inverse().contains(CR))
-      return False;
-    return Unknown;
+      return LazyValueInfo::False;
+    return LazyValueInfo::Unknown;
   }
   
   if (Result.isNotConstant()) {
@@ -1118,19 +1169,47 @@ LazyValueInfo::getPredicateOnEdge(unsigned Pred, Value *V, Constant *C,
                                             Result.getNotConstant(), C, TD,
                                             TLI);
       if (Res->isNullValue())
-        return False;
+        return LazyValueInfo::False;
     } else if (Pred == ICmpInst::ICMP_NE) {
       // !C1 != C -> true iff C1 == C.
       Res = ConstantFoldCompareInstOperands(ICmpInst::ICMP_NE,
                                             Result.getNotConstant(), C, TD,
                                             TLI);
       if (Res->isNullValue())
-        return True;
+        return LazyValueInfo::True;
     }
-    return Unknown;
+    return LazyValueInfo::Unknown;
   }
   
-  return Unknown;
+  return LazyValueInfo::Unknown;
+}
+
+/// getPredicateOnEdge - Determine whether the specified value comparison
+/// with a constant is known to be true or false on the specified CFG edge.
+/// Pred is a CmpInst predicate.
+LazyValueInfo::Tristate
+LazyValueInfo::getPredicateOnEdge(unsigned Pred, Value *V, Constant *C,
+                                  BasicBlock *FromBB, BasicBlock *ToBB) {
+  LVILatticeVal Result = getCache(PImpl).getValueOnEdge(V, FromBB, ToBB);
+  return getPredicateResult(Pred, C, Result, TD, TLI);
+}
+
+void LazyValueInfo::getConstantsOnEdges(ArrayRef<EdgeQuery> Queries,
+                                        SmallVectorImpl<Constant*> &Results) {
+  SmallVector<LVILatticeVal, 16> Vals;
+  getCache(PImpl).getValuesOnEdges(Queries, Vals);
+  for (unsigned i = 0, e = Queries.size(); i != e; ++i)
+    Results.push_back(getConstantResult(Queries[i].V, Vals[i]));
+}
+
+void LazyValueInfo::getPredicatesOnEdges(ArrayRef<PredicateQuery> Queries,
+                                         SmallVectorImpl<Tristate> &Results) {
+  SmallVector<EdgeQuery, 16> Edges(Queries.begin(), Queries.end());
+  SmallVector<LVILatticeVal, 16> Vals;
+  getCache(PImpl).getValuesOnEdges(Edges, Vals);
+  for (unsigned i = 0, e = Queries.size(); i != e; ++i)
+    Results.push_back(getPredicateResult(Queries[i].Pred, Queries[i].C,
+                                         Vals[i], TD, TLI));
 }
 
 void LazyValueInfo::threadEdge(BasicBlock *PredBB, BasicBlock *OldSucc,
@@ -14,6 +14,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Analysis/LoopPass.h"
+#include "llvm/Analysis/ScalarEvolution.h"
 #include "llvm/Assembly/PrintModulePass.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Timer.h"
@@ -225,7 +226,11 @@ bool LPPassManager::runOnFunction(Function &F) {
         PassManagerPrettyStackEntry X(P, *CurrentLoop->getHeader());
         TimeRegion PassTimer(getPassTimer(P));
 
-        Changed |= P->runOnLoop(CurrentLoop, *this);
+        if (P->runOnLoop(CurrentLoop, *this)) {
+          // Start a new epoch for the function analyses that cache results.
+          F.markModified();
+          Changed = true;
+        }
       }
 
       if (Changed)
@@ -270,6 +275,13 @@ bool LPPassManager::runOnFunction(Function &F) {
         freePass(P, "<deleted>", ON_LOOP_MSG);
       }
 
+    // Once the passes are done with a whole loop nest, ScalarEvolution may
+    // drop what it knows about it.
+    if (!skipThisLoop && !redoThisLoop && !CurrentLoop->getParentLoop())
+      if (Pass *P = findAnalysisPass(&ScalarEvolution::ID, true))
+        ((ScalarEvolution*)P->getAdjustedAnalysisPointer(&ScalarEvolution::ID))
+          ->releaseLoopNest(CurrentLoop);
+
     // Pop the loop from queue after running all passes.
     LQ.pop_back();
 
@@ -0,0 +1,109 @@
+//===- LoopTimeProfileReader.cpp - Read loop timing profiles --------------===//
+//
+//                      The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the LoopTimeProfileReader class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/LoopTimeProfileReader.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SwapByteOrder.h"
+#include "llvm/Support/system_error.h"
+#include <algorithm>
+#include <cstring>
+using namespace llvm;
+
+namespace {
+  struct RecordIdLess {
+    bool operator()(const LoopTimeRecord &LHS, uint64_t LoopId) const {
+      return LHS.LoopId < LoopId;
+    }
+  };
+}
+
+const LoopTimeRecord *LoopTimeRun::lookup(uint64_t LoopId) const {
+  std::vector<LoopTimeRecord>::const_iterator I =
+    std::lower_bound(Records.begin(), Records.end(), LoopId, RecordIdLess());
+  if (I == Records.end() || I->LoopId != LoopId)
+    return 0;
+  return &*I;
+}
+
+LoopTimeProfileReader *LoopTimeProfileReader::Create(StringRef Filename,
+                                                     std::string &ErrMsg) {
+  OwningPtr<MemoryBuffer> Buffer;
+  if (error_code ec = MemoryBuffer::getFile(Filename, Buffer)) {
+    ErrMsg = "Could not open " + Filename.str() + ": " + ec.message();
+    return 0;
+  }
+
+  OwningPtr<LoopTimeProfileReader> Reader(new LoopTimeProfileReader());
+  if (Reader->read(Buffer->getBuffer(), ErrMsg)) {
+    ErrMsg = Filename.str() + ": " + ErrMsg;
+    return 0;
+  }
+  return Reader.take();
+}
+
+/// read - Parse the blocks in Data.  Every field of the header and of the
+/// records after the magic is a 32 or 64 bit integer, so a file from a host
+/// of the other byte order is converted field by field.  Returns true on
+/// error.
+bool LoopTimeProfileReader::read(StringRef Data, std::string &ErrMsg) {
+  while (!Data.empty()) {
+    LoopTimeRun Run;
+    if (Data.size() < sizeof(LoopTimeHeader) ||
+        !Data.startswith(StringRef(LOOPTIME_MAGIC, LOOPTIME_MAGIC_SIZE))) {
+      ErrMsg = "not a loop timing profile";
+      return true;
+    }
+    memcpy(&Run.Header, Data.data(), sizeof(LoopTimeHeader));
+
+    bool Swapped = false;
+    if (Run.Header.Version != LOOPTIME_VERSION &&
+        sys::SwapByteOrder_32(Run.Header.Version) == LOOPTIME_VERSION) {
+      Swapped = true;
+      LoopTimeHeader &H = Run.Header;
+      H.Version = sys::SwapByteOrder_32(H.Version);
+      H.HeaderSize = sys::SwapByteOrder_32(H.HeaderSize);
+      H.ProgramId = sys::SwapByteOrder_64(H.ProgramId);
+      H.CopyCount = sys::SwapByteOrder_64(H.CopyCount);
+      H.CyclesPerSecond = sys::SwapByteOrder_64(H.CyclesPerSecond);
+      H.TimerOverhead = sys::SwapByteOrder_64(H.TimerOverhead);
+      H.NumRecords = sys::SwapByteOrder_64(H.NumRecords);
+    }
+    if (Run.Header.Version != LOOPTIME_VERSION ||
+        Run.Header.HeaderSize != sizeof(LoopTimeHeader)) {
+      ErrMsg = "unsupported loop timing profile version";
+      return true;
+    }
+    Data = Data.substr(sizeof(LoopTimeHeader));
+
+    uint64_t NumRecords = Run.Header.NumRecords;
+    if (NumRecords > Data.size() / sizeof(LoopTimeRecord)) {
+      ErrMsg = "truncated loop timing profile";
+      return true;
+    }
+    Run.Records.resize(NumRecords);
+    if (NumRecords)
+      memcpy(&Run.Records[0], Data.data(), NumRecords * sizeof(LoopTimeRecord));
+    Data = Data.substr(NumRecords * sizeof(LoopTimeRecord));
+
+    if (Swapped)
+      for (unsigned i = 0, e = Run.Records.size(); i != e; ++i) {
+        uint64_t *Fields = reinterpret_cast<uint64_t *>(&Run.Records[i]);
+        for (unsigned j = 0; j != sizeof(LoopTimeRecord) / 8; ++j)
+          Fields[j] = sys::SwapByteOrder_64(Fields[j]);
+      }
+
+    Runs.push_back(Run);
+  }
+  return false;
+}
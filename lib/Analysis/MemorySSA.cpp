@@ -0,0 +1,454 @@
+//===- MemorySSA.cpp - Memory SSA form ------------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the MemorySSA analysis.  The graph is built the way
+// SSA form is built for a single variable: a phi goes at every block with
+// more than one reachable predecessor edge, a walk over the dominator tree
+// links each access to the closest def above it, and phis whose incoming
+// values all agree are then folded away.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "memoryssa"
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Assembly/AssemblyAnnotationWriter.h"
+#include "llvm/Assembly/Writer.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FormattedStream.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+using namespace llvm;
+
+STATISTIC(NumMemoryPhis, "Number of memory phis left after pruning");
+STATISTIC(NumClobberQueries, "Number of clobber queries");
+STATISTIC(NumClobberCacheHits, "Number of clobber queries answered from cache");
+
+static cl::opt<unsigned>
+WalkLimit("memoryssa-walk-limit", cl::init(100), cl::Hidden,
+          cl::desc("The most defs and phis a clobber query looks at "
+                   "(default 100)"));
+
+char MemorySSA::ID = 0;
+INITIALIZE_PASS_BEGIN(MemorySSA, "memoryssa", "Memory SSA", false, true)
+INITIALIZE_AG_DEPENDENCY(AliasAnalysis)
+INITIALIZE_PASS_DEPENDENCY(DominatorTree)
+INITIALIZE_PASS_END(MemorySSA, "memoryssa", "Memory SSA", false, true)
+
+void MemoryAccess::printID(raw_ostream &OS) const {
+  if (ID)
+    OS << ID;
+  else
+    OS << "liveOnEntry";
+}
+
+void MemoryAccess::print(raw_ostream &OS) const {
+  switch (Kind) {
+  case UseKind:
+    OS << "MemoryUse(";
+    cast<MemoryUse>(this)->getDefiningAccess()->printID(OS);
+    OS << ')';
+    break;
+  case DefKind:
+    if (!cast<MemoryDef>(this)->getMemoryInst()) {
+      OS << "liveOnEntry";
+      break;
+    }
+    OS << ID << " = MemoryDef(";
+    cast<MemoryDef>(this)->getDefiningAccess()->printID(OS);
+    OS << ')';
+    break;
+  case PhiKind: {
+    const MemoryPhi *Phi = cast<MemoryPhi>(this);
+    OS << ID << " = MemoryPhi(";
+    for (unsigned i = 0, e = Phi->getNumIncomingValues(); i != e; ++i) {
+      if (i)
+        OS << ',';
+      BasicBlock *BB = Phi->getIncomingBlock(i);
+      OS << '{';
+      WriteAsOperand(OS, BB, false, BB->getParent()->getParent());
+      OS << ',';
+      Phi->getIncomingValue(i)->printID(OS);
+      OS << '}';
+    }
+    OS << ')';
+    break;
+  }
+  }
+}
+
+MemorySSA::MemorySSA()
+  : FunctionPass(ID), AA(0), DT(0), Fn(0), LiveOnEntry(0), Generation(1) {
+  initializeMemorySSAPass(*PassRegistry::getPassRegistry());
+}
+
+MemorySSA::~MemorySSA() {
+  releaseMemory();
+}
+
+void MemorySSA::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.setPreservesAll();
+  AU.addRequired<AliasAnalysis>();
+  AU.addRequired<DominatorTree>();
+}
+
+void MemorySSA::releaseMemory() {
+  for (DenseMap<const Instruction*, MemoryUseOrDef*>::iterator
+       I = Accesses.begin(), E = Accesses.end(); I != E; ++I)
+    delete I->second;
+  for (DenseMap<const BasicBlock*, MemoryPhi*>::iterator
+       I = Phis.begin(), E = Phis.end(); I != E; ++I)
+    delete I->second;
+  Accesses.clear();
+  Phis.clear();
+  delete LiveOnEntry;
+  LiveOnEntry = 0;
+  Fn = 0;
+}
+
+/// getAccessKind - Return true if I reads or writes memory, and set IsDef if
+/// it has to be a def: it may write memory, or it is a load that must stay
+/// ordered with the writes around it.
+static bool getAccessKind(Instruction *I, AliasAnalysis *AA, bool &IsDef) {
+  if (LoadInst *LI = dyn_cast<LoadInst>(I)) {
+    IsDef = !LI->isUnordered();
+    return true;
+  }
+  ImmutableCallSite CS(I);
+  if (CS) {
+    AliasAnalysis::ModRefBehavior MRB = AA->getModRefBehavior(CS);
+    if (MRB == AliasAnalysis::DoesNotAccessMemory)
+      return false;
+    IsDef = !AliasAnalysis::onlyReadsMemory(MRB);
+    return true;
+  }
+  IsDef = I->mayWriteToMemory();
+  return IsDef || I->mayReadFromMemory();
+}
+
+bool MemorySSA::runOnFunction(Function &F) {
+  AA = &getAnalysis<AliasAnalysis>();
+  DT = &getAnalysis<DominatorTree>();
+  Fn = &F;
+  LiveOnEntry = new MemoryDef(0, 0, 0);
+
+  placePhis(F);
+  renamePass();
+  removeTrivialPhis();
+  numberAccesses(F);
+  NumMemoryPhis += Phis.size();
+  return false;
+}
+
+/// placePhis - Put a phi at the start of every reachable block with more
+/// than one reachable predecessor edge.  Most of them turn out to be trivial
+/// and are folded away afterwards; that costs less than computing dominance
+/// frontiers to place only the ones that are needed.
+void MemorySSA::placePhis(Function &F) {
+  for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
+    if (!DT->isReachableFromEntry(BB))
+      continue;
+    unsigned NumPreds = 0;
+    for (pred_iterator PI = pred_begin(BB), PE = pred_end(BB); PI != PE; ++PI)
+      if (DT->isReachableFromEntry(*PI))
+        ++NumPreds;
+    if (NumPreds < 2)
+      continue;
+
+    MemoryPhi *Phi = new MemoryPhi(BB);
+    for (pred_iterator PI = pred_begin(BB), PE = pred_end(BB); PI != PE; ++PI)
+      if (DT->isReachableFromEntry(*PI))
+        Phi->Incoming.push_back(std::make_pair(*PI, (MemoryAccess*)0));
+    Phis[BB] = Phi;
+  }
+}
+
+/// renamePass - Walk the dominator tree, giving every memory instruction an
+/// access linked to the def above it and filling in the incoming values of
+/// the phis of successor blocks.
+void MemorySSA::renamePass() {
+  SmallVector<std::pair<DomTreeNode*, MemoryAccess*>, 32> Worklist;
+  Worklist.push_back(std::make_pair(DT->getRootNode(),
+                                    (MemoryAccess*)LiveOnEntry));
+  while (!Worklist.empty()) {
+    DomTreeNode *Node = Worklist.back().first;
+    MemoryAccess *Cur = Worklist.back().second;
+    Worklist.pop_back();
+
+    BasicBlock *BB = Node->getBlock();
+    if (MemoryPhi *Phi = Phis.lookup(BB))
+      Cur = Phi;
+
+    for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I) {
+      bool IsDef;
+      if (!getAccessKind(I, AA, IsDef))
+        continue;
+      MemoryUseOrDef *Access;
+      if (IsDef)
+        Access = new MemoryDef(I, Cur, BB);
+      else
+        Access = new MemoryUse(I, Cur, BB);
+      Cur->Users.insert(Access);
+      Accesses[I] = Access;
+      if (IsDef)
+        Cur = Access;
+    }
+
+    // Each edge to a successor with a phi fills in one incoming value.
+    for (succ_iterator SI = succ_begin(BB), SE = succ_end(BB); SI != SE;
+         ++SI) {
+      MemoryPhi *Phi = Phis.lookup(*SI);
+      if (!Phi)
+        continue;
+      for (unsigned i = 0, e = Phi->Incoming.size(); i != e; ++i)
+        if (Phi->Incoming[i].first == BB && !Phi->Incoming[i].second) {
+          Phi->Incoming[i].second = Cur;
+          Cur->Users.insert(Phi);
+          break;
+        }
+    }
+
+    for (DomTreeNode::iterator CI = Node->begin(), CE = Node->end(); CI != CE;
+         ++CI)
+      Worklist.push_back(std::make_pair(*CI, Cur));
+  }
+}
+
+/// replaceAllUsesWith - Make every user of From use To instead.  The phis
+/// among the users are added to ChangedPhis.
+void MemorySSA::replaceAllUsesWith(MemoryAccess *From, MemoryAccess *To,
+                                   SmallVectorImpl<MemoryPhi*> &ChangedPhis) {
+  for (MemoryAccess::user_iterator UI = From->user_begin(),
+       UE = From->user_end(); UI != UE; ++UI) {
+    MemoryAccess *U = *UI;
+    if (U == From)
+      continue;
+    if (MemoryUseOrDef *UD = dyn_cast<MemoryUseOrDef>(U)) {
+      UD->DefiningAccess = To;
+    } else {
+      MemoryPhi *Phi = cast<MemoryPhi>(U);
+      for (unsigned i = 0, e = Phi->Incoming.size(); i != e; ++i)
+        if (Phi->Incoming[i].second == From)
+          Phi->Incoming[i].second = To;
+      ChangedPhis.push_back(Phi);
+    }
+    To->Users.insert(U);
+  }
+  From->Users.clear();
+}
+
+/// removeTrivialPhis - Fold away the phis whose incoming values are all the
+/// same access, or the phi itself.  Folding one can make the phis that use
+/// it trivial in turn.
+void MemorySSA::removeTrivialPhis() {
+  SmallVector<MemoryPhi*, 32> Worklist;
+  for (Function::iterator BB = Fn->begin(), E = Fn->end(); BB != E; ++BB)
+    if (MemoryPhi *Phi = Phis.lookup(BB))
+      Worklist.push_back(Phi);
+
+  // Folded phis stay allocated until the end, so that the worklist can tell
+  // them from the live ones.
+  SmallVector<MemoryPhi*, 32> Dead;
+  while (!Worklist.empty()) {
+    MemoryPhi *Phi = Worklist.pop_back_val();
+    if (Phis.lookup(Phi->getBlock()) != Phi)
+      continue;
+
+    MemoryAccess *Same = 0;
+    bool Trivial = true;
+    for (unsigned i = 0, e = Phi->Incoming.size(); i != e; ++i) {
+      MemoryAccess *V = Phi->Incoming[i].second;
+      if (V == Phi || V == Same)
+        continue;
+      if (Same) {
+        Trivial = false;
+        break;
+      }
+      Same = V;
+    }
+    if (!Trivial || !Same)
+      continue;
+
+    Phis.erase(Phi->getBlock());
+    for (unsigned i = 0, e = Phi->Incoming.size(); i != e; ++i)
+      Phi->Incoming[i].second->Users.erase(Phi);
+    replaceAllUsesWith(Phi, Same, Worklist);
+    Dead.push_back(Phi);
+  }
+  DeleteContainerPointers(Dead);
+}
+
+/// numberAccesses - Number the phis and defs in the order they are printed.
+void MemorySSA::numberAccesses(Function &F) {
+  unsigned NextID = 0;
+  for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
+    if (MemoryPhi *Phi = Phis.lookup(BB))
+      Phi->ID = ++NextID;
+    for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+      if (MemoryUseOrDef *Access = Accesses.lookup(I))
+        if (isa<MemoryDef>(Access))
+          Access->ID = ++NextID;
+  }
+}
+
+MemoryAccess *MemorySSA::getClobberingMemoryAccess(Instruction *I) {
+  MemoryUseOrDef *Access = getMemoryAccess(I);
+  if (!Access)
+    return 0;
+
+  AliasAnalysis::Location Loc;
+  if (LoadInst *LI = dyn_cast<LoadInst>(I)) {
+    // Nothing writes the memory an invariant load reads.
+    if (LI->getMetadata(LLVMContext::MD_invariant_load))
+      return LiveOnEntry;
+    Loc = AA->getLocation(LI);
+  } else if (StoreInst *SI = dyn_cast<StoreInst>(I))
+    Loc = AA->getLocation(SI);
+  else
+    return Access->getDefiningAccess();
+
+  ++NumClobberQueries;
+  if (Access->Clobber && Access->ClobberGeneration == Generation) {
+    ++NumClobberCacheHits;
+    return Access->Clobber;
+  }
+
+  DenseMap<const MemoryPhi*, unsigned> Active;
+  DenseMap<const MemoryPhi*, MemoryAccess*> Done;
+  unsigned Steps = 0, MinCut = ~0U;
+  MemoryAccess *Clobber = findClobber(Access->getDefiningAccess(), Loc, Active,
+                                      Done, Steps, MinCut);
+  Access->Clobber = Clobber;
+  Access->ClobberGeneration = Generation;
+  return Clobber;
+}
+
+/// findClobber - Walk up from Start to the closest access that may modify
+/// Loc.  Active maps the phis being walked through to their depth in the
+/// walk.  Reaching one of them again closes a cycle with no clobber on it, so
+/// that path returns null and lowers MinCut to the depth of the phi: the
+/// answers found below it assume that phi has no clobber of its own on the
+/// other paths, and are only kept in Done once that phi is finished.
+MemoryAccess *
+MemorySSA::findClobber(MemoryAccess *Start, const AliasAnalysis::Location &Loc,
+                       DenseMap<const MemoryPhi*, unsigned> &Active,
+                       DenseMap<const MemoryPhi*, MemoryAccess*> &Done,
+                       unsigned &Steps, unsigned &MinCut) {
+  MemoryAccess *Cur = Start;
+  while (MemoryDef *Def = dyn_cast<MemoryDef>(Cur)) {
+    if (Def == LiveOnEntry || ++Steps > WalkLimit)
+      return Def;
+    Instruction *I = Def->getMemoryInst();
+    AliasAnalysis::ModRefResult MR = AA->getModRefInfo(I, Loc);
+    // A call can only get at a local object that was captured before it.
+    if (MR == AliasAnalysis::ModRef && ImmutableCallSite(I))
+      MR = AA->callCapturesBefore(I, Loc, DT);
+    if (MR & AliasAnalysis::Mod)
+      return Def;
+    Cur = Def->getDefiningAccess();
+  }
+
+  MemoryPhi *Phi = cast<MemoryPhi>(Cur);
+  DenseMap<const MemoryPhi*, MemoryAccess*>::iterator DI = Done.find(Phi);
+  if (DI != Done.end())
+    return DI->second;
+  DenseMap<const MemoryPhi*, unsigned>::iterator AI = Active.find(Phi);
+  if (AI != Active.end()) {
+    MinCut = std::min(MinCut, AI->second);
+    return 0;
+  }
+  if (++Steps > WalkLimit)
+    return Phi;
+
+  unsigned Depth = Active.size();
+  Active[Phi] = Depth;
+  unsigned PhiMinCut = ~0U;
+  MemoryAccess *Result = 0;
+  for (unsigned i = 0, e = Phi->getNumIncomingValues(); i != e; ++i) {
+    MemoryAccess *Clobber = findClobber(Phi->getIncomingValue(i), Loc, Active,
+                                        Done, Steps, PhiMinCut);
+    if (!Clobber || Clobber == Result)
+      continue;
+    if (Result) {
+      Result = Phi;
+      break;
+    }
+    Result = Clobber;
+  }
+  Active.erase(Phi);
+
+  if (!Result)
+    Result = Phi;
+  if (PhiMinCut >= Depth)
+    Done[Phi] = Result;
+  else
+    MinCut = std::min(MinCut, PhiMinCut);
+  return Result;
+}
+
+void MemorySSA::removeMemoryAccess(Instruction *I) {
+  DenseMap<const Instruction*, MemoryUseOrDef*>::iterator It =
+    Accesses.find(I);
+  if (It == Accesses.end())
+    return;
+  MemoryUseOrDef *Access = It->second;
+  Accesses.erase(It);
+
+  MemoryAccess *Def = Access->getDefiningAccess();
+  Def->Users.erase(Access);
+  if (isa<MemoryDef>(Access)) {
+    SmallVector<MemoryPhi*, 4> ChangedPhis;
+    replaceAllUsesWith(Access, Def, ChangedPhis);
+    ++Generation;
+  }
+  delete Access;
+}
+
+namespace {
+/// MemorySSAAnnotatedWriter - Prints the accesses of a function as comments
+/// above the instructions and blocks they belong to.
+class MemorySSAAnnotatedWriter : public AssemblyAnnotationWriter {
+  const MemorySSA *MSSA;
+
+public:
+  explicit MemorySSAAnnotatedWriter(const MemorySSA *M) : MSSA(M) {}
+
+  virtual void emitBasicBlockStartAnnot(const BasicBlock *BB,
+                                        formatted_raw_ostream &OS) {
+    if (MemoryPhi *Phi = MSSA->getMemoryPhi(BB)) {
+      OS << "  ; ";
+      Phi->print(OS);
+      OS << '\n';
+    }
+  }
+
+  virtual void emitInstructionAnnot(const Instruction *I,
+                                    formatted_raw_ostream &OS) {
+    if (MemoryAccess *Access = MSSA->getMemoryAccess(I)) {
+      OS << "  ; ";
+      Access->print(OS);
+      OS << '\n';
+    }
+  }
+};
+}
+
+void MemorySSA::print(raw_ostream &OS, const Module *) const {
+  if (!Fn)
+    return;
+  MemorySSAAnnotatedWriter Writer(this);
+  Fn->print(OS, &Writer);
+}
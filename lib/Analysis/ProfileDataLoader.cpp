@@ -95,6 +95,36 @@ static void ReadProfilingBlock(const char *ToolName, FILE *F,
   }
 }
 
+/// ReadProfilingBlock64 - Like ReadProfilingBlock, for a packet of 64-bit
+/// counters.  The counts saturate below Uncounted.
+static void ReadProfilingBlock64(const char *ToolName, FILE *F,
+                                 bool ShouldByteSwap,
+                                 SmallVector<unsigned, 32> &Data) {
+  // Read the number of entries...
+  unsigned NumEntries = ReadProfilingNumEntries(ToolName, F, ShouldByteSwap);
+
+  // Read in the data.
+  SmallVector<uint64_t, 8> TempSpace(NumEntries);
+  ReadProfilingData<uint64_t>(ToolName, F, TempSpace.data(), NumEntries);
+
+  // Make sure we have enough space ...
+  if (Data.size() < NumEntries)
+    Data.resize(NumEntries, ProfileDataLoader::Uncounted);
+
+  // Accumulate the data we just read into the existing data.
+  const uint64_t Max = ProfileDataLoader::Uncounted - 1;
+  for (unsigned i = 0; i < NumEntries; ++i) {
+    uint64_t Entry = ShouldByteSwap ? ByteSwap_64(TempSpace[i]) : TempSpace[i];
+    if (Entry == ~0ULL) {
+      Data[i] = AddCounts(ProfileDataLoader::Uncounted, Data[i]);
+      continue;
+    }
+    if (Data[i] != ProfileDataLoader::Uncounted)
+      Entry += Data[i];
+    Data[i] = Entry < Max ? unsigned(Entry) : unsigned(Max);
+  }
+}
+
 /// ReadProfilingArgBlock - Read the command line arguments that the progam was
 /// run with when the current profiling data packet(s) were generated.
 static void ReadProfilingArgBlock(const char *ToolName, FILE *F,
@@ -144,6 +174,10 @@ ProfileDataLoader::ProfileDataLoader(const char *ToolName,
         ReadProfilingBlock(ToolName, F, ShouldByteSwap, EdgeCounts);
         break;
 
+      case EdgeInfo64:
+        ReadProfilingBlock64(ToolName, F, ShouldByteSwap, EdgeCounts);
+        break;
+
       default:
         report_fatal_error(std::string(ToolName)
                            + ": Unknown profiling packet type");
@@ -16,6 +16,7 @@
 #include "llvm/Analysis/ProfileInfoTypes.h"
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/SwapByteOrder.h"
 #include "llvm/Support/raw_ostream.h"
 #include <cstdio>
 #include <cstdlib>
@@ -31,16 +32,19 @@ static inline unsigned ByteSwap(unsigned Var, bool Really) {
          ((Var & (255U<<24U)) >> 24U);
 }
 
-static unsigned AddCounts(unsigned A, unsigned B) {
+static uint64_t AddCounts(uint64_t A, uint64_t B) {
   // If either value is undefined, use the other.
   if (A == ProfileInfoLoader::Uncounted) return B;
   if (B == ProfileInfoLoader::Uncounted) return A;
   return A + B;
 }
 
+// ReadProfilingBlock - Read a packet of 32-bit (EdgeInfo etc.) or 64-bit
+// (EdgeInfo64 etc.) counters and accumulate it into Data.
+//
 static void ReadProfilingBlock(const char *ToolName, FILE *F,
-                               bool ShouldByteSwap,
-                               std::vector<unsigned> &Data) {
+                               bool ShouldByteSwap, bool Is64Bit,
+                               std::vector<uint64_t> &Data) {
   // Read the number of entries...
   unsigned NumEntries;
   if (fread(&NumEntries, sizeof(unsigned), 1, F) != 1) {
@@ -51,13 +55,29 @@ static void ReadProfilingBlock(const char *ToolName, FILE *F,
   NumEntries = ByteSwap(NumEntries, ShouldByteSwap);
 
   // Read the counts...
-  std::vector<unsigned> TempSpace(NumEntries);
-
-  // Read in the block of data...
-  if (fread(&TempSpace[0], sizeof(unsigned)*NumEntries, 1, F) != 1) {
-    errs() << ToolName << ": data packet truncated!\n";
-    perror(0);
-    exit(1);
+  std::vector<uint64_t> TempSpace(NumEntries);
+  if (Is64Bit) {
+    if (NumEntries &&
+        fread(&TempSpace[0], sizeof(uint64_t)*NumEntries, 1, F) != 1) {
+      errs() << ToolName << ": data packet truncated!\n";
+      perror(0);
+      exit(1);
+    }
+    if (ShouldByteSwap)
+      for (unsigned i = 0; i != NumEntries; ++i)
+        TempSpace[i] = sys::SwapByteOrder_64(TempSpace[i]);
+  } else {
+    std::vector<unsigned> Narrow(NumEntries);
+    if (NumEntries &&
+        fread(&Narrow[0], sizeof(unsigned)*NumEntries, 1, F) != 1) {
+      errs() << ToolName << ": data packet truncated!\n";
+      perror(0);
+      exit(1);
+    }
+    for (unsigned i = 0; i != NumEntries; ++i) {
+      unsigned Count = ByteSwap(Narrow[i], ShouldByteSwap);
+      TempSpace[i] = Count == ~0U ? ProfileInfoLoader::Uncounted : Count;
+    }
   }
 
   // Make sure we have enough space... The space is initialised to -1 to
@@ -66,18 +86,11 @@ static void ReadProfilingBlock(const char *ToolName, FILE *F,
     Data.resize(NumEntries, ProfileInfoLoader::Uncounted);
 
   // Accumulate the data we just read into the data.
-  if (!ShouldByteSwap) {
-    for (unsigned i = 0; i != NumEntries; ++i) {
-      Data[i] = AddCounts(TempSpace[i], Data[i]);
-    }
-  } else {
-    for (unsigned i = 0; i != NumEntries; ++i) {
-      Data[i] = AddCounts(ByteSwap(TempSpace[i], true), Data[i]);
-    }
-  }
+  for (unsigned i = 0; i != NumEntries; ++i)
+    Data[i] = AddCounts(TempSpace[i], Data[i]);
 }
 
-const unsigned ProfileInfoLoader::Uncounted = ~0U;
+const uint64_t ProfileInfoLoader::Uncounted = ~0ULL;
 
 // ProfileInfoLoader ctor - Read the specified profiling data file, exiting the
 // program if the file is invalid or broken.
@@ -125,23 +138,27 @@ ProfileInfoLoader::ProfileInfoLoader(const char *ToolName,
     }
 
     case FunctionInfo:
-      ReadProfilingBlock(ToolName, F, ShouldByteSwap, FunctionCounts);
+      ReadProfilingBlock(ToolName, F, ShouldByteSwap, false, FunctionCounts);
       break;
 
     case BlockInfo:
-      ReadProfilingBlock(ToolName, F, ShouldByteSwap, BlockCounts);
+      ReadProfilingBlock(ToolName, F, ShouldByteSwap, false, BlockCounts);
       break;
 
     case EdgeInfo:
-      ReadProfilingBlock(ToolName, F, ShouldByteSwap, EdgeCounts);
+    case EdgeInfo64:
+      ReadProfilingBlock(ToolName, F, ShouldByteSwap, PacketType == EdgeInfo64,
+                         EdgeCounts);
       break;
 
     case OptEdgeInfo:
-      ReadProfilingBlock(ToolName, F, ShouldByteSwap, OptimalEdgeCounts);
+    case OptEdgeInfo64:
+      ReadProfilingBlock(ToolName, F, ShouldByteSwap,
+                         PacketType == OptEdgeInfo64, OptimalEdgeCounts);
       break;
 
     case BBTraceInfo:
-      ReadProfilingBlock(ToolName, F, ShouldByteSwap, BBTrace);
+      ReadProfilingBlock(ToolName, F, ShouldByteSwap, false, BBTrace);
       break;
 
     default:
@@ -62,7 +62,7 @@ namespace {
     // blocks as possbile.
     virtual void recurseBasicBlock(const BasicBlock *BB);
     virtual void readEdgeOrRemember(Edge, Edge&, unsigned &, double &);
-    virtual void readEdge(ProfileInfo::Edge, std::vector<unsigned>&);
+    virtual void readEdge(ProfileInfo::Edge, std::vector<uint64_t>&);
 
     /// getAdjustedAnalysisPointer - This method is used when a pass implements
     /// an analysis interface through multiple inheritance.  If needed, it
@@ -130,14 +130,12 @@ void LoaderPass::recurseBasicBlock(const BasicBlock *BB) {
 }
 
 void LoaderPass::readEdge(ProfileInfo::Edge e,
-                          std::vector<unsigned> &ECs) {
+                          std::vector<uint64_t> &ECs) {
   if (ReadCount < ECs.size()) {
-    double weight = ECs[ReadCount++];
+    uint64_t weight = ECs[ReadCount++];
     if (weight != ProfileInfoLoader::Uncounted) {
-      // Here the data realm changes from the unsigned of the file to the
-      // double of the ProfileInfo. This conversion is save because we know
-      // that everything thats representable in unsinged is also representable
-      // in double.
+      // Here the data realm changes from the 64-bit counters of the file to
+      // the double of the ProfileInfo. Counts above 2^53 lose precision.
       EdgeInformation[getFunction(e)][e] += (double)weight;
 
       DEBUG(dbgs() << "--Read Edge Counter for " << e
@@ -155,7 +153,7 @@ bool LoaderPass::runOnModule(Module &M) {
   ProfileInfoLoader PIL("profile-loader", Filename);
 
   EdgeInformation.clear();
-  std::vector<unsigned> Counters = PIL.getRawEdgeCounts();
+  std::vector<uint64_t> Counters = PIL.getRawEdgeCounts();
   if (Counters.size() > 0) {
     ReadCount = 0;
     for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
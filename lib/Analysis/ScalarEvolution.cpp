@@ -98,6 +98,10 @@ STATISTIC(NumTripCountsNotComputed,
           "Number of loops without predictable loop counts");
 STATISTIC(NumBruteForceTripCountsComputed,
           "Number of loops with trip counts computed by force");
+STATISTIC(NumLoopNestsReleased,
+          "Number of loop nests whose SCEVs were dropped with -scev-sparse");
+STATISTIC(NumSCEVCacheResets,
+          "Number of times the SCEV caches went over -scev-cache-limit");
 
 static cl::opt<unsigned>
 MaxBruteForceIterations("scalar-evolution-max-iterations", cl::ReallyHidden,
@@ -106,6 +110,23 @@ MaxBruteForceIterations("scalar-evolution-max-iterations", cl::ReallyHidden,
                                  "derived loop"),
                         cl::init(100));
 
+static cl::opt<bool>
+SparseSCEV("scev-sparse", cl::Hidden,
+           cl::desc("Only analyze values that are in or feed loops, and drop "
+                    "the SCEVs of each loop nest once the loop passes are "
+                    "done with it"));
+
+static cl::opt<unsigned>
+SCEVCacheLimit("scev-cache-limit", cl::Hidden, cl::init(65536),
+               cl::desc("With -scev-sparse, the most kilobytes the SCEVs of "
+                        "a function may take between loop nests "
+                        "(default 65536)"));
+
+static cl::opt<bool>
+ReportFootprint("scev-report-footprint", cl::Hidden,
+                cl::desc("Print the peak memory the SCEVs of each function "
+                         "took"));
+
 // FIXME: Enable this with XDEBUG when the test suite is clean.
 static cl::opt<bool>
 VerifySCEV("verify-scev",
@@ -3578,6 +3599,11 @@ const SCEV *ScalarEvolution::createSCEV(Value *V) {
     // analysis depends on.
     if (!DT->isReachableFromEntry(I->getParent()))
       return getUnknown(V);
+
+    // In sparse mode, values that have nothing to do with loops are left
+    // opaque; no loop client needs more than their identity.
+    if (SparseSCEV && !isLoopRelevant(I))
+      return getUnknown(V);
   } else if (ConstantExpr *CE = dyn_cast<ConstantExpr>(V))
     Opcode = CE->getOpcode();
   else if (ConstantInt *CI = dyn_cast<ConstantInt>(V))
@@ -4183,6 +4209,7 @@ void ScalarEvolution::forgetValue(Value *V) {
       if (PHINode *PN = dyn_cast<PHINode>(I))
         ConstantEvolutionLoopExitValue.erase(PN);
     }
+    LoopRelevance.erase(I);
 
     PushDefUseChildren(I, Worklist);
   }
@@ -6642,7 +6669,8 @@ ScalarEvolution::SCEVCallbackVH::SCEVCallbackVH(Value *V, ScalarEvolution *se)
 //===----------------------------------------------------------------------===//
 
 ScalarEvolution::ScalarEvolution()
-  : FunctionPass(ID), FirstUnknown(0) {
+  : FunctionPass(ID), F(0), FirstUnknown(0), PeakFootprint(0),
+    NumNestsReleased(0), NumCacheResets(0) {
   initializeScalarEvolutionPass(*PassRegistry::getPassRegistry());
 }
 
@@ -6652,10 +6680,25 @@ bool ScalarEvolution::runOnFunction(Function &F) {
   TD = getAnalysisIfAvailable<DataLayout>();
   TLI = &getAnalysis<TargetLibraryInfo>();
   DT = &getAnalysis<DominatorTree>();
+  PeakFootprint = 0;
+  NumNestsReleased = NumCacheResets = 0;
   return false;
 }
 
 void ScalarEvolution::releaseMemory() {
+  if (ReportFootprint && F) {
+    PeakFootprint = std::max(PeakFootprint, getMemoryFootprint());
+    errs() << "SCEV footprint of '" << F->getName() << "': peak "
+           << (PeakFootprint + 1023) / 1024 << " KB";
+    if (SparseSCEV)
+      errs() << ", " << NumNestsReleased << " loop nests released, "
+             << NumCacheResets << " cache resets";
+    errs() << '\n';
+  }
+  clearCaches();
+}
+
+void ScalarEvolution::clearCaches() {
   // Iterate through all the SCEVUnknown instances and call their
   // destructors, so that they release their references to their values.
   for (SCEVUnknown *U = FirstUnknown; U; U = U->Next)
@@ -6663,6 +6706,7 @@ void ScalarEvolution::releaseMemory() {
   FirstUnknown = 0;
 
   ValueExprMap.clear();
+  LoopRelevance.clear();
 
   // Free any extra memory created for ExitNotTakenInfo in the unlikely event
   // that a loop had multiple computable exits.
@@ -6685,6 +6729,118 @@ void ScalarEvolution::releaseMemory() {
   SCEVAllocator.Reset();
 }
 
+/// getNestedMapSize - Estimate the bytes taken by a DenseMap of std::maps:
+/// its buckets, and a node of the usual red-black tree layout for each entry
+/// of the inner maps.
+template <typename MapT>
+static size_t getNestedMapSize(const MapT &Map) {
+  typedef typename MapT::mapped_type::value_type EntryT;
+  size_t Size = Map.getMemorySize();
+  for (typename MapT::const_iterator I = Map.begin(), E = Map.end(); I != E;
+       ++I)
+    Size += I->second.size() * (sizeof(EntryT) + 4 * sizeof(void*));
+  return Size;
+}
+
+size_t ScalarEvolution::getMemoryFootprint() const {
+  // The SCEVs themselves live in SCEVAllocator; UniqueSCEVs only adds its
+  // bucket array, which has about one pointer per SCEV.
+  return SCEVAllocator.getTotalMemory() +
+         UniqueSCEVs.size() * sizeof(void*) +
+         ValueExprMap.getMemorySize() +
+         BackedgeTakenCounts.getMemorySize() +
+         ConstantEvolutionLoopExitValue.getMemorySize() +
+         getNestedMapSize(ValuesAtScopes) +
+         getNestedMapSize(LoopDispositions) +
+         getNestedMapSize(BlockDispositions) +
+         UnsignedRanges.getMemorySize() +
+         SignedRanges.getMemorySize();
+}
+
+bool ScalarEvolution::isLoopRelevant(const Instruction *I) {
+  if (LI->getLoopFor(I->getParent()))
+    return true;
+  DenseMap<const Instruction *, bool>::iterator It = LoopRelevance.find(I);
+  if (It != LoopRelevance.end())
+    return It->second;
+
+  // Exit values: I uses a value computed in a loop.
+  for (User::const_op_iterator OI = I->op_begin(), OE = I->op_end(); OI != OE;
+       ++OI)
+    if (const Instruction *Op = dyn_cast<Instruction>(*OI))
+      if (LI->getLoopFor(Op->getParent()))
+        return LoopRelevance[I] = true;
+
+  // Walk the users of I until one is in a loop or is known to feed one.
+  // Parent maps each visited instruction to the one it was reached from, so
+  // that a hit marks the whole chain back to I, and asking about any of
+  // them later is free.
+  SmallVector<const Instruction *, 16> Worklist;
+  DenseMap<const Instruction *, const Instruction *> Parent;
+  Worklist.push_back(I);
+  Parent[I] = 0;
+  while (!Worklist.empty()) {
+    const Instruction *Cur = Worklist.pop_back_val();
+    for (Value::const_use_iterator UI = Cur->use_begin(), UE = Cur->use_end();
+         UI != UE; ++UI) {
+      const Instruction *User = cast<Instruction>(*UI);
+      if (!Parent.insert(std::make_pair(User, Cur)).second)
+        continue;
+      It = LoopRelevance.find(User);
+      if (LI->getLoopFor(User->getParent()) ||
+          (It != LoopRelevance.end() && It->second)) {
+        for (const Instruction *P = Cur; P; P = Parent[P])
+          LoopRelevance[P] = true;
+        return true;
+      }
+      if (It == LoopRelevance.end())
+        Worklist.push_back(User);
+    }
+  }
+
+  // Nothing I reaches is in a loop, so the same holds for everything on
+  // the way.
+  for (DenseMap<const Instruction *, const Instruction *>::iterator
+       VI = Parent.begin(), VE = Parent.end(); VI != VE; ++VI)
+    LoopRelevance[VI->first] = false;
+  return false;
+}
+
+void ScalarEvolution::releaseLoopNest(const Loop *L) {
+  if (!SparseSCEV)
+    return;
+  assert(!L->getParentLoop() && "Not the outermost loop of a nest!");
+  ++NumLoopNestsReleased;
+  ++NumNestsReleased;
+
+  // forgetLoop drops the trip counts of the nest and what depends on its
+  // header phis.  The other values of the nest go too.
+  forgetLoop(L);
+  for (Loop::block_iterator BI = L->block_begin(), BE = L->block_end();
+       BI != BE; ++BI)
+    for (BasicBlock::iterator I = (*BI)->begin(), E = (*BI)->end(); I != E;
+         ++I) {
+      if (PHINode *PN = dyn_cast<PHINode>(I))
+        ConstantEvolutionLoopExitValue.erase(PN);
+      ValueExprMapType::iterator It =
+        ValueExprMap.find_as(static_cast<Value *>(I));
+      if (It == ValueExprMap.end())
+        continue;
+      forgetMemoizedResults(It->second);
+      ValueExprMap.erase(It);
+    }
+
+  // The SCEVs themselves cannot be freed one at a time, so once they take
+  // too much, everything goes.
+  size_t Footprint = getMemoryFootprint();
+  PeakFootprint = std::max(PeakFootprint, Footprint);
+  if (Footprint > size_t(SCEVCacheLimit) * 1024) {
+    ++NumSCEVCacheResets;
+    ++NumCacheResets;
+    clearCaches();
+  }
+}
+
 void ScalarEvolution::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.setPreservesAll();
   AU.addRequiredTransitive<LoopInfo>();
@@ -7051,7 +7207,7 @@ void ScalarEvolution::verifyAnalysis() const {
 
   // Gather stringified backedge taken counts for all loops without using
   // SCEV's caches.
-  SE.releaseMemory();
+  SE.clearCaches();
   for (LoopInfo::reverse_iterator I = LI->rbegin(), E = LI->rend(); I != E; ++I)
     getLoopBackedgeTakenCounts(*I, BackedgeDumpsNew, SE);
 
@@ -15,6 +15,7 @@
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Analysis/InstructionSimplify.h"
+#include "llvm/Analysis/KnownBitsCache.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/GlobalAlias.h"
@@ -325,6 +326,12 @@ void llvm::ComputeMaskedBits(Value *V, APInt &KnownZero, APInt &KnownOne,
     return;
   }
 
+  // An active cache knows about the instructions of the function, however
+  // deep their operands go.
+  if (KnownBitsCache *Cache = KnownBitsCache::getActive())
+    if (Cache->getKnownBits(V, KnownZero, KnownOne))
+      return;
+
   // Start out not knowing anything.
   KnownZero.clearAllBits(); KnownOne.clearAllBits();
 
@@ -1103,6 +1110,10 @@ unsigned llvm::ComputeNumSignBits(Value *V, const DataLayout *TD,
   // Note that ConstantInt is handled by the general ComputeMaskedBits case
   // below.
 
+  if (KnownBitsCache *Cache = KnownBitsCache::getActive())
+    if (unsigned NumSignBits = Cache->getNumSignBits(V))
+      return NumSignBits;
+
   if (Depth == 6)
     return 1;  // Limit search depth.
 
@@ -19,15 +19,32 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/OperandTraits.h"
 #include "llvm/IR/Operator.h"
+#include "llvm/Support/Atomic.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/DataStream.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 using namespace llvm;
 
+static cl::opt<bool>
+LazyBitcodeMetadata("lazy-bitcode-metadata", cl::Hidden, cl::init(true),
+  cl::desc("Read module metadata on demand in lazily loaded bitcode"));
+
+static cl::opt<unsigned>
+BitcodeThreads("bitcode-threads",
+  cl::desc("Read the function bodies of a whole module on this many threads"),
+  cl::init(0));
+
 enum {
   SWITCH_INST_MAGIC = 0x4B5 // May 2012 => 1205 => Hex
 };
 
+/// MaxLazyMDDepth - How deeply lazy reads of metadata may nest before the
+/// nodes further down are put off.
+static const unsigned MaxLazyMDDepth = 32;
+
 void BitcodeReader::materializeForwardReferencedFunctions() {
   while (!BlockAddrFwdRefs.empty()) {
     Function *F = BlockAddrFwdRefs.begin()->first;
@@ -42,6 +59,10 @@ void BitcodeReader::FreeState() {
   std::vector<Type*>().swap(TypeList);
   ValueList.clear();
   MDValueList.clear();
+  MDCursors.clear();
+  std::vector<unsigned>().swap(MDCursorFirstIDs);
+  std::vector<uint64_t>().swap(LazyMDBits);
+  std::vector<std::pair<uint64_t, unsigned> >().swap(LazyNamedMDs);
 
   std::vector<AttributeSet>().swap(MAttributes);
   std::vector<BasicBlock*>().swap(FunctionBBs);
@@ -52,6 +73,21 @@ void BitcodeReader::FreeState() {
   assert(BlockAddrFwdRefs.empty() && "Unresolved blockaddress fwd references");
 }
 
+/// A reader of function bodies for a worker thread.  It reads from its own
+/// cursor and keeps its own function-level values, and shares everything the
+/// module defines with P.
+BitcodeReader::BitcodeReader(BitcodeReader &P)
+  : Context(P.Context), TheModule(P.TheModule), Buffer(0), BufferOwned(false),
+    Stream(P.Stream), LazyStreamer(0), NextUnreadBit(0),
+    SeenValueSymbolTable(true), ErrorString(0), TypeList(P.TypeList),
+    ValueList(P.Context), MDValueList(P.Context), MAttributes(P.MAttributes),
+    MDKindMap(P.MDKindMap), SeenFirstFunctionBody(true),
+    UseRelativeIDs(P.UseRelativeIDs), LazyMetadata(false), LazyMDDepth(0),
+    LazyMDFailed(false), Parent(&P) {
+  ValueList.shareModuleValues(P.ValueList);
+  MDValueList.shareModuleValues(P.MDValueList);
+}
+
 //===----------------------------------------------------------------------===//
 //  Helper functions to implement forward reference resolution, etc.
 //===----------------------------------------------------------------------===//
@@ -235,7 +271,8 @@ void BitcodeReaderValueList::AssignValue(Value *V, unsigned Idx) {
   if (Idx >= size())
     resize(Idx+1);
 
-  WeakVH &OldV = ValuePtrs[Idx];
+  assert(Idx >= NumModuleValues && "Cannot assign to a shared module value!");
+  WeakVH &OldV = ValuePtrs[Idx - NumModuleValues];
   if (OldV == 0) {
     OldV = V;
     return;
@@ -257,25 +294,38 @@ void BitcodeReaderValueList::AssignValue(Value *V, unsigned Idx) {
 
 Constant *BitcodeReaderValueList::getConstantFwdRef(unsigned Idx,
                                                     Type *Ty) {
+  // The module values are all known by the time they are shared.
+  if (Idx < NumModuleValues)
+    return cast_or_null<Constant>((Value *)(*ModuleValuePtrs)[Idx]);
+
   if (Idx >= size())
     resize(Idx + 1);
 
-  if (Value *V = ValuePtrs[Idx]) {
+  WeakVH &Slot = ValuePtrs[Idx - NumModuleValues];
+  if (Value *V = Slot) {
     assert(Ty == V->getType() && "Type mismatch in constant table!");
     return cast<Constant>(V);
   }
 
   // Create and return a placeholder, which will later be RAUW'd.
   Constant *C = new ConstantPlaceHolder(Ty, Context);
-  ValuePtrs[Idx] = C;
+  Slot = C;
   return C;
 }
 
 Value *BitcodeReaderValueList::getValueFwdRef(unsigned Idx, Type *Ty) {
+  if (Idx < NumModuleValues) {
+    Value *V = (*ModuleValuePtrs)[Idx];
+    assert((Ty == 0 || V == 0 || Ty == V->getType()) &&
+           "Type mismatch in value table!");
+    return V;
+  }
+
   if (Idx >= size())
     resize(Idx + 1);
 
-  if (Value *V = ValuePtrs[Idx]) {
+  WeakVH &Slot = ValuePtrs[Idx - NumModuleValues];
+  if (Value *V = Slot) {
     assert((Ty == 0 || Ty == V->getType()) && "Type mismatch in value table!");
     return V;
   }
@@ -285,7 +335,7 @@ Value *BitcodeReaderValueList::getValueFwdRef(unsigned Idx, Type *Ty) {
 
   // Create and return a placeholder, which will later be RAUW'd.
   Value *V = new Argument(Ty);
-  ValuePtrs[Idx] = V;
+  Slot = V;
   return V;
 }
 
@@ -380,7 +430,9 @@ void BitcodeReaderMDValueList::AssignValue(Value *V, unsigned Idx) {
   if (Idx >= size())
     resize(Idx+1);
 
-  WeakVH &OldV = MDValuePtrs[Idx];
+  assert(Idx >= NumModuleMDValues &&
+         "Cannot assign to shared module metadata!");
+  WeakVH &OldV = MDValuePtrs[Idx - NumModuleMDValues];
   if (OldV == 0) {
     OldV = V;
     return;
@@ -392,21 +444,30 @@ void BitcodeReaderMDValueList::AssignValue(Value *V, unsigned Idx) {
   MDNode::deleteTemporary(PrevVal);
   // Deleting PrevVal sets Idx value in MDValuePtrs to null. Set new
   // value for Idx.
-  MDValuePtrs[Idx] = V;
+  MDValuePtrs[Idx - NumModuleMDValues] = V;
 }
 
 Value *BitcodeReaderMDValueList::getValueFwdRef(unsigned Idx) {
+  // The module metadata has all been read by the time it is shared.
+  if (Idx < NumModuleMDValues)
+    return (*ModuleMDValuePtrs)[Idx];
+
   if (Idx >= size())
     resize(Idx + 1);
 
-  if (Value *V = MDValuePtrs[Idx]) {
+  if (Value *V = MDValuePtrs[Idx - NumModuleMDValues]) {
     assert(V->getType()->isMetadataTy() && "Type mismatch in value table!");
     return V;
   }
 
+  // Read the value now if the module-level metadata is read on demand.
+  if (Loader)
+    if (Value *V = Loader->loadLazyMetadata(Idx))
+      return V;
+
   // Create and return a placeholder, which will later be RAUW'd.
   Value *V = MDNode::getTemporary(Context, None);
-  MDValuePtrs[Idx] = V;
+  MDValuePtrs[Idx - NumModuleMDValues] = V;
   return V;
 }
 
@@ -885,80 +946,226 @@ bool BitcodeReader::ParseMetadata() {
       break;
     }
 
-    bool IsFunctionLocal = false;
     // Read a record.
     Record.clear();
     unsigned Code = Stream.readRecord(Entry.ID, Record);
     switch (Code) {
     default:  // Default behavior: ignore.
       break;
-    case bitc::METADATA_NAME: {
-      // Read name of the named metadata.
-      SmallString<8> Name(Record.begin(), Record.end());
-      Record.clear();
-      Code = Stream.ReadCode();
-
-      // METADATA_NAME is always followed by METADATA_NAMED_NODE.
-      unsigned NextBitCode = Stream.readRecord(Code, Record);
-      assert(NextBitCode == bitc::METADATA_NAMED_NODE); (void)NextBitCode;
-
-      // Read named metadata elements.
-      unsigned Size = Record.size();
-      NamedMDNode *NMD = TheModule->getOrInsertNamedMetadata(Name);
-      for (unsigned i = 0; i != Size; ++i) {
-        MDNode *MD = dyn_cast<MDNode>(MDValueList.getValueFwdRef(Record[i]));
-        if (MD == 0)
-          return Error("Malformed metadata record");
-        NMD->addOperand(MD);
-      }
+    case bitc::METADATA_NAME:
+      if (ParseNamedMetadata(Stream, Record))
+        return true;
       break;
-    }
     case bitc::METADATA_FN_NODE:
-      IsFunctionLocal = true;
-      // fall-through
-    case bitc::METADATA_NODE: {
-      if (Record.size() % 2 == 1)
-        return Error("Invalid METADATA_NODE record");
-
-      unsigned Size = Record.size();
-      SmallVector<Value*, 8> Elts;
-      for (unsigned i = 0; i != Size; i += 2) {
-        Type *Ty = getTypeByID(Record[i]);
-        if (!Ty) return Error("Invalid METADATA_NODE record");
-        if (Ty->isMetadataTy())
-          Elts.push_back(MDValueList.getValueFwdRef(Record[i+1]));
-        else if (!Ty->isVoidTy())
-          Elts.push_back(ValueList.getValueFwdRef(Record[i+1], Ty));
-        else
-          Elts.push_back(NULL);
-      }
-      Value *V = MDNode::getWhenValsUnresolved(Context, Elts, IsFunctionLocal);
-      IsFunctionLocal = false;
-      MDValueList.AssignValue(V, NextMDValueNo++);
+    case bitc::METADATA_NODE:
+    case bitc::METADATA_STRING:
+      if (ParseMetadataValue(Code, Record, NextMDValueNo++))
+        return true;
       break;
-    }
-    case bitc::METADATA_STRING: {
-      SmallString<8> String(Record.begin(), Record.end());
-      Value *V = MDString::get(Context, String);
-      MDValueList.AssignValue(V, NextMDValueNo++);
+    case bitc::METADATA_KIND:
+      if (ParseMetadataKind(Record))
+        return true;
       break;
     }
-    case bitc::METADATA_KIND: {
-      if (Record.size() < 2)
-        return Error("Invalid METADATA_KIND record");
+  }
+}
+
+/// ParseMetadataValue - Create the metadata value with the given ID from a
+/// METADATA_NODE, METADATA_FN_NODE or METADATA_STRING record.
+bool BitcodeReader::ParseMetadataValue(unsigned Code,
+                                       SmallVectorImpl<uint64_t> &Record,
+                                       unsigned ID) {
+  if (Code == bitc::METADATA_STRING) {
+    SmallString<8> String(Record.begin(), Record.end());
+    MDValueList.AssignValue(MDString::get(Context, String), ID);
+    return false;
+  }
+
+  if (Record.size() % 2 == 1)
+    return Error("Invalid METADATA_NODE record");
+
+  unsigned Size = Record.size();
+  SmallVector<Value*, 8> Elts;
+  for (unsigned i = 0; i != Size; i += 2) {
+    Type *Ty = getTypeByID(Record[i]);
+    if (!Ty) return Error("Invalid METADATA_NODE record");
+    if (Ty->isMetadataTy())
+      Elts.push_back(MDValueList.getValueFwdRef(Record[i+1]));
+    else if (!Ty->isVoidTy())
+      Elts.push_back(ValueList.getValueFwdRef(Record[i+1], Ty));
+    else
+      Elts.push_back(NULL);
+  }
+  bool IsFunctionLocal = Code == bitc::METADATA_FN_NODE;
+  Value *V = MDNode::getWhenValsUnresolved(Context, Elts, IsFunctionLocal);
+  MDValueList.AssignValue(V, ID);
+  return false;
+}
+
+bool BitcodeReader::ParseMetadataKind(SmallVectorImpl<uint64_t> &Record) {
+  if (Record.size() < 2)
+    return Error("Invalid METADATA_KIND record");
+
+  unsigned Kind = Record[0];
+  SmallString<8> Name(Record.begin()+1, Record.end());
+
+  unsigned NewKind = TheModule->getMDKindID(Name.str());
+  if (!MDKindMap.insert(std::make_pair(Kind, NewKind)).second)
+    return Error("Conflicting METADATA_KIND records");
+  return false;
+}
 
-      unsigned Kind = Record[0];
-      SmallString<8> Name(Record.begin()+1, Record.end());
+/// ParseNamedMetadata - Create the named metadata of the METADATA_NAME record
+/// in Record, whose elements are in the record that follows it in Cursor.
+bool BitcodeReader::ParseNamedMetadata(BitstreamCursor &Cursor,
+                                       SmallVectorImpl<uint64_t> &Record) {
+  // Read name of the named metadata.
+  SmallString<8> Name(Record.begin(), Record.end());
+  Record.clear();
+  unsigned Code = Cursor.ReadCode();
+
+  // METADATA_NAME is always followed by METADATA_NAMED_NODE.
+  unsigned NextBitCode = Cursor.readRecord(Code, Record);
+  assert(NextBitCode == bitc::METADATA_NAMED_NODE); (void)NextBitCode;
+
+  // Read named metadata elements.  This may read other records from Cursor,
+  // so it must come after the record has been read.
+  unsigned Size = Record.size();
+  NamedMDNode *NMD = TheModule->getOrInsertNamedMetadata(Name);
+  for (unsigned i = 0; i != Size; ++i) {
+    MDNode *MD = dyn_cast<MDNode>(MDValueList.getValueFwdRef(Record[i]));
+    if (MD == 0)
+      return Error("Malformed metadata record");
+    NMD->addOperand(MD);
+  }
+  return false;
+}
+
+/// IndexMetadata - Instead of reading the module-level METADATA_BLOCK the
+/// stream is at, remember where each of its records is so that
+/// loadLazyMetadata and MaterializeMetadata can read them later.  Metadata
+/// kinds are read right away, since instructions refer to them by number.
+bool BitcodeReader::IndexMetadata() {
+  MDCursors.push_back(Stream);
+  if (Stream.SkipBlock())
+    return Error("Malformed block record");
+
+  BitstreamCursor &Cursor = MDCursors.back();
+  unsigned CursorNo = MDCursors.size() - 1;
+  if (Cursor.EnterSubBlock(bitc::METADATA_BLOCK_ID))
+    return Error("Malformed block record");
+
+  // The values of this block are numbered after those already read.
+  LazyMDBits.resize(MDValueList.size());
+  MDCursorFirstIDs.push_back(LazyMDBits.size());
+
+  // Abbreviations are read here, so that the cursor has all of them when it
+  // jumps back to a record.
+  const unsigned Flags = BitstreamCursor::AF_DontPopBlockAtEnd |
+                         BitstreamCursor::AF_DontAutoprocessAbbrevs;
+  SmallVector<uint64_t, 64> Record;
+  while (1) {
+    uint64_t Bit = Cursor.GetCurrentBitNo();
+    BitstreamEntry Entry = Cursor.advance(Flags);
 
-      unsigned NewKind = TheModule->getMDKindID(Name.str());
-      if (!MDKindMap.insert(std::make_pair(Kind, NewKind)).second)
-        return Error("Conflicting METADATA_KIND records");
+    switch (Entry.Kind) {
+    case BitstreamEntry::SubBlock:
+      if (Cursor.SkipBlock())
+        return Error("malformed metadata block");
+      continue;
+    case BitstreamEntry::Error:
+      return Error("malformed metadata block");
+    case BitstreamEntry::EndBlock:
+      MDValueList.resize(LazyMDBits.size());
+      return false;
+    case BitstreamEntry::Record:
+      // The interesting case.
       break;
     }
+
+    if (Entry.ID == bitc::DEFINE_ABBREV) {
+      Cursor.ReadAbbrevRecord();
+      continue;
+    }
+
+    Record.clear();
+    switch (Cursor.readRecord(Entry.ID, Record)) {
+    default:  // Default behavior: ignore.
+      break;
+    case bitc::METADATA_NAME:
+      LazyNamedMDs.push_back(std::make_pair(Bit, CursorNo));
+      // Skip the METADATA_NAMED_NODE record that goes with it.
+      Cursor.skipRecord(Cursor.ReadCode());
+      break;
+    case bitc::METADATA_FN_NODE:
+    case bitc::METADATA_NODE:
+    case bitc::METADATA_STRING:
+      LazyMDBits.push_back(Bit);
+      break;
+    case bitc::METADATA_KIND:
+      if (ParseMetadataKind(Record))
+        return true;
+      break;
     }
   }
 }
 
+Value *BitcodeReader::loadLazyMetadata(unsigned ID) {
+  // Nothing to do if the value has been read, or is being read further up
+  // the stack, in which case the caller gets a placeholder.
+  if (ID >= LazyMDBits.size() || !LazyMDBits[ID] || LazyMDFailed)
+    return 0;
+
+  if (LazyMDDepth == MaxLazyMDDepth) {
+    LazyMDWorklist.push_back(ID);
+    return 0;
+  }
+
+  ++LazyMDDepth;
+  bool Failed = ReadLazyMetadata(ID);
+  --LazyMDDepth;
+
+  // Read the nodes that were put off once the stack has unwound.
+  while (!Failed && LazyMDDepth == 0 && !LazyMDWorklist.empty()) {
+    unsigned Next = LazyMDWorklist.pop_back_val();
+    if (!LazyMDBits[Next])
+      continue;
+    ++LazyMDDepth;
+    Failed = ReadLazyMetadata(Next);
+    --LazyMDDepth;
+  }
+
+  if (Failed) {
+    LazyMDFailed = true;
+    LazyMDWorklist.clear();
+    return 0;
+  }
+  return MDValueList[ID];
+}
+
+/// ReadLazyMetadata - Read the record of the module-level metadata value with
+/// the given ID, which has not been read yet.
+bool BitcodeReader::ReadLazyMetadata(unsigned ID) {
+  unsigned CursorNo = std::upper_bound(MDCursorFirstIDs.begin(),
+                                       MDCursorFirstIDs.end(), ID) -
+                      MDCursorFirstIDs.begin() - 1;
+  BitstreamCursor &Cursor = MDCursors[CursorNo];
+  Cursor.JumpToBit(LazyMDBits[ID]);
+  LazyMDBits[ID] = 0;
+
+  BitstreamEntry Entry =
+    Cursor.advance(BitstreamCursor::AF_DontPopBlockAtEnd |
+                   BitstreamCursor::AF_DontAutoprocessAbbrevs);
+  if (Entry.Kind != BitstreamEntry::Record)
+    return Error("malformed metadata block");
+
+  // The record must be read in full before the values it refers to, since
+  // reading those moves the cursor.
+  SmallVector<uint64_t, 32> Record;
+  unsigned Code = Cursor.readRecord(Entry.ID, Record);
+  return ParseMetadataValue(Code, Record, ID);
+}
+
 /// decodeSignRotatedValue - Decode a signed value stored with the sign bit in
 /// the LSB for dense VBR encoding.
 uint64_t BitcodeReader::decodeSignRotatedValue(uint64_t V) {
@@ -1383,8 +1590,8 @@ bool BitcodeReader::ParseConstants() {
       if (Fn == 0) return Error("Invalid CE_BLOCKADDRESS record");
 
       // If the function is already parsed we can insert the block address right
-      // away.
-      if (!Fn->empty()) {
+      // away.  Functions another thread may be parsing do not count.
+      if (!Fn->empty() && !(Parent && Parent->BodiesInFlight.count(Fn))) {
         Function::iterator BBI = Fn->begin(), BBE = Fn->end();
         for (size_t I = 0, E = Record[2]; I != E; ++I) {
           if (BBI == BBE)
@@ -1394,11 +1601,17 @@ bool BitcodeReader::ParseConstants() {
         V = BlockAddress::get(Fn, BBI);
       } else {
         // Otherwise insert a placeholder and remember it so it can be inserted
-        // when the function is parsed.
-        GlobalVariable *FwdRef = new GlobalVariable(*Fn->getParent(),
-                                                    Type::getInt8Ty(Context),
-                                            false, GlobalValue::InternalLinkage,
-                                                    0, "");
+        // when the function is parsed.  A worker thread keeps its placeholders
+        // out of the module; the parent reader takes them over.
+        GlobalVariable *FwdRef;
+        if (Parent)
+          FwdRef = new GlobalVariable(Type::getInt8Ty(Context), false,
+                                      GlobalValue::InternalLinkage);
+        else
+          FwdRef = new GlobalVariable(*Fn->getParent(),
+                                      Type::getInt8Ty(Context),
+                                      false, GlobalValue::InternalLinkage,
+                                      0, "");
         BlockAddrFwdRefs[Fn].push_back(std::make_pair(Record[2], FwdRef));
         V = FwdRef;
       }
@@ -1548,7 +1761,7 @@ bool BitcodeReader::ParseModule(bool Resume) {
           return true;
         break;
       case bitc::METADATA_BLOCK_ID:
-        if (ParseMetadata())
+        if (LazyMetadata ? IndexMetadata() : ParseMetadata())
           return true;
         break;
       case bitc::FUNCTION_BLOCK_ID:
@@ -2841,7 +3054,10 @@ OutOfRecordLoop:
 
       GlobalVariable *FwdRef = RefList[i].second;
       FwdRef->replaceAllUsesWith(BlockAddress::get(F, FunctionBBs[BlockIdx]));
-      FwdRef->eraseFromParent();
+      if (FwdRef->getParent())
+        FwdRef->eraseFromParent();
+      else
+        delete FwdRef;
     }
 
     BlockAddrFwdRefs.erase(BAFRI);
@@ -2851,6 +3067,10 @@ OutOfRecordLoop:
   ValueList.shrinkTo(ModuleValueListSize);
   MDValueList.shrinkTo(ModuleMDValueListSize);
   std::vector<BasicBlock*>().swap(FunctionBBs);
+
+  // A lazy read of module-level metadata may have failed on the way.
+  if (LazyMDFailed)
+    return true;
   return false;
 }
 
@@ -2934,10 +3154,183 @@ void BitcodeReader::Dematerialize(GlobalValue *GV) {
   F->deleteBody();
 }
 
+bool BitcodeReader::MaterializeMetadata(std::string *ErrInfo) {
+  // Read the named metadata in the order of the file, along with the nodes
+  // it refers to that no function has pulled in yet.
+  std::vector<std::pair<uint64_t, unsigned> > NamedMDs;
+  NamedMDs.swap(LazyNamedMDs);
+  SmallVector<uint64_t, 64> Record;
+  for (unsigned i = 0, e = NamedMDs.size(); i != e; ++i) {
+    BitstreamCursor &Cursor = MDCursors[NamedMDs[i].second];
+    Cursor.JumpToBit(NamedMDs[i].first);
+    BitstreamEntry Entry =
+      Cursor.advance(BitstreamCursor::AF_DontPopBlockAtEnd |
+                     BitstreamCursor::AF_DontAutoprocessAbbrevs);
+    Record.clear();
+    if (Entry.Kind != BitstreamEntry::Record ||
+        Cursor.readRecord(Entry.ID, Record) != bitc::METADATA_NAME) {
+      Error("malformed metadata block");
+      if (ErrInfo) *ErrInfo = ErrorString;
+      return true;
+    }
+    if (ParseNamedMetadata(Cursor, Record) || LazyMDFailed) {
+      if (ErrInfo) *ErrInfo = ErrorString;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+/// BodyWorker - The state of one worker thread of
+/// ParseFunctionBodiesInParallel.  The workers take the bodies in order from a
+/// shared counter, and all stop at the first error.
+struct BitcodeReader::BodyWorker {
+  BitcodeReader *Reader;
+  ArrayRef<std::pair<Function *, uint64_t> > Bodies;
+  volatile sys::cas_flag *NextBody;
+  volatile bool *Stop;
+  bool Failed;
+
+  static void run(void *Arg) {
+    BodyWorker *W = static_cast<BodyWorker *>(Arg);
+    while (!*W->Stop) {
+      unsigned Index = sys::AtomicIncrement(W->NextBody) - 1;
+      if (Index >= W->Bodies.size())
+        break;
+      W->Reader->Stream.JumpToBit(W->Bodies[Index].second);
+      if (W->Reader->ParseFunctionBody(W->Bodies[Index].first)) {
+        W->Failed = true;
+        *W->Stop = true;
+      }
+    }
+  }
+};
+
+/// ParseFunctionBodiesInParallel - Read the bodies of the functions that are
+/// still on disk on -bitcode-threads worker threads.  Each function is filled
+/// in by a single thread; the context locks everything the functions share.
+/// Bodies that need the block addresses of a function parsed earlier, and
+/// those left over when there are too few to share, are left to the caller.
+bool BitcodeReader::ParseFunctionBodiesInParallel() {
+  if (BitcodeThreads < 2 || Parent)
+    return false;
+
+  // Find every function body first.  A streamed file is fetched in full, so
+  // that the workers only ever read bytes that are already in memory.
+  if (LazyStreamer) {
+    StreamFile->getBitcodeBytes().getExtent();
+    for (Module::iterator F = TheModule->begin(), E = TheModule->end();
+         F != E; ++F) {
+      DenseMap<Function*, uint64_t>::iterator DFII =
+        DeferredFunctionInfo.find(F);
+      if (DFII != DeferredFunctionInfo.end() && DFII->second == 0 &&
+          F->isMaterializable() && FindFunctionInStream(F, DFII))
+        return true;
+    }
+  }
+
+  std::vector<std::pair<Function *, uint64_t> > Bodies;
+  for (Module::iterator F = TheModule->begin(), E = TheModule->end();
+       F != E; ++F)
+    if (F->isMaterializable() && !BlockAddrFwdRefs.count(F))
+      Bodies.push_back(std::make_pair(&*F, DeferredFunctionInfo[&*F]));
+  if (Bodies.size() < 2)
+    return false;
+
+  // The context and the other shared structures only lock once LLVM has
+  // been told it is multithreaded.
+  if (!llvm_is_multithreaded() && !llvm_start_multithreaded())
+    return false;
+
+  // The workers share the module metadata without locking, so read what is
+  // still on disk first.
+  for (unsigned ID = 0, e = LazyMDBits.size(); ID != e; ++ID)
+    if (LazyMDBits[ID])
+      loadLazyMetadata(ID);
+  if (LazyMDFailed)
+    return true;
+
+  for (unsigned i = 0, e = Bodies.size(); i != e; ++i)
+    BodiesInFlight.insert(Bodies[i].first);
+
+  unsigned NumThreads = std::min<unsigned>(BitcodeThreads, Bodies.size());
+  volatile sys::cas_flag NextBody = 0;
+  volatile bool Stop = false;
+  std::vector<BodyWorker> Workers(NumThreads);
+  {
+    LLVMContext::SharedScope Shared(Context);
+    ThreadPool Pool(NumThreads);
+    for (unsigned i = 0; i != NumThreads; ++i) {
+      Workers[i].Reader = new BitcodeReader(*this);
+      Workers[i].Bodies = Bodies;
+      Workers[i].NextBody = &NextBody;
+      Workers[i].Stop = &Stop;
+      Workers[i].Failed = false;
+      Pool.async(BodyWorker::run, &Workers[i]);
+    }
+    Pool.wait();
+  }
+  BodiesInFlight.clear();
+
+  bool Failed = false;
+  for (unsigned i = 0; i != NumThreads; ++i) {
+    if (Workers[i].Failed && !Failed) {
+      ErrorString = Workers[i].Reader->getErrorString();
+      Failed = true;
+    }
+    if (AdoptBlockAddrFwdRefs(*Workers[i].Reader))
+      Failed = true;
+    delete Workers[i].Reader;
+  }
+  return Failed;
+}
+
+/// AdoptBlockAddrFwdRefs - Resolve the block address placeholders a worker
+/// made for functions other than the ones it parsed, or take them over if
+/// the function is still on disk.
+bool BitcodeReader::AdoptBlockAddrFwdRefs(BitcodeReader &Worker) {
+  DenseMap<Function*, std::vector<BlockAddrRefTy> > Refs;
+  Refs.swap(Worker.BlockAddrFwdRefs);
+
+  bool Failed = false;
+  for (DenseMap<Function*, std::vector<BlockAddrRefTy> >::iterator
+         I = Refs.begin(), E = Refs.end(); I != E; ++I) {
+    Function *F = I->first;
+    std::vector<BlockAddrRefTy> &RefList = I->second;
+    for (unsigned i = 0, e = RefList.size(); i != e; ++i) {
+      GlobalVariable *FwdRef = RefList[i].second;
+      if (F->empty()) {
+        TheModule->getGlobalList().push_back(FwdRef);
+        BlockAddrFwdRefs[F].push_back(RefList[i]);
+        continue;
+      }
+
+      Function::iterator BBI = F->begin(), BBE = F->end();
+      for (unsigned BlockIdx = RefList[i].first; BlockIdx && BBI != BBE;
+           --BlockIdx)
+        ++BBI;
+      if (BBI == BBE) {
+        // Leave the placeholder to be deleted with the module.
+        TheModule->getGlobalList().push_back(FwdRef);
+        Failed = Error("Invalid blockaddress block #");
+        continue;
+      }
+      FwdRef->replaceAllUsesWith(BlockAddress::get(F, BBI));
+      delete FwdRef;
+    }
+  }
+  return Failed;
+}
 
 bool BitcodeReader::MaterializeModule(Module *M, std::string *ErrInfo) {
   assert(M == TheModule &&
          "Can only Materialize the Module this BitcodeReader is attached to.");
+  if (ParseFunctionBodiesInParallel()) {
+    if (ErrInfo) *ErrInfo = ErrorString;
+    return true;
+  }
+
   // Iterate over the module, deserializing any functions that are still on
   // disk.
   for (Module::iterator F = TheModule->begin(), E = TheModule->end();
@@ -2952,6 +3345,9 @@ bool BitcodeReader::MaterializeModule(Module *M, std::string *ErrInfo) {
   if (NextUnreadBit)
     ParseModule(true);
 
+  if (MaterializeMetadata(ErrInfo))
+    return true;
+
   // Upgrade any intrinsic calls that slipped through (should not happen!) and
   // delete the old functions to clean up. We can't do this unless the entire
   // module is materialized because there could always be another function body
@@ -3030,13 +3426,15 @@ bool BitcodeReader::InitLazyStream() {
 // External interface
 //===----------------------------------------------------------------------===//
 
-/// getLazyBitcodeModule - lazy function-at-a-time loading from a file.
-///
-Module *llvm::getLazyBitcodeModule(MemoryBuffer *Buffer,
-                                   LLVMContext& Context,
-                                   std::string *ErrMsg) {
+/// getLazyBitcodeModuleImpl - Read the module header and make a module that
+/// reads function bodies on demand, and metadata as well if LazyMetadata.
+static Module *getLazyBitcodeModuleImpl(MemoryBuffer *Buffer,
+                                        LLVMContext& Context,
+                                        std::string *ErrMsg,
+                                        bool LazyMetadata) {
   Module *M = new Module(Buffer->getBufferIdentifier(), Context);
   BitcodeReader *R = new BitcodeReader(Buffer, Context);
+  R->setLazyMetadata(LazyMetadata);
   M->setMaterializer(R);
   if (R->ParseBitcodeInto(M)) {
     if (ErrMsg)
@@ -3053,6 +3451,15 @@ Module *llvm::getLazyBitcodeModule(MemoryBuffer *Buffer,
   return M;
 }
 
+/// getLazyBitcodeModule - lazy function-at-a-time loading from a file.
+///
+Module *llvm::getLazyBitcodeModule(MemoryBuffer *Buffer,
+                                   LLVMContext& Context,
+                                   std::string *ErrMsg) {
+  return getLazyBitcodeModuleImpl(Buffer, Context, ErrMsg,
+                                  LazyBitcodeMetadata);
+}
+
 
 Module *llvm::getStreamedBitcodeModule(const std::string &name,
                                        DataStreamer *streamer,
@@ -3075,7 +3482,8 @@ Module *llvm::getStreamedBitcodeModule(const std::string &name,
 /// If an error occurs, return null and fill in *ErrMsg if non-null.
 Module *llvm::ParseBitcodeFile(MemoryBuffer *Buffer, LLVMContext& Context,
                                std::string *ErrMsg){
-  Module *M = getLazyBitcodeModule(Buffer, Context, ErrMsg);
+  // Everything is read anyway, so read the metadata in one pass too.
+  Module *M = getLazyBitcodeModuleImpl(Buffer, Context, ErrMsg, false);
   if (!M) return 0;
 
   // Don't let the BitcodeReader dtor delete 'Buffer', regardless of whether
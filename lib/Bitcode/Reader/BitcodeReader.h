@@ -15,6 +15,7 @@
 #define BITCODE_READER_H
 
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Bitcode/BitstreamReader.h"
 #include "llvm/Bitcode/LLVMBitCodes.h"
 #include "llvm/GVMaterializer.h"
@@ -22,9 +23,11 @@
 #include "llvm/IR/OperandTraits.h"
 #include "llvm/IR/Type.h"
 #include "llvm/Support/ValueHandle.h"
+#include <deque>
 #include <vector>
 
 namespace llvm {
+  class BitcodeReader;
   class MemoryBuffer;
   class LLVMContext;
 
@@ -35,6 +38,12 @@ namespace llvm {
 class BitcodeReaderValueList {
   std::vector<WeakVH> ValuePtrs;
 
+  /// ModuleValuePtrs - When a function body is read on a worker thread, the
+  /// values of the module, which the first NumModuleValues slots refer to
+  /// without copying them.  ValuePtrs then holds the slots after them.
+  const std::vector<WeakVH> *ModuleValuePtrs;
+  unsigned NumModuleValues;
+
   /// ResolveConstants - As we resolve forward-referenced constants, we add
   /// information about them to this vector.  This allows us to resolve them in
   /// bulk instead of resolving each reference at a time.  See the code in
@@ -46,14 +55,26 @@ class BitcodeReaderValueList {
   ResolveConstantsTy ResolveConstants;
   LLVMContext &Context;
 public:
-  BitcodeReaderValueList(LLVMContext &C) : Context(C) {}
+  BitcodeReaderValueList(LLVMContext &C)
+    : ModuleValuePtrs(0), NumModuleValues(0), Context(C) {}
   ~BitcodeReaderValueList() {
     assert(ResolveConstants.empty() && "Constants not resolved?");
   }
 
+  /// shareModuleValues - Refer to the values of Module, which must not change
+  /// while this list is in use, instead of holding module values of its own.
+  void shareModuleValues(const BitcodeReaderValueList &Module) {
+    assert(empty() && "Value list already in use!");
+    ModuleValuePtrs = &Module.ValuePtrs;
+    NumModuleValues = Module.size();
+  }
+
   // vector compatibility methods
-  unsigned size() const { return ValuePtrs.size(); }
-  void resize(unsigned N) { ValuePtrs.resize(N); }
+  unsigned size() const { return NumModuleValues + ValuePtrs.size(); }
+  void resize(unsigned N) {
+    assert(N >= NumModuleValues && "Cannot resize the module values!");
+    ValuePtrs.resize(N - NumModuleValues);
+  }
   void push_back(Value *V) {
     ValuePtrs.push_back(V);
   }
@@ -64,16 +85,18 @@ public:
   }
 
   Value *operator[](unsigned i) const {
-    assert(i < ValuePtrs.size());
-    return ValuePtrs[i];
+    assert(i < size());
+    if (i < NumModuleValues)
+      return (*ModuleValuePtrs)[i];
+    return ValuePtrs[i - NumModuleValues];
   }
 
-  Value *back() const { return ValuePtrs.back(); }
+  Value *back() const { return operator[](size() - 1); }
     void pop_back() { ValuePtrs.pop_back(); }
-  bool empty() const { return ValuePtrs.empty(); }
+  bool empty() const { return size() == 0; }
   void shrinkTo(unsigned N) {
     assert(N <= size() && "Invalid shrinkTo request!");
-    ValuePtrs.resize(N);
+    resize(N);
   }
 
   Constant *getConstantFwdRef(unsigned Idx, Type *Ty);
@@ -94,27 +117,52 @@ public:
 class BitcodeReaderMDValueList {
   std::vector<WeakVH> MDValuePtrs;
 
+  /// ModuleMDValuePtrs - Like BitcodeReaderValueList::ModuleValuePtrs, the
+  /// module-level metadata of a function body read on a worker thread.
+  const std::vector<WeakVH> *ModuleMDValuePtrs;
+  unsigned NumModuleMDValues;
+
   LLVMContext &Context;
+
+  /// Loader - The reader to ask for module-level metadata that has not been
+  /// read yet, or null if all of it is read up front.
+  BitcodeReader *Loader;
 public:
-  BitcodeReaderMDValueList(LLVMContext& C) : Context(C) {}
+  BitcodeReaderMDValueList(LLVMContext& C)
+    : ModuleMDValuePtrs(0), NumModuleMDValues(0), Context(C), Loader(0) {}
+
+  void setLoader(BitcodeReader *R) { Loader = R; }
+
+  /// shareModuleValues - Refer to the metadata of Module, which must all be
+  /// read and must not change while this list is in use.
+  void shareModuleValues(const BitcodeReaderMDValueList &Module) {
+    assert(empty() && "Metadata list already in use!");
+    ModuleMDValuePtrs = &Module.MDValuePtrs;
+    NumModuleMDValues = Module.size();
+  }
 
   // vector compatibility methods
-  unsigned size() const       { return MDValuePtrs.size(); }
-  void resize(unsigned N)     { MDValuePtrs.resize(N); }
+  unsigned size() const { return NumModuleMDValues + MDValuePtrs.size(); }
+  void resize(unsigned N) {
+    assert(N >= NumModuleMDValues && "Cannot resize the module metadata!");
+    MDValuePtrs.resize(N - NumModuleMDValues);
+  }
   void push_back(Value *V)    { MDValuePtrs.push_back(V);  }
   void clear()                { MDValuePtrs.clear();  }
-  Value *back() const         { return MDValuePtrs.back(); }
+  Value *back() const         { return operator[](size() - 1); }
   void pop_back()             { MDValuePtrs.pop_back(); }
-  bool empty() const          { return MDValuePtrs.empty(); }
+  bool empty() const          { return size() == 0; }
 
   Value *operator[](unsigned i) const {
-    assert(i < MDValuePtrs.size());
-    return MDValuePtrs[i];
+    assert(i < size());
+    if (i < NumModuleMDValues)
+      return (*ModuleMDValuePtrs)[i];
+    return MDValuePtrs[i - NumModuleMDValues];
   }
 
   void shrinkTo(unsigned N) {
     assert(N <= size() && "Invalid shrinkTo request!");
-    MDValuePtrs.resize(N);
+    resize(N);
   }
 
   Value *getValueFwdRef(unsigned Idx);
@@ -191,18 +239,67 @@ class BitcodeReader : public GVMaterializer {
   /// not need this flag.
   bool UseRelativeIDs;
 
+  /// LazyMetadata - Whether the module-level metadata is only indexed when the
+  /// module is read, and each node read the first time it is referenced.
+  bool LazyMetadata;
+
+  /// MDCursors - A cursor into each module-level METADATA_BLOCK, with the
+  /// abbreviations of the block, to read the records of the block from.
+  std::deque<BitstreamCursor> MDCursors;
+
+  /// MDCursorFirstIDs - The ID of the first metadata value of each block in
+  /// MDCursors.
+  std::vector<unsigned> MDCursorFirstIDs;
+
+  /// LazyMDBits - For each module-level metadata ID, the bit its record
+  /// starts at, or zero once the record has been read.
+  std::vector<uint64_t> LazyMDBits;
+
+  /// LazyNamedMDs - The bit of each METADATA_NAME record and the block it is
+  /// in, until MaterializeMetadata reads them.
+  std::vector<std::pair<uint64_t, unsigned> > LazyNamedMDs;
+
+  /// LazyMDDepth - How many lazy reads of metadata are on the stack.  Past
+  /// MaxLazyMDDepth, references get a placeholder and the node is queued on
+  /// LazyMDWorklist instead, so that long chains of nodes do not overflow the
+  /// stack.
+  unsigned LazyMDDepth;
+  SmallVector<unsigned, 16> LazyMDWorklist;
+
+  /// LazyMDFailed - Set when a lazy read of metadata hit a malformed record.
+  /// ErrorString has the details.
+  bool LazyMDFailed;
+
+  /// Parent - For a reader of function bodies on a worker thread, the reader
+  /// of the module.  Its type, value and metadata tables are shared, not
+  /// copied, and must not change while the workers run.
+  BitcodeReader *Parent;
+
+  /// BodiesInFlight - The functions whose bodies the workers of this reader
+  /// are reading.  Workers must not look at these, since another thread may
+  /// be filling them in.
+  SmallPtrSet<const Function*, 16> BodiesInFlight;
+
+  struct BodyWorker;
+
+  explicit BitcodeReader(BitcodeReader &Parent);
+
 public:
   explicit BitcodeReader(MemoryBuffer *buffer, LLVMContext &C)
     : Context(C), TheModule(0), Buffer(buffer), BufferOwned(false),
       LazyStreamer(0), NextUnreadBit(0), SeenValueSymbolTable(false),
       ErrorString(0), ValueList(C), MDValueList(C),
-      SeenFirstFunctionBody(false), UseRelativeIDs(false) {
+      SeenFirstFunctionBody(false), UseRelativeIDs(false),
+      LazyMetadata(false), LazyMDDepth(0), LazyMDFailed(false), Parent(0) {
+    MDValueList.setLoader(this);
   }
   explicit BitcodeReader(DataStreamer *streamer, LLVMContext &C)
     : Context(C), TheModule(0), Buffer(0), BufferOwned(false),
       LazyStreamer(streamer), NextUnreadBit(0), SeenValueSymbolTable(false),
       ErrorString(0), ValueList(C), MDValueList(C),
-      SeenFirstFunctionBody(false), UseRelativeIDs(false) {
+      SeenFirstFunctionBody(false), UseRelativeIDs(false),
+      LazyMetadata(false), LazyMDDepth(0), LazyMDFailed(false), Parent(0) {
+    MDValueList.setLoader(this);
   }
   ~BitcodeReader() {
     FreeState();
@@ -216,11 +313,23 @@ public:
   /// when the reader is destroyed.
   void setBufferOwned(bool Owned) { BufferOwned = Owned; }
 
+  /// setLazyMetadata - If this is true, module-level metadata is read when
+  /// something refers to it rather than with the module.  Call this before
+  /// ParseBitcodeInto.
+  void setLazyMetadata(bool Lazy) { LazyMetadata = Lazy; }
+
+  /// loadLazyMetadata - Read the module-level metadata value with the given
+  /// ID if it has not been read yet.  Return null if there is no such value
+  /// to read, or if it can only be read later, in which case the caller makes
+  /// a placeholder for it.
+  Value *loadLazyMetadata(unsigned ID);
+
   virtual bool isMaterializable(const GlobalValue *GV) const;
   virtual bool isDematerializable(const GlobalValue *GV) const;
   virtual bool Materialize(GlobalValue *GV, std::string *ErrInfo = 0);
   virtual bool MaterializeModule(Module *M, std::string *ErrInfo = 0);
   virtual void Dematerialize(GlobalValue *GV);
+  virtual bool MaterializeMetadata(std::string *ErrInfo = 0);
 
   bool Error(const char *Str) {
     ErrorString = Str;
@@ -331,9 +440,18 @@ private:
   bool ParseConstants();
   bool RememberAndSkipFunctionBody();
   bool ParseFunctionBody(Function *F);
+  bool ParseFunctionBodiesInParallel();
+  bool AdoptBlockAddrFwdRefs(BitcodeReader &Worker);
   bool GlobalCleanup();
   bool ResolveGlobalAndAliasInits();
   bool ParseMetadata();
+  bool ParseMetadataValue(unsigned Code, SmallVectorImpl<uint64_t> &Record,
+                          unsigned ID);
+  bool ParseMetadataKind(SmallVectorImpl<uint64_t> &Record);
+  bool ParseNamedMetadata(BitstreamCursor &Cursor,
+                          SmallVectorImpl<uint64_t> &Record);
+  bool IndexMetadata();
+  bool ReadLazyMetadata(unsigned ID);
   bool ParseMetadataAttachment();
   bool ParseModuleTriple(std::string &Triple);
   bool ParseUseLists();
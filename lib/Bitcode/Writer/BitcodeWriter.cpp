@@ -13,6 +13,7 @@
 
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "ValueEnumerator.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/Bitcode/BitstreamWriter.h"
 #include "llvm/Bitcode/LLVMBitCodes.h"
@@ -23,10 +24,12 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Operator.h"
 #include "llvm/IR/ValueSymbolTable.h"
+#include "llvm/Support/Atomic.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/Program.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include <cctype>
 #include <map>
@@ -38,6 +41,12 @@ EnablePreserveUseListOrdering("enable-bc-uselist-preserve",
                                        "use-list order preservation."),
                               cl::init(false), cl::Hidden);
 
+static cl::opt<unsigned>
+BitcodeWriterThreads("bitcode-writer-threads",
+                     cl::desc("Encode the function blocks of a module on this "
+                              "many threads"),
+                     cl::init(0));
+
 /// These are manifest constants used by the bitcode writer. They do not need to
 /// be kept in sync with the reader, but need to be consistent within this file.
 enum {
@@ -1482,10 +1491,19 @@ static void WriteValueSymbolTable(const ValueSymbolTable &VST,
   // FIXME: We know if the type names can use 7-bit ascii.
   SmallVector<unsigned, 64> NameVals;
 
+  // Emit the names in the order of the values they name rather than that of
+  // the hash table, which depends on the names added and removed before.
+  // Blocks are numbered apart from the other values and come after them.
+  SmallVector<std::pair<uint64_t, const ValueName *>, 64> Names;
   for (ValueSymbolTable::const_iterator SI = VST.begin(), SE = VST.end();
-       SI != SE; ++SI) {
+       SI != SE; ++SI)
+    Names.push_back(std::make_pair(
+      uint64_t(isa<BasicBlock>(SI->getValue())) << 32 |
+        VE.getValueID(SI->getValue()), &*SI));
+  array_pod_sort(Names.begin(), Names.end());
 
-    const ValueName &Name = *SI;
+  for (unsigned i = 0, e = Names.size(); i != e; ++i) {
+    const ValueName &Name = *Names[i].second;
 
     // Figure out the encoding to use for the name.
     bool is7Bit = true;
@@ -1505,7 +1523,7 @@ static void WriteValueSymbolTable(const ValueSymbolTable &VST,
     // VST_ENTRY:   [valueid, namechar x N]
     // VST_BBENTRY: [bbid, namechar x N]
     unsigned Code;
-    if (isa<BasicBlock>(SI->getValue())) {
+    if (isa<BasicBlock>(Name.getValue())) {
       Code = bitc::VST_CODE_BBENTRY;
       if (isChar6)
         AbbrevToUse = VST_BBENTRY_6_ABBREV;
@@ -1517,7 +1535,7 @@ static void WriteValueSymbolTable(const ValueSymbolTable &VST,
         AbbrevToUse = VST_ENTRY_7_ABBREV;
     }
 
-    NameVals.push_back(VE.getValueID(SI->getValue()));
+    NameVals.push_back(VE.getValueID(Name.getValue()));
     for (const char *P = Name.getKeyData(),
          *E = Name.getKeyData()+Name.getKeyLength(); P != E; ++P)
       NameVals.push_back((unsigned char)*P);
@@ -1601,6 +1619,97 @@ static void WriteFunction(const Function &F, ValueEnumerator &VE,
   Stream.ExitBlock();
 }
 
+namespace {
+/// FunctionBlockSlot - Where WriteFunctionsInParallel left the encoded block
+/// of one function: a range of the buffer of one of its workers.
+struct FunctionBlockSlot {
+  unsigned Worker;
+  unsigned Begin, End;
+};
+
+/// FunctionBlockWorker - The state of one thread of WriteFunctionsInParallel.
+/// The workers take the functions in order from a shared counter and encode
+/// them one after another into their own buffers, numbering the values local
+/// to each with their own copy of the module's ValueEnumerator.
+struct FunctionBlockWorker {
+  unsigned Index;
+  ValueEnumerator *VE;
+  SmallVector<char, 0> Buffer;
+  BitstreamWriter *Stream;
+  ArrayRef<const Function *> Funcs;
+  FunctionBlockSlot *Slots;
+  volatile sys::cas_flag *NextFunc;
+
+  static void run(void *Arg) {
+    FunctionBlockWorker *W = static_cast<FunctionBlockWorker *>(Arg);
+    while (true) {
+      unsigned FuncNo = sys::AtomicIncrement(W->NextFunc) - 1;
+      if (FuncNo >= W->Funcs.size())
+        break;
+      FunctionBlockSlot &Slot = W->Slots[FuncNo];
+      Slot.Worker = W->Index;
+      Slot.Begin = W->Buffer.size();
+      WriteFunction(*W->Funcs[FuncNo], *W->VE, *W->Stream);
+      Slot.End = W->Buffer.size();
+    }
+  }
+};
+}
+
+/// WriteFunctionsInParallel - Emit the function bodies of M to the module
+/// stream, encoding them on -bitcode-writer-threads threads.  A function block
+/// only depends on the module-level numbering, which is fixed by now, so the
+/// blocks are spliced into the stream in module order and the output is the
+/// same as that of WriteFunction.  Return false if there are too few threads
+/// or function bodies to share, and nothing was written.
+static bool WriteFunctionsInParallel(const Module *M, const ValueEnumerator &VE,
+                                     BitstreamWriter &Stream) {
+  if (BitcodeWriterThreads < 2)
+    return false;
+
+  std::vector<const Function *> Funcs;
+  for (Module::const_iterator F = M->begin(), E = M->end(); F != E; ++F)
+    if (!F->isDeclaration())
+      Funcs.push_back(F);
+  if (Funcs.size() < 2)
+    return false;
+
+  unsigned NumThreads = std::min<unsigned>(BitcodeWriterThreads, Funcs.size());
+  std::vector<FunctionBlockSlot> Slots(Funcs.size());
+  volatile sys::cas_flag NextFunc = 0;
+  std::vector<FunctionBlockWorker> Workers(NumThreads);
+  {
+    ThreadPool Pool(NumThreads);
+    for (unsigned i = 0; i != NumThreads; ++i) {
+      FunctionBlockWorker &W = Workers[i];
+      W.Index = i;
+      W.VE = new ValueEnumerator(VE);
+      W.Stream = new BitstreamWriter(W.Buffer);
+      W.Stream->CopyBlockInfoRecords(Stream);
+      W.Funcs = Funcs;
+      W.Slots = &Slots[0];
+      W.NextFunc = &NextFunc;
+      Pool.async(FunctionBlockWorker::run, &W);
+    }
+    Pool.wait();
+  }
+
+  // WriteFunction opens function blocks with a code width of 4.
+  for (unsigned i = 0, e = Slots.size(); i != e; ++i) {
+    const FunctionBlockSlot &Slot = Slots[i];
+    const SmallVectorImpl<char> &Buffer = Workers[Slot.Worker].Buffer;
+    Stream.EmitEncodedBlock(bitc::FUNCTION_BLOCK_ID, 4,
+                            StringRef(Buffer.data() + Slot.Begin,
+                                      Slot.End - Slot.Begin));
+  }
+
+  for (unsigned i = 0; i != NumThreads; ++i) {
+    delete Workers[i].Stream;
+    delete Workers[i].VE;
+  }
+  return true;
+}
+
 // Emit blockinfo, which defines the standard abbreviations etc.
 static void WriteBlockInfo(const ValueEnumerator &VE, BitstreamWriter &Stream) {
   // We only want to emit block info records for blocks that have multiple
@@ -1904,9 +2013,10 @@ static void WriteModule(const Module *M, BitstreamWriter &Stream) {
     WriteModuleUseLists(M, VE, Stream);
 
   // Emit function bodies.
-  for (Module::const_iterator F = M->begin(), E = M->end(); F != E; ++F)
-    if (!F->isDeclaration())
-      WriteFunction(*F, VE, Stream);
+  if (!WriteFunctionsInParallel(M, VE, Stream))
+    for (Module::const_iterator F = M->begin(), E = M->end(); F != E; ++F)
+      if (!F->isDeclaration())
+        WriteFunction(*F, VE, Stream);
 
   Stream.ExitBlock();
 }
@@ -38,6 +38,7 @@ Attribute Attribute::get(LLVMContext &Context, Attribute::AttrKind Kind,
   if (Val) ID.AddInteger(Val);
 
   void *InsertPoint;
+  sys::SmartScopedLock<true> Guard(pImpl->Lock);
   AttributeImpl *PA = pImpl->AttrsSet.FindNodeOrInsertPos(ID, InsertPoint);
 
   if (!PA) {
@@ -60,6 +61,7 @@ Attribute Attribute::get(LLVMContext &Context, StringRef Kind, StringRef Val) {
   if (!Val.empty()) ID.AddString(Val);
 
   void *InsertPoint;
+  sys::SmartScopedLock<true> Guard(pImpl->Lock);
   AttributeImpl *PA = pImpl->AttrsSet.FindNodeOrInsertPos(ID, InsertPoint);
 
   if (!PA) {
@@ -421,6 +423,7 @@ AttributeSetNode *AttributeSetNode::get(LLVMContext &C,
     I->Profile(ID);
 
   void *InsertPoint;
+  sys::SmartScopedLock<true> Guard(pImpl->Lock);
   AttributeSetNode *PA =
     pImpl->AttrsSetNodes.FindNodeOrInsertPos(ID, InsertPoint);
 
@@ -539,6 +542,7 @@ AttributeSet::getImpl(LLVMContext &C,
   AttributeSetImpl::Profile(ID, Attrs);
 
   void *InsertPoint;
+  sys::SmartScopedLock<true> Guard(pImpl->Lock);
   AttributeSetImpl *PA = pImpl->AttrsLists.FindNodeOrInsertPos(ID, InsertPoint);
 
   // If we didn't find any existing attributes of the same shape then
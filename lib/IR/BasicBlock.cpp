@@ -83,8 +83,12 @@ BasicBlock::~BasicBlock() {
 }
 
 void BasicBlock::setParent(Function *parent) {
-  if (getParent())
+  if (getParent()) {
     LeakDetector::addGarbageObject(this);
+    getParent()->markModified();
+  }
+  if (parent)
+    parent->markModified();
 
   // Set Parent=parent, updating instruction symtab entries as appropriate.
   InstList.setSymTabObject(&Parent, parent);
@@ -393,6 +393,10 @@ static bool removeDeadUsersOfConstant(const Constant *C) {
 /// that want to check to see if a global is unused, but don't want to deal
 /// with potentially dead constants hanging off of the globals.
 void Constant::removeDeadConstantUsers() const {
+  if (FunctionLocalScope::isActive())
+    report_fatal_error("Cannot destroy constants while running passes on "
+                       "several threads");
+
   Value::const_use_iterator I = use_begin(), E = use_end();
   Value::const_use_iterator LastNonDeadUser = E;
   while (I != E) {
@@ -436,17 +440,11 @@ ConstantInt::ConstantInt(IntegerType *Ty, const APInt& V)
 }
 
 ConstantInt *ConstantInt::getTrue(LLVMContext &Context) {
-  LLVMContextImpl *pImpl = Context.pImpl;
-  if (!pImpl->TheTrueVal)
-    pImpl->TheTrueVal = ConstantInt::get(Type::getInt1Ty(Context), 1);
-  return pImpl->TheTrueVal;
+  return Context.pImpl->TheTrueVal;
 }
 
 ConstantInt *ConstantInt::getFalse(LLVMContext &Context) {
-  LLVMContextImpl *pImpl = Context.pImpl;
-  if (!pImpl->TheFalseVal)
-    pImpl->TheFalseVal = ConstantInt::get(Type::getInt1Ty(Context), 0);
-  return pImpl->TheFalseVal;
+  return Context.pImpl->TheFalseVal;
 }
 
 Constant *ConstantInt::getTrue(Type *Ty) {
@@ -484,7 +482,13 @@ ConstantInt *ConstantInt::get(LLVMContext &Context, const APInt &V) {
   IntegerType *ITy = IntegerType::get(Context, V.getBitWidth());
   // get an existing value or the insertion position
   DenseMapAPIntKeyInfo::KeyTy Key(V, ITy);
-  ConstantInt *&Slot = Context.pImpl->IntConstants[Key]; 
+  LLVMContextImpl *pImpl = Context.pImpl;
+  if (ConstantInt *CI = pImpl->IntConstants.lookup(Key))
+    return CI;
+
+  LLVMContextImpl::IntMapTy::Shard &S = pImpl->IntConstants.getShard(Key);
+  sys::SmartScopedWriter<true> Writer(S.Lock);
+  ConstantInt *&Slot = S.Map[Key]; 
   if (!Slot) Slot = new ConstantInt(ITy, V);
   return Slot;
 }
@@ -611,8 +615,12 @@ ConstantFP* ConstantFP::get(LLVMContext &Context, const APFloat& V) {
   DenseMapAPFloatKeyInfo::KeyTy Key(V);
 
   LLVMContextImpl* pImpl = Context.pImpl;
+  if (ConstantFP *CFP = pImpl->FPConstants.lookup(Key))
+    return CFP;
 
-  ConstantFP *&Slot = pImpl->FPConstants[Key];
+  LLVMContextImpl::FPMapTy::Shard &S = pImpl->FPConstants.getShard(Key);
+  sys::SmartScopedWriter<true> Writer(S.Lock);
+  ConstantFP *&Slot = S.Map[Key];
 
   if (!Slot) {
     Type *Ty;
@@ -1233,7 +1241,13 @@ ConstantAggregateZero *ConstantAggregateZero::get(Type *Ty) {
   assert((Ty->isStructTy() || Ty->isArrayTy() || Ty->isVectorTy()) &&
          "Cannot create an aggregate zero of non-aggregate type!");
   
-  ConstantAggregateZero *&Entry = Ty->getContext().pImpl->CAZConstants[Ty];
+  LLVMContextImpl *pImpl = Ty->getContext().pImpl;
+  if (ConstantAggregateZero *CAZ = pImpl->CAZConstants.lookup(Ty))
+    return CAZ;
+
+  LLVMContextImpl::CAZMapTy::Shard &S = pImpl->CAZConstants.getShard(Ty);
+  sys::SmartScopedWriter<true> Writer(S.Lock);
+  ConstantAggregateZero *&Entry = S.Map[Ty];
   if (Entry == 0)
     Entry = new ConstantAggregateZero(Ty);
 
@@ -1313,7 +1327,13 @@ const APInt &Constant::getUniqueInteger() const {
 //
 
 ConstantPointerNull *ConstantPointerNull::get(PointerType *Ty) {
-  ConstantPointerNull *&Entry = Ty->getContext().pImpl->CPNConstants[Ty];
+  LLVMContextImpl *pImpl = Ty->getContext().pImpl;
+  if (ConstantPointerNull *CPN = pImpl->CPNConstants.lookup(Ty))
+    return CPN;
+
+  LLVMContextImpl::CPNMapTy::Shard &S = pImpl->CPNConstants.getShard(Ty);
+  sys::SmartScopedWriter<true> Writer(S.Lock);
+  ConstantPointerNull *&Entry = S.Map[Ty];
   if (Entry == 0)
     Entry = new ConstantPointerNull(Ty);
 
@@ -1333,7 +1353,13 @@ void ConstantPointerNull::destroyConstant() {
 //
 
 UndefValue *UndefValue::get(Type *Ty) {
-  UndefValue *&Entry = Ty->getContext().pImpl->UVConstants[Ty];
+  LLVMContextImpl *pImpl = Ty->getContext().pImpl;
+  if (UndefValue *UV = pImpl->UVConstants.lookup(Ty))
+    return UV;
+
+  LLVMContextImpl::UVMapTy::Shard &S = pImpl->UVConstants.getShard(Ty);
+  sys::SmartScopedWriter<true> Writer(S.Lock);
+  UndefValue *&Entry = S.Map[Ty];
   if (Entry == 0)
     Entry = new UndefValue(Ty);
 
@@ -1357,6 +1383,7 @@ BlockAddress *BlockAddress::get(BasicBlock *BB) {
 }
 
 BlockAddress *BlockAddress::get(Function *F, BasicBlock *BB) {
+  sys::SmartScopedLock<true> Guard(F->getContext().pImpl->Lock);
   BlockAddress *&BA =
     F->getContext().pImpl->BlockAddresses[std::make_pair(F, BB)];
   if (BA == 0)
@@ -1378,6 +1405,7 @@ BlockAddress::BlockAddress(Function *F, BasicBlock *BB)
 // destroyConstant - Remove the constant from the constant table.
 //
 void BlockAddress::destroyConstant() {
+  sys::SmartScopedLock<true> Guard(getContext().pImpl->Lock);
   getFunction()->getType()->getContext().pImpl
     ->BlockAddresses.erase(std::make_pair(getFunction(), getBasicBlock()));
   getBasicBlock()->AdjustBlockAddressRefCount(-1);
@@ -1397,6 +1425,7 @@ void BlockAddress::replaceUsesOfWithOnConstant(Value *From, Value *To, Use *U) {
 
   // See if the 'new' entry already exists, if not, just update this in place
   // and return early.
+  sys::SmartScopedLock<true> Guard(getContext().pImpl->Lock);
   BlockAddress *&NewBA =
     getContext().pImpl->BlockAddresses[std::make_pair(NewF, NewBB)];
   if (NewBA == 0) {
@@ -2149,9 +2178,9 @@ GetElementPtrConstantExpr(Constant *C, ArrayRef<Constant*> IdxList,
   : ConstantExpr(DestTy, Instruction::GetElementPtr,
                  OperandTraits<GetElementPtrConstantExpr>::op_end(this)
                  - (IdxList.size()+1), IdxList.size()+1) {
-  OperandList[0] = C;
+  op_begin()[0] = C;
   for (unsigned i = 0, E = IdxList.size(); i != E; ++i)
-    OperandList[i+1] = IdxList[i];
+    op_begin()[i+1] = IdxList[i];
 }
 
 //===----------------------------------------------------------------------===//
@@ -2228,6 +2257,8 @@ Constant *ConstantDataSequential::getImpl(StringRef Elements, Type *Ty) {
     return ConstantAggregateZero::get(Ty);
 
   // Do a lookup to see if we have already formed one of these.
+  LLVMContextImpl *pImpl = Ty->getContext().pImpl;
+  SharedContextLock Guard(pImpl->CDSConstantsLock, pImpl->SharingThreads);
   StringMap<ConstantDataSequential*>::MapEntryTy &Slot =
     Ty->getContext().pImpl->CDSConstants.GetOrCreateValue(Elements);
 
@@ -2252,39 +2283,42 @@ Constant *ConstantDataSequential::getImpl(StringRef Elements, Type *Ty) {
 
 void ConstantDataSequential::destroyConstant() {
   // Remove the constant from the StringMap.
-  StringMap<ConstantDataSequential*> &CDSConstants = 
-    getType()->getContext().pImpl->CDSConstants;
+  {
+    sys::SmartScopedLock<true> Guard(getContext().pImpl->CDSConstantsLock);
+    StringMap<ConstantDataSequential*> &CDSConstants = 
+      getType()->getContext().pImpl->CDSConstants;
 
-  StringMap<ConstantDataSequential*>::iterator Slot =
-    CDSConstants.find(getRawDataValues());
+    StringMap<ConstantDataSequential*>::iterator Slot =
+      CDSConstants.find(getRawDataValues());
 
-  assert(Slot != CDSConstants.end() && "CDS not found in uniquing table");
+    assert(Slot != CDSConstants.end() && "CDS not found in uniquing table");
 
-  ConstantDataSequential **Entry = &Slot->getValue();
+    ConstantDataSequential **Entry = &Slot->getValue();
 
-  // Remove the entry from the hash table.
-  if ((*Entry)->Next == 0) {
-    // If there is only one value in the bucket (common case) it must be this
-    // entry, and removing the entry should remove the bucket completely.
-    assert((*Entry) == this && "Hash mismatch in ConstantDataSequential");
-    getContext().pImpl->CDSConstants.erase(Slot);
-  } else {
-    // Otherwise, there are multiple entries linked off the bucket, unlink the 
-    // node we care about but keep the bucket around.
-    for (ConstantDataSequential *Node = *Entry; ;
-         Entry = &Node->Next, Node = *Entry) {
-      assert(Node && "Didn't find entry in its uniquing hash table!");
-      // If we found our entry, unlink it from the list and we're done.
-      if (Node == this) {
-        *Entry = Node->Next;
-        break;
+    // Remove the entry from the hash table.
+    if ((*Entry)->Next == 0) {
+      // If there is only one value in the bucket (common case) it must be this
+      // entry, and removing the entry should remove the bucket completely.
+      assert((*Entry) == this && "Hash mismatch in ConstantDataSequential");
+      getContext().pImpl->CDSConstants.erase(Slot);
+    } else {
+      // Otherwise, there are multiple entries linked off the bucket, unlink
+      // the node we care about but keep the bucket around.
+      for (ConstantDataSequential *Node = *Entry; ;
+           Entry = &Node->Next, Node = *Entry) {
+        assert(Node && "Didn't find entry in its uniquing hash table!");
+        // If we found our entry, unlink it from the list and we're done.
+        if (Node == this) {
+          *Entry = Node->Next;
+          break;
+        }
       }
-    }
   }
 
   // If we were part of a list, make sure that we don't delete the list that is
   // still owned by the uniquing map.
   Next = 0;
+  }
 
   // Finally, actually delete it.
   destroyConstantImpl();
@@ -2538,6 +2572,7 @@ void ConstantArray::replaceUsesOfWithOnConstant(Value *From, Value *To,
   Constant *ToC = cast<Constant>(To);
 
   LLVMContextImpl *pImpl = getType()->getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->Lock);
 
   SmallVector<Constant*, 8> Values;
   LLVMContextImpl::ArrayConstantsTy::LookupKey Lookup;
@@ -2550,7 +2585,7 @@ void ConstantArray::replaceUsesOfWithOnConstant(Value *From, Value *To,
 
   // Keep track of whether all the values in the array are "ToC".
   bool AllSame = true;
-  for (Use *O = OperandList, *E = OperandList+getNumOperands(); O != E; ++O) {
+  for (Use *O = op_begin(), *E = op_begin()+getNumOperands(); O != E; ++O) {
     Constant *Val = cast<Constant>(O->get());
     if (Val == From) {
       Val = ToC;
@@ -2566,7 +2601,9 @@ void ConstantArray::replaceUsesOfWithOnConstant(Value *From, Value *To,
   } else if (AllSame && isa<UndefValue>(ToC)) {
     Replacement = UndefValue::get(getType());
   } else {
-    // Check to see if we have this array type already.
+    // Check to see if we have this array type already.  The table lock is
+    // released before the replacement below destroys this constant.
+    sys::SmartScopedLock<true> TableGuard(pImpl->ArrayConstants.getLock());
     Lookup.second = makeArrayRef(Values);
     LLVMContextImpl::ArrayConstantsTy::MapTy::iterator I =
       pImpl->ArrayConstants.find(Lookup);
@@ -2583,7 +2620,7 @@ void ConstantArray::replaceUsesOfWithOnConstant(Value *From, Value *To,
       // Update to the new value.  Optimize for the case when we have a single
       // operand that we're changing, but handle bulk updates efficiently.
       if (NumUpdated == 1) {
-        unsigned OperandToUpdate = U - OperandList;
+        unsigned OperandToUpdate = U - op_begin();
         assert(getOperand(OperandToUpdate) == From &&
                "ReplaceAllUsesWith broken!");
         setOperand(OperandToUpdate, ToC);
@@ -2612,7 +2649,7 @@ void ConstantStruct::replaceUsesOfWithOnConstant(Value *From, Value *To,
   assert(isa<Constant>(To) && "Cannot make Constant refer to non-constant!");
   Constant *ToC = cast<Constant>(To);
 
-  unsigned OperandToUpdate = U-OperandList;
+  unsigned OperandToUpdate = U-op_begin();
   assert(getOperand(OperandToUpdate) == From && "ReplaceAllUsesWith broken!");
 
   SmallVector<Constant*, 8> Values;
@@ -2626,25 +2663,26 @@ void ConstantStruct::replaceUsesOfWithOnConstant(Value *From, Value *To,
   bool isAllUndef = false;
   if (ToC->isNullValue()) {
     isAllZeros = true;
-    for (Use *O = OperandList, *E = OperandList+getNumOperands(); O != E; ++O) {
+    for (Use *O = op_begin(), *E = op_begin()+getNumOperands(); O != E; ++O) {
       Constant *Val = cast<Constant>(O->get());
       Values.push_back(Val);
       if (isAllZeros) isAllZeros = Val->isNullValue();
     }
   } else if (isa<UndefValue>(ToC)) {
     isAllUndef = true;
-    for (Use *O = OperandList, *E = OperandList+getNumOperands(); O != E; ++O) {
+    for (Use *O = op_begin(), *E = op_begin()+getNumOperands(); O != E; ++O) {
       Constant *Val = cast<Constant>(O->get());
       Values.push_back(Val);
       if (isAllUndef) isAllUndef = isa<UndefValue>(Val);
     }
   } else {
-    for (Use *O = OperandList, *E = OperandList + getNumOperands(); O != E; ++O)
+    for (Use *O = op_begin(), *E = op_begin() + getNumOperands(); O != E; ++O)
       Values.push_back(cast<Constant>(O->get()));
   }
   Values[OperandToUpdate] = ToC;
 
   LLVMContextImpl *pImpl = getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->Lock);
 
   Constant *Replacement = 0;
   if (isAllZeros) {
@@ -2652,7 +2690,9 @@ void ConstantStruct::replaceUsesOfWithOnConstant(Value *From, Value *To,
   } else if (isAllUndef) {
     Replacement = UndefValue::get(getType());
   } else {
-    // Check to see if we have this struct type already.
+    // Check to see if we have this struct type already.  The table lock is
+    // released before the replacement below destroys this constant.
+    sys::SmartScopedLock<true> TableGuard(pImpl->StructConstants.getLock());
     Lookup.second = makeArrayRef(Values);
     LLVMContextImpl::StructConstantsTy::MapTy::iterator I =
       pImpl->StructConstants.find(Lookup);
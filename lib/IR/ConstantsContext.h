@@ -20,8 +20,10 @@
 #include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Operator.h"
+#include "llvm/Support/Atomic.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Mutex.h"
 #include "llvm/Support/raw_ostream.h"
 #include <map>
 
@@ -510,6 +512,25 @@ struct ConstantKeyData<InlineAsm> {
   }
 };
 
+/// SharedContextLock - Hold Lock for the current scope, but only while some
+/// LLVMContext::SharedScope of its context is alive.  The scopes only begin
+/// and end while no other thread uses the context, so the lookups of uniquing
+/// hits can go without the lock the rest of the time.
+class SharedContextLock {
+  sys::SmartMutex<true> *Lock;
+public:
+  SharedContextLock(sys::SmartMutex<true> &L,
+                    const volatile sys::cas_flag &SharingThreads)
+    : Lock(SharingThreads ? &L : 0) {
+    if (Lock)
+      Lock->acquire();
+  }
+  ~SharedContextLock() {
+    if (Lock)
+      Lock->release();
+  }
+};
+
 template<class ValType, class ValRefType, class TypeClass, class ConstantClass,
          bool HasLargeKey = false /*true for arrays and structs*/ >
 class ConstantUniqueMap {
@@ -529,7 +550,17 @@ private:
   /// through the map with very large keys.
   InverseMapTy InverseMap;
 
+  /// Lock - Guards Map and InverseMap.  Each unique map has a lock of its own
+  /// so that threads creating different kinds of constants do not contend.
+  sys::SmartMutex<true> Lock;
+
+  /// SharingThreads - The count of live SharedScopes of the owning context.
+  const volatile sys::cas_flag &SharingThreads;
+
 public:
+  explicit ConstantUniqueMap(const volatile sys::cas_flag &SharingThreads)
+    : SharingThreads(SharingThreads) {}
+
   typename MapTy::iterator map_begin() { return Map.begin(); }
   typename MapTy::iterator map_end() { return Map.end(); }
 
@@ -597,6 +628,7 @@ public:
     MapKey Lookup(Ty, V);
     ConstantClass* Result = 0;
     
+    SharedContextLock Guard(Lock, SharingThreads);
     typename MapTy::iterator I = Map.find(Lookup);
     // Is it in the map?  
     if (I != Map.end())
@@ -611,6 +643,7 @@ public:
   }
 
   void remove(ConstantClass *CP) {
+    sys::SmartScopedLock<true> Guard(Lock);
     typename MapTy::iterator I = FindExistingElement(CP);
     assert(I != Map.end() && "Constant not found in constant table!");
     assert(I->second == CP && "Didn't find correct element?");
@@ -699,10 +732,23 @@ private:
   /// constant.
   MapTy Map;
 
+  /// Lock - Guards Map.
+  sys::SmartMutex<true> Lock;
+
+  /// SharingThreads - The count of live SharedScopes of the owning context.
+  const volatile sys::cas_flag &SharingThreads;
+
 public:
+  explicit ConstantAggrUniqueMap(const volatile sys::cas_flag &SharingThreads)
+    : SharingThreads(SharingThreads) {}
+
   typename MapTy::iterator map_begin() { return Map.begin(); }
   typename MapTy::iterator map_end() { return Map.end(); }
 
+  /// getLock - Return the lock that callers of find, insert and remove must
+  /// hold across a sequence of calls that has to appear atomic.
+  sys::SmartMutex<true> &getLock() { return Lock; }
+
   void freeConstants() {
     for (typename MapTy::iterator I=Map.begin(), E=Map.end();
          I != E; ++I) {
@@ -733,6 +779,7 @@ public:
     LookupKey Lookup(Ty, V);
     ConstantClass* Result = 0;
 
+    SharedContextLock Guard(Lock, SharingThreads);
     typename MapTy::iterator I = Map.find_as(Lookup);
     // Is it in the map?
     if (I != Map.end())
@@ -753,11 +800,13 @@ public:
 
   /// Insert the constant into its proper slot.
   void insert(ConstantClass *CP) {
+    sys::SmartScopedLock<true> Guard(Lock);
     Map[CP] = '\0';
   }
 
   /// Remove this constant from the map
   void remove(ConstantClass *CP) {
+    sys::SmartScopedLock<true> Guard(Lock);
     typename MapTy::iterator I = findExistingElement(CP);
     assert(I != Map.end() && "Constant not found in constant table!");
     assert(I->first == CP && "Didn't find correct element?");
@@ -19,6 +19,8 @@ using namespace llvm;
 
 MDNode *DebugLoc::getScope(const LLVMContext &Ctx) const {
   if (ScopeIdx == 0) return 0;
+
+  sys::SmartScopedLock<true> Guard(Ctx.pImpl->Lock);
   
   if (ScopeIdx > 0) {
     // Positive ScopeIdx is an index into ScopeRecords, which has no inlined-at
@@ -39,6 +41,8 @@ MDNode *DebugLoc::getInlinedAt(const LLVMContext &Ctx) const {
   // position specified.  Zero is invalid.
   if (ScopeIdx >= 0) return 0;
   
+  sys::SmartScopedLock<true> Guard(Ctx.pImpl->Lock);
+
   // Otherwise, the index is in the ScopeInlinedAtRecords array.
   assert(unsigned(-ScopeIdx) <= Ctx.pImpl->ScopeInlinedAtRecords.size() &&
          "Invalid ScopeIdx");
@@ -53,6 +57,7 @@ void DebugLoc::getScopeAndInlinedAt(MDNode *&Scope, MDNode *&IA,
     return;
   }
   
+  sys::SmartScopedLock<true> Guard(Ctx.pImpl->Lock);
   if (ScopeIdx > 0) {
     // Positive ScopeIdx is an index into ScopeRecords, which has no inlined-at
     // position specified.
@@ -160,6 +165,8 @@ unsigned DenseMapInfo<DebugLoc>::getHashValue(const DebugLoc &Key) {
 
 int LLVMContextImpl::getOrAddScopeRecordIdxEntry(MDNode *Scope,
                                                  int ExistingIdx) {
+  sys::SmartScopedLock<true> Guard(Lock);
+
   // If we already have an entry for this scope, return it.
   int &Idx = ScopeRecordIdx[Scope];
   if (Idx) return Idx;
@@ -183,6 +190,8 @@ int LLVMContextImpl::getOrAddScopeRecordIdxEntry(MDNode *Scope,
 
 int LLVMContextImpl::getOrAddScopeInlinedAtIdxEntry(MDNode *Scope, MDNode *IA,
                                                     int ExistingIdx) {
+  sys::SmartScopedLock<true> Guard(Lock);
+
   // If we already have an entry, return it.
   int &Idx = ScopeInlinedAtIdx[std::make_pair(Scope, IA)];
   if (Idx) return Idx;
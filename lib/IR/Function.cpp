@@ -22,6 +22,7 @@
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/Atomic.h"
 #include "llvm/Support/CallSite.h"
 #include "llvm/Support/InstIterator.h"
 #include "llvm/Support/LeakDetector.h"
@@ -186,7 +187,7 @@ void Function::eraseFromParent() {
 Function::Function(FunctionType *Ty, LinkageTypes Linkage,
                    const Twine &name, Module *ParentModule)
   : GlobalValue(PointerType::getUnqual(Ty),
-                Value::FunctionVal, 0, 0, Linkage, name) {
+                Value::FunctionVal, 0, 0, Linkage, name), ModificationEpoch(0) {
   assert(FunctionType::isValidReturnType(getReturnType()) &&
          "invalid return type");
   SymTab = new ValueSymbolTable();
@@ -198,8 +199,11 @@ Function::Function(FunctionType *Ty, LinkageTypes Linkage,
   // Make sure that we get added to a function
   LeakDetector::addGarbageObject(this);
 
-  if (ParentModule)
+  if (ParentModule) {
+    FunctionLocalScope::orderGlobalCreation();
+    sys::SmartScopedLock<true> Guard(getContext().pImpl->Lock);
     ParentModule->getFunctionList().push_back(this);
+  }
 
   // Ensure intrinsics have the right parameter attributes.
   if (unsigned IID = getIntrinsicID())
@@ -218,8 +222,10 @@ Function::~Function() {
   clearGC();
 
   // Remove the intrinsicID from the Cache.
-  if (getValueName() && isIntrinsic())
+  if (getValueName() && isIntrinsic()) {
+    sys::SmartScopedLock<true> Guard(getContext().pImpl->Lock);
     getContext().pImpl->IntrinsicIDCache.erase(this);
+  }
 }
 
 void Function::BuildLazyArguments() const {
@@ -243,6 +249,17 @@ bool Function::arg_empty() const {
   return getFunctionType()->getNumParams() == 0;
 }
 
+/// LastModificationEpoch - The last epoch handed out to any function, so that
+/// a function that replaces a deleted one never sees the epoch of the latter.
+static volatile sys::cas_flag LastModificationEpoch = 0;
+
+unsigned Function::getModificationEpoch() const {
+  // Epochs are handed out lazily, a run of modifications costs only one.
+  while (ModificationEpoch == 0)
+    ModificationEpoch = sys::AtomicIncrement(&LastModificationEpoch);
+  return ModificationEpoch;
+}
+
 void Function::setParent(Module *parent) {
   if (getParent())
     LeakDetector::addGarbageObject(this);
@@ -357,6 +374,7 @@ unsigned Function::getIntrinsicID() const {
   if (!ValName || !isIntrinsic())
     return 0;
 
+  sys::SmartScopedLock<true> Guard(getContext().pImpl->Lock);
   LLVMContextImpl::IntrinsicIDCacheTy &IntrinsicIDCache =
     getContext().pImpl->IntrinsicIDCache;
   if (!IntrinsicIDCache.count(this)) {
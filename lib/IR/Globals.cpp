@@ -13,6 +13,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/IR/GlobalValue.h"
+#include "LLVMContextImpl.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
@@ -121,6 +122,8 @@ GlobalVariable::GlobalVariable(Module &M, Type *Ty, bool constant,
   
   LeakDetector::addGarbageObject(this);
   
+  FunctionLocalScope::orderGlobalCreation();
+  sys::SmartScopedLock<true> Guard(getContext().pImpl->Lock);
   if (Before)
     Before->getParent()->getGlobalList().insert(Before, this);
   else
@@ -167,13 +170,13 @@ void GlobalVariable::setInitializer(Constant *InitVal) {
   if (InitVal == 0) {
     if (hasInitializer()) {
       Op<0>().set(0);
-      NumOperands = 0;
+      NumUserOperands = 0;
     }
   } else {
     assert(InitVal->getType() == getType()->getElementType() &&
            "Initializer type must match GlobalVariable type");
     if (!hasInitializer())
-      NumOperands = 1;
+      NumUserOperands = 1;
     Op<0>().set(InitVal);
   }
 }
@@ -202,8 +205,10 @@ GlobalAlias::GlobalAlias(Type *Ty, LinkageTypes Link,
     assert(aliasee->getType() == Ty && "Alias and aliasee types should match!");
   Op<0>() = aliasee;
 
-  if (ParentModule)
+  if (ParentModule) {
+    FunctionLocalScope::orderGlobalCreation();
     ParentModule->getAliasList().push_back(this);
+  }
 }
 
 void GlobalAlias::setParent(Module *parent) {
@@ -58,11 +58,16 @@ Instruction::~Instruction() {
 void Instruction::setParent(BasicBlock *P) {
   if (getParent()) {
     if (!P) LeakDetector::addGarbageObject(this);
+    if (Function *F = getParent()->getParent())
+      F->markModified();
   } else {
     if (P) LeakDetector::removeGarbageObject(this);
   }
 
   Parent = P;
+  if (P)
+    if (Function *F = P->getParent())
+      F->markModified();
 }
 
 void Instruction::removeFromParent() {
@@ -85,9 +85,10 @@ const char *SelectInst::areInvalidOperands(Value *Op0, Value *Op1, Value *Op2) {
 //===----------------------------------------------------------------------===//
 
 PHINode::PHINode(const PHINode &PN)
-  : Instruction(PN.getType(), Instruction::PHI,
-                allocHungoffUses(PN.getNumOperands()), PN.getNumOperands()),
+  : Instruction(PN.getType(), Instruction::PHI, 0, 0),
     ReservedSpace(PN.getNumOperands()) {
+  setHungOffOperands(allocHungoffUses(ReservedSpace));
+  setNumHungOffUseOperands(PN.getNumOperands());
   std::copy(PN.op_begin(), PN.op_end(), op_begin());
   std::copy(PN.block_begin(), PN.block_end(), block_begin());
   SubclassOptionalData = PN.SubclassOptionalData;
@@ -124,7 +125,7 @@ Value *PHINode::removeIncomingValue(unsigned Idx, bool DeletePHIIfEmpty) {
 
   // Nuke the last value.
   Op<-1>().set(0);
-  --NumOperands;
+  setNumHungOffUseOperands(getNumOperands() - 1);
 
   // If the PHI node is dead, because it has zero entries, nuke it now.
   if (getNumOperands() == 0 && DeletePHIIfEmpty) {
@@ -148,7 +149,7 @@ void PHINode::growOperands() {
   BasicBlock **OldBlocks = block_begin();
 
   ReservedSpace = NumOps;
-  OperandList = allocHungoffUses(ReservedSpace);
+  setHungOffOperands(allocHungoffUses(ReservedSpace));
 
   std::copy(OldOps, OldOps + e, op_begin());
   std::copy(OldBlocks, OldBlocks + e, block_begin());
@@ -192,10 +193,12 @@ LandingPadInst::LandingPadInst(Type *RetTy, Value *PersonalityFn,
 }
 
 LandingPadInst::LandingPadInst(const LandingPadInst &LP)
-  : Instruction(LP.getType(), Instruction::LandingPad,
-                allocHungoffUses(LP.getNumOperands()), LP.getNumOperands()),
+  : Instruction(LP.getType(), Instruction::LandingPad, 0, 0),
     ReservedSpace(LP.getNumOperands()) {
-  Use *OL = OperandList, *InOL = LP.OperandList;
+  setHungOffOperands(allocHungoffUses(ReservedSpace));
+  setNumHungOffUseOperands(ReservedSpace);
+  Use *OL = op_begin();
+  const Use *InOL = LP.op_begin();
   for (unsigned I = 0, E = ReservedSpace; I != E; ++I)
     OL[I] = InOL[I];
 
@@ -225,9 +228,9 @@ LandingPadInst *LandingPadInst::Create(Type *RetTy, Value *PersonalityFn,
 void LandingPadInst::init(Value *PersFn, unsigned NumReservedValues,
                           const Twine &NameStr) {
   ReservedSpace = NumReservedValues;
-  NumOperands = 1;
-  OperandList = allocHungoffUses(ReservedSpace);
-  OperandList[0] = PersFn;
+  setHungOffOperands(allocHungoffUses(ReservedSpace));
+  setNumHungOffUseOperands(1);
+  Op<0>() = PersFn;
   setName(NameStr);
   setCleanup(false);
 }
@@ -240,11 +243,11 @@ void LandingPadInst::growOperands(unsigned Size) {
   ReservedSpace = (e + Size / 2) * 2;
 
   Use *NewOps = allocHungoffUses(ReservedSpace);
-  Use *OldOps = OperandList;
+  Use *OldOps = op_begin();
   for (unsigned i = 0; i != e; ++i)
       NewOps[i] = OldOps[i];
 
-  OperandList = NewOps;
+  setHungOffOperands(NewOps);
   Use::zap(OldOps, OldOps + e, true);
 }
 
@@ -252,8 +255,8 @@ void LandingPadInst::addClause(Value *Val) {
   unsigned OpNo = getNumOperands();
   growOperands(1);
   assert(OpNo < ReservedSpace && "Growing didn't work!");
-  ++NumOperands;
-  OperandList[OpNo] = Val;
+  setNumHungOffUseOperands(OpNo + 1);
+  getOperandList()[OpNo] = Val;
 }
 
 //===----------------------------------------------------------------------===//
@@ -264,7 +267,7 @@ CallInst::~CallInst() {
 }
 
 void CallInst::init(Value *Func, ArrayRef<Value *> Args, const Twine &NameStr) {
-  assert(NumOperands == Args.size() + 1 && "NumOperands not set up?");
+  assert(getNumOperands() == Args.size() + 1 && "NumOperands not set up?");
   Op<-1>() = Func;
 
 #ifndef NDEBUG
@@ -286,7 +289,7 @@ void CallInst::init(Value *Func, ArrayRef<Value *> Args, const Twine &NameStr) {
 }
 
 void CallInst::init(Value *Func, const Twine &NameStr) {
-  assert(NumOperands == 1 && "NumOperands not set up?");
+  assert(getNumOperands() == 1 && "NumOperands not set up?");
   Op<-1>() = Func;
 
 #ifndef NDEBUG
@@ -530,7 +533,7 @@ Instruction* CallInst::CreateFree(Value* Source, BasicBlock *InsertAtEnd) {
 
 void InvokeInst::init(Value *Fn, BasicBlock *IfNormal, BasicBlock *IfException,
                       ArrayRef<Value *> Args, const Twine &NameStr) {
-  assert(NumOperands == 3 + Args.size() && "NumOperands not set up?");
+  assert(getNumOperands() == 3 + Args.size() && "NumOperands not set up?");
   Op<-3>() = Fn;
   Op<-2>() = IfNormal;
   Op<-1>() = IfException;
@@ -1331,8 +1334,9 @@ FenceInst::FenceInst(LLVMContext &C, AtomicOrdering Ordering,
 
 void GetElementPtrInst::init(Value *Ptr, ArrayRef<Value *> IdxList,
                              const Twine &Name) {
-  assert(NumOperands == 1 + IdxList.size() && "NumOperands not initialized?");
-  OperandList[0] = Ptr;
+  assert(getNumOperands() == 1 + IdxList.size() &&
+         "NumOperands not initialized?");
+  Op<0>() = Ptr;
   std::copy(IdxList.begin(), IdxList.end(), op_begin() + 1);
   setName(Name);
 }
@@ -1646,7 +1650,7 @@ void ShuffleVectorInst::getShuffleMask(Constant *Mask,
 
 void InsertValueInst::init(Value *Agg, Value *Val, ArrayRef<unsigned> Idxs, 
                            const Twine &Name) {
-  assert(NumOperands == 2 && "NumOperands not initialized?");
+  assert(getNumOperands() == 2 && "NumOperands not initialized?");
 
   // There's no fundamental reason why we require at least one index
   // (other than weirdness with &*IdxBegin being invalid; see
@@ -1677,7 +1681,7 @@ InsertValueInst::InsertValueInst(const InsertValueInst &IVI)
 //===----------------------------------------------------------------------===//
 
 void ExtractValueInst::init(ArrayRef<unsigned> Idxs, const Twine &Name) {
-  assert(NumOperands == 1 && "NumOperands not initialized?");
+  assert(getNumOperands() == 1 && "NumOperands not initialized?");
 
   // There's no fundamental reason why we require at least one index.
   // But there's no present need to support it.
@@ -3142,11 +3146,11 @@ bool CmpInst::isFalseWhenEqual(unsigned short predicate) {
 void SwitchInst::init(Value *Value, BasicBlock *Default, unsigned NumReserved) {
   assert(Value && Default && NumReserved);
   ReservedSpace = NumReserved;
-  NumOperands = 2;
-  OperandList = allocHungoffUses(ReservedSpace);
+  setHungOffOperands(allocHungoffUses(ReservedSpace));
+  setNumHungOffUseOperands(2);
 
-  OperandList[0] = Value;
-  OperandList[1] = Default;
+  Op<0>() = Value;
+  Op<1>() = Default;
 }
 
 /// SwitchInst ctor - Create a new switch instruction, specifying a value to
@@ -3174,8 +3178,9 @@ SwitchInst::SwitchInst(Value *Value, BasicBlock *Default, unsigned NumCases,
 SwitchInst::SwitchInst(const SwitchInst &SI)
   : TerminatorInst(SI.getType(), Instruction::Switch, 0, 0) {
   init(SI.getCondition(), SI.getDefaultDest(), SI.getNumOperands());
-  NumOperands = SI.getNumOperands();
-  Use *OL = OperandList, *InOL = SI.OperandList;
+  setNumHungOffUseOperands(SI.getNumOperands());
+  Use *OL = op_begin();
+  const Use *InOL = SI.op_begin();
   for (unsigned i = 2, E = SI.getNumOperands(); i != E; i += 2) {
     OL[i] = InOL[i];
     OL[i+1] = InOL[i+1];
@@ -3203,12 +3208,12 @@ void SwitchInst::addCase(ConstantInt *OnVal, BasicBlock *Dest) {
 
 void SwitchInst::addCase(IntegersSubset& OnVal, BasicBlock *Dest) {
   unsigned NewCaseIdx = getNumCases(); 
-  unsigned OpNo = NumOperands;
+  unsigned OpNo = getNumOperands();
   if (OpNo+2 > ReservedSpace)
     growOperands();  // Get more space!
   // Initialize some new operands.
   assert(OpNo+1 < ReservedSpace && "Growing didn't work!");
-  NumOperands = OpNo+2;
+  setNumHungOffUseOperands(OpNo+2);
 
   SubsetsIt TheSubsetsIt = TheSubsets.insert(TheSubsets.end(), OnVal);
   
@@ -3225,7 +3230,7 @@ void SwitchInst::removeCase(CaseIt& i) {
   assert(2 + idx*2 < getNumOperands() && "Case index out of range!!!");
 
   unsigned NumOps = getNumOperands();
-  Use *OL = OperandList;
+  Use *OL = op_begin();
 
   // Overwrite this case with the end of the list.
   if (2 + (idx + 1) * 2 != NumOps) {
@@ -3246,7 +3251,7 @@ void SwitchInst::removeCase(CaseIt& i) {
     i.SubsetIt = TheSubsets.end();
   }
   
-  NumOperands = NumOps-2;
+  setNumHungOffUseOperands(NumOps-2);
 }
 
 /// growOperands - grow operands - This grows the operand list in response
@@ -3258,11 +3263,11 @@ void SwitchInst::growOperands() {
 
   ReservedSpace = NumOps;
   Use *NewOps = allocHungoffUses(NumOps);
-  Use *OldOps = OperandList;
+  Use *OldOps = op_begin();
   for (unsigned i = 0; i != e; ++i) {
       NewOps[i] = OldOps[i];
   }
-  OperandList = NewOps;
+  setHungOffOperands(NewOps);
   Use::zap(OldOps, OldOps + e, true);
 }
 
@@ -3285,10 +3290,10 @@ void IndirectBrInst::init(Value *Address, unsigned NumDests) {
   assert(Address && Address->getType()->isPointerTy() &&
          "Address of indirectbr must be a pointer");
   ReservedSpace = 1+NumDests;
-  NumOperands = 1;
-  OperandList = allocHungoffUses(ReservedSpace);
+  setHungOffOperands(allocHungoffUses(ReservedSpace));
+  setNumHungOffUseOperands(1);
   
-  OperandList[0] = Address;
+  Op<0>() = Address;
 }
 
 
@@ -3301,10 +3306,10 @@ void IndirectBrInst::growOperands() {
   
   ReservedSpace = NumOps;
   Use *NewOps = allocHungoffUses(NumOps);
-  Use *OldOps = OperandList;
+  Use *OldOps = op_begin();
   for (unsigned i = 0; i != e; ++i)
     NewOps[i] = OldOps[i];
-  OperandList = NewOps;
+  setHungOffOperands(NewOps);
   Use::zap(OldOps, OldOps + e, true);
 }
 
@@ -3324,9 +3329,11 @@ IndirectBrInst::IndirectBrInst(Value *Address, unsigned NumCases,
 
 IndirectBrInst::IndirectBrInst(const IndirectBrInst &IBI)
   : TerminatorInst(Type::getVoidTy(IBI.getContext()), Instruction::IndirectBr,
-                   allocHungoffUses(IBI.getNumOperands()),
-                   IBI.getNumOperands()) {
-  Use *OL = OperandList, *InOL = IBI.OperandList;
+                   0, 0) {
+  setHungOffOperands(allocHungoffUses(IBI.getNumOperands()));
+  setNumHungOffUseOperands(IBI.getNumOperands());
+  Use *OL = op_begin();
+  const Use *InOL = IBI.op_begin();
   for (unsigned i = 0, E = IBI.getNumOperands(); i != E; ++i)
     OL[i] = InOL[i];
   SubclassOptionalData = IBI.SubclassOptionalData;
@@ -3339,13 +3346,13 @@ IndirectBrInst::~IndirectBrInst() {
 /// addDestination - Add a destination.
 ///
 void IndirectBrInst::addDestination(BasicBlock *DestBB) {
-  unsigned OpNo = NumOperands;
+  unsigned OpNo = getNumOperands();
   if (OpNo+1 > ReservedSpace)
     growOperands();  // Get more space!
   // Initialize some new operands.
   assert(OpNo < ReservedSpace && "Growing didn't work!");
-  NumOperands = OpNo+1;
-  OperandList[OpNo] = DestBB;
+  setNumHungOffUseOperands(OpNo+1);
+  getOperandList()[OpNo] = DestBB;
 }
 
 /// removeDestination - This method removes the specified successor from the
@@ -3354,14 +3361,14 @@ void IndirectBrInst::removeDestination(unsigned idx) {
   assert(idx < getNumOperands()-1 && "Successor index out of range!");
   
   unsigned NumOps = getNumOperands();
-  Use *OL = OperandList;
+  Use *OL = op_begin();
 
   // Replace this value with the last one.
   OL[idx+1] = OL[NumOps-1];
   
   // Nuke the last value.
   OL[NumOps-1].set(0);
-  NumOperands = NumOps-1;
+  setNumHungOffUseOperands(NumOps-1);
 }
 
 BasicBlock *IndirectBrInst::getSuccessorV(unsigned idx) const {
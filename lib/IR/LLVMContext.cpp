@@ -19,6 +19,7 @@
 #include "llvm/IR/Metadata.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/Threading.h"
 #include <cctype>
 using namespace llvm;
 
@@ -98,6 +99,16 @@ void *LLVMContext::getInlineAsmDiagnosticContext() const {
   return pImpl->InlineAsmDiagContext;
 }
 
+LLVMContext::SharedScope::SharedScope(LLVMContext &Context)
+  : Context(Context) {
+  assert(llvm_is_multithreaded() && "Sharing a context on one thread?");
+  sys::AtomicIncrement(&Context.pImpl->SharingThreads);
+}
+
+LLVMContext::SharedScope::~SharedScope() {
+  sys::AtomicDecrement(&Context.pImpl->SharingThreads);
+}
+
 void LLVMContext::emitError(const Twine &ErrorStr) {
   emitError(0U, ErrorStr);
 }
@@ -153,6 +164,7 @@ unsigned LLVMContext::getMDKindID(StringRef Name) const {
   assert(isValidName(Name) && "Invalid MDNode name");
 
   // If this is new, assign it its ID.
+  sys::SmartScopedLock<true> Guard(pImpl->Lock);
   return
     pImpl->CustomMDKindNames.GetOrCreateValue(
       Name, pImpl->CustomMDKindNames.size()).second;
@@ -161,6 +173,7 @@ unsigned LLVMContext::getMDKindID(StringRef Name) const {
 /// getHandlerNames - Populate client supplied smallvector using custome
 /// metadata name and ID.
 void LLVMContext::getMDKindNames(SmallVectorImpl<StringRef> &Names) const {
+  sys::SmartScopedLock<true> Guard(pImpl->Lock);
   Names.resize(pImpl->CustomMDKindNames.size());
   for (StringMap<unsigned>::const_iterator I = pImpl->CustomMDKindNames.begin(),
        E = pImpl->CustomMDKindNames.end(); I != E; ++I)
@@ -19,7 +19,18 @@
 using namespace llvm;
 
 LLVMContextImpl::LLVMContextImpl(LLVMContext &C)
-  : TheTrueVal(0), TheFalseVal(0),
+  : SharingThreads(0),
+    IntConstants(SharingThreads),
+    FPConstants(SharingThreads),
+    CAZConstants(SharingThreads),
+    ArrayConstants(SharingThreads),
+    StructConstants(SharingThreads),
+    VectorConstants(SharingThreads),
+    CPNConstants(SharingThreads),
+    UVConstants(SharingThreads),
+    ExprConstants(SharingThreads),
+    InlineAsms(SharingThreads),
+    TheTrueVal(0), TheFalseVal(0),
     VoidTy(C, Type::VoidTyID),
     LabelTy(C, Type::LabelTyID),
     HalfTy(C, Type::HalfTyID),
@@ -34,10 +45,26 @@ LLVMContextImpl::LLVMContextImpl(LLVMContext &C)
     Int8Ty(C, 8),
     Int16Ty(C, 16),
     Int32Ty(C, 32),
-    Int64Ty(C, 64) {
+    Int64Ty(C, 64),
+    IntegerTypes(SharingThreads),
+    FunctionTypes(SharingThreads),
+    AnonStructTypes(SharingThreads),
+    ArrayTypes(SharingThreads),
+    VectorTypes(SharingThreads),
+    PointerTypes(SharingThreads),
+    ASPointerTypes(SharingThreads) {
   InlineAsmDiagHandler = 0;
   InlineAsmDiagContext = 0;
   NamedStructTypesUniqueID = 0;
+
+  // Create i1 true and false up front, so that ConstantInt::getTrue and
+  // getFalse only ever read them, even from several threads.
+  TheTrueVal = new ConstantInt(&Int1Ty, APInt(1, 1));
+  TheFalseVal = new ConstantInt(&Int1Ty, APInt(1, 0));
+  DenseMapAPIntKeyInfo::KeyTy TrueKey(TheTrueVal->getValue(), &Int1Ty);
+  DenseMapAPIntKeyInfo::KeyTy FalseKey(TheFalseVal->getValue(), &Int1Ty);
+  IntConstants.getShard(TrueKey).Map[TrueKey] = TheTrueVal;
+  IntConstants.getShard(FalseKey).Map[FalseKey] = TheFalseVal;
 }
 
 namespace {
@@ -61,6 +88,14 @@ struct DropFirst {
 };
 }
 
+/// DeleteShardSeconds - DeleteContainerSeconds for each shard of a
+/// ShardedDenseMap.
+template<typename ShardedMapTy>
+static void DeleteShardSeconds(ShardedMapTy &Map) {
+  for (unsigned i = 0, e = Map.getNumShards(); i != e; ++i)
+    DeleteContainerSeconds(Map.getShardMap(i));
+}
+
 LLVMContextImpl::~LLVMContextImpl() {
   // NOTE: We need to delete the contents of OwnedModules, but we have to
   // duplicate it into a temporary vector, because the destructor of Module
@@ -83,12 +118,12 @@ LLVMContextImpl::~LLVMContextImpl() {
   ArrayConstants.freeConstants();
   StructConstants.freeConstants();
   VectorConstants.freeConstants();
-  DeleteContainerSeconds(CAZConstants);
-  DeleteContainerSeconds(CPNConstants);
-  DeleteContainerSeconds(UVConstants);
+  DeleteShardSeconds(CAZConstants);
+  DeleteShardSeconds(CPNConstants);
+  DeleteShardSeconds(UVConstants);
   InlineAsms.freeConstants();
-  DeleteContainerSeconds(IntConstants);
-  DeleteContainerSeconds(FPConstants);
+  DeleteShardSeconds(IntConstants);
+  DeleteShardSeconds(FPConstants);
   
   for (StringMap<ConstantDataSequential*>::iterator I = CDSConstants.begin(),
        E = CDSConstants.end(); I != E; ++I)
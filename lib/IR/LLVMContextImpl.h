@@ -30,6 +30,9 @@
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Metadata.h"
+#include "llvm/Support/Atomic.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/RWMutex.h"
 #include "llvm/Support/ValueHandle.h"
 #include <vector>
 
@@ -207,6 +210,117 @@ template<> struct FoldingSetTrait<MDNode> : DefaultFoldingSetTrait<MDNode> {
   }
 };
 
+/// ShardedDenseMap - A DenseMap split by key hash into NumShards maps, each
+/// guarded by its own reader/writer lock, for the uniquing tables that
+/// threads running passes on different functions hit concurrently.  Threads
+/// uniquing different keys mostly touch different shards, and lookups that
+/// find their key only take a shared lock.  Like the other context locks, the
+/// shard locks do nothing until LLVM is multithreaded, and lookups skip them
+/// altogether unless some LLVMContext::SharedScope is alive.
+template<typename KeyT, typename ValueT,
+         typename KeyInfoT = DenseMapInfo<KeyT>, unsigned NumShards = 16>
+class ShardedDenseMap {
+  /// HashedKey - A key together with its hash, which lets lookup hash the
+  /// key only once for picking the shard and for probing the shard's map.
+  template<typename LookupKeyT>
+  struct HashedKey {
+    const LookupKeyT &Key;
+    unsigned Hash;
+    HashedKey(const LookupKeyT &Key, unsigned Hash) : Key(Key), Hash(Hash) {}
+  };
+
+  /// ShardKeyInfo - KeyInfoT, taught to hash and compare HashedKeys.
+  struct ShardKeyInfo : KeyInfoT {
+    using KeyInfoT::getHashValue;
+    using KeyInfoT::isEqual;
+    template<typename LookupKeyT>
+    static unsigned getHashValue(const HashedKey<LookupKeyT> &K) {
+      return K.Hash;
+    }
+    template<typename LookupKeyT>
+    static bool isEqual(const HashedKey<LookupKeyT> &LHS, const KeyT &RHS) {
+      return KeyInfoT::isEqual(LHS.Key, RHS);
+    }
+  };
+
+public:
+  typedef DenseMap<KeyT, ValueT, ShardKeyInfo> MapTy;
+
+  struct Shard {
+    MapTy Map;
+    sys::SmartRWMutex<true> Lock;
+  };
+
+private:
+  Shard Shards[NumShards];
+
+  /// SharingThreads - The count of live SharedScopes of the owning context.
+  const volatile sys::cas_flag &SharingThreads;
+
+  Shard &getShardForHash(unsigned Hash) {
+    uint32_t Mixed = Hash * 0x9E3779B9U;
+    return Shards[(uint64_t(Mixed) * NumShards) >> 32];
+  }
+
+public:
+  explicit ShardedDenseMap(const volatile sys::cas_flag &SharingThreads)
+    : SharingThreads(SharingThreads) {}
+
+  /// getShard - Return the shard that holds Key, which may be of any type
+  /// KeyInfoT can hash.  The shard is picked from the high bits of a mixed
+  /// hash, so the keys of one shard still spread over all of its buckets.
+  template<typename LookupKeyT>
+  Shard &getShard(const LookupKeyT &Key) {
+    return getShardForHash(KeyInfoT::getHashValue(Key));
+  }
+
+  /// lookup - Return the value for Key, which may be of any type KeyInfoT can
+  /// hash and compare with KeyT, or a default-constructed value if it is not
+  /// in the map.  This is the path of every uniquing hit, so it only takes
+  /// the shard lock while threads share the context.
+  template<typename LookupKeyT>
+  ValueT lookup(const LookupKeyT &Key) {
+    unsigned Hash = KeyInfoT::getHashValue(Key);
+    Shard &S = getShardForHash(Hash);
+    if (!SharingThreads) {
+      typename MapTy::iterator I =
+        S.Map.find_as(HashedKey<LookupKeyT>(Key, Hash));
+      return I == S.Map.end() ? ValueT() : I->second;
+    }
+    sys::SmartScopedReader<true> Reader(S.Lock);
+    typename MapTy::iterator I =
+      S.Map.find_as(HashedKey<LookupKeyT>(Key, Hash));
+    return I == S.Map.end() ? ValueT() : I->second;
+  }
+
+  /// lookupKey - Like lookup, but return the key stored in the map, or a
+  /// default-constructed key, for the maps that are used as sets.
+  template<typename LookupKeyT>
+  KeyT lookupKey(const LookupKeyT &Key) {
+    unsigned Hash = KeyInfoT::getHashValue(Key);
+    Shard &S = getShardForHash(Hash);
+    if (!SharingThreads) {
+      typename MapTy::iterator I =
+        S.Map.find_as(HashedKey<LookupKeyT>(Key, Hash));
+      return I == S.Map.end() ? KeyT() : I->first;
+    }
+    sys::SmartScopedReader<true> Reader(S.Lock);
+    typename MapTy::iterator I =
+      S.Map.find_as(HashedKey<LookupKeyT>(Key, Hash));
+    return I == S.Map.end() ? KeyT() : I->first;
+  }
+
+  /// erase - Remove Key from the map.
+  void erase(const KeyT &Key) {
+    Shard &S = getShard(Key);
+    sys::SmartScopedWriter<true> Writer(S.Lock);
+    S.Map.erase(Key);
+  }
+
+  unsigned getNumShards() const { return NumShards; }
+  MapTy &getShardMap(unsigned i) { return Shards[i].Map; }
+};
+
 /// DebugRecVH - This is a CallbackVH used to keep the Scope -> index maps
 /// up to date as MDNodes mutate.  This class is implemented in DebugLoc.cpp.
 class DebugRecVH : public CallbackVH {
@@ -238,13 +352,18 @@ public:
   
   LLVMContext::InlineAsmDiagHandlerTy InlineAsmDiagHandler;
   void *InlineAsmDiagContext;
+
+  /// SharingThreads - The number of live LLVMContext::SharedScopes.  While it
+  /// is zero only one thread uses the context, and uniquing hits in the
+  /// sharded tables, the constant unique maps and CDSConstants skip the locks.
+  volatile sys::cas_flag SharingThreads;
   
-  typedef DenseMap<DenseMapAPIntKeyInfo::KeyTy, ConstantInt*, 
-                         DenseMapAPIntKeyInfo> IntMapTy;
+  typedef ShardedDenseMap<DenseMapAPIntKeyInfo::KeyTy, ConstantInt*,
+                          DenseMapAPIntKeyInfo> IntMapTy;
   IntMapTy IntConstants;
   
-  typedef DenseMap<DenseMapAPFloatKeyInfo::KeyTy, ConstantFP*, 
-                         DenseMapAPFloatKeyInfo> FPMapTy;
+  typedef ShardedDenseMap<DenseMapAPFloatKeyInfo::KeyTy, ConstantFP*,
+                          DenseMapAPFloatKeyInfo> FPMapTy;
   FPMapTy FPConstants;
 
   FoldingSet<AttributeImpl> AttrsSet;
@@ -261,7 +380,8 @@ public:
   // on Context destruction.
   SmallPtrSet<MDNode*, 1> NonUniquedMDNodes;
   
-  DenseMap<Type*, ConstantAggregateZero*> CAZConstants;
+  typedef ShardedDenseMap<Type*, ConstantAggregateZero*> CAZMapTy;
+  CAZMapTy CAZConstants;
 
   typedef ConstantAggrUniqueMap<ArrayType, ConstantArray> ArrayConstantsTy;
   ArrayConstantsTy ArrayConstants;
@@ -272,12 +392,17 @@ public:
   typedef ConstantAggrUniqueMap<VectorType, ConstantVector> VectorConstantsTy;
   VectorConstantsTy VectorConstants;
   
-  DenseMap<PointerType*, ConstantPointerNull*> CPNConstants;
+  typedef ShardedDenseMap<PointerType*, ConstantPointerNull*> CPNMapTy;
+  CPNMapTy CPNConstants;
 
-  DenseMap<Type*, UndefValue*> UVConstants;
+  typedef ShardedDenseMap<Type*, UndefValue*> UVMapTy;
+  UVMapTy UVConstants;
   
   StringMap<ConstantDataSequential*> CDSConstants;
 
+  /// CDSConstantsLock - Guards CDSConstants.
+  sys::SmartMutex<true> CDSConstantsLock;
+
   
   DenseMap<std::pair<Function*, BasicBlock*> , BlockAddress*> BlockAddresses;
   ConstantUniqueMap<ExprMapKeyType, const ExprMapKeyType&, Type, ConstantExpr>
@@ -300,20 +425,33 @@ public:
   /// TypeAllocator - All dynamically allocated types are allocated from this.
   /// They live forever until the context is torn down.
   BumpPtrAllocator TypeAllocator;
+
+  /// TypeAllocatorLock - Guards TypeAllocator.
+  sys::SmartMutex<true> TypeAllocatorLock;
   
-  DenseMap<unsigned, IntegerType*> IntegerTypes;
+  typedef ShardedDenseMap<unsigned, IntegerType*> IntegerTypeMap;
+  IntegerTypeMap IntegerTypes;
   
-  typedef DenseMap<FunctionType*, bool, FunctionTypeKeyInfo> FunctionTypeMap;
+  typedef ShardedDenseMap<FunctionType*, bool, FunctionTypeKeyInfo>
+    FunctionTypeMap;
   FunctionTypeMap FunctionTypes;
-  typedef DenseMap<StructType*, bool, AnonStructTypeKeyInfo> StructTypeMap;
+  typedef ShardedDenseMap<StructType*, bool, AnonStructTypeKeyInfo>
+    StructTypeMap;
   StructTypeMap AnonStructTypes;
   StringMap<StructType*> NamedStructTypes;
   unsigned NamedStructTypesUniqueID;
     
-  DenseMap<std::pair<Type *, uint64_t>, ArrayType*> ArrayTypes;
-  DenseMap<std::pair<Type *, unsigned>, VectorType*> VectorTypes;
-  DenseMap<Type*, PointerType*> PointerTypes;  // Pointers in AddrSpace = 0
-  DenseMap<std::pair<Type*, unsigned>, PointerType*> ASPointerTypes;
+  typedef ShardedDenseMap<std::pair<Type *, uint64_t>, ArrayType*>
+    ArrayTypeMap;
+  ArrayTypeMap ArrayTypes;
+  typedef ShardedDenseMap<std::pair<Type *, unsigned>, VectorType*>
+    VectorTypeMap;
+  VectorTypeMap VectorTypes;
+  typedef ShardedDenseMap<Type*, PointerType*> PointerTypeMap;
+  PointerTypeMap PointerTypes;  // Pointers in AddrSpace = 0
+  typedef ShardedDenseMap<std::pair<Type*, unsigned>, PointerType*>
+    ASPointerTypeMap;
+  ASPointerTypeMap ASPointerTypes;
 
 
   /// ValueHandles - This map keeps track of all of the value handles that are
@@ -355,6 +493,15 @@ public:
   typedef DenseMap<const Function*, unsigned> IntrinsicIDCacheTy;
   IntrinsicIDCacheTy IntrinsicIDCache;
 
+  /// Lock - Guards the value handle map, the metadata store, the attribute,
+  /// metadata and named struct tables and the other maps above that have no
+  /// lock of their own while function passes run on several threads (see
+  /// -pass-threads).  It only locks once LLVM is multithreaded and may be
+  /// acquired recursively.  The sharded tables, the constant unique maps,
+  /// CDSConstantsLock and TypeAllocatorLock may be acquired while holding it,
+  /// never the other way around.
+  sys::SmartMutex<true> Lock;
+
   int getOrAddScopeRecordIdxEntry(MDNode *N, int ExistingIdx);
   int getOrAddScopeInlinedAtIdxEntry(MDNode *Scope, MDNode *IA,int ExistingIdx);
   
@@ -37,6 +37,7 @@ MDString::MDString(LLVMContext &C)
 
 MDString *MDString::get(LLVMContext &Context, StringRef Str) {
   LLVMContextImpl *pImpl = Context.pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->Lock);
   StringMapEntry<Value*> &Entry =
     pImpl->MDStringCache.GetOrCreateValue(Str);
   Value *&S = Entry.getValue();
@@ -132,6 +133,7 @@ MDNode::~MDNode() {
   assert((getSubclassDataFromValue() & DestroyFlag) != 0 &&
          "Not being destroyed through destroy()?");
   LLVMContextImpl *pImpl = getType()->getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->Lock);
   if (isNotUniqued()) {
     pImpl->NonUniquedMDNodes.erase(this);
   } else {
@@ -215,6 +217,7 @@ static bool isFunctionLocalValue(Value *V) {
 MDNode *MDNode::getMDNode(LLVMContext &Context, ArrayRef<Value*> Vals,
                           FunctionLocalness FL, bool Insert) {
   LLVMContextImpl *pImpl = Context.pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->Lock);
 
   // Add all the operand pointers. Note that we don't have to add the
   // isFunctionLocal bit because that's implied by the operands.
@@ -319,6 +322,7 @@ void MDNode::Profile(FoldingSetNodeID &ID) const {
 void MDNode::setIsNotUniqued() {
   setValueSubclassData(getSubclassDataFromValue() | NotUniquedBit);
   LLVMContextImpl *pImpl = getType()->getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->Lock);
   pImpl->NonUniquedMDNodes.insert(this);
 }
 
@@ -355,6 +359,7 @@ void MDNode::replaceOperand(MDNodeOperand *Op, Value *To) {
   if (isNotUniqued()) return;
 
   LLVMContextImpl *pImpl = getType()->getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->Lock);
 
   // Remove "this" from the context map.  FoldingSet doesn't have to reprofile
   // this node to remove it, so we don't care what state the operands are in.
@@ -592,6 +597,8 @@ void Instruction::setMetadata(unsigned KindID, MDNode *Node) {
     DbgLoc = DebugLoc::getFromDILocation(Node);
     return;
   }
+
+  sys::SmartScopedLock<true> Guard(getContext().pImpl->Lock);
   
   // Handle the case when we're adding/updating metadata on an instruction.
   if (Node) {
@@ -647,6 +654,7 @@ MDNode *Instruction::getMetadataImpl(unsigned KindID) const {
   
   if (!hasMetadataHashEntry()) return 0;
   
+  sys::SmartScopedLock<true> Guard(getContext().pImpl->Lock);
   LLVMContextImpl::MDMapTy &Info = getContext().pImpl->MetadataStore[this];
   assert(!Info.empty() && "bit out of sync with hash table");
 
@@ -671,6 +679,7 @@ void Instruction::getAllMetadataImpl(SmallVectorImpl<std::pair<unsigned,
   assert(hasMetadataHashEntry() &&
          getContext().pImpl->MetadataStore.count(this) &&
          "Shouldn't have called this");
+  sys::SmartScopedLock<true> Guard(getContext().pImpl->Lock);
   const LLVMContextImpl::MDMapTy &Info =
     getContext().pImpl->MetadataStore.find(this)->second;
   assert(!Info.empty() && "Shouldn't have called this");
@@ -689,6 +698,7 @@ getAllMetadataOtherThanDebugLocImpl(SmallVectorImpl<std::pair<unsigned,
   assert(hasMetadataHashEntry() &&
          getContext().pImpl->MetadataStore.count(this) &&
          "Shouldn't have called this");
+  sys::SmartScopedLock<true> Guard(getContext().pImpl->Lock);
   const LLVMContextImpl::MDMapTy &Info =
     getContext().pImpl->MetadataStore.find(this)->second;
   assert(!Info.empty() && "Shouldn't have called this");
@@ -703,6 +713,7 @@ getAllMetadataOtherThanDebugLocImpl(SmallVectorImpl<std::pair<unsigned,
 /// this instruction.
 void Instruction::clearMetadataHashEntries() {
   assert(hasMetadataHashEntry() && "Caller should check");
+  sys::SmartScopedLock<true> Guard(getContext().pImpl->Lock);
   getContext().pImpl->MetadataStore.erase(this);
   setHasMetadataHashEntry(false);
 }
@@ -12,6 +12,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/IR/Module.h"
+#include "LLVMContextImpl.h"
 #include "SymbolTableListTraitsImpl.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/STLExtras.h"
@@ -109,6 +110,7 @@ Module::PointerSize Module::getPointerSize() const {
 /// the specified name, of arbitrary type.  This method returns null
 /// if a global with the specified name is not found.
 GlobalValue *Module::getNamedValue(StringRef Name) const {
+  sys::SmartScopedLock<true> Guard(Context.pImpl->Lock);
   return cast_or_null<GlobalValue>(getValueSymbolTable().lookup(Name));
 }
 
@@ -138,8 +140,16 @@ void Module::getMDKindNames(SmallVectorImpl<StringRef> &Result) const {
 Constant *Module::getOrInsertFunction(StringRef Name,
                                       FunctionType *Ty,
                                       AttributeSet AttributeList) {
-  // See if we have a definition for the specified function already.
+  // A pass worker has to wait its turn before it adds a prototype.  Another
+  // worker may add this one meanwhile, so look again once it is our turn.
   GlobalValue *F = getNamedValue(Name);
+  if (F == 0 || F->hasLocalLinkage())
+    FunctionLocalScope::orderGlobalCreation();
+
+  sys::SmartScopedLock<true> Guard(Context.pImpl->Lock);
+
+  // See if we have a definition for the specified function already.
+  F = getNamedValue(Name);
   if (F == 0) {
     // Nope, add it
     Function *New = Function::Create(Ty, GlobalVariable::ExternalLinkage, Name);
@@ -171,6 +181,11 @@ Constant *Module::getOrInsertFunction(StringRef Name,
 Constant *Module::getOrInsertTargetIntrinsic(StringRef Name,
                                              FunctionType *Ty,
                                              AttributeSet AttributeList) {
+  if (getNamedValue(Name) == 0)
+    FunctionLocalScope::orderGlobalCreation();
+
+  sys::SmartScopedLock<true> Guard(Context.pImpl->Lock);
+
   // See if we have a definition for the specified function already.
   GlobalValue *F = getNamedValue(Name);
   if (F == 0) {
@@ -266,6 +281,11 @@ GlobalVariable *Module::getGlobalVariable(StringRef Name,
 ///   3. Finally, if the existing global is the correct delclaration, return the
 ///      existing global.
 Constant *Module::getOrInsertGlobal(StringRef Name, Type *Ty) {
+  if (getNamedValue(Name) == 0)
+    FunctionLocalScope::orderGlobalCreation();
+
+  sys::SmartScopedLock<true> Guard(Context.pImpl->Lock);
+
   // See if we have a definition for the specified global already.
   GlobalVariable *GV = dyn_cast_or_null<GlobalVariable>(getNamedValue(Name));
   if (GV == 0) {
@@ -414,6 +434,12 @@ void Module::Dematerialize(GlobalValue *GV) {
     return Materializer->Dematerialize(GV);
 }
 
+bool Module::MaterializeMetadata(std::string *ErrInfo) {
+  if (Materializer)
+    return Materializer->MaterializeMetadata(ErrInfo);
+  return false;
+}
+
 bool Module::MaterializeAll(std::string *ErrInfo) {
   if (!Materializer)
     return false;
@@ -15,14 +15,24 @@
 #include "llvm/PassManagers.h"
 #include "llvm/Assembly/PrintModulePass.h"
 #include "llvm/Assembly/Writer.h"
+#include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/PassManager.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/Atomic.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/Mutex.h"
 #include "llvm/Support/PassNameParser.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/TimeValue.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
@@ -79,6 +89,11 @@ PrintAfterAll("print-after-all",
               llvm::cl::desc("Print IR after each pass"),
               cl::init(false));
 
+static cl::opt<unsigned>
+PassThreads("pass-threads",
+            cl::desc("Run function pass pipelines on this many threads"),
+            cl::init(0));
+
 /// This is a helper to determine whether to print IR before or
 /// after a pass.
 
@@ -484,6 +499,119 @@ public:
   }
 };
 
+static cl::opt<std::string>
+PassTraceFile("time-passes-trace", cl::value_desc("filename"),
+              cl::desc("Write a Chrome trace of every pass run on every "
+                       "function, with instruction counts and allocations"));
+
+//===----------------------------------------------------------------------===//
+/// PassTraceInfo Class - This class records one trace event per run of a
+/// pass on a function (or module) and writes them out in the Chrome trace
+/// event format when it is destroyed.  This only happens when
+/// -time-passes-trace is given on the command line.
+///
+class PassTraceInfo {
+  struct Event {
+    std::string PassName;
+    std::string UnitName;
+    bool OnModule;
+    uint64_t Start, Duration;      // In microseconds.
+    unsigned InstsBefore, InstsAfter;
+    int64_t MallocBytes;
+    uint64_t SlabBytes;
+  };
+  std::vector<Event> Events;
+  uint64_t Origin;
+
+  static void printString(raw_ostream &OS, StringRef Str);
+public:
+  PassTraceInfo() : Origin(sys::TimeValue::now().usec()) {}
+
+  // ~PassTraceInfo - Write the trace file.
+  ~PassTraceInfo();
+
+  // createThePassTrace - This method either initializes the ThePassTrace
+  // pointer to a non null value (if -time-passes-trace is given) or it leaves
+  // it null.  It may be called multiple times.
+  static void createThePassTrace();
+
+  void addEvent(Pass *P, StringRef UnitName, bool OnModule, uint64_t Start,
+                uint64_t End, unsigned InstsBefore, unsigned InstsAfter,
+                int64_t MallocBytes, uint64_t SlabBytes) {
+    Event E;
+    E.PassName = P->getPassName();
+    E.UnitName = UnitName;
+    E.OnModule = OnModule;
+    E.Start = Start - Origin;
+    E.Duration = End - Start;
+    E.InstsBefore = InstsBefore;
+    E.InstsAfter = InstsAfter;
+    E.MallocBytes = MallocBytes;
+    E.SlabBytes = SlabBytes;
+    Events.push_back(E);
+  }
+};
+
+static PassTraceInfo *ThePassTrace;
+
+/// PassTraceRegion - Record the run of a pass on a function or module in the
+/// pass trace, if there is one, for the lifetime of the region.
+class PassTraceRegion {
+  Pass *P;
+  Function *F;
+  Module *M;
+  uint64_t Start;
+  unsigned InstsBefore;
+  size_t MallocBefore;
+  uint64_t SlabsBefore;
+
+  static unsigned countInstructions(Function &F) {
+    unsigned Count = 0;
+    for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+      Count += BB->size();
+    return Count;
+  }
+
+  unsigned countInstructions() const {
+    if (F)
+      return countInstructions(*F);
+    unsigned Count = 0;
+    for (Module::iterator I = M->begin(), E = M->end(); I != E; ++I)
+      Count += countInstructions(*I);
+    return Count;
+  }
+
+  void start() {
+    InstsBefore = countInstructions();
+    MallocBefore = sys::Process::GetMallocUsage();
+    SlabsBefore = BumpPtrAllocator::getSlabBytesAllocated();
+    Start = sys::TimeValue::now().usec();
+  }
+
+public:
+  PassTraceRegion(Pass *p, Function &f) : P(ThePassTrace ? p : 0), F(&f), M(0) {
+    if (P)
+      start();
+  }
+  PassTraceRegion(Pass *p, Module &m) : P(ThePassTrace ? p : 0), F(0), M(&m) {
+    if (P)
+      start();
+  }
+
+  ~PassTraceRegion() {
+    if (!P)
+      return;
+    uint64_t End = sys::TimeValue::now().usec();
+    uint64_t SlabBytes =
+      BumpPtrAllocator::getSlabBytesAllocated() - SlabsBefore;
+    int64_t MallocBytes =
+      int64_t(sys::Process::GetMallocUsage()) - int64_t(MallocBefore);
+    StringRef Unit = F ? F->getName() : StringRef(M->getModuleIdentifier());
+    ThePassTrace->addEvent(P, Unit, F == 0, Start, End, InstsBefore,
+                           countInstructions(), MallocBytes, SlabBytes);
+  }
+};
+
 } // End of anon namespace
 
 static TimingInfo *TheTimeInfo;
@@ -492,12 +620,23 @@ static TimingInfo *TheTimeInfo;
 // PMTopLevelManager implementation
 
 /// Initialize top level manager. Create first pass manager.
-PMTopLevelManager::PMTopLevelManager(PMDataManager *PMDM) {
+PMTopLevelManager::PMTopLevelManager(PMDataManager *PMDM)
+  : CacheAnalyses(false) {
   PMDM->setTopLevelManager(this);
   addPassManager(PMDM);
   activeStack.push(PMDM);
 }
 
+void PMTopLevelManager::setAnalysisCaching(bool Enable) {
+  // The passes were given the analyses computed at the positions of this
+  // manager, which the cached ones stand in for from now on.
+  if (Enable && !CacheAnalyses)
+    for (SmallVectorImpl<PMDataManager *>::iterator I = PassManagers.begin(),
+           E = PassManagers.end(); I != E; ++I)
+      (*I)->clearAnalysisImpls();
+  CacheAnalyses = Enable;
+}
+
 /// Set pass P as the last user of the given analysis passes.
 void
 PMTopLevelManager::setLastUser(ArrayRef<Pass*> AnalysisPasses, Pass *P) {
@@ -951,6 +1090,10 @@ void PMDataManager::freePass(Pass *P, StringRef Msg,
     P->releaseMemory();
   }
 
+  removeAvailableAnalysis(P);
+}
+
+void PMDataManager::removeAvailableAnalysis(Pass *P) {
   AnalysisID PI = P->getPassID();
   if (const PassInfo *PInf = PassRegistry::getPassRegistry()->getPassInfo(PI)) {
     // Remove the pass itself (if it is not already removed).
@@ -1073,12 +1216,23 @@ void PMDataManager::collectRequiredAnalysis(SmallVectorImpl<Pass *> &RP,
   }
 }
 
+/// PassRunCount - The number of pass runs started so far, see
+/// PMDataManager::getPassRunCount.
+static volatile sys::cas_flag PassRunCount = 0;
+
+unsigned PMDataManager::getPassRunCount() {
+  return PassRunCount;
+}
+
 // All Required analyses should be available to the pass as it runs!  Here
 // we fill in the AnalysisImpls member of the pass so that it can
 // successfully use the getAnalysis() method to retrieve the
 // implementations it needs.
 //
 void PMDataManager::initializeAnalysisImpl(Pass *P) {
+  // Every pass manager calls this right before it runs P.
+  sys::AtomicIncrement(&PassRunCount);
+
   AnalysisUsage *AnUsage = TPM->findAnalysisUsage(P);
 
   for (AnalysisUsage::VectorType::const_iterator
@@ -1095,6 +1249,24 @@ void PMDataManager::initializeAnalysisImpl(Pass *P) {
   }
 }
 
+void PMDataManager::clearAnalysisImpls() {
+  for (SmallVectorImpl<Pass *>::iterator I = PassVector.begin(),
+         E = PassVector.end(); I != E; ++I) {
+    (*I)->getResolver()->clearAnalysisImpls();
+    if (PMDataManager *PMD = (*I)->getAsPMDataManager())
+      PMD->clearAnalysisImpls();
+  }
+}
+
+void PMDataManager::removeAnalysisImplsOf(Pass *P) {
+  for (SmallVectorImpl<Pass *>::iterator I = PassVector.begin(),
+         E = PassVector.end(); I != E; ++I) {
+    (*I)->getResolver()->removeAnalysisImplsOf(P);
+    if (PMDataManager *PMD = (*I)->getAsPMDataManager())
+      PMD->removeAnalysisImplsOf(P);
+  }
+}
+
 /// Find the pass that implements Analysis AID. If desired pass is not found
 /// then return NULL.
 Pass *PMDataManager::findAnalysisPass(AnalysisID AID, bool SearchParent) {
@@ -1304,9 +1476,11 @@ bool BBPassManager::runOnFunction(Function &F) {
       }
 
       Changed |= LocalChanged;
-      if (LocalChanged)
+      if (LocalChanged) {
+        F.markModified();
         dumpPassInfo(BP, MODIFICATION_MSG, ON_BASICBLOCK_MSG,
                      I->getName());
+      }
       dumpPreservedSet(BP);
 
       verifyPreservedAnalysis(BP);
@@ -1412,6 +1586,10 @@ bool FunctionPassManager::doFinalization() {
   return FPM->doFinalization(*M);
 }
 
+void FunctionPassManager::setAnalysisCaching(bool Enable) {
+  FPM->setAnalysisCaching(Enable);
+}
+
 //===----------------------------------------------------------------------===//
 // FunctionPassManagerImpl implementation
 //
@@ -1475,6 +1653,7 @@ void FunctionPassManagerImpl::releaseMemoryOnTheFly() {
 bool FunctionPassManagerImpl::run(Function &F) {
   bool Changed = false;
   TimingInfo::createTheTimeInfo();
+  PassTraceInfo::createThePassTrace();
 
   initializeAllAnalysisInfo();
   for (unsigned Index = 0; Index < getNumContainedManagers(); ++Index)
@@ -1511,39 +1690,86 @@ bool FPPassManager::runOnFunction(Function &F) {
 
   bool Changed = false;
 
-  // Collect inherited analysis from Module level pass manager.
-  populateInheritedAnalysis(TPM->activeStack);
+  // Collect inherited analysis from Module level pass manager.  A replica
+  // leaves the managers it shares with the other worker threads alone.
+  if (!Original)
+    populateInheritedAnalysis(TPM->activeStack);
+
+  bool UseCache = !Original && TPM->isAnalysisCachingEnabled();
+  // The cached analyses that are available at the current point of the run.
+  SmallVector<CachedAnalysis *, 8> LiveCachedAnalyses;
+  if (UseCache)
+    releaseStaleCachedAnalyses(F);
 
   for (unsigned Index = 0; Index < getNumContainedPasses(); ++Index) {
     FunctionPass *FP = getContainedPass(Index);
     bool LocalChanged = false;
 
-    dumpPassInfo(FP, EXECUTION_MSG, ON_FUNCTION_MSG, F.getName());
-    dumpRequiredSet(FP);
+    // A cached analysis stands in for FP, and only runs if its result is
+    // stale.
+    CachedAnalysis *CA = UseCache ? getCachedAnalysis(F, FP) : 0;
+    FunctionPass *RunP = CA ? CA->P : FP;
+    bool Run = !CA || CA->Epoch != F.getModificationEpoch();
 
-    initializeAnalysisImpl(FP);
+    if (Run) {
+      dumpPassInfo(FP, EXECUTION_MSG, ON_FUNCTION_MSG, F.getName());
+      dumpRequiredSet(FP);
 
-    {
-      PassManagerPrettyStackEntry X(FP, F);
+      initializeAnalysisImpl(RunP);
+
+      PassManagerPrettyStackEntry X(RunP, F);
       TimeRegion PassTimer(getPassTimer(FP));
+      PassTraceRegion PassTrace(FP, F);
 
-      LocalChanged |= FP->runOnFunction(F);
+      if (CA && CA->HasRun)
+        RunP->releaseMemory();
+      LocalChanged |= RunP->runOnFunction(F);
+      if (CA)
+        CA->HasRun = true;
     }
 
     Changed |= LocalChanged;
-    if (LocalChanged)
+    if (LocalChanged) {
+      F.markModified();
       dumpPassInfo(FP, MODIFICATION_MSG, ON_FUNCTION_MSG, F.getName());
+    }
     dumpPreservedSet(FP);
 
     verifyPreservedAnalysis(FP);
     removeNotPreservedAnalysis(FP);
-    recordAvailableAnalysis(FP);
-    removeDeadPasses(FP, F.getName(), ON_FUNCTION_MSG);
+    recordAvailableAnalysis(RunP);
+    if (Original) {
+      removeDeadReplicaPasses(Original->getContainedPass(Index), F.getName());
+    } else if (UseCache) {
+      if (CA)
+        LiveCachedAnalyses.push_back(CA);
+      updateCachedAnalyses(F, LiveCachedAnalyses);
+      removeDeadCachedPasses(FP, F, LiveCachedAnalyses);
+    } else {
+      removeDeadPasses(FP, F.getName(), ON_FUNCTION_MSG);
+    }
+  }
+
+  // Like the passes that are freed after their last use, the analyses that
+  // went stale during the run must not keep their results until the next one.
+  // The passes must not find the analyses of F when they run on another
+  // function.
+  if (UseCache) {
+    releaseStaleCachedAnalyses(F);
+    CachedAnalysisList &List = CachedAnalyses[&F];
+    for (unsigned i = 0, e = List.size(); i != e; ++i)
+      removeAnalysisImplsOf(List[i]->P);
   }
   return Changed;
 }
 
 bool FPPassManager::runOnModule(Module &M) {
+  if (canRunInParallel(M))
+    return runOnModuleInParallel(M);
+
+  if (!CachedAnalyses.empty())
+    pruneCachedAnalyses(M);
+
   bool Changed = false;
 
   for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I)
@@ -1557,6 +1783,9 @@ bool FPPassManager::doInitialization(Module &M) {
 
   for (unsigned Index = 0; Index < getNumContainedPasses(); ++Index)
     Changed |= getContainedPass(Index)->doInitialization(M);
+
+  for (unsigned i = 0, e = Replicas.size(); i != e; ++i)
+    Changed |= Replicas[i]->doInitialization(M);
   
   return Changed;
 }
@@ -1564,12 +1793,357 @@ bool FPPassManager::doInitialization(Module &M) {
 bool FPPassManager::doFinalization(Module &M) {
   bool Changed = false;
 
+  // A FunctionPassManager is run one function at a time, this is where the
+  // analyses of the functions it will not see again are dropped.
+  if (!CachedAnalyses.empty())
+    pruneCachedAnalyses(M);
+
+  for (unsigned i = 0, e = Replicas.size(); i != e; ++i)
+    Changed |= Replicas[i]->doFinalization(M);
+
   for (int Index = getNumContainedPasses() - 1; Index >= 0; --Index)
     Changed |= getContainedPass(Index)->doFinalization(M);
   
   return Changed;
 }
 
+FPPassManager::~FPPassManager() {
+  DeleteContainerPointers(Replicas);
+  for (CachedAnalysisMapTy::iterator I = CachedAnalyses.begin(),
+         E = CachedAnalyses.end(); I != E; ++I)
+    deleteCachedAnalyses(I->second);
+}
+
+/// Only plain function analyses are cached: an analysis group member is part
+/// of a chain that is set up again on every run, and a pass manager has
+/// passes of its own.
+bool FPPassManager::isCacheableAnalysis(Pass *P) const {
+  if (P->getAsPMDataManager())
+    return false;
+  const PassInfo *PI =
+    PassRegistry::getPassRegistry()->getPassInfo(P->getPassID());
+  return PI && PI->isAnalysis() && PI->getNormalCtor() &&
+         PI->getInterfacesImplemented().empty();
+}
+
+FPPassManager::CachedAnalysis *
+FPPassManager::getCachedAnalysis(Function &F, FunctionPass *FP) {
+  if (!isCacheableAnalysis(FP))
+    return 0;
+
+  CachedAnalysisList &List = CachedAnalyses[&F];
+  for (unsigned i = 0, e = List.size(); i != e; ++i)
+    if (List[i]->Position == FP)
+      return List[i];
+
+  const PassInfo *PI =
+    PassRegistry::getPassRegistry()->getPassInfo(FP->getPassID());
+  CachedAnalysis *CA =
+    new CachedAnalysis(FP, static_cast<FunctionPass *>(PI->createPass()));
+  CA->P->setResolver(new AnalysisResolver(*this));
+  CA->P->doInitialization(*F.getParent());
+  List.push_back(CA);
+  return CA;
+}
+
+void FPPassManager::updateCachedAnalyses(
+    Function &F, SmallVectorImpl<CachedAnalysis *> &Live) {
+  unsigned Epoch = F.getModificationEpoch();
+  for (unsigned i = 0; i != Live.size(); ) {
+    CachedAnalysis *CA = Live[i];
+    if (findAnalysisPass(CA->P->getPassID(), true) == CA->P) {
+      CA->Epoch = Epoch;
+      ++i;
+    } else {
+      CA->Epoch = 0;
+      Live.erase(Live.begin() + i);
+    }
+  }
+}
+
+void FPPassManager::removeDeadCachedPasses(
+    Pass *P, Function &F, SmallVectorImpl<CachedAnalysis *> &Live) {
+  SmallVector<Pass *, 12> DeadPasses;
+  TPM->collectLastUses(DeadPasses, P);
+
+  CachedAnalysisList &List = CachedAnalyses[&F];
+  for (SmallVectorImpl<Pass *>::iterator I = DeadPasses.begin(),
+         E = DeadPasses.end(); I != E; ++I) {
+    CachedAnalysis *CA = 0;
+    for (unsigned i = 0, e = List.size(); i != e && !CA; ++i)
+      if (List[i]->Position == *I)
+        CA = List[i];
+    if (!CA) {
+      freePass(*I, F.getName(), ON_FUNCTION_MSG);
+      continue;
+    }
+
+    // The result stays current in the cache, only its availability ends.
+    dumpPassInfo(*I, FREEING_MSG, ON_FUNCTION_MSG, F.getName());
+    removeAvailableAnalysis(CA->P);
+    Live.erase(std::remove(Live.begin(), Live.end(), CA), Live.end());
+  }
+}
+
+/// A current result may point into the results of the analyses it requires
+/// transitively, so it is only kept while each of those is an immutable pass
+/// or a current result of the cache.  Stale results are released in the
+/// reverse order they were first run, dependent results first.
+void FPPassManager::releaseStaleCachedAnalyses(Function &F) {
+  CachedAnalysisMapTy::iterator MI = CachedAnalyses.find(&F);
+  if (MI == CachedAnalyses.end())
+    return;
+  CachedAnalysisList &List = MI->second;
+  unsigned Epoch = F.getModificationEpoch();
+
+  SmallPtrSet<Pass *, 8> Current;
+  for (unsigned i = 0, e = List.size(); i != e; ++i)
+    if (List[i]->HasRun && List[i]->Epoch == Epoch)
+      Current.insert(List[i]->P);
+
+  bool Demoted = true;
+  while (Demoted) {
+    Demoted = false;
+    for (unsigned i = 0, e = List.size(); i != e; ++i) {
+      Pass *P = List[i]->P;
+      if (!Current.count(P))
+        continue;
+      const AnalysisUsage::VectorType &IDs =
+        TPM->findAnalysisUsage(P)->getRequiredTransitiveSet();
+      for (unsigned j = 0, je = IDs.size(); j != je; ++j) {
+        Pass *Impl = P->getResolver()->findImplPass(IDs[j]);
+        if (Impl && (Impl->getAsImmutablePass() || Current.count(Impl)))
+          continue;
+        Current.erase(P);
+        Demoted = true;
+        break;
+      }
+    }
+  }
+
+  for (unsigned i = List.size(); i != 0; --i) {
+    CachedAnalysis *CA = List[i - 1];
+    if (Current.count(CA->P))
+      continue;
+    CA->Epoch = 0;
+    if (CA->HasRun) {
+      CA->P->releaseMemory();
+      CA->HasRun = false;
+    }
+  }
+}
+
+void FPPassManager::deleteCachedAnalyses(CachedAnalysisList &List) {
+  for (unsigned i = List.size(); i != 0; --i)
+    delete List[i - 1];
+  List.clear();
+}
+
+void FPPassManager::pruneCachedAnalyses(Module &M) {
+  SmallPtrSet<Function *, 32> Functions;
+  for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I)
+    Functions.insert(I);
+
+  for (CachedAnalysisMapTy::iterator I = CachedAnalyses.begin(),
+         E = CachedAnalyses.end(); I != E; ) {
+    CachedAnalysisMapTy::iterator Cur = I++;
+    if (Functions.count(Cur->first))
+      continue;
+    deleteCachedAnalyses(Cur->second);
+    CachedAnalyses.erase(Cur);
+  }
+}
+
+/// The functions run on the worker threads are only known to be safe when
+/// every pass can be copied and nothing else observes the order in which the
+/// passes run.  Nested loop and basic block managers keep the run serial.
+bool FPPassManager::canRunInParallel(Module &M) const {
+  if (PassThreads < 2 || Original || !TPM)
+    return false;
+  if (TPM->isAnalysisCachingEnabled())
+    return false;
+  if (TimePassesIsEnabled || ThePassTrace || PassDebugging >= Executions ||
+      PrintBeforeAll || PrintAfterAll || !PrintBefore.empty() ||
+      !PrintAfter.empty())
+    return false;
+
+  for (unsigned Index = 0; Index < getNumContainedPasses(); ++Index) {
+    Pass *P = PassVector[Index];
+    if (P->getAsPMDataManager())
+      return false;
+    const PassInfo *PI =
+      PassRegistry::getPassRegistry()->getPassInfo(P->getPassID());
+    if (!PI || !PI->getNormalCtor())
+      return false;
+  }
+
+  // Deleting or merging a block whose address is taken replaces its
+  // BlockAddress, a constant that the workers must leave alone (see
+  // SharedUseListGuard).
+  for (Module::iterator F = M.begin(), FE = M.end(); F != FE; ++F)
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+      if (BB->hasAddressTaken())
+        return false;
+
+  // The context and the other shared structures only lock once LLVM has
+  // been told it is multithreaded.
+  return llvm_is_multithreaded() || llvm_start_multithreaded();
+}
+
+FPPassManager *FPPassManager::createReplica(Module &M) {
+  FPPassManager *FPPM = new FPPassManager();
+  FPPM->Original = this;
+  FPPM->setTopLevelManager(TPM);
+  FPPM->setDepth(getDepth());
+
+  for (unsigned Index = 0; Index < getNumContainedPasses(); ++Index) {
+    Pass *P = PassVector[Index];
+    const PassInfo *PI =
+      PassRegistry::getPassRegistry()->getPassInfo(P->getPassID());
+    Pass *Copy = PI->createPass();
+    FPPM->add(Copy, false);
+    FPPM->ReplicaOf[P] = Copy;
+
+    // Fill the top level manager's usage cache now, the workers only read it.
+    TPM->findAnalysisUsage(Copy);
+  }
+
+  FPPM->doInitialization(M);
+  return FPPM;
+}
+
+void FPPassManager::removeDeadReplicaPasses(Pass *OriginalP, StringRef Msg) {
+  SmallVector<Pass *, 12> DeadPasses;
+  TPM->collectLastUses(DeadPasses, OriginalP);
+
+  for (SmallVectorImpl<Pass *>::iterator I = DeadPasses.begin(),
+         E = DeadPasses.end(); I != E; ++I) {
+    DenseMap<Pass *, Pass *>::iterator Copy = ReplicaOf.find(*I);
+    if (Copy != ReplicaOf.end())
+      freePass(Copy->second, Msg, ON_FUNCTION_MSG);
+  }
+}
+
+namespace {
+/// FunctionWorker - The state of one worker thread of
+/// FPPassManager::runOnModuleInParallel.  The workers take the functions in
+/// order from a shared counter.  While a worker runs on a function it holds
+/// the function's lock in Running.
+struct FunctionWorker {
+  FPPassManager *FPPM;
+  ArrayRef<Function *> Functions;
+  sys::Mutex *NextFunctionLock;
+  unsigned *NextFunction;
+  sys::Mutex *Running;
+  bool Changed;
+
+  static void run(void *Arg);
+};
+
+/// FunctionWorkerScope - The FunctionLocalScope of a worker.  Before the
+/// worker adds a global to the module, it waits for the functions that come
+/// before its own to be done.  The functions of a serial run add their
+/// globals in function order, and so do those of a parallel run then, which
+/// also gives the globals the same names.
+class FunctionWorkerScope : public FunctionLocalScope {
+  FunctionWorker &W;
+
+  /// Index - The function the worker is on.
+  unsigned Index;
+
+  /// DoneBefore - The functions before this one are known to be done.  The
+  /// worker takes its functions in order, so this only ever grows.
+  unsigned DoneBefore;
+
+public:
+  explicit FunctionWorkerScope(FunctionWorker &W)
+    : W(W), Index(0), DoneBefore(0) {}
+
+  void setFunction(unsigned I) { Index = I; }
+
+protected:
+  virtual void waitToCreateGlobals() {
+    for (; DoneBefore < Index; ++DoneBefore) {
+      W.Running[DoneBefore].acquire();
+      W.Running[DoneBefore].release();
+    }
+  }
+};
+}
+
+void FunctionWorker::run(void *Arg) {
+  FunctionWorker *W = static_cast<FunctionWorker *>(Arg);
+  FunctionWorkerScope Scope(*W);
+  for (;;) {
+    // Take the lock of the next function before anyone else can take the
+    // function after it and wait for this one.
+    W->NextFunctionLock->acquire();
+    unsigned Index = (*W->NextFunction)++;
+    if (Index < W->Functions.size())
+      W->Running[Index].acquire();
+    W->NextFunctionLock->release();
+    if (Index >= W->Functions.size())
+      break;
+
+    Scope.setFunction(Index);
+    W->Changed |= W->FPPM->runOnFunction(*W->Functions[Index]);
+    W->Running[Index].release();
+  }
+}
+
+bool FPPassManager::runOnModuleInParallel(Module &M) {
+  SmallVector<Function *, 64> Functions;
+  for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I)
+    if (!I->isDeclaration())
+      Functions.push_back(I);
+  if (Functions.empty())
+    return false;
+
+  unsigned NumThreads = std::min<unsigned>(PassThreads, Functions.size());
+  while (Replicas.size() < NumThreads)
+    Replicas.push_back(createReplica(M));
+
+  sys::Mutex NextFunctionLock;
+  unsigned NextFunction = 0;
+  OwningArrayPtr<sys::Mutex> Running(new sys::Mutex[Functions.size()]);
+  std::vector<FunctionWorker> Workers(NumThreads);
+  {
+    LLVMContext::SharedScope Shared(M.getContext());
+    ThreadPool Pool(NumThreads);
+    for (unsigned i = 0; i != NumThreads; ++i) {
+      Workers[i].FPPM = Replicas[i];
+      Workers[i].Functions = Functions;
+      Workers[i].NextFunctionLock = &NextFunctionLock;
+      Workers[i].NextFunction = &NextFunction;
+      Workers[i].Running = Running.get();
+      Workers[i].Changed = false;
+      Pool.async(FunctionWorker::run, &Workers[i]);
+    }
+    Pool.wait();
+  }
+
+  bool Changed = false;
+  for (unsigned i = 0; i != NumThreads; ++i)
+    Changed |= Workers[i].Changed;
+
+  // Leave the analysis bookkeeping of this manager as a serial run would, so
+  // that the passes scheduled after it see the same available analyses.  The
+  // passes of this manager never ran, so there is no memory to release.
+  populateInheritedAnalysis(TPM->activeStack);
+  for (unsigned Index = 0; Index < getNumContainedPasses(); ++Index) {
+    FunctionPass *FP = getContainedPass(Index);
+    removeNotPreservedAnalysis(FP);
+    recordAvailableAnalysis(FP);
+
+    SmallVector<Pass *, 12> DeadPasses;
+    TPM->collectLastUses(DeadPasses, FP);
+    for (SmallVectorImpl<Pass *>::iterator I = DeadPasses.begin(),
+           E = DeadPasses.end(); I != E; ++I)
+      removeAvailableAnalysis(*I);
+  }
+  return Changed;
+}
+
 //===----------------------------------------------------------------------===//
 // MPPassManager implementation
 
@@ -1604,14 +2178,21 @@ MPPassManager::runOnModule(Module &M) {
     {
       PassManagerPrettyStackEntry X(MP, M);
       TimeRegion PassTimer(getPassTimer(MP));
+      PassTraceRegion PassTrace(MP, M);
 
       LocalChanged |= MP->runOnModule(M);
     }
 
     Changed |= LocalChanged;
-    if (LocalChanged)
+    if (LocalChanged) {
+      // A module pass may change any function.  The function pass managers
+      // have marked the functions they changed themselves.
+      if (MP->getPassID() != &FPPassManager::ID)
+        for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I)
+          I->markModified();
       dumpPassInfo(MP, MODIFICATION_MSG, ON_MODULE_MSG,
                    M.getModuleIdentifier());
+    }
     dumpPreservedSet(MP);
 
     verifyPreservedAnalysis(MP);
@@ -1688,6 +2269,7 @@ Pass* MPPassManager::getOnTheFlyPass(Pass *MP, AnalysisID PI, Function &F){
 bool PassManagerImpl::run(Module &M) {
   bool Changed = false;
   TimingInfo::createTheTimeInfo();
+  PassTraceInfo::createThePassTrace();
 
   dumpArguments();
   dumpPasses();
@@ -1738,6 +2320,10 @@ bool PassManager::run(Module &M) {
   return PM->run(M);
 }
 
+void PassManager::setAnalysisCaching(bool Enable) {
+  PM->setAnalysisCaching(Enable);
+}
+
 //===----------------------------------------------------------------------===//
 // TimingInfo implementation
 
@@ -1759,6 +2345,59 @@ void TimingInfo::createTheTimeInfo() {
   TheTimeInfo = &*TTI;
 }
 
+//===----------------------------------------------------------------------===//
+// PassTraceInfo implementation
+
+void PassTraceInfo::createThePassTrace() {
+  if (PassTraceFile.empty() || ThePassTrace) return;
+
+  // Constructed the first time this is called, like TheTimeInfo.
+  static ManagedStatic<PassTraceInfo> PTI;
+  ThePassTrace = &*PTI;
+}
+
+/// printString - Print Str as a JSON string.
+void PassTraceInfo::printString(raw_ostream &OS, StringRef Str) {
+  OS << '"';
+  for (unsigned i = 0, e = Str.size(); i != e; ++i) {
+    unsigned char C = Str[i];
+    if (C == '"' || C == '\\')
+      OS << '\\' << C;
+    else if (C < 0x20)
+      OS << format("\\u%04x", C);
+    else
+      OS << C;
+  }
+  OS << '"';
+}
+
+PassTraceInfo::~PassTraceInfo() {
+  std::string ErrorInfo;
+  raw_fd_ostream OS(PassTraceFile.c_str(), ErrorInfo);
+  if (!ErrorInfo.empty()) {
+    errs() << "Error opening pass trace file '" << PassTraceFile << "': "
+           << ErrorInfo << '\n';
+    return;
+  }
+
+  OS << "{\"traceEvents\": [";
+  for (unsigned i = 0, e = Events.size(); i != e; ++i) {
+    const Event &E = Events[i];
+    OS << (i ? ",\n" : "\n") << "  {\"name\": ";
+    printString(OS, E.PassName);
+    OS << ", \"cat\": \"" << (E.OnModule ? "module" : "function")
+       << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": " << E.Start
+       << ", \"dur\": " << E.Duration << ", \"args\": {\""
+       << (E.OnModule ? "module" : "function") << "\": ";
+    printString(OS, E.UnitName);
+    OS << ", \"instructions_before\": " << E.InstsBefore
+       << ", \"instructions_after\": " << E.InstsAfter
+       << ", \"malloc_bytes\": " << E.MallocBytes
+       << ", \"bump_slab_bytes\": " << E.SlabBytes << "}}";
+  }
+  OS << "\n], \"displayTimeUnit\": \"ms\"}\n";
+}
+
 /// If TimingInfo is enabled then start pass timer.
 Timer *llvm::getPassTimer(Pass *P) {
   if (TheTimeInfo)
@@ -0,0 +1,440 @@
+//===-- StructuralHash.cpp - Stable hashes of IR --------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements hashFunction and hashGlobalDeclaration.  Every part of
+// the IR is added with a tag that says what it is, so that different
+// structures cannot run together into the same bytes.  Arguments, blocks and
+// instructions are identified by their position in the function, metadata
+// nodes by the order in which they are reached, and globals by name.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/IR/StructuralHash.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalAlias.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/Support/MD5.h"
+
+using namespace llvm;
+
+namespace {
+
+/// What the next bytes of the hash describe.
+enum HashTag {
+  HT_Function, HT_Argument, HT_Block, HT_Instruction, HT_Local,
+  HT_Global, HT_GlobalVariable, HT_GlobalAlias, HT_Constant, HT_ConstantExpr,
+  HT_BlockAddress, HT_InlineAsm, HT_MDString, HT_MDNode, HT_MDNodeRef,
+  HT_MDNull, HT_Attachment, HT_Type, HT_NamedStruct, HT_End
+};
+
+class StructuralHasher {
+  MD5 &Hash;
+
+  /// LocalNumbers - The position of each argument, block and instruction of
+  /// the function being hashed.
+  DenseMap<const Value *, unsigned> LocalNumbers;
+
+  /// MDNumbers - The nodes reached so far, which may be reached again
+  /// through a cycle.
+  DenseMap<const MDNode *, unsigned> MDNumbers;
+
+  /// Structs - The named structs whose body has been added.
+  SmallPtrSet<StructType *, 8> Structs;
+
+  /// Globals - The globals referred to, in the order they were reached.
+  SmallVector<const GlobalValue *, 16> Globals;
+  SmallPtrSet<const GlobalValue *, 16> SeenGlobals;
+
+  SmallVector<StringRef, 8> MDKindNames;
+
+public:
+  explicit StructuralHasher(MD5 &Hash) : Hash(Hash) {}
+
+  void add(uint64_t V) {
+    uint8_t Bytes[8];
+    for (unsigned i = 0; i != 8; ++i)
+      Bytes[i] = uint8_t(V >> (8 * i));
+    Hash.update(Bytes);
+  }
+
+  void add(StringRef S) {
+    add(S.size());
+    Hash.update(S);
+  }
+
+  void addType(Type *Ty);
+  void addAttributes(AttributeSet Attrs);
+  void addValue(const Value *V);
+  void addConstant(const Constant *C);
+  void addMDNode(const MDNode *N);
+  void addInstruction(const Instruction &I);
+  void addFunction(const Function &F);
+
+  /// addGlobalDeclaration - Add GV as seen from the code that refers to it.
+  void addGlobalDeclaration(const GlobalValue &GV);
+
+  /// addReferencedGlobals - Add the declarations of the globals reached
+  /// since Start, and of those their initializers reach in turn, except for
+  /// Skip.
+  void addReferencedGlobals(unsigned Start, const GlobalValue *Skip);
+
+  /// noteGlobal - Record that GV is referred to.
+  void noteGlobal(const GlobalValue *GV) {
+    if (SeenGlobals.insert(GV))
+      Globals.push_back(GV);
+  }
+};
+
+}
+
+void StructuralHasher::addType(Type *Ty) {
+  add(HT_Type);
+  add(Ty->getTypeID());
+  switch (Ty->getTypeID()) {
+  case Type::IntegerTyID:
+    add(cast<IntegerType>(Ty)->getBitWidth());
+    return;
+  case Type::PointerTyID:
+    add(cast<PointerType>(Ty)->getAddressSpace());
+    addType(cast<PointerType>(Ty)->getElementType());
+    return;
+  case Type::ArrayTyID:
+    add(cast<ArrayType>(Ty)->getNumElements());
+    addType(cast<ArrayType>(Ty)->getElementType());
+    return;
+  case Type::VectorTyID:
+    add(cast<VectorType>(Ty)->getNumElements());
+    addType(cast<VectorType>(Ty)->getElementType());
+    return;
+  case Type::FunctionTyID: {
+    FunctionType *FTy = cast<FunctionType>(Ty);
+    add(FTy->isVarArg());
+    add(FTy->getNumParams());
+    addType(FTy->getReturnType());
+    for (unsigned i = 0, e = FTy->getNumParams(); i != e; ++i)
+      addType(FTy->getParamType(i));
+    return;
+  }
+  case Type::StructTyID: {
+    StructType *STy = cast<StructType>(Ty);
+    // A named struct is referred to by name, and its body is added the first
+    // time, which also ends the recursion of self referential structs.
+    if (STy->hasName()) {
+      add(HT_NamedStruct);
+      add(STy->getName());
+      if (!Structs.insert(STy))
+        return;
+    }
+    add(STy->isOpaque());
+    add(STy->isPacked());
+    add(STy->getNumElements());
+    for (unsigned i = 0, e = STy->getNumElements(); i != e; ++i)
+      addType(STy->getElementType(i));
+    return;
+  }
+  default:
+    return;
+  }
+}
+
+void StructuralHasher::addAttributes(AttributeSet Attrs) {
+  add(Attrs.getNumSlots());
+  for (unsigned i = 0, e = Attrs.getNumSlots(); i != e; ++i) {
+    unsigned Index = Attrs.getSlotIndex(i);
+    add(Index);
+    add(Attrs.getAsString(Index));
+  }
+}
+
+void StructuralHasher::addValue(const Value *V) {
+  DenseMap<const Value *, unsigned>::iterator I = LocalNumbers.find(V);
+  if (I != LocalNumbers.end()) {
+    add(HT_Local);
+    add(I->second);
+    return;
+  }
+
+  if (const Constant *C = dyn_cast<Constant>(V))
+    return addConstant(C);
+
+  if (const MDString *S = dyn_cast<MDString>(V)) {
+    add(HT_MDString);
+    add(S->getString());
+    return;
+  }
+
+  if (const MDNode *N = dyn_cast<MDNode>(V))
+    return addMDNode(N);
+
+  if (const InlineAsm *IA = dyn_cast<InlineAsm>(V)) {
+    add(HT_InlineAsm);
+    addType(IA->getType());
+    add(IA->getAsmString());
+    add(IA->getConstraintString());
+    add(IA->hasSideEffects());
+    add(IA->isAlignStack());
+    add(IA->getDialect());
+    return;
+  }
+
+  // A value of another function, which only function local metadata of a
+  // broken module could refer to.
+  add(V->getValueID());
+}
+
+void StructuralHasher::addConstant(const Constant *C) {
+  if (const GlobalValue *GV = dyn_cast<GlobalValue>(C)) {
+    add(HT_Global);
+    add(GV->getName());
+    noteGlobal(GV);
+    return;
+  }
+
+  if (const BlockAddress *BA = dyn_cast<BlockAddress>(C)) {
+    const Function *F = BA->getFunction();
+    add(HT_BlockAddress);
+    add(F->getName());
+    noteGlobal(F);
+    unsigned Index = 0;
+    for (Function::const_iterator I = F->begin(); &*I != BA->getBasicBlock();
+         ++I)
+      ++Index;
+    add(Index);
+    return;
+  }
+
+  add(C->getValueID());
+  addType(C->getType());
+
+  if (const ConstantInt *CI = dyn_cast<ConstantInt>(C)) {
+    const APInt &Value = CI->getValue();
+    for (unsigned i = 0, e = Value.getNumWords(); i != e; ++i)
+      add(Value.getRawData()[i]);
+    return;
+  }
+
+  if (const ConstantFP *CFP = dyn_cast<ConstantFP>(C)) {
+    APInt Bits = CFP->getValueAPF().bitcastToAPInt();
+    for (unsigned i = 0, e = Bits.getNumWords(); i != e; ++i)
+      add(Bits.getRawData()[i]);
+    return;
+  }
+
+  if (const ConstantDataSequential *CDS = dyn_cast<ConstantDataSequential>(C)) {
+    add(CDS->getRawDataValues());
+    return;
+  }
+
+  if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(C)) {
+    add(HT_ConstantExpr);
+    add(CE->getOpcode());
+    add(CE->getRawSubclassOptionalData());
+    if (CE->isCompare())
+      add(CE->getPredicate());
+    if (CE->hasIndices()) {
+      ArrayRef<unsigned> Indices = CE->getIndices();
+      add(Indices.size());
+      for (unsigned i = 0, e = Indices.size(); i != e; ++i)
+        add(Indices[i]);
+    }
+  }
+
+  // Aggregates and expressions are made of their operands, the remaining
+  // kinds (zero, null, undef) have none.
+  add(HT_Constant);
+  add(C->getNumOperands());
+  for (unsigned i = 0, e = C->getNumOperands(); i != e; ++i)
+    addConstant(cast<Constant>(C->getOperand(i)));
+}
+
+void StructuralHasher::addMDNode(const MDNode *N) {
+  std::pair<DenseMap<const MDNode *, unsigned>::iterator, bool> Inserted =
+    MDNumbers.insert(std::make_pair(N, MDNumbers.size()));
+  if (!Inserted.second) {
+    add(HT_MDNodeRef);
+    add(Inserted.first->second);
+    return;
+  }
+
+  add(HT_MDNode);
+  add(N->isFunctionLocal());
+  add(N->getNumOperands());
+  for (unsigned i = 0, e = N->getNumOperands(); i != e; ++i) {
+    if (Value *Op = N->getOperand(i))
+      addValue(Op);
+    else
+      add(HT_MDNull);
+  }
+}
+
+void StructuralHasher::addInstruction(const Instruction &I) {
+  add(HT_Instruction);
+  add(I.getOpcode());
+  addType(I.getType());
+  add(I.getName());
+  add(I.getRawSubclassOptionalData());
+
+  add(I.getNumOperands());
+  for (unsigned i = 0, e = I.getNumOperands(); i != e; ++i) {
+    if (const Value *Op = I.getOperand(i))
+      addValue(Op);
+    else
+      add(HT_MDNull);
+  }
+
+  // The parts of each kind of instruction that are not operands.
+  if (const PHINode *PN = dyn_cast<PHINode>(&I)) {
+    for (unsigned i = 0, e = PN->getNumIncomingValues(); i != e; ++i)
+      addValue(PN->getIncomingBlock(i));
+  } else if (const CmpInst *CI = dyn_cast<CmpInst>(&I)) {
+    add(CI->getPredicate());
+  } else if (const AllocaInst *AI = dyn_cast<AllocaInst>(&I)) {
+    add(AI->getAlignment());
+  } else if (const LoadInst *LI = dyn_cast<LoadInst>(&I)) {
+    add(LI->isVolatile());
+    add(LI->getAlignment());
+    add(LI->getOrdering());
+    add(LI->getSynchScope());
+  } else if (const StoreInst *SI = dyn_cast<StoreInst>(&I)) {
+    add(SI->isVolatile());
+    add(SI->getAlignment());
+    add(SI->getOrdering());
+    add(SI->getSynchScope());
+  } else if (const CallInst *CI = dyn_cast<CallInst>(&I)) {
+    add(CI->isTailCall());
+    add(CI->getCallingConv());
+    addAttributes(CI->getAttributes());
+  } else if (const InvokeInst *II = dyn_cast<InvokeInst>(&I)) {
+    add(II->getCallingConv());
+    addAttributes(II->getAttributes());
+  } else if (const AtomicCmpXchgInst *CXI = dyn_cast<AtomicCmpXchgInst>(&I)) {
+    add(CXI->isVolatile());
+    add(CXI->getOrdering());
+    add(CXI->getSynchScope());
+  } else if (const AtomicRMWInst *RMWI = dyn_cast<AtomicRMWInst>(&I)) {
+    add(RMWI->getOperation());
+    add(RMWI->isVolatile());
+    add(RMWI->getOrdering());
+    add(RMWI->getSynchScope());
+  } else if (const FenceInst *FI = dyn_cast<FenceInst>(&I)) {
+    add(FI->getOrdering());
+    add(FI->getSynchScope());
+  } else if (const ExtractValueInst *EVI = dyn_cast<ExtractValueInst>(&I)) {
+    for (unsigned i = 0, e = EVI->getNumIndices(); i != e; ++i)
+      add(EVI->getIndices()[i]);
+  } else if (const InsertValueInst *IVI = dyn_cast<InsertValueInst>(&I)) {
+    for (unsigned i = 0, e = IVI->getNumIndices(); i != e; ++i)
+      add(IVI->getIndices()[i]);
+  } else if (const LandingPadInst *LPI = dyn_cast<LandingPadInst>(&I)) {
+    add(LPI->isCleanup());
+    for (unsigned i = 0, e = LPI->getNumClauses(); i != e; ++i)
+      add(LPI->isCatch(i));
+  }
+
+  // Metadata kinds are numbered per context, so they are added by name.
+  SmallVector<std::pair<unsigned, MDNode *>, 4> MDs;
+  I.getAllMetadata(MDs);
+  if (!MDs.empty() && MDKindNames.empty())
+    I.getContext().getMDKindNames(MDKindNames);
+  for (unsigned i = 0, e = MDs.size(); i != e; ++i) {
+    add(HT_Attachment);
+    add(MDKindNames[MDs[i].first]);
+    addMDNode(MDs[i].second);
+  }
+}
+
+void StructuralHasher::addFunction(const Function &F) {
+  add(HT_Function);
+  addGlobalDeclaration(F);
+
+  // Number everything first, so that uses before definitions (in PHI nodes
+  // and unreachable code) find their number.
+  for (Function::const_arg_iterator I = F.arg_begin(), E = F.arg_end();
+       I != E; ++I)
+    LocalNumbers[I] = LocalNumbers.size();
+  for (Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
+    LocalNumbers[BB] = LocalNumbers.size();
+    for (BasicBlock::const_iterator I = BB->begin(), IE = BB->end(); I != IE;
+         ++I)
+      LocalNumbers[I] = LocalNumbers.size();
+  }
+
+  for (Function::const_arg_iterator I = F.arg_begin(), E = F.arg_end();
+       I != E; ++I) {
+    add(HT_Argument);
+    add(I->getName());
+  }
+  for (Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
+    add(HT_Block);
+    add(BB->getName());
+    for (BasicBlock::const_iterator I = BB->begin(), IE = BB->end(); I != IE;
+         ++I)
+      addInstruction(*I);
+  }
+  add(HT_End);
+}
+
+void StructuralHasher::addGlobalDeclaration(const GlobalValue &GV) {
+  add(GV.getName());
+  addType(GV.getType());
+  add(GV.getLinkage());
+  add(GV.getVisibility());
+  add(GV.hasUnnamedAddr());
+  add(GV.getSection());
+  add(GV.getAlignment());
+  add(GV.isDeclaration());
+
+  if (const Function *F = dyn_cast<Function>(&GV)) {
+    add(F->getCallingConv());
+    addAttributes(F->getAttributes());
+    add(F->hasGC() ? StringRef(F->getGC()) : StringRef());
+  } else if (const GlobalVariable *GVar = dyn_cast<GlobalVariable>(&GV)) {
+    add(HT_GlobalVariable);
+    add(GVar->getThreadLocalMode());
+    add(GVar->isConstant());
+    add(GVar->isExternallyInitialized());
+    // Only the initializer of a constant can be relied on.
+    if (GVar->isConstant() && GVar->hasInitializer())
+      addConstant(GVar->getInitializer());
+  } else if (const GlobalAlias *GA = dyn_cast<GlobalAlias>(&GV)) {
+    add(HT_GlobalAlias);
+    addConstant(GA->getAliasee());
+  }
+}
+
+void StructuralHasher::addReferencedGlobals(unsigned Start,
+                                            const GlobalValue *Skip) {
+  for (unsigned i = Start; i != Globals.size(); ++i)
+    if (Globals[i] != Skip)
+      addGlobalDeclaration(*Globals[i]);
+  add(HT_End);
+}
+
+void llvm::hashFunction(const Function &F, MD5 &Hash) {
+  StructuralHasher Hasher(Hash);
+  Hasher.noteGlobal(&F);
+  Hasher.addFunction(F);
+  Hasher.addReferencedGlobals(0, &F);
+}
+
+void llvm::hashGlobalDeclaration(const GlobalValue &GV, MD5 &Hash) {
+  StructuralHasher Hasher(Hash);
+  Hasher.noteGlobal(&GV);
+  Hasher.addGlobalDeclaration(GV);
+  Hasher.addReferencedGlobals(1, 0);
+}
@@ -317,10 +317,19 @@ IntegerType *IntegerType::get(LLVMContext &C, unsigned NumBits) {
     break;
   }
   
-  IntegerType *&Entry = C.pImpl->IntegerTypes[NumBits];
+  LLVMContextImpl *pImpl = C.pImpl;
+  if (IntegerType *ITy = pImpl->IntegerTypes.lookup(NumBits))
+    return ITy;
+
+  LLVMContextImpl::IntegerTypeMap::Shard &S =
+    pImpl->IntegerTypes.getShard(NumBits);
+  sys::SmartScopedWriter<true> Writer(S.Lock);
+  IntegerType *&Entry = S.Map[NumBits];
   
-  if (Entry == 0)
-    Entry = new (C.pImpl->TypeAllocator) IntegerType(C, NumBits);
+  if (Entry == 0) {
+    sys::SmartScopedLock<true> Alloc(pImpl->TypeAllocatorLock);
+    Entry = new (pImpl->TypeAllocator) IntegerType(C, NumBits);
+  }
   
   return Entry;
 }
@@ -362,16 +371,24 @@ FunctionType *FunctionType::get(Type *ReturnType,
                                 ArrayRef<Type*> Params, bool isVarArg) {
   LLVMContextImpl *pImpl = ReturnType->getContext().pImpl;
   FunctionTypeKeyInfo::KeyTy Key(ReturnType, Params, isVarArg);
-  LLVMContextImpl::FunctionTypeMap::iterator I =
-    pImpl->FunctionTypes.find_as(Key);
+  if (FunctionType *FT = pImpl->FunctionTypes.lookupKey(Key))
+    return FT;
+
+  LLVMContextImpl::FunctionTypeMap::Shard &S =
+    pImpl->FunctionTypes.getShard(Key);
+  sys::SmartScopedWriter<true> Writer(S.Lock);
+  LLVMContextImpl::FunctionTypeMap::MapTy::iterator I = S.Map.find_as(Key);
   FunctionType *FT;
 
-  if (I == pImpl->FunctionTypes.end()) {
-    FT = (FunctionType*) pImpl->TypeAllocator.
-      Allocate(sizeof(FunctionType) + sizeof(Type*) * (Params.size() + 1),
-               AlignOf<FunctionType>::Alignment);
+  if (I == S.Map.end()) {
+    {
+      sys::SmartScopedLock<true> Alloc(pImpl->TypeAllocatorLock);
+      FT = (FunctionType*) pImpl->TypeAllocator.
+        Allocate(sizeof(FunctionType) + sizeof(Type*) * (Params.size() + 1),
+                 AlignOf<FunctionType>::Alignment);
+    }
     new (FT) FunctionType(ReturnType, Params, isVarArg);
-    pImpl->FunctionTypes[FT] = true;
+    S.Map[FT] = true;
   } else {
     FT = I->first;
   }
@@ -406,16 +423,24 @@ StructType *StructType::get(LLVMContext &Context, ArrayRef<Type*> ETypes,
                             bool isPacked) {
   LLVMContextImpl *pImpl = Context.pImpl;
   AnonStructTypeKeyInfo::KeyTy Key(ETypes, isPacked);
-  LLVMContextImpl::StructTypeMap::iterator I =
-    pImpl->AnonStructTypes.find_as(Key);
+  if (StructType *ST = pImpl->AnonStructTypes.lookupKey(Key))
+    return ST;
+
+  LLVMContextImpl::StructTypeMap::Shard &S =
+    pImpl->AnonStructTypes.getShard(Key);
+  sys::SmartScopedWriter<true> Writer(S.Lock);
+  LLVMContextImpl::StructTypeMap::MapTy::iterator I = S.Map.find_as(Key);
   StructType *ST;
 
-  if (I == pImpl->AnonStructTypes.end()) {
+  if (I == S.Map.end()) {
     // Value not found.  Create a new type!
-    ST = new (Context.pImpl->TypeAllocator) StructType(Context);
+    {
+      sys::SmartScopedLock<true> Alloc(pImpl->TypeAllocatorLock);
+      ST = new (pImpl->TypeAllocator) StructType(Context);
+    }
     ST->setSubclassData(SCDB_IsLiteral);  // Literal struct.
     ST->setBody(ETypes, isPacked);
-    Context.pImpl->AnonStructTypes[ST] = true;
+    S.Map[ST] = true;
   } else {
     ST = I->first;
   }
@@ -431,7 +456,9 @@ void StructType::setBody(ArrayRef<Type*> Elements, bool isPacked) {
     setSubclassData(getSubclassData() | SCDB_Packed);
 
   unsigned NumElements = Elements.size();
-  Type **Elts = getContext().pImpl->TypeAllocator.Allocate<Type*>(NumElements);
+  LLVMContextImpl *pImpl = getContext().pImpl;
+  sys::SmartScopedLock<true> Alloc(pImpl->TypeAllocatorLock);
+  Type **Elts = pImpl->TypeAllocator.Allocate<Type*>(NumElements);
   memcpy(Elts, Elements.data(), sizeof(Elements[0]) * NumElements);
   
   ContainedTys = Elts;
@@ -441,6 +468,7 @@ void StructType::setBody(ArrayRef<Type*> Elements, bool isPacked) {
 void StructType::setName(StringRef Name) {
   if (Name == getName()) return;
 
+  sys::SmartScopedLock<true> Guard(getContext().pImpl->Lock);
   StringMap<StructType *> &SymbolTable = getContext().pImpl->NamedStructTypes;
   typedef StringMap<StructType *>::MapEntryTy EntryTy;
 
@@ -492,7 +520,11 @@ void StructType::setName(StringRef Name) {
 // StructType Helper functions.
 
 StructType *StructType::create(LLVMContext &Context, StringRef Name) {
-  StructType *ST = new (Context.pImpl->TypeAllocator) StructType(Context);
+  StructType *ST;
+  {
+    sys::SmartScopedLock<true> Alloc(Context.pImpl->TypeAllocatorLock);
+    ST = new (Context.pImpl->TypeAllocator) StructType(Context);
+  }
   if (!Name.empty())
     ST->setName(Name);
   return ST;
@@ -616,6 +648,7 @@ bool StructType::isLayoutIdentical(StructType *Other) const {
 /// getTypeByName - Return the type with the specified name, or null if there
 /// is none by that name.
 StructType *Module::getTypeByName(StringRef Name) const {
+  sys::SmartScopedLock<true> Guard(getContext().pImpl->Lock);
   StringMap<StructType*>::iterator I =
     getContext().pImpl->NamedStructTypes.find(Name);
   if (I != getContext().pImpl->NamedStructTypes.end())
@@ -685,11 +718,18 @@ ArrayType *ArrayType::get(Type *elementType, uint64_t NumElements) {
   assert(isValidElementType(ElementType) && "Invalid type for array element!");
     
   LLVMContextImpl *pImpl = ElementType->getContext().pImpl;
-  ArrayType *&Entry = 
-    pImpl->ArrayTypes[std::make_pair(ElementType, NumElements)];
+  std::pair<Type *, uint64_t> Key(ElementType, NumElements);
+  if (ArrayType *ATy = pImpl->ArrayTypes.lookup(Key))
+    return ATy;
+
+  LLVMContextImpl::ArrayTypeMap::Shard &S = pImpl->ArrayTypes.getShard(Key);
+  sys::SmartScopedWriter<true> Writer(S.Lock);
+  ArrayType *&Entry = S.Map[Key];
   
-  if (Entry == 0)
+  if (Entry == 0) {
+    sys::SmartScopedLock<true> Alloc(pImpl->TypeAllocatorLock);
     Entry = new (pImpl->TypeAllocator) ArrayType(ElementType, NumElements);
+  }
   return Entry;
 }
 
@@ -714,11 +754,18 @@ VectorType *VectorType::get(Type *elementType, unsigned NumElements) {
          "Elements of a VectorType must be a primitive type");
   
   LLVMContextImpl *pImpl = ElementType->getContext().pImpl;
-  VectorType *&Entry = ElementType->getContext().pImpl
-    ->VectorTypes[std::make_pair(ElementType, NumElements)];
+  std::pair<Type *, unsigned> Key(ElementType, NumElements);
+  if (VectorType *VTy = pImpl->VectorTypes.lookup(Key))
+    return VTy;
+
+  LLVMContextImpl::VectorTypeMap::Shard &S = pImpl->VectorTypes.getShard(Key);
+  sys::SmartScopedWriter<true> Writer(S.Lock);
+  VectorType *&Entry = S.Map[Key];
   
-  if (Entry == 0)
+  if (Entry == 0) {
+    sys::SmartScopedLock<true> Alloc(pImpl->TypeAllocatorLock);
     Entry = new (pImpl->TypeAllocator) VectorType(ElementType, NumElements);
+  }
   return Entry;
 }
 
@@ -738,11 +785,33 @@ PointerType *PointerType::get(Type *EltTy, unsigned AddressSpace) {
   LLVMContextImpl *CImpl = EltTy->getContext().pImpl;
   
   // Since AddressSpace #0 is the common case, we special case it.
-  PointerType *&Entry = AddressSpace == 0 ? CImpl->PointerTypes[EltTy]
-     : CImpl->ASPointerTypes[std::make_pair(EltTy, AddressSpace)];
+  if (AddressSpace == 0) {
+    if (PointerType *PTy = CImpl->PointerTypes.lookup(EltTy))
+      return PTy;
+
+    LLVMContextImpl::PointerTypeMap::Shard &S =
+      CImpl->PointerTypes.getShard(EltTy);
+    sys::SmartScopedWriter<true> Writer(S.Lock);
+    PointerType *&Entry = S.Map[EltTy];
+    if (Entry == 0) {
+      sys::SmartScopedLock<true> Alloc(CImpl->TypeAllocatorLock);
+      Entry = new (CImpl->TypeAllocator) PointerType(EltTy, AddressSpace);
+    }
+    return Entry;
+  }
 
-  if (Entry == 0)
+  std::pair<Type *, unsigned> Key(EltTy, AddressSpace);
+  if (PointerType *PTy = CImpl->ASPointerTypes.lookup(Key))
+    return PTy;
+
+  LLVMContextImpl::ASPointerTypeMap::Shard &S =
+    CImpl->ASPointerTypes.getShard(Key);
+  sys::SmartScopedWriter<true> Writer(S.Lock);
+  PointerType *&Entry = S.Map[Key];
+  if (Entry == 0) {
+    sys::SmartScopedLock<true> Alloc(CImpl->TypeAllocatorLock);
     Entry = new (CImpl->TypeAllocator) PointerType(EltTy, AddressSpace);
+  }
   return Entry;
 }
 
@@ -12,6 +12,10 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/IR/Value.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/ThreadLocal.h"
+#include "llvm/Support/Threading.h"
 #include <new>
 
 namespace llvm {
@@ -25,11 +29,11 @@ void Use::swap(Use &RHS) {
   Value *V2(RHS.Val);
   if (V1 != V2) {
     if (V1) {
-      removeFromList();
+      removeFromVal();
     }
 
     if (V2) {
-      RHS.removeFromList();
+      RHS.removeFromVal();
       Val = V2;
       V2->addUse(*this);
     } else {
@@ -45,6 +49,83 @@ void Use::swap(Use &RHS) {
   }
 }
 
+//===----------------------------------------------------------------------===//
+//                         Shared Use List Implementation
+//===----------------------------------------------------------------------===//
+
+// The use lists of constants, globals and metadata are updated by the passes
+// of every function that uses them, which may run concurrently.  Each list is
+// guarded by one of a fixed set of locks picked from the address of its value,
+// so threads working on the uses of different values rarely wait for each
+// other.  A use list only links the uses of one value, so adding or removing
+// a use never needs more than one of the locks.
+namespace {
+struct SharedUseListLocks {
+  enum { NumShards = 32 };
+  sys::SmartMutex<true> Shards[NumShards];
+
+  sys::SmartMutex<true> &get(const Value *V) {
+    uintptr_t Key = reinterpret_cast<uintptr_t>(V);
+    return Shards[((Key >> 4) ^ (Key >> 9)) % NumShards];
+  }
+};
+}
+
+static ManagedStatic<SharedUseListLocks> SharedUseListLock;
+
+void Use::addToSharedList(Use **List) {
+  if (!llvm_is_multithreaded())
+    return addToList(List);
+  sys::SmartScopedLock<true> Guard(SharedUseListLock->get(Val));
+  addToList(List);
+}
+
+void Use::removeFromSharedList() {
+  if (!llvm_is_multithreaded())
+    return removeFromList();
+  sys::SmartScopedLock<true> Guard(SharedUseListLock->get(Val));
+  removeFromList();
+}
+
+SharedUseListGuard::SharedUseListGuard(const Value *V) : Locked(0) {
+  if (V->hasSharedUseList() && llvm_is_multithreaded()) {
+    Locked = V;
+    SharedUseListLock->get(V).acquire();
+  }
+}
+
+SharedUseListGuard::~SharedUseListGuard() {
+  if (Locked)
+    SharedUseListLock->get(Locked).release();
+}
+
+// InFunctionLocalScope - Set on the threads inside a FunctionLocalScope.
+static ManagedStatic<sys::ThreadLocal<const FunctionLocalScope> >
+InFunctionLocalScope;
+
+FunctionLocalScope::FunctionLocalScope() {
+  InFunctionLocalScope->set(this);
+}
+
+FunctionLocalScope::~FunctionLocalScope() {
+  InFunctionLocalScope->erase();
+}
+
+bool FunctionLocalScope::isActive() {
+  return llvm_is_multithreaded() && InFunctionLocalScope->get() != 0;
+}
+
+void FunctionLocalScope::orderGlobalCreation() {
+  if (!llvm_is_multithreaded())
+    return;
+  // ThreadLocal only hands out const pointers; the scope itself is not const.
+  if (const FunctionLocalScope *Scope = InFunctionLocalScope->get())
+    const_cast<FunctionLocalScope *>(Scope)->waitToCreateGlobals();
+}
+
+void FunctionLocalScope::waitToCreateGlobals() {
+}
+
 //===----------------------------------------------------------------------===//
 //                         Use getImpliedUser Implementation
 //===----------------------------------------------------------------------===//
@@ -60,11 +60,16 @@ void *User::operator new(size_t s, unsigned Us) {
   void *Storage = ::operator new(s + sizeof(Use) * Us);
   Use *Start = static_cast<Use*>(Storage);
   Use *End = Start + Us;
-  User *Obj = reinterpret_cast<User*>(End);
-  Obj->OperandList = Start;
-  Obj->NumOperands = Us;
   Use::initTags(Start, End);
-  return Obj;
+  return End;
+}
+
+void *User::operator new(size_t s) {
+  // Leave room for the pointer to the Uses in front of the User.
+  void *Storage = ::operator new(s + sizeof(Use *));
+  Use **HungOffOperandList = static_cast<Use **>(Storage);
+  *HungOffOperandList = 0;
+  return HungOffOperandList + 1;
 }
 
 //===----------------------------------------------------------------------===//
@@ -72,10 +77,14 @@ void *User::operator new(size_t s, unsigned Us) {
 //===----------------------------------------------------------------------===//
 
 void User::operator delete(void *Usr) {
-  User *Start = static_cast<User*>(Usr);
-  Use *Storage = static_cast<Use*>(Usr) - Start->NumOperands;
-  // If there were hung-off uses, they will have been freed already and
-  // NumOperands reset to 0, so here we just free the User itself.
+  User *Obj = static_cast<User*>(Usr);
+  // If there were hung-off uses, they will have been freed already, so here
+  // we just free the User itself and the pointer in front of it.
+  if (Obj->HasHungOffUses) {
+    ::operator delete(static_cast<Use **>(Usr) - 1);
+    return;
+  }
+  Use *Storage = static_cast<Use*>(Usr) - Obj->NumUserOperands;
   ::operator delete(Storage);
 }
 
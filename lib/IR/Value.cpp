@@ -20,6 +20,7 @@
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Operator.h"
 #include "llvm/IR/ValueSymbolTable.h"
@@ -43,7 +44,8 @@ static inline Type *checkType(Type *Ty) {
 
 Value::Value(Type *ty, unsigned scid)
   : SubclassID(scid), HasValueHandle(0),
-    SubclassOptionalData(0), SubclassData(0), VTy((Type*)checkType(ty)),
+    SubclassOptionalData(0), SubclassData(0), NumUserOperands(0),
+    HasHungOffUses(0), VTy((Type*)checkType(ty)),
     UseList(0), Name(0) {
   // FIXME: Why isn't this in the subclass gunk??
   // Note, we cannot call isa<CallInst> before the CallInst has been
@@ -90,6 +92,7 @@ Value::~Value() {
 /// hasNUses - Return true if this Value has exactly N users.
 ///
 bool Value::hasNUses(unsigned N) const {
+  SharedUseListGuard Guard(this);
   const_use_iterator UI = use_begin(), E = use_end();
 
   for (; N; --N, ++UI)
@@ -101,6 +104,7 @@ bool Value::hasNUses(unsigned N) const {
 /// logically equivalent to getNumUses() >= N.
 ///
 bool Value::hasNUsesOrMore(unsigned N) const {
+  SharedUseListGuard Guard(this);
   const_use_iterator UI = use_begin(), E = use_end();
 
   for (; N; --N, ++UI)
@@ -125,6 +129,7 @@ bool Value::isUsedInBasicBlock(const BasicBlock *BB) const {
   if (MaxBlockSize != 0) // We scanned the entire block and found no use.
     return false;
 
+  SharedUseListGuard Guard(this);
   for (const_use_iterator I = use_begin(), E = use_end(); I != E; ++I) {
     const Instruction *User = dyn_cast<Instruction>(*I);
     if (User && User->getParent() == BB)
@@ -138,6 +143,7 @@ bool Value::isUsedInBasicBlock(const BasicBlock *BB) const {
 /// is a linear time operation.  Use hasOneUse or hasNUses to check for specific
 /// values.
 unsigned Value::getNumUses() const {
+  SharedUseListGuard Guard(this);
   return (unsigned)std::distance(use_begin(), use_end());
 }
 
@@ -195,8 +201,10 @@ void Value::setName(const Twine &NewName) {
   if (getSymTab(this, ST))
     return;  // Cannot set a name on this value (e.g. constant).
 
-  if (Function *F = dyn_cast<Function>(this))
+  if (Function *F = dyn_cast<Function>(this)) {
+    sys::SmartScopedLock<true> Guard(getContext().pImpl->Lock);
     getContext().pImpl->IntrinsicIDCache.erase(F);
+  }
 
   if (!ST) { // No symbol table to update?  Just do the change.
     if (NameRef.empty()) {
@@ -307,6 +315,15 @@ void Value::replaceAllUsesWith(Value *New) {
   assert(New->getType() == getType() &&
          "replaceAllUses of value with new value of different type!");
 
+  // The uses of a shared value are spread over functions that other threads
+  // may be transforming, see SharedUseListGuard.  Function local metadata is
+  // only used by its own function.
+  const MDNode *MD = dyn_cast<MDNode>(this);
+  if (hasSharedUseList() && !(MD && MD->isFunctionLocal()) &&
+      FunctionLocalScope::isActive())
+    report_fatal_error("Cannot replace a value used by several functions "
+                       "while running passes on several threads");
+
   // Notify all ValueHandles (if present) that this value is going away.
   if (HasValueHandle)
     ValueHandleBase::ValueIsRAUWd(this, New);
@@ -509,11 +526,19 @@ void ValueHandleBase::AddToExistingUseListAfter(ValueHandleBase *List) {
     Next->setPrevPtr(&Next);
 }
 
+/// AddToUseListBefore - Add this ValueHandle to the use list for VP, just
+/// before RHS.  The lock keeps other threads from relinking RHS meanwhile.
+void ValueHandleBase::AddToUseListBefore(const ValueHandleBase &RHS) {
+  sys::SmartScopedLock<true> Guard(VP.getPointer()->getContext().pImpl->Lock);
+  AddToExistingUseList(RHS.getPrevPtr());
+}
+
 /// AddToUseList - Add this ValueHandle to the use list for VP.
 void ValueHandleBase::AddToUseList() {
   assert(VP.getPointer() && "Null pointer doesn't have a use list!");
 
   LLVMContextImpl *pImpl = VP.getPointer()->getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->Lock);
 
   if (VP.getPointer()->HasValueHandle) {
     // If this value already has a ValueHandle, then it must be in the
@@ -558,6 +583,9 @@ void ValueHandleBase::RemoveFromUseList() {
   assert(VP.getPointer() && VP.getPointer()->HasValueHandle &&
          "Pointer doesn't have a use list!");
 
+  LLVMContextImpl *pImpl = VP.getPointer()->getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->Lock);
+
   // Unlink this from its use list.
   ValueHandleBase **PrevPtr = getPrevPtr();
   assert(*PrevPtr == this && "List invariant broken");
@@ -572,7 +600,6 @@ void ValueHandleBase::RemoveFromUseList() {
   // If the Next pointer was null, then it is possible that this was the last
   // ValueHandle watching VP.  If so, delete its entry from the ValueHandles
   // map.
-  LLVMContextImpl *pImpl = VP.getPointer()->getContext().pImpl;
   DenseMap<Value*, ValueHandleBase*> &Handles = pImpl->ValueHandles;
   if (Handles.isPointerIntoBucketsArray(PrevPtr)) {
     Handles.erase(VP.getPointer());
@@ -587,6 +614,7 @@ void ValueHandleBase::ValueIsDeleted(Value *V) {
   // Get the linked list base, which is guaranteed to exist since the
   // HasValueHandle flag is set.
   LLVMContextImpl *pImpl = V->getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->Lock);
   ValueHandleBase *Entry = pImpl->ValueHandles[V];
   assert(Entry && "Value bit set but no entries exist");
 
@@ -645,6 +673,7 @@ void ValueHandleBase::ValueIsRAUWd(Value *Old, Value *New) {
   // Get the linked list base, which is guaranteed to exist since the
   // HasValueHandle flag is set.
   LLVMContextImpl *pImpl = Old->getContext().pImpl;
+  sys::SmartScopedLock<true> Guard(pImpl->Lock);
   ValueHandleBase *Entry = pImpl->ValueHandles[Old];
 
   assert(Entry && "Value bit set but no entries exist");
@@ -1223,6 +1223,10 @@ bool ModuleLinker::run() {
   // Resolve all uses of aliases with aliasees.
   linkAliasBodies();
 
+  // A lazily loaded source module may not have read its named metadata yet.
+  if (SrcM->MaterializeMetadata(&ErrorMsg))
+    return true;
+
   // Remap all of the named MDNodes in Src into the DstM module. We do this
   // after linking GlobalValues so that MDNodes that reference GlobalValues
   // are properly remapped.
@@ -14,13 +14,27 @@
 #include "llvm/Support/Allocator.h"
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/DataTypes.h"
+#include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/Memory.h"
+#include "llvm/Support/Mutex.h"
 #include "llvm/Support/Recycler.h"
 #include "llvm/Support/raw_ostream.h"
 #include <cstring>
 
 namespace llvm {
 
+// SlabBytesAllocated - The total size of the slabs requested by all
+// BumpPtrAllocators, for the allocation counts of -time-passes-trace.  It
+// takes a lock rather than an atomic add because cas_flag is only 32 bits
+// wide; slabs are allocated rarely enough for that not to matter.
+static uint64_t SlabBytesAllocated = 0;
+static ManagedStatic<sys::SmartMutex<true> > SlabBytesLock;
+
+static void countSlabBytes(size_t Size) {
+  sys::SmartScopedLock<true> Lock(*SlabBytesLock);
+  SlabBytesAllocated += Size;
+}
+
 BumpPtrAllocator::BumpPtrAllocator(size_t size, size_t threshold,
                                    SlabAllocator &allocator)
     : SlabSize(size), SizeThreshold(std::min(size, threshold)),
@@ -52,6 +66,7 @@ void BumpPtrAllocator::StartNewSlab() {
     SlabSize *= 2;
 
   MemSlab *NewSlab = Allocator.Allocate(SlabSize);
+  countSlabBytes(SlabSize);
   NewSlab->NextPtr = CurSlab;
   CurSlab = NewSlab;
   CurPtr = (char*)(CurSlab + 1);
@@ -115,6 +130,7 @@ void *BumpPtrAllocator::Allocate(size_t Size, size_t Alignment) {
   size_t PaddedSize = Size + sizeof(MemSlab) + Alignment - 1;
   if (PaddedSize > SizeThreshold) {
     MemSlab *NewSlab = Allocator.Allocate(PaddedSize);
+    countSlabBytes(PaddedSize);
 
     // Put the new slab after the current slab, since we are not allocating
     // into it.
@@ -136,6 +152,11 @@ void *BumpPtrAllocator::Allocate(size_t Size, size_t Alignment) {
   return Ptr;
 }
 
+uint64_t BumpPtrAllocator::getSlabBytesAllocated() {
+  sys::SmartScopedLock<true> Lock(*SlabBytesLock);
+  return SlabBytesAllocated;
+}
+
 unsigned BumpPtrAllocator::GetNumSlabs() const {
   unsigned NumSlabs = 0;
   for (MemSlab *Slab = CurSlab; Slab != 0; Slab = Slab->NextPtr) {
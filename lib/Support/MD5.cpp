@@ -0,0 +1,149 @@
+//===-- MD5.cpp - MD5 message digest --------------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the MD5 message digest as described in RFC 1321.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/MD5.h"
+#include <cstring>
+
+using namespace llvm;
+
+// The sine derived constants of each of the 64 steps.
+static const uint32_t StepConstants[64] = {
+  0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+  0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+  0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+  0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+  0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+  0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+  0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+  0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+  0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+  0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+  0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+  0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+  0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+  0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+  0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+  0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+// The rotation of each step, four per round.
+static const unsigned StepShifts[4][4] = {
+  { 7, 12, 17, 22 }, { 5, 9, 14, 20 }, { 4, 11, 16, 23 }, { 6, 10, 15, 21 }
+};
+
+static inline uint32_t rotateLeft(uint32_t X, unsigned N) {
+  return (X << N) | (X >> (32 - N));
+}
+
+static inline uint32_t readLE32(const uint8_t *P) {
+  return uint32_t(P[0]) | uint32_t(P[1]) << 8 | uint32_t(P[2]) << 16 |
+         uint32_t(P[3]) << 24;
+}
+
+static inline void writeLE32(uint8_t *P, uint32_t V) {
+  P[0] = uint8_t(V);
+  P[1] = uint8_t(V >> 8);
+  P[2] = uint8_t(V >> 16);
+  P[3] = uint8_t(V >> 24);
+}
+
+MD5::MD5()
+  : A(0x67452301), B(0xefcdab89), C(0x98badcfe), D(0x10325476), Length(0) {
+}
+
+void MD5::processBlock(const uint8_t *Block) {
+  uint32_t X[16];
+  for (unsigned i = 0; i != 16; ++i)
+    X[i] = readLE32(Block + 4 * i);
+
+  uint32_t AA = A, BB = B, CC = C, DD = D;
+  for (unsigned i = 0; i != 64; ++i) {
+    uint32_t F;
+    unsigned G;
+    switch (i / 16) {
+    case 0:  F = (BB & CC) | (~BB & DD); G = i;               break;
+    case 1:  F = (DD & BB) | (~DD & CC); G = (5 * i + 1) % 16; break;
+    case 2:  F = BB ^ CC ^ DD;           G = (3 * i + 5) % 16; break;
+    default: F = CC ^ (BB | ~DD);        G = (7 * i) % 16;     break;
+    }
+    uint32_t Next = DD;
+    DD = CC;
+    CC = BB;
+    BB += rotateLeft(AA + F + StepConstants[i] + X[G],
+                     StepShifts[i / 16][i % 4]);
+    AA = Next;
+  }
+
+  A += AA;
+  B += BB;
+  C += CC;
+  D += DD;
+}
+
+void MD5::update(ArrayRef<uint8_t> Data) {
+  const uint8_t *P = Data.data();
+  size_t Size = Data.size();
+  unsigned Used = unsigned(Length % 64);
+  Length += Size;
+
+  // Complete the block that an earlier update started.
+  if (Used) {
+    size_t Free = 64 - Used;
+    if (Size < Free) {
+      memcpy(Buffer + Used, P, Size);
+      return;
+    }
+    memcpy(Buffer + Used, P, Free);
+    processBlock(Buffer);
+    P += Free;
+    Size -= Free;
+  }
+
+  for (; Size >= 64; P += 64, Size -= 64)
+    processBlock(P);
+  memcpy(Buffer, P, Size);
+}
+
+void MD5::update(StringRef Str) {
+  update(ArrayRef<uint8_t>(reinterpret_cast<const uint8_t *>(Str.data()),
+                           Str.size()));
+}
+
+void MD5::final(MD5Result &Result) {
+  uint64_t Bits = Length * 8;
+
+  // Pad with a one bit and zeros up to 56 bytes into a block, then append
+  // the length in bits.
+  static const uint8_t Padding[64] = { 0x80 };
+  unsigned Used = unsigned(Length % 64);
+  update(ArrayRef<uint8_t>(Padding, Used < 56 ? 56 - Used : 120 - Used));
+
+  uint8_t Size[8];
+  writeLE32(Size, uint32_t(Bits));
+  writeLE32(Size + 4, uint32_t(Bits >> 32));
+  update(Size);
+
+  writeLE32(Result, A);
+  writeLE32(Result + 4, B);
+  writeLE32(Result + 8, C);
+  writeLE32(Result + 12, D);
+}
+
+void MD5::stringifyResult(const MD5Result &Result, SmallString<32> &Str) {
+  static const char Digits[] = "0123456789abcdef";
+  Str.clear();
+  for (unsigned i = 0; i != 16; ++i) {
+    Str.push_back(Digits[Result[i] >> 4]);
+    Str.push_back(Digits[Result[i] & 15]);
+  }
+}
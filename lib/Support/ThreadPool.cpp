@@ -0,0 +1,133 @@
+//===-- ThreadPool.cpp - A pool of worker threads -------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the ThreadPool class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Config/config.h"
+#include "llvm/Support/ErrorHandling.h"
+#include <deque>
+#include <utility>
+#include <vector>
+
+using namespace llvm;
+
+#if LLVM_ENABLE_THREADS != 0 && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+
+namespace llvm {
+class ThreadPoolImpl {
+public:
+  std::vector<pthread_t> Threads;
+  std::deque<std::pair<ThreadPool::TaskFn, void *> > Tasks;
+  pthread_mutex_t Lock;
+  pthread_cond_t TaskQueued;     // Signalled when Tasks grows or on shutdown.
+  pthread_cond_t TasksFinished;  // Signalled when Active drops to zero.
+  unsigned Active;               // Queued plus running tasks.
+  bool ShuttingDown;
+
+  static void *runWorker(void *Arg);
+};
+}
+
+void *ThreadPoolImpl::runWorker(void *Arg) {
+  ThreadPoolImpl *Impl = static_cast<ThreadPoolImpl *>(Arg);
+  pthread_mutex_lock(&Impl->Lock);
+  for (;;) {
+    while (Impl->Tasks.empty() && !Impl->ShuttingDown)
+      pthread_cond_wait(&Impl->TaskQueued, &Impl->Lock);
+    if (Impl->Tasks.empty())
+      break;
+
+    std::pair<ThreadPool::TaskFn, void *> Task = Impl->Tasks.front();
+    Impl->Tasks.pop_front();
+    pthread_mutex_unlock(&Impl->Lock);
+    Task.first(Task.second);
+    pthread_mutex_lock(&Impl->Lock);
+
+    if (--Impl->Active == 0)
+      pthread_cond_broadcast(&Impl->TasksFinished);
+  }
+  pthread_mutex_unlock(&Impl->Lock);
+  return 0;
+}
+
+ThreadPool::ThreadPool(unsigned NumThreads) : Impl(new ThreadPoolImpl()) {
+  pthread_mutex_init(&Impl->Lock, 0);
+  pthread_cond_init(&Impl->TaskQueued, 0);
+  pthread_cond_init(&Impl->TasksFinished, 0);
+  Impl->Active = 0;
+  Impl->ShuttingDown = false;
+
+  if (NumThreads == 0)
+    NumThreads = 1;
+  for (unsigned i = 0; i != NumThreads; ++i) {
+    pthread_t Thread;
+    if (pthread_create(&Thread, 0, ThreadPoolImpl::runWorker, Impl) != 0)
+      report_fatal_error("Unable to create a worker thread");
+    Impl->Threads.push_back(Thread);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  pthread_mutex_lock(&Impl->Lock);
+  Impl->ShuttingDown = true;
+  pthread_cond_broadcast(&Impl->TaskQueued);
+  pthread_mutex_unlock(&Impl->Lock);
+
+  for (unsigned i = 0, e = Impl->Threads.size(); i != e; ++i)
+    pthread_join(Impl->Threads[i], 0);
+
+  pthread_cond_destroy(&Impl->TasksFinished);
+  pthread_cond_destroy(&Impl->TaskQueued);
+  pthread_mutex_destroy(&Impl->Lock);
+  delete Impl;
+}
+
+void ThreadPool::async(TaskFn Fn, void *Arg) {
+  pthread_mutex_lock(&Impl->Lock);
+  Impl->Tasks.push_back(std::make_pair(Fn, Arg));
+  ++Impl->Active;
+  pthread_cond_signal(&Impl->TaskQueued);
+  pthread_mutex_unlock(&Impl->Lock);
+}
+
+void ThreadPool::wait() {
+  pthread_mutex_lock(&Impl->Lock);
+  while (Impl->Active != 0)
+    pthread_cond_wait(&Impl->TasksFinished, &Impl->Lock);
+  pthread_mutex_unlock(&Impl->Lock);
+}
+
+unsigned ThreadPool::getNumThreads() const {
+  return Impl->Threads.size();
+}
+
+#else
+// Without thread support every task runs as soon as it is queued.
+
+ThreadPool::ThreadPool(unsigned NumThreads) : Impl(0) {
+  (void)NumThreads;
+}
+
+ThreadPool::~ThreadPool() {}
+
+void ThreadPool::async(TaskFn Fn, void *Arg) {
+  Fn(Arg);
+}
+
+void ThreadPool::wait() {}
+
+unsigned ThreadPool::getNumThreads() const {
+  return 1;
+}
+
+#endif
@@ -25,6 +25,7 @@ namespace llvm {
   class DataLayout;
   class TargetLibraryInfo;
   class DbgDeclareInst;
+  class KnownBitsCache;
   class MemIntrinsic;
   class MemSetInst;
 
@@ -76,6 +77,7 @@ class LLVM_LIBRARY_VISIBILITY InstCombiner
   TargetLibraryInfo *TLI;
   bool MadeIRChange;
   LibCallSimplifier *Simplifier;
+  KnownBitsCache *KnownBits;
   bool MinimizeSize;
 public:
   /// Worklist - All of the instructions that need to be simplified.
@@ -87,7 +89,7 @@ public:
   BuilderTy *Builder;
 
   static char ID; // Pass identification, replacement for typeid
-  InstCombiner() : FunctionPass(ID), TD(0), Builder(0) {
+  InstCombiner() : FunctionPass(ID), TD(0), KnownBits(0), Builder(0) {
     MinimizeSize = false;
     initializeInstCombinerPass(*PassRegistry::getPassRegistry());
   }
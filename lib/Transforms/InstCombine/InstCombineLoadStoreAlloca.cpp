@@ -13,6 +13,7 @@
 
 #include "InstCombine.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/KnownBitsCache.h"
 #include "llvm/Analysis/Loads.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/IntrinsicInst.h"
@@ -198,8 +199,11 @@ Instruction *InstCombiner::visitAllocaInst(AllocaInst &AI) {
 
   if (TD && AI.getAllocatedType()->isSized()) {
     // If the alignment is 0 (unspecified), assign it the preferred alignment.
-    if (AI.getAlignment() == 0)
+    if (AI.getAlignment() == 0) {
       AI.setAlignment(TD->getPrefTypeAlignment(AI.getAllocatedType()));
+      if (KnownBits)
+        KnownBits->refineUsers(&AI);
+    }
 
     // Move all alloca's of zero byte objects to the entry block and merge them
     // together.  Note that we only do this for alloca's, because malloc should
@@ -238,6 +242,8 @@ Instruction *InstCombiner::visitAllocaInst(AllocaInst &AI) {
         unsigned MaxAlign = std::max(EntryAI->getAlignment(),
                                      AI.getAlignment());
         EntryAI->setAlignment(MaxAlign);
+        if (KnownBits)
+          KnownBits->refineUsers(EntryAI);
         if (AI.getType() != EntryAI->getType())
           return new BitCastInst(EntryAI, AI.getType());
         return ReplaceInstUsesWith(AI, EntryAI);
@@ -14,6 +14,7 @@
 
 
 #include "InstCombine.h"
+#include "llvm/Analysis/KnownBitsCache.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/Support/PatternMatch.h"
@@ -58,7 +59,12 @@ bool InstCombiner::SimplifyDemandedInstructionBits(Instruction &Inst) {
   Value *V = SimplifyDemandedUseBits(&Inst, DemandedMask,
                                      KnownZero, KnownOne, 0);
   if (V == 0) return false;
-  if (V == &Inst) return true;
+  if (V == &Inst) {
+    // Inst was rewritten in place; what was known about it may not hold.
+    if (KnownBits)
+      KnownBits->forget(&Inst);
+    return true;
+  }
   ReplaceInstUsesWith(Inst, V);
   return true;
 }
@@ -72,6 +78,8 @@ bool InstCombiner::SimplifyDemandedBits(Use &U, APInt DemandedMask,
   Value *NewVal = SimplifyDemandedUseBits(U.get(), DemandedMask,
                                           KnownZero, KnownOne, Depth);
   if (NewVal == 0) return false;
+  if (KnownBits && NewVal == U.get())
+    KnownBits->forget(NewVal);
   U = NewVal;
   return true;
 }
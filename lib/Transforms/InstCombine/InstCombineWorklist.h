@@ -13,6 +13,7 @@
 #define DEBUG_TYPE "instcombine"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/KnownBitsCache.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/Debug.h"
@@ -36,6 +37,10 @@ public:
   /// Add - Add the specified instruction to the worklist if it isn't already
   /// in it.
   void Add(Instruction *I) {
+    // Whoever adds I may have changed it in place, so what an active known
+    // bits cache says about it may no longer hold.
+    if (KnownBitsCache *Cache = KnownBitsCache::getActive())
+      Cache->forget(I);
     if (WorklistMap.insert(std::make_pair(I, Worklist.size())).second) {
       DEBUG(errs() << "IC: ADD: " << *I << '\n');
       Worklist.push_back(I);
@@ -37,11 +37,13 @@
 #include "llvm/Transforms/Scalar.h"
 #include "InstCombine.h"
 #include "llvm-c/Initialization.h"
+#include "llvm/ADT/OwningPtr.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringSwitch.h"
 #include "llvm/Analysis/ConstantFolding.h"
 #include "llvm/Analysis/InstructionSimplify.h"
+#include "llvm/Analysis/KnownBitsCache.h"
 #include "llvm/Analysis/MemoryBuiltins.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/IntrinsicInst.h"
@@ -71,6 +73,12 @@ static cl::opt<bool> UnsafeFPShrink("enable-double-float-shrink", cl::Hidden,
                                    cl::desc("Enable unsafe double to float "
                                             "shrinking for math lib calls"));
 
+static cl::opt<bool>
+UseKnownBitsCache("instcombine-known-bits-cache", cl::Hidden,
+                  cl::desc("Compute the known bits of the whole function once "
+                           "and keep them up to date, rather than recomputing "
+                           "them to a fixed depth on each query"));
+
 // Initialization Routines
 void llvm::initializeInstCombine(PassRegistry &Registry) {
   initializeInstCombinerPass(Registry);
@@ -2429,6 +2437,8 @@ bool InstCombiner::DoOneIteration(Function &F, unsigned Iteration) {
         InstParent->getInstList().insert(InsertPos, Result);
 
         EraseInstFromFunction(*I);
+        if (KnownBits)
+          KnownBits->update(Result);
       } else {
 #ifndef NDEBUG
         DEBUG(errs() << "IC: Mod = " << OrigI << '\n'
@@ -2442,6 +2452,8 @@ bool InstCombiner::DoOneIteration(Function &F, unsigned Iteration) {
         } else {
           Worklist.Add(I);
           Worklist.AddUsersToWorkList(*I);
+          if (KnownBits)
+            KnownBits->update(I);
         }
       }
       MadeIRChange = true;
@@ -2494,12 +2506,24 @@ bool InstCombiner::runOnFunction(Function &F) {
   // by instcombiner.
   EverMadeChange = LowerDbgDeclare(F);
 
+  // The known bits of the function are computed up front and kept up to date
+  // as instructions are rewritten.  The cache stops being used when it goes
+  // away.
+  OwningPtr<KnownBitsCache> TheKnownBits;
+  if (UseKnownBitsCache) {
+    TheKnownBits.reset(new KnownBitsCache(TD));
+    TheKnownBits->compute(F);
+    KnownBitsCache::setActive(TheKnownBits.get());
+  }
+  KnownBits = TheKnownBits.get();
+
   // Iterate while there is work to do.
   unsigned Iteration = 0;
   while (DoOneIteration(F, Iteration++))
     EverMadeChange = true;
 
   Builder = 0;
+  KnownBits = 0;
   return EverMadeChange;
 }
 
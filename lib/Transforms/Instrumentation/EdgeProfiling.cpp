@@ -74,7 +74,8 @@ bool EdgeProfiler::runOnModule(Module &M) {
     }
   }
 
-  Type *ATy = ArrayType::get(Type::getInt32Ty(M.getContext()), NumEdges);
+  Type *CounterTy = GetProfilingCounterType(M.getContext());
+  Type *ATy = ArrayType::get(CounterTy, NumEdges);
   GlobalVariable *Counters =
     new GlobalVariable(M, ATy, false, GlobalValue::InternalLinkage,
                        Constant::getNullValue(ATy), "EdgeProfCounters");
@@ -108,10 +109,15 @@ bool EdgeProfiler::runOnModule(Module &M) {
           }
         }
       }
+    FinishCountersInFunction(F, Counters);
   }
 
   // Add the initialization call to main.
-  InsertProfilingInitCall(Main, "llvm_start_edge_profiling", Counters);
+  if (CounterTy->isIntegerTy(64))
+    InsertProfilingInitCall(Main, "llvm_start_edge_profiling64", Counters,
+                            PointerType::getUnqual(CounterTy));
+  else
+    InsertProfilingInitCall(Main, "llvm_start_edge_profiling", Counters);
   return true;
 }
 
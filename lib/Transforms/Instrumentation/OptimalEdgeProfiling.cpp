@@ -20,7 +20,6 @@
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/Passes.h"
 #include "llvm/Analysis/ProfileInfo.h"
-#include "llvm/Analysis/ProfileInfoLoader.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
@@ -112,16 +111,16 @@ bool OptimalEdgeProfiler::runOnModule(Module &M) {
   // be calculated from other edge counters on reading the profile info back
   // in.
 
-  Type *Int32 = Type::getInt32Ty(M.getContext());
-  ArrayType *ATy = ArrayType::get(Int32, NumEdges);
+  Type *CounterTy = GetProfilingCounterType(M.getContext());
+  ArrayType *ATy = ArrayType::get(CounterTy, NumEdges);
   GlobalVariable *Counters =
     new GlobalVariable(M, ATy, false, GlobalValue::InternalLinkage,
                        Constant::getNullValue(ATy), "OptEdgeProfCounters");
   NumEdgesInserted = 0;
 
   std::vector<Constant*> Initializer(NumEdges);
-  Constant *Zero = ConstantInt::get(Int32, 0);
-  Constant *Uncounted = ConstantInt::get(Int32, ProfileInfoLoader::Uncounted);
+  Constant *Zero = ConstantInt::get(CounterTy, 0);
+  Constant *Uncounted = Constant::getAllOnesValue(CounterTy);
 
   // Instrument all of the edges not in MST...
   unsigned i = 0;
@@ -208,6 +207,7 @@ bool OptimalEdgeProfiler::runOnModule(Module &M) {
         }
       }
     }
+    FinishCountersInFunction(F, Counters);
   }
 
   // Check if the number of edges counted at first was the number of edges we
@@ -219,7 +219,11 @@ bool OptimalEdgeProfiler::runOnModule(Module &M) {
   Counters->setInitializer(init);
 
   // Add the initialization call to main.
-  InsertProfilingInitCall(Main, "llvm_start_opt_edge_profiling", Counters);
+  if (CounterTy->isIntegerTy(64))
+    InsertProfilingInitCall(Main, "llvm_start_opt_edge_profiling64", Counters,
+                            PointerType::getUnqual(CounterTy));
+  else
+    InsertProfilingInitCall(Main, "llvm_start_opt_edge_profiling", Counters);
   return true;
 }
 
@@ -12,14 +12,58 @@
 // to worry about *what* to insert, and these functions take care of *how* to do
 // it.
 //
+// The -profile-counter-mode option selects how counters are updated:
+//
+//   plain       32-bit counters, incremented with a load, add and store.
+//   atomic      64-bit counters, incremented with a relaxed atomicrmw add.
+//   per-thread  64-bit counters in a thread local copy of the array, which the
+//               runtime adds to the global array when the thread exits.
+//   promote     64-bit counters.  Updates inside loops are accumulated in
+//               registers and added atomically to the array on every loop
+//               exit; the other updates are atomic.
+//
+// The plain mode loses counts when threads race and wraps after 2^32 events.
+// In the promote mode the updates of loops left through exit(), longjmp or an
+// unwinding call are lost.
+//
 //===----------------------------------------------------------------------===//
 
 #include "ProfilingUtils.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Transforms/Utils/PromoteMemToReg.h"
+using namespace llvm;
+
+namespace {
+  enum CounterMode {
+    PlainCounters, AtomicCounters, PerThreadCounters, PromotedCounters
+  };
+}
+
+static cl::opt<CounterMode>
+ProfileCounterMode("profile-counter-mode", cl::init(PlainCounters),
+  cl::desc("How profiling counters are updated:"),
+  cl::values(
+    clEnumValN(PlainCounters, "plain", "32-bit load/add/store (default)"),
+    clEnumValN(AtomicCounters, "atomic", "64-bit relaxed atomic increments"),
+    clEnumValN(PerThreadCounters, "per-thread",
+               "64-bit per-thread arrays merged at thread exit"),
+    clEnumValN(PromotedCounters, "promote",
+               "64-bit, loop updates kept in registers until the loop exits"),
+    clEnumValEnd));
+
+Type *llvm::GetProfilingCounterType(LLVMContext &Context) {
+  if (ProfileCounterMode == PlainCounters)
+    return Type::getInt32Ty(Context);
+  return Type::getInt64Ty(Context);
+}
 
 void llvm::InsertProfilingInitCall(Function *MainFn, const char *FnName,
                                    GlobalValue *Array,
@@ -104,6 +148,26 @@ void llvm::InsertProfilingInitCall(Function *MainFn, const char *FnName,
   }
 }
 
+/// getThreadCounters - Return the thread local copy of CounterArray that the
+/// per-thread mode increments.
+static GlobalVariable *getThreadCounters(GlobalValue *CounterArray) {
+  Module *M = CounterArray->getParent();
+  std::string Name = CounterArray->getName().str() + ".thread";
+  if (GlobalVariable *GV = M->getNamedGlobal(Name))
+    return GV;
+  Type *ATy = CounterArray->getType()->getElementType();
+  return new GlobalVariable(*M, ATy, false, GlobalValue::InternalLinkage,
+                            Constant::getNullValue(ATy), Name, 0,
+                            GlobalVariable::GeneralDynamicTLSModel);
+}
+
+/// isCounterOf - Return true if Ptr addresses an element of CounterArray.
+static bool isCounterOf(Value *Ptr, GlobalValue *CounterArray) {
+  ConstantExpr *CE = dyn_cast<ConstantExpr>(Ptr);
+  return CE && CE->getOpcode() == Instruction::GetElementPtr &&
+         CE->getOperand(0) == CounterArray;
+}
+
 void llvm::IncrementCounterInBlock(BasicBlock *BB, unsigned CounterNum,
                                    GlobalValue *CounterArray, bool beginning) {
   // Insert the increment after any alloca or PHI instructions...
@@ -113,6 +177,13 @@ void llvm::IncrementCounterInBlock(BasicBlock *BB, unsigned CounterNum,
     ++InsertPos;
 
   LLVMContext &Context = BB->getContext();
+  Type *CounterTy =
+    cast<ArrayType>(CounterArray->getType()->getElementType())
+      ->getElementType();
+  Constant *One = ConstantInt::get(CounterTy, 1);
+
+  if (ProfileCounterMode == PerThreadCounters)
+    CounterArray = getThreadCounters(CounterArray);
 
   // Create the getelementptr constant expression
   std::vector<Constant*> Indices(2);
@@ -121,14 +192,158 @@ void llvm::IncrementCounterInBlock(BasicBlock *BB, unsigned CounterNum,
   Constant *ElementPtr =
     ConstantExpr::getGetElementPtr(CounterArray, Indices);
 
+  // Increments that the promote mode finds inside a loop are rewritten by
+  // FinishCountersInFunction.
+  if (ProfileCounterMode == AtomicCounters ||
+      ProfileCounterMode == PromotedCounters) {
+    new AtomicRMWInst(AtomicRMWInst::Add, ElementPtr, One, Monotonic,
+                      CrossThread, InsertPos);
+    return;
+  }
+
   // Load, increment and store the value back.
   Value *OldVal = new LoadInst(ElementPtr, "OldFuncCounter", InsertPos);
-  Value *NewVal = BinaryOperator::Create(Instruction::Add, OldVal,
-                                 ConstantInt::get(Type::getInt32Ty(Context), 1),
+  Value *NewVal = BinaryOperator::Create(Instruction::Add, OldVal, One,
                                          "NewFuncCounter", InsertPos);
   new StoreInst(NewVal, ElementPtr, InsertPos);
 }
 
+/// registerThreadCounters - Make the entry of F hand the calling thread's copy
+/// of CounterArray to the runtime the first time the thread gets there.
+static void registerThreadCounters(Function *F, GlobalValue *CounterArray) {
+  GlobalVariable *ThreadCounters = getThreadCounters(CounterArray);
+  bool Used = false;
+  for (Function::iterator BB = F->begin(), E = F->end(); BB != E && !Used; ++BB)
+    for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+      if (isa<StoreInst>(I) && isCounterOf(I->getOperand(1), ThreadCounters)) {
+        Used = true;
+        break;
+      }
+  if (!Used)
+    return;
+
+  Module *M = F->getParent();
+  LLVMContext &Context = F->getContext();
+  Type *Int1 = Type::getInt1Ty(Context);
+  Type *Int32 = Type::getInt32Ty(Context);
+  std::string FlagName = CounterArray->getName().str() + ".registered";
+  GlobalVariable *Registered = M->getNamedGlobal(FlagName);
+  if (!Registered)
+    Registered = new GlobalVariable(*M, Int1, false,
+                                    GlobalValue::InternalLinkage,
+                                    ConstantInt::getFalse(Context), FlagName,
+                                    0, GlobalVariable::GeneralDynamicTLSModel);
+
+  Type *CounterPtrTy = PointerType::getUnqual(
+    cast<ArrayType>(CounterArray->getType()->getElementType())
+      ->getElementType());
+  Constant *RegisterFn =
+    M->getOrInsertFunction("llvm_profile_register_thread_counters",
+                           Type::getVoidTy(Context), CounterPtrTy,
+                           CounterPtrTy, Int32, (Type *)0);
+
+  // Split the entry block after its allocas:
+  //   entry:    %r = load @Counters.registered; br %r, body, register
+  //   register: call register(@Counters.thread, @Counters, N); store true
+  BasicBlock *Entry = &F->getEntryBlock();
+  BasicBlock::iterator SplitPos = Entry->getFirstInsertionPt();
+  while (isa<AllocaInst>(SplitPos))
+    ++SplitPos;
+  BasicBlock *Body = Entry->splitBasicBlock(SplitPos, "profile.body");
+  BasicBlock *Register =
+    BasicBlock::Create(Context, "profile.register", F, Body);
+
+  Entry->getTerminator()->eraseFromParent();
+  Value *IsRegistered = new LoadInst(Registered, "profile.registered", Entry);
+  BranchInst::Create(Body, Register, IsRegistered, Entry);
+
+  std::vector<Constant*> Indices(2, Constant::getNullValue(Int32));
+  Value *Args[] = {
+    ConstantExpr::getGetElementPtr(ThreadCounters, Indices),
+    ConstantExpr::getGetElementPtr(CounterArray, Indices),
+    ConstantInt::get(Int32,
+      cast<ArrayType>(CounterArray->getType()->getElementType())
+        ->getNumElements())
+  };
+  CallInst::Create(RegisterFn, Args, "", Register);
+  new StoreInst(ConstantInt::getTrue(Context), Registered, Register);
+  BranchInst::Create(Body, Register);
+}
+
+/// promoteLoopCounters - Accumulate the increments of CounterArray inside the
+/// loops of F in locals and add them to the array on every exit of the
+/// outermost loop, which keeps the atomic updates out of the loops.
+static void promoteLoopCounters(Function *F, GlobalValue *CounterArray) {
+  DominatorTree DT;
+  DT.runOnFunction(*F);
+  LoopInfoBase<BasicBlock, Loop> LI;
+  LI.Analyze(DT.getBase());
+  if (LI.empty())
+    return;
+
+  BasicBlock::iterator AllocaPos = F->getEntryBlock().begin();
+  DenseMap<Loop*, std::vector<std::pair<AllocaInst*, Value*> > > LoopCounters;
+  std::vector<AllocaInst*> Locals;
+
+  for (Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB) {
+    Loop *L = LI.getLoopFor(BB);
+    if (!L)
+      continue;
+    while (L->getParentLoop())
+      L = L->getParentLoop();
+
+    for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ) {
+      AtomicRMWInst *RMW = dyn_cast<AtomicRMWInst>(I++);
+      if (!RMW || !isCounterOf(RMW->getPointerOperand(), CounterArray))
+        continue;
+
+      // Every counter is incremented in one block, so it needs one local.
+      Type *CounterTy = RMW->getValOperand()->getType();
+      AllocaInst *Local =
+        new AllocaInst(CounterTy, "profile.local", AllocaPos);
+      new StoreInst(Constant::getNullValue(CounterTy), Local,
+                    F->getEntryBlock().getTerminator());
+      Value *OldVal = new LoadInst(Local, "OldFuncCounter", RMW);
+      Value *NewVal = BinaryOperator::Create(Instruction::Add, OldVal,
+                                             RMW->getValOperand(),
+                                             "NewFuncCounter", RMW);
+      new StoreInst(NewVal, Local, RMW);
+      LoopCounters[L].push_back(std::make_pair(Local,
+                                               RMW->getPointerOperand()));
+      Locals.push_back(Local);
+      RMW->eraseFromParent();
+    }
+  }
+
+  // Exit blocks may also be reached from outside the loop; the locals are
+  // zero there, so the flush adds nothing.
+  for (DenseMap<Loop*, std::vector<std::pair<AllocaInst*, Value*> > >::iterator
+       I = LoopCounters.begin(), E = LoopCounters.end(); I != E; ++I) {
+    SmallVector<BasicBlock*, 8> ExitBlocks;
+    I->first->getUniqueExitBlocks(ExitBlocks);
+    for (unsigned i = 0, e = ExitBlocks.size(); i != e; ++i) {
+      BasicBlock::iterator InsertPos = ExitBlocks[i]->getFirstInsertionPt();
+      for (unsigned j = 0, je = I->second.size(); j != je; ++j) {
+        AllocaInst *Local = I->second[j].first;
+        Value *Count = new LoadInst(Local, "LoopCounter", InsertPos);
+        new AtomicRMWInst(AtomicRMWInst::Add, I->second[j].second, Count,
+                          Monotonic, CrossThread, InsertPos);
+        new StoreInst(Constant::getNullValue(Count->getType()), Local,
+                      InsertPos);
+      }
+    }
+  }
+
+  PromoteMemToReg(Locals, DT);
+}
+
+void llvm::FinishCountersInFunction(Function *F, GlobalValue *CounterArray) {
+  if (ProfileCounterMode == PerThreadCounters)
+    registerThreadCounters(F, CounterArray);
+  else if (ProfileCounterMode == PromotedCounters)
+    promoteLoopCounters(F, CounterArray);
+}
+
 void llvm::InsertProfilingShutdownCall(Function *Callee, Module *Mod) {
   // llvm.global_dtors is an array of type { i32, void ()* }. Prepare those
   // types.
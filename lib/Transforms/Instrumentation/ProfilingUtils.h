@@ -21,8 +21,14 @@ namespace llvm {
   class BasicBlock;
   class Function;
   class GlobalValue;
+  class LLVMContext;
   class Module;
   class PointerType;
+  class Type;
+
+  /// GetProfilingCounterType - The type of the counters selected by
+  /// -profile-counter-mode: i32 for plain counters, i64 otherwise.
+  Type *GetProfilingCounterType(LLVMContext &Context);
 
   void InsertProfilingInitCall(Function *MainFn, const char *FnName,
                                GlobalValue *Arr = 0,
@@ -30,6 +36,10 @@ namespace llvm {
   void IncrementCounterInBlock(BasicBlock *BB, unsigned CounterNum,
                                GlobalValue *CounterArray,
                                bool beginning = true);
+  /// FinishCountersInFunction - Called once all counters of F are inserted,
+  /// before F is changed further.  Registers the per-thread counters or
+  /// promotes the updates inside loops, depending on the counter mode.
+  void FinishCountersInFunction(Function *F, GlobalValue *CounterArray);
   void InsertProfilingShutdownCall(Function *Callee, Module *Mod);
 }
 
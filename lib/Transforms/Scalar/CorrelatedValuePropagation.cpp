@@ -13,6 +13,7 @@
 
 #define DEBUG_TYPE "correlated-value-propagation"
 #include "llvm/Transforms/Scalar.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/InstructionSimplify.h"
 #include "llvm/Analysis/LazyValueInfo.h"
@@ -95,11 +96,24 @@ bool CorrelatedValuePropagation::processPHI(PHINode *P) {
   bool Changed = false;
 
   BasicBlock *BB = P->getParent();
+
+  // Look up the incoming values on their edges all at once.
+  SmallVector<LazyValueInfo::EdgeQuery, 8> Queries;
+  for (unsigned i = 0, e = P->getNumIncomingValues(); i < e; ++i) {
+    Value *Incoming = P->getIncomingValue(i);
+    if (!isa<Constant>(Incoming))
+      Queries.push_back(LazyValueInfo::EdgeQuery(Incoming,
+                                                 P->getIncomingBlock(i), BB));
+  }
+  SmallVector<Constant*, 8> Constants;
+  LVI->getConstantsOnEdges(Queries, Constants);
+
+  unsigned NextQuery = 0;
   for (unsigned i = 0, e = P->getNumIncomingValues(); i < e; ++i) {
     Value *Incoming = P->getIncomingValue(i);
     if (isa<Constant>(Incoming)) continue;
 
-    Value *V = LVI->getConstantOnEdge(Incoming, P->getIncomingBlock(i), BB);
+    Value *V = Constants[NextQuery++];
 
     // Look if the incoming value is a select with a constant but LVI tells us
     // that the incoming value can never be that constant. In that case replace
@@ -175,13 +189,16 @@ bool CorrelatedValuePropagation::processCmp(CmpInst *C) {
                                     C->getOperand(0), Op1, *PI, C->getParent());
   if (Result == LazyValueInfo::Unknown) return false;
 
-  ++PI;
-  while (PI != PE) {
-    LazyValueInfo::Tristate Res = LVI->getPredicateOnEdge(C->getPredicate(),
-                                    C->getOperand(0), Op1, *PI, C->getParent());
-    if (Res != Result) return false;
-    ++PI;
-  }
+  // Ask about the remaining edges all at once.
+  SmallVector<LazyValueInfo::PredicateQuery, 8> Queries;
+  while (++PI != PE)
+    Queries.push_back(LazyValueInfo::PredicateQuery(C->getPredicate(),
+                                    C->getOperand(0), Op1, *PI, C->getParent()));
+  SmallVector<LazyValueInfo::Tristate, 8> Results;
+  LVI->getPredicatesOnEdges(Queries, Results);
+
+  for (unsigned i = 0, e = Results.size(); i != e; ++i)
+    if (Results[i] != Result) return false;
 
   ++NumCmps;
 
@@ -212,8 +229,15 @@ bool CorrelatedValuePropagation::processSwitch(SwitchInst *SI) {
     return false;
 
   // If the switch is unreachable then trying to improve it is a waste of time.
-  pred_iterator PB = pred_begin(BB), PE = pred_end(BB);
-  if (PB == PE) return false;
+  if (pred_begin(BB) == pred_end(BB)) return false;
+
+  // Whether the condition is equal to each case value on every incoming edge,
+  // equal/not equal being the same each time.  The cases are asked about in
+  // batches, so that LazyValueInfo works out the condition on each edge just
+  // once.  Removing a case can change the condition, so the states are asked
+  // for again after that.
+  SmallVector<LazyValueInfo::Tristate, 32> States;
+  bool StatesStale = true;
 
   // Analyse each switch case in turn.  This is done in reverse order so that
   // removing a case doesn't cause trouble for the iteration.
@@ -222,42 +246,68 @@ bool CorrelatedValuePropagation::processSwitch(SwitchInst *SI) {
        ) {
     ConstantInt *Case = CI.getCaseValue();
 
-    // Check to see if the switch condition is equal to/not equal to the case
-    // value on every incoming edge, equal/not equal being the same each time.
-    LazyValueInfo::Tristate State = LazyValueInfo::Unknown;
-    for (pred_iterator PI = PB; PI != PE; ++PI) {
-      // Is the switch condition equal to the case value?
-      LazyValueInfo::Tristate Value = LVI->getPredicateOnEdge(CmpInst::ICMP_EQ,
-                                                              Cond, Case, *PI, BB);
-      // Give up on this case if nothing is known.
-      if (Value == LazyValueInfo::Unknown) {
-        State = LazyValueInfo::Unknown;
-        break;
-      }
-
-      // If this was the first edge to be visited, record that all other edges
-      // need to give the same result.
-      if (PI == PB) {
-        State = Value;
-        continue;
-      }
-
-      // If this case is known to fire for some edges and known not to fire for
-      // others then there is nothing we can do - give up.
-      if (Value != State) {
-        State = LazyValueInfo::Unknown;
+    if (StatesStale) {
+      SmallVector<BasicBlock*, 8> Preds(pred_begin(BB), pred_end(BB));
+      if (Preds.empty())
         break;
+      unsigned NumCases = CI.getCaseIndex() + 1;
+
+      SmallVector<ConstantInt*, 32> CaseValues;
+      for (SwitchInst::CaseIt QI = SI->case_begin();
+           QI.getCaseIndex() != NumCases; ++QI)
+        CaseValues.push_back(QI.getCaseValue());
+
+      // Is the switch condition equal to the case value on the first edge?
+      SmallVector<LazyValueInfo::PredicateQuery, 32> Queries;
+      for (unsigned c = 0; c != NumCases; ++c)
+        Queries.push_back(LazyValueInfo::PredicateQuery(
+          CmpInst::ICMP_EQ, Cond, CaseValues[c], Preds[0], BB));
+      States.clear();
+      LVI->getPredicatesOnEdges(Queries, States);
+
+      // Go on an edge at a time with the cases that are still known the same
+      // way on every edge so far.  A case known to fire for some edges and
+      // known not to fire for others, or not known on some edge, is given up
+      // on.
+      SmallVector<unsigned, 32> Live;
+      for (unsigned c = 0; c != NumCases; ++c)
+        if (States[c] != LazyValueInfo::Unknown)
+          Live.push_back(c);
+      for (unsigned i = 1, e = Preds.size(); i != e && !Live.empty(); ++i) {
+        Queries.clear();
+        for (unsigned l = 0, le = Live.size(); l != le; ++l)
+          Queries.push_back(LazyValueInfo::PredicateQuery(
+            CmpInst::ICMP_EQ, Cond, CaseValues[Live[l]], Preds[i], BB));
+        SmallVector<LazyValueInfo::Tristate, 32> Answers;
+        LVI->getPredicatesOnEdges(Queries, Answers);
+
+        unsigned NumLive = 0;
+        for (unsigned l = 0, le = Live.size(); l != le; ++l) {
+          if (Answers[l] != States[Live[l]]) {
+            States[Live[l]] = LazyValueInfo::Unknown;
+            continue;
+          }
+          Live[NumLive++] = Live[l];
+        }
+        Live.resize(NumLive);
       }
+      StatesStale = false;
     }
 
+    LazyValueInfo::Tristate State = States[CI.getCaseIndex()];
+
     if (State == LazyValueInfo::False) {
       // This case never fires - remove it.
       CI.getCaseSuccessor()->removePredecessor(BB);
       SI->removeCase(CI); // Does not invalidate the iterator.
 
       // The condition can be modified by removePredecessor's PHI simplification
-      // logic.
-      Cond = SI->getCondition();
+      // logic.  The answers for the cases not yet visited, which all come
+      // before this one, only need recomputing if it was.
+      if (SI->getCondition() != Cond) {
+        Cond = SI->getCondition();
+        StatesStale = true;
+      }
 
       ++NumDeadCases;
       Changed = true;
@@ -25,6 +25,7 @@
 #include "llvm/Analysis/Dominators.h"
 #include "llvm/Analysis/MemoryBuiltins.h"
 #include "llvm/Analysis/MemoryDependenceAnalysis.h"
+#include "llvm/Analysis/MemorySSA.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DataLayout.h"
@@ -33,6 +34,7 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Target/TargetLibraryInfo.h"
 #include "llvm/Transforms/Utils/Local.h"
@@ -41,21 +43,30 @@ using namespace llvm;
 STATISTIC(NumFastStores, "Number of stores deleted");
 STATISTIC(NumFastOther , "Number of other instrs removed");
 
+static cl::opt<bool>
+EnableMemorySSA("enable-dse-memoryssa", cl::init(false), cl::Hidden,
+                cl::desc("Find the writes a store overwrites with MemorySSA "
+                         "rather than MemoryDependenceAnalysis"));
+
 namespace {
   struct DSE : public FunctionPass {
     AliasAnalysis *AA;
     MemoryDependenceAnalysis *MD;
+    MemorySSA *MSSA;
     DominatorTree *DT;
     const TargetLibraryInfo *TLI;
 
     static char ID; // Pass identification, replacement for typeid
-    DSE() : FunctionPass(ID), AA(0), MD(0), DT(0) {
+    DSE() : FunctionPass(ID), AA(0), MD(0), MSSA(0), DT(0) {
       initializeDSEPass(*PassRegistry::getPassRegistry());
     }
 
     virtual bool runOnFunction(Function &F) {
       AA = &getAnalysis<AliasAnalysis>();
-      MD = &getAnalysis<MemoryDependenceAnalysis>();
+      if (EnableMemorySSA)
+        MSSA = &getAnalysis<MemorySSA>();
+      else
+        MD = &getAnalysis<MemoryDependenceAnalysis>();
       DT = &getAnalysis<DominatorTree>();
       TLI = AA->getTargetLibraryInfo();
 
@@ -66,13 +77,20 @@ namespace {
         if (DT->isReachableFromEntry(I))
           Changed |= runOnBasicBlock(*I);
 
-      AA = 0; MD = 0; DT = 0;
+      AA = 0; MD = 0; MSSA = 0; DT = 0;
       return Changed;
     }
 
     bool runOnBasicBlock(BasicBlock &BB);
     bool HandleFree(CallInst *F);
     bool handleEndBlock(BasicBlock &BB);
+    MemDepResult getDependencyFromMemorySSA(const AliasAnalysis::Location &Loc,
+                                            Instruction *ScanPt,
+                                            BasicBlock *BB);
+    Instruction *findReadInBlock(MemoryAccess *Def,
+                                 const AliasAnalysis::Location &Loc,
+                                 BasicBlock *BB);
+    LoadInst *getLoadOfStoredValue(StoreInst *SI);
     void RemoveAccessedObjects(const AliasAnalysis::Location &LoadedLoc,
                                SmallSetVector<Value*, 16> &DeadStackObjects);
 
@@ -80,7 +98,10 @@ namespace {
       AU.setPreservesCFG();
       AU.addRequired<DominatorTree>();
       AU.addRequired<AliasAnalysis>();
-      AU.addRequired<MemoryDependenceAnalysis>();
+      if (EnableMemorySSA)
+        AU.addRequired<MemorySSA>();
+      else
+        AU.addRequired<MemoryDependenceAnalysis>();
       AU.addPreserved<AliasAnalysis>();
       AU.addPreserved<DominatorTree>();
       AU.addPreserved<MemoryDependenceAnalysis>();
@@ -92,6 +113,7 @@ char DSE::ID = 0;
 INITIALIZE_PASS_BEGIN(DSE, "dse", "Dead Store Elimination", false, false)
 INITIALIZE_PASS_DEPENDENCY(DominatorTree)
 INITIALIZE_PASS_DEPENDENCY(MemoryDependenceAnalysis)
+INITIALIZE_PASS_DEPENDENCY(MemorySSA)
 INITIALIZE_AG_DEPENDENCY(AliasAnalysis)
 INITIALIZE_PASS_END(DSE, "dse", "Dead Store Elimination", false, false)
 
@@ -106,9 +128,11 @@ FunctionPass *llvm::createDeadStoreEliminationPass() { return new DSE(); }
 /// dead, delete them and the computation tree that feeds them.
 ///
 /// If ValueSet is non-null, remove any deleted instructions from it as well.
+/// Exactly one of MD and MSSA is non-null.
 ///
 static void DeleteDeadInstruction(Instruction *I,
-                                  MemoryDependenceAnalysis &MD,
+                                  MemoryDependenceAnalysis *MD,
+                                  MemorySSA *MSSA,
                                   const TargetLibraryInfo *TLI,
                                   SmallSetVector<Value*, 16> *ValueSet = 0) {
   SmallVector<Instruction*, 32> NowDeadInsts;
@@ -122,9 +146,12 @@ static void DeleteDeadInstruction(Instruction *I,
     ++NumFastOther;
 
     // This instruction is dead, zap it, in stages.  Start by removing it from
-    // MemDep, which needs to know the operands and needs it to be in the
-    // function.
-    MD.removeInstruction(DeadInst);
+    // MemDep or MemorySSA, which need to know the operands and need it to be
+    // in the function.
+    if (MD)
+      MD->removeInstruction(DeadInst);
+    else
+      MSSA->removeMemoryAccess(DeadInst);
 
     for (unsigned op = 0, e = DeadInst->getNumOperands(); op != e; ++op) {
       Value *Op = DeadInst->getOperand(op);
@@ -505,7 +532,21 @@ bool DSE::runOnBasicBlock(BasicBlock &BB) {
     if (!hasMemoryWrite(Inst, TLI))
       continue;
 
-    MemDepResult InstDep = MD->getDependency(Inst);
+    // Figure out what location is being stored to.
+    AliasAnalysis::Location Loc = getLocForWrite(Inst, *AA);
+
+    // If we didn't get a useful location, fail.
+    if (Loc.Ptr == 0)
+      continue;
+
+    // A volatile store, or an atomic one stronger than monotonic, does not
+    // kill the stores above it; MemDep reports no dependency for one.
+    if (StoreInst *SI = dyn_cast<StoreInst>(Inst))
+      if (!SI->isUnordered() && SI->getOrdering() != Monotonic)
+        continue;
+
+    MemDepResult InstDep = MSSA ? getDependencyFromMemorySSA(Loc, Inst, &BB)
+                                : MD->getDependency(Inst);
 
     // Ignore any store where we can't find a local dependence.
     // FIXME: cross-block DSE would be fun. :)
@@ -515,7 +556,9 @@ bool DSE::runOnBasicBlock(BasicBlock &BB) {
     // If we're storing the same value back to a pointer that we just
     // loaded from, then the store can be removed.
     if (StoreInst *SI = dyn_cast<StoreInst>(Inst)) {
-      if (LoadInst *DepLoad = dyn_cast<LoadInst>(InstDep.getInst())) {
+      LoadInst *DepLoad = MSSA ? getLoadOfStoredValue(SI)
+                               : dyn_cast<LoadInst>(InstDep.getInst());
+      if (DepLoad) {
         if (SI->getPointerOperand() == DepLoad->getPointerOperand() &&
             SI->getOperand(0) == DepLoad && isRemovable(SI)) {
           DEBUG(dbgs() << "DSE: Remove Store Of Load from same pointer:\n  "
@@ -525,7 +568,7 @@ bool DSE::runOnBasicBlock(BasicBlock &BB) {
           // in case we need it.
           WeakVH NextInst(BBI);
 
-          DeleteDeadInstruction(SI, *MD, TLI);
+          DeleteDeadInstruction(SI, MD, MSSA, TLI);
 
           if (NextInst == 0)  // Next instruction deleted.
             BBI = BB.begin();
@@ -538,13 +581,6 @@ bool DSE::runOnBasicBlock(BasicBlock &BB) {
       }
     }
 
-    // Figure out what location is being stored to.
-    AliasAnalysis::Location Loc = getLocForWrite(Inst, *AA);
-
-    // If we didn't get a useful location, fail.
-    if (Loc.Ptr == 0)
-      continue;
-
     while (InstDep.isDef() || InstDep.isClobber()) {
       // Get the memory clobbered by the instruction we depend on.  MemDep will
       // skip any instructions that 'Loc' clearly doesn't interact with.  If we
@@ -572,7 +608,7 @@ bool DSE::runOnBasicBlock(BasicBlock &BB) {
                 << *DepWrite << "\n  KILLER: " << *Inst << '\n');
 
           // Delete the store and now-dead instructions that feed it.
-          DeleteDeadInstruction(DepWrite, *MD, TLI);
+          DeleteDeadInstruction(DepWrite, MD, MSSA, TLI);
           ++NumFastStores;
           MadeChange = true;
 
@@ -624,7 +660,8 @@ bool DSE::runOnBasicBlock(BasicBlock &BB) {
       if (AA->getModRefInfo(DepWrite, Loc) & AliasAnalysis::Ref)
         break;
 
-      InstDep = MD->getPointerDependencyFrom(Loc, false, DepWrite, &BB);
+      InstDep = MSSA ? getDependencyFromMemorySSA(Loc, DepWrite, &BB)
+                     : MD->getPointerDependencyFrom(Loc, false, DepWrite, &BB);
     }
   }
 
@@ -636,6 +673,87 @@ bool DSE::runOnBasicBlock(BasicBlock &BB) {
   return MadeChange;
 }
 
+/// getDependencyFromMemorySSA - The MemorySSA version of MemDep's
+/// getPointerDependencyFrom: return the closest instruction above ScanPt in
+/// BB that may read or write Loc as a clobber, or non-local if there is none.
+/// Only the defs of BB and the reads between them are looked at, by walking
+/// up the def chain rather than over every instruction.
+MemDepResult
+DSE::getDependencyFromMemorySSA(const AliasAnalysis::Location &Loc,
+                                Instruction *ScanPt, BasicBlock *BB) {
+  // Find the def above ScanPt.  The reads between that def and a def at
+  // ScanPt are the users of the former; otherwise scan back to it.
+  MemoryAccess *Cur = 0;
+  MemoryUseOrDef *Access = MSSA->getMemoryAccess(ScanPt);
+  if (Access && isa<MemoryDef>(Access)) {
+    Cur = Access->getDefiningAccess();
+    if (Instruction *Read = findReadInBlock(Cur, Loc, BB))
+      return MemDepResult::getClobber(Read);
+  } else {
+    for (BasicBlock::iterator I = ScanPt; !Cur; ) {
+      if (I == BB->begin())
+        return MemDepResult::getNonLocal();
+      Access = MSSA->getMemoryAccess(--I);
+      if (!Access)
+        continue;
+      if (isa<MemoryDef>(Access))
+        Cur = Access;
+      else if (AA->getModRefInfo(I, Loc) & AliasAnalysis::Ref)
+        return MemDepResult::getClobber(I);
+    }
+  }
+
+  while (MemoryDef *Def = dyn_cast<MemoryDef>(Cur)) {
+    if (Def->getBlock() != BB)
+      break;
+    Instruction *DefInst = Def->getMemoryInst();
+    if (AA->getModRefInfo(DefInst, Loc) != AliasAnalysis::NoModRef)
+      return MemDepResult::getClobber(DefInst);
+    Cur = Def->getDefiningAccess();
+    if (Instruction *Read = findReadInBlock(Cur, Loc, BB))
+      return MemDepResult::getClobber(Read);
+  }
+  return MemDepResult::getNonLocal();
+}
+
+/// findReadInBlock - Return an instruction of BB that reads the memory state
+/// Def defines and may read Loc, if there is one.  These are the reads
+/// between Def and the next def of BB, or the start of BB if Def is not in
+/// it.
+Instruction *DSE::findReadInBlock(MemoryAccess *Def,
+                                  const AliasAnalysis::Location &Loc,
+                                  BasicBlock *BB) {
+  for (MemoryAccess::user_iterator UI = Def->user_begin(),
+       UE = Def->user_end(); UI != UE; ++UI) {
+    MemoryUse *Use = dyn_cast<MemoryUse>(*UI);
+    if (Use && Use->getBlock() == BB &&
+        (AA->getModRefInfo(Use->getMemoryInst(), Loc) & AliasAnalysis::Ref))
+      return Use->getMemoryInst();
+  }
+  return 0;
+}
+
+/// getLoadOfStoredValue - Return the load SI stores the value of, if it is in
+/// the same block and nothing between the two may write the location.
+/// MemorySSA does not order the reads between two defs, so this stands in for
+/// MemDep finding the load as the dependency of SI.
+LoadInst *DSE::getLoadOfStoredValue(StoreInst *SI) {
+  LoadInst *LI = dyn_cast<LoadInst>(SI->getValueOperand());
+  if (!LI || LI->getParent() != SI->getParent())
+    return 0;
+  MemoryUseOrDef *LoadAccess = MSSA->getMemoryAccess(LI);
+  if (!LoadAccess)
+    return 0;
+  // A volatile or atomic load is a def of its own, but writes nothing.
+  MemoryAccess *Seen = LoadAccess;
+  if (isa<MemoryUse>(LoadAccess))
+    Seen = LoadAccess->getDefiningAccess();
+  // Nothing between that state and SI may write the stored location.
+  if (Seen != MSSA->getClobberingMemoryAccess(SI))
+    return 0;
+  return LI;
+}
+
 /// Find all blocks that will unconditionally lead to the block BB and append
 /// them to F.
 static void FindUnconditionalPreds(SmallVectorImpl<BasicBlock *> &Blocks,
@@ -666,7 +784,9 @@ bool DSE::HandleFree(CallInst *F) {
     Instruction *InstPt = BB->getTerminator();
     if (BB == F->getParent()) InstPt = F;
 
-    MemDepResult Dep = MD->getPointerDependencyFrom(Loc, false, InstPt, BB);
+    MemDepResult Dep =
+      MSSA ? getDependencyFromMemorySSA(Loc, InstPt, BB)
+           : MD->getPointerDependencyFrom(Loc, false, InstPt, BB);
     while (Dep.isDef() || Dep.isClobber()) {
       Instruction *Dependency = Dep.getInst();
       if (!hasMemoryWrite(Dependency, TLI) || !isRemovable(Dependency))
@@ -682,7 +802,7 @@ bool DSE::HandleFree(CallInst *F) {
       Instruction *Next = llvm::next(BasicBlock::iterator(Dependency));
 
       // DCE instructions only used to calculate that store
-      DeleteDeadInstruction(Dependency, *MD, TLI);
+      DeleteDeadInstruction(Dependency, MD, MSSA, TLI);
       ++NumFastStores;
       MadeChange = true;
 
@@ -691,7 +811,9 @@ bool DSE::HandleFree(CallInst *F) {
       //    s[0] = 0;
       //    s[1] = 0; // This has just been deleted.
       //    free(s);
-      Dep = MD->getPointerDependencyFrom(Loc, false, Next, BB);
+      // MemorySSA has forgotten the store, so it can start over from InstPt.
+      Dep = MSSA ? getDependencyFromMemorySSA(Loc, InstPt, BB)
+                 : MD->getPointerDependencyFrom(Loc, false, Next, BB);
     }
 
     if (Dep.isNonLocal())
@@ -782,7 +904,7 @@ bool DSE::handleEndBlock(BasicBlock &BB) {
               dbgs() << '\n');
 
         // DCE instructions only used to calculate that store.
-        DeleteDeadInstruction(Dead, *MD, TLI, &DeadStackObjects);
+        DeleteDeadInstruction(Dead, MD, MSSA, TLI, &DeadStackObjects);
         ++NumFastStores;
         MadeChange = true;
         continue;
@@ -792,7 +914,7 @@ bool DSE::handleEndBlock(BasicBlock &BB) {
     // Remove any dead non-memory-mutating instructions.
     if (isInstructionTriviallyDead(BBI, TLI)) {
       Instruction *Inst = BBI++;
-      DeleteDeadInstruction(Inst, *MD, TLI, &DeadStackObjects);
+      DeleteDeadInstruction(Inst, MD, MSSA, TLI, &DeadStackObjects);
       ++NumFastOther;
       MadeChange = true;
       continue;
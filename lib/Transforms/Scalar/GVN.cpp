@@ -29,6 +29,7 @@
 #include "llvm/Analysis/Loads.h"
 #include "llvm/Analysis/MemoryBuiltins.h"
 #include "llvm/Analysis/MemoryDependenceAnalysis.h"
+#include "llvm/Analysis/MemorySSA.h"
 #include "llvm/Analysis/PHITransAddr.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/Assembly/Writer.h"
@@ -59,6 +60,10 @@ STATISTIC(NumPRELoad,   "Number of loads PRE'd");
 static cl::opt<bool> EnablePRE("enable-pre",
                                cl::init(true), cl::Hidden);
 static cl::opt<bool> EnableLoadPRE("enable-load-pre", cl::init(true));
+static cl::opt<bool>
+EnableMemorySSA("enable-gvn-memoryssa", cl::init(false), cl::Hidden,
+                cl::desc("Find the values of loads with MemorySSA rather than "
+                         "MemoryDependenceAnalysis"));
 
 // Maximum allowed recursion depth.
 static cl::opt<uint32_t>
@@ -571,6 +576,7 @@ namespace {
   class GVN : public FunctionPass {
     bool NoLoads;
     MemoryDependenceAnalysis *MD;
+    MemorySSA *MSSA;
     DominatorTree *DT;
     const DataLayout *TD;
     const TargetLibraryInfo *TLI;
@@ -589,6 +595,13 @@ namespace {
 
     SmallVector<Instruction*, 8> InstrsToErase;
 
+    /// LoadsByClobber - With MemorySSA, the last few loads seen from each
+    /// underlying object after each clobbering access.  A later load with the
+    /// same clobber that one of them dominates reads memory nothing has
+    /// written since.
+    typedef std::pair<MemoryAccess*, Value*> ClobberKey;
+    DenseMap<ClobberKey, SmallVector<LoadInst*, 4> > LoadsByClobber;
+
     typedef SmallVector<NonLocalDepResult, 64> LoadDepVect;
     typedef SmallVector<AvailableValueInBlock, 64> AvailValInBlkVect;
     typedef SmallVector<BasicBlock*, 64> UnavailBlkVect;
@@ -596,7 +609,7 @@ namespace {
   public:
     static char ID; // Pass identification, replacement for typeid
     explicit GVN(bool noloads = false)
-        : FunctionPass(ID), NoLoads(noloads), MD(0) {
+        : FunctionPass(ID), NoLoads(noloads), MD(0), MSSA(0) {
       initializeGVNPass(*PassRegistry::getPassRegistry());
     }
 
@@ -666,6 +679,8 @@ namespace {
       AU.addRequired<TargetLibraryInfo>();
       if (!NoLoads)
         AU.addRequired<MemoryDependenceAnalysis>();
+      if (!NoLoads && EnableMemorySSA)
+        AU.addRequired<MemorySSA>();
       AU.addRequired<AliasAnalysis>();
 
       AU.addPreserved<DominatorTree>();
@@ -675,6 +690,8 @@ namespace {
 
     // Helper fuctions of redundant load elimination 
     bool processLoad(LoadInst *L);
+    MemDepResult getDependencyFromMemorySSA(LoadInst *L);
+    void rememberLoad(LoadInst *L);
     bool processNonLocalLoad(LoadInst *L);
     void AnalyzeLoadAvailability(LoadInst *LI, LoadDepVect &Deps, 
                                  AvailValInBlkVect &ValuesPerBlock,
@@ -707,6 +724,7 @@ FunctionPass *llvm::createGVNPass(bool NoLoads) {
 
 INITIALIZE_PASS_BEGIN(GVN, "gvn", "Global Value Numbering", false, false)
 INITIALIZE_PASS_DEPENDENCY(MemoryDependenceAnalysis)
+INITIALIZE_PASS_DEPENDENCY(MemorySSA)
 INITIALIZE_PASS_DEPENDENCY(DominatorTree)
 INITIALIZE_PASS_DEPENDENCY(TargetLibraryInfo)
 INITIALIZE_AG_DEPENDENCY(AliasAnalysis)
@@ -1777,7 +1795,8 @@ bool GVN::processLoad(LoadInst *L) {
   }
 
   // ... to a pointer that has been loaded from before...
-  MemDepResult Dep = MD->getDependency(L);
+  MemDepResult Dep = MSSA ? getDependencyFromMemorySSA(L)
+                          : MD->getDependency(L);
 
   // If we have a clobber and target data is around, see if this is a clobber
   // that we can fix up through code synthesis.
@@ -1952,6 +1971,92 @@ bool GVN::processLoad(LoadInst *L) {
   return false;
 }
 
+/// getDependencyFromMemorySSA - Answer the MemDep query for L from MemorySSA.
+/// The clobbering access of L is reported the way MemDep would report the
+/// instruction.  An earlier load with the same clobber that dominates L is a
+/// def if it must alias L, or a clobber if it is in the block of L and could
+/// be widened to cover L.  Like MemDep, a clobber that cannot give L its
+/// value is only reported if it is in the block of L; otherwise the answer is
+/// non-local, and processNonLocalLoad asks MemDep about the predecessors for
+/// load PRE.  Loads made after MemorySSA was built have no access and ask
+/// MemDep too.
+MemDepResult GVN::getDependencyFromMemorySSA(LoadInst *L) {
+  MemoryAccess *Clobber = MSSA->getClobberingMemoryAccess(L);
+  if (!Clobber)
+    return MD->getDependency(L);
+
+  AliasAnalysis *AA = getAliasAnalysis();
+  AliasAnalysis::Location Loc = AA->getLocation(L);
+  Value *Ptr = L->getPointerOperand();
+  Value *Object = GetUnderlyingObject(Ptr, TD);
+  BasicBlock *BB = L->getParent();
+
+  DenseMap<ClobberKey, SmallVector<LoadInst*, 4> >::iterator It =
+    LoadsByClobber.find(std::make_pair(Clobber, Object));
+  if (It != LoadsByClobber.end()) {
+    SmallVectorImpl<LoadInst*> &Loads = It->second;
+    int64_t Offset = 0;
+    Value *Base = TD ? GetPointerBaseWithConstantOffset(Ptr, Offset, TD) : 0;
+    for (unsigned i = Loads.size(); i != 0; --i) {
+      LoadInst *Prev = Loads[i - 1];
+      if (!DT->dominates(Prev, L))
+        continue;
+      AliasAnalysis::AliasResult R = AA->alias(AA->getLocation(Prev), Loc);
+      if (R == AliasAnalysis::MustAlias)
+        return MemDepResult::getDef(Prev);
+      // The over-aligned integer loads MemDep offers GVN to widen.
+      IntegerType *ITy = dyn_cast<IntegerType>(Prev->getType());
+      if (R == AliasAnalysis::NoAlias && Base && Prev->getParent() == BB &&
+          ITy && Prev->getAlignment() * 8 > ITy->getPrimitiveSizeInBits() &&
+          MemoryDependenceAnalysis::getLoadLoadClobberFullWidthSize(
+            Base, Offset, Loc.Size, Prev, *TD))
+        return MemDepResult::getClobber(Prev);
+    }
+  }
+
+  // Nothing in the function writes the location.  If it is in an alloca, the
+  // load reads the fresh allocation.
+  if (MSSA->isLiveOnEntryDef(Clobber))
+    if (AllocaInst *AI = dyn_cast<AllocaInst>(Object))
+      return MemDepResult::getDef(AI);
+
+  MemoryDef *Def = dyn_cast<MemoryDef>(Clobber);
+  if (Instruction *DepInst = Def ? Def->getMemoryInst() : 0) {
+    if (StoreInst *SI = dyn_cast<StoreInst>(DepInst))
+      if (AA->alias(AA->getLocation(SI), Loc) == AliasAnalysis::MustAlias)
+        return MemDepResult::getDef(SI);
+    if (isNoAliasFn(DepInst, TLI) && Object == DepInst)
+      return MemDepResult::getDef(DepInst);
+    if (IntrinsicInst *II = dyn_cast<IntrinsicInst>(DepInst))
+      if (II->getIntrinsicID() == Intrinsic::lifetime_start &&
+          AA->isMustAlias(II->getArgOperand(1), Ptr))
+        return MemDepResult::getDef(II);
+    if (DepInst->getParent() == BB)
+      return MemDepResult::getClobber(DepInst);
+  }
+
+  if (BB == &BB->getParent()->getEntryBlock())
+    return MemDepResult::getNonFuncLocal();
+  return MemDepResult::getNonLocal();
+}
+
+/// rememberLoad - Add L to the loads that later loads from its underlying
+/// object with the same clobbering access may reuse.  Only the last few are
+/// kept, which bounds the alias queries a load makes.
+void GVN::rememberLoad(LoadInst *L) {
+  if (!L->isUnordered())
+    return;
+  MemoryAccess *Clobber = MSSA->getClobberingMemoryAccess(L);
+  if (!Clobber)
+    return;
+  Value *Object = GetUnderlyingObject(L->getPointerOperand(), TD);
+  SmallVectorImpl<LoadInst*> &Loads =
+    LoadsByClobber[std::make_pair(Clobber, Object)];
+  if (Loads.size() == 4)
+    Loads.erase(Loads.begin());
+  Loads.push_back(L);
+}
+
 // findLeader - In order to find a leader for a given value number at a
 // specific basic block, we first obtain the list of all Values for that number,
 // and then scan the list to find one whose block dominates the block in
@@ -2172,6 +2277,8 @@ bool GVN::processInstruction(Instruction *I) {
   if (LoadInst *LI = dyn_cast<LoadInst>(I)) {
     if (processLoad(LI))
       return true;
+    if (MSSA)
+      rememberLoad(LI);
 
     unsigned Num = VN.lookup_or_add(LI);
     addToLeaderTable(Num, LI, LI->getParent());
@@ -2272,6 +2379,7 @@ bool GVN::processInstruction(Instruction *I) {
 bool GVN::runOnFunction(Function& F) {
   if (!NoLoads)
     MD = &getAnalysis<MemoryDependenceAnalysis>();
+  MSSA = !NoLoads && EnableMemorySSA ? &getAnalysis<MemorySSA>() : 0;
   DT = &getAnalysis<DominatorTree>();
   TD = getAnalysisIfAvailable<DataLayout>();
   TLI = &getAnalysis<TargetLibraryInfo>();
@@ -2348,6 +2456,7 @@ bool GVN::processBlock(BasicBlock *BB) {
          E = InstrsToErase.end(); I != E; ++I) {
       DEBUG(dbgs() << "GVN removed: " << **I << '\n');
       if (MD) MD->removeInstruction(*I);
+      if (MSSA) MSSA->removeMemoryAccess(*I);
       DEBUG(verifyRemoved(*I));
       (*I)->eraseFromParent();
     }
@@ -2581,6 +2690,7 @@ void GVN::cleanupGlobalSets() {
   VN.clear();
   LeaderTable.clear();
   TableAllocator.Reset();
+  LoadsByClobber.clear();
 }
 
 /// verifyRemoved - Verify that the specified instruction does not occur in our
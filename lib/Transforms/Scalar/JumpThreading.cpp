@@ -361,13 +361,17 @@ ComputeValueKnownInPredecessors(Value *V, BasicBlock *BB, PredValueInfo &Result,
     // "X < 4" and "X < 3" is known true but "X < 4" itself is not available.
     // Perhaps getConstantOnEdge should be smart enough to do this?
 
-    for (pred_iterator PI = pred_begin(BB), E = pred_end(BB); PI != E; ++PI) {
-      BasicBlock *P = *PI;
+    SmallVector<LazyValueInfo::EdgeQuery, 8> Queries;
+    for (pred_iterator PI = pred_begin(BB), E = pred_end(BB); PI != E; ++PI)
+      Queries.push_back(LazyValueInfo::EdgeQuery(V, *PI, BB));
+    SmallVector<Constant*, 8> PredCsts;
+    LVI->getConstantsOnEdges(Queries, PredCsts);
+
+    for (unsigned i = 0, e = Queries.size(); i != e; ++i) {
       // If the value is known by LazyValueInfo to be a constant in a
       // predecessor, use that information to try to thread this block.
-      Constant *PredCst = LVI->getConstantOnEdge(V, P, BB);
-      if (Constant *KC = getKnownConstant(PredCst, Preference))
-        Result.push_back(std::make_pair(KC, P));
+      if (Constant *KC = getKnownConstant(PredCsts[i], Preference))
+        Result.push_back(std::make_pair(KC, Queries[i].FromBB));
     }
 
     return !Result.empty();
@@ -516,18 +520,22 @@ ComputeValueKnownInPredecessors(Value *V, BasicBlock *BB, PredValueInfo &Result,
           cast<Instruction>(Cmp->getOperand(0))->getParent() != BB) {
         Constant *RHSCst = cast<Constant>(Cmp->getOperand(1));
 
-        for (pred_iterator PI = pred_begin(BB), E = pred_end(BB);PI != E; ++PI){
-          BasicBlock *P = *PI;
+        SmallVector<LazyValueInfo::PredicateQuery, 8> Queries;
+        for (pred_iterator PI = pred_begin(BB), E = pred_end(BB);PI != E; ++PI)
+          Queries.push_back(LazyValueInfo::PredicateQuery(Cmp->getPredicate(),
+                              Cmp->getOperand(0), RHSCst, *PI, BB));
+        SmallVector<LazyValueInfo::Tristate, 8> Results;
+        LVI->getPredicatesOnEdges(Queries, Results);
+
+        for (unsigned i = 0, e = Queries.size(); i != e; ++i) {
           // If the value is known by LazyValueInfo to be a constant in a
           // predecessor, use that information to try to thread this block.
-          LazyValueInfo::Tristate Res =
-            LVI->getPredicateOnEdge(Cmp->getPredicate(), Cmp->getOperand(0),
-                                    RHSCst, P, BB);
+          LazyValueInfo::Tristate Res = Results[i];
           if (Res == LazyValueInfo::Unknown)
             continue;
 
           Constant *ResC = ConstantInt::get(Cmp->getType(), Res);
-          Result.push_back(std::make_pair(ResC, P));
+          Result.push_back(std::make_pair(ResC, Queries[i].FromBB));
         }
 
         return !Result.empty();
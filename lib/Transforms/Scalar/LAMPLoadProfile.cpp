@@ -1,6 +1,7 @@
-
+#define DEBUG_TYPE "lamp-load-profile"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
+#include "llvm/Analysis/LAMPProfileReader.h"
 #include "llvm/Analysis/Passes.h"
 #include "llvm/Analysis/LoopPass.h"
 #include "llvm/Analysis/LoopInfo.h"
@@ -8,29 +9,22 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/BasicBlock.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/IR/DataLayout.h" //#include "llvm/Target/TargetData.h"
-#include "llvm/ADT/IndexedMap.h"
-#include <map>
-#include <sstream>
-#include <fstream>
-#include <iostream>
+#include "llvm/ADT/DenseMap.h"
 #include <string>
-#include <sys/stat.h>
 #include "LAMP/LAMPLoadProfile.h"
 
 using namespace llvm;
 
-static std::map<unsigned int, BasicBlock*> IdToLoopMap_global;
-static std::map<BasicBlock*, unsigned int> LoopToIdMap_global;
+static DenseMap<unsigned int, BasicBlock*> IdToLoopMap_global;
+static DenseMap<BasicBlock*, unsigned int> LoopToIdMap_global;
 
-inline unsigned int str_to_int(std::string& s)
-{
-	std::istringstream iss(s);
-	unsigned int t;
-	iss >> t;
-	return t;	
-}
+static cl::opt<std::string>
+LAMPProfileFile("lamp-profile-file", cl::init("result.lamp.profile"),
+                cl::value_desc("filename"),
+                cl::desc("LAMP dependence profile to load (binary or text)"));
 
 namespace {
   class LdStCallCounter : public ModulePass {
@@ -134,14 +128,13 @@ void LAMPLoadProfile::getAnalysisUsage(AnalysisUsage &AU) const {
 }
 
 char LAMPLoadProfile::ID = 0;
-unsigned int LAMPLoadProfile::lamp_id = -1;
 static RegisterPass<LAMPLoadProfile> Z("lamp-load-profile","Load back profile data and generate dependency information");
 
 bool LAMPLoadProfile::runOnModule(Module& M)
 {
-	IdToLoopMap.insert(IdToLoopMap_global.begin(), IdToLoopMap_global.end());
-	LoopToIdMap.insert(LoopToIdMap_global.begin(), LoopToIdMap_global.end());
-  // build the <IDs, Instrucion> map
+	IdToLoopMap = IdToLoopMap_global;
+	LoopToIdMap = LoopToIdMap_global;
+  // build the <IDs, Instrucion> map; ids are assigned densely from 0
 	for (Module::iterator FB = M.begin(), FE = M.end(); FB != FE; FB++){
   			// for all blocks in the function
 		if (!FB->isDeclaration())
@@ -149,137 +142,94 @@ bool LAMPLoadProfile::runOnModule(Module& M)
 		{		// for all instructions in a block
 			for (BasicBlock::iterator IB = BBB->begin(), IE = BBB->end(); IB != IE; IB++)
 			{
-				if (isa<LoadInst>(IB) || isa<StoreInst>(IB)){ // count loads, stores, calls
-					IdToInstMap[++lamp_id]=IB;
-					InstToIdMap[IB]=lamp_id;
-				}
-				else if (isa<CallInst>(IB) && ( (dyn_cast<CallInst>(IB)->getCalledFunction() == NULL) || 
-							(dyn_cast<CallInst>(IB)->getCalledFunction()->isDeclaration()))){
-					IdToInstMap[++lamp_id]=IB;
-					InstToIdMap[IB]=lamp_id;
+				if (isa<LoadInst>(IB) || isa<StoreInst>(IB) ||
+				    (isa<CallInst>(IB) && ( (dyn_cast<CallInst>(IB)->getCalledFunction() == NULL) || 
+							(dyn_cast<CallInst>(IB)->getCalledFunction()->isDeclaration())))){
+					InstToIdMap[IB] = IdToInstMap.size();
+					IdToInstMap.push_back(IB);
 				}
 			}
 		}
 	}
-	std::ifstream ifs;
-	struct stat sInfo;
-
-	if(stat("result.lamp.profile", &sInfo ) !=0){    // need to add file name
-		std::cerr << "Could not find file result.lamp.profile\n";
+	std::string ErrMsg;
+	OwningPtr<LAMPProfileReader> Reader(
+		LAMPProfileReader::Create(LAMPProfileFile, ErrMsg));
+	if (!Reader) {
+		errs() << ErrMsg << "\n";
 		return false;
 	}
-//    try{
-		ifs.open("result.lamp.profile");
-		//llvm::errs() << "Opened result.lamp.profile\n";
-//    }catch (...){
-//        std::cerr << "Could not find file result.lamp.profile\n";
-//        return false;
-//    }
-	std::string s;
-	// discard the first three strings ("BEGIN" "Memory" "Profile")
-	ifs >> s; ifs >> s; ifs >> s;
 
-	unsigned int num_cnt = 0;
-	unsigned int num, i1_id=0, i2_id=0, cross_iter=0, loop_id=0, times=0;
-	BasicBlock* BB;
-	std::map<BasicBlock*, std::set<std::pair<Instruction*, Instruction*>* > >::iterator iter;
+	DEBUG(dbgs() << "--------------------------------------------------\n");
+	DEBUG(dbgs() << "  Inst_1 --> Inst_2        Loop          Count\n");
+	DEBUG(dbgs() << "--------------------------------------------------\n");
 
-	llvm::errs() << "--------------------------------------------------\n";
-	llvm::errs() << "  Inst_1 --> Inst_2        Loop          Count\n";
-	llvm::errs() << "--------------------------------------------------\n";
-
-  while (ifs >> s)
+	// Records are sorted by loop, so each loop's dependences end up in one
+	// contiguous slice of Deps.
+	ArrayRef<LAMPDepRecord> Records = Reader->getRecords();
+	Deps.reserve(Records.size());
+	for (const LAMPDepRecord *R = Records.begin(), *RE = Records.end(); R != RE; ++R)
 	{
-		size_t found_leftP;   // ( 
-		size_t found_rightP;  // )
-
-    // String Operation
-		// (1) discard string with ")"
-		// (2) erase "(" in the string
-
-		found_rightP = s.find_first_of(")");
-		if (found_rightP !=  std::string::npos) continue;
-
-		found_leftP = s.find_first_of("(");
-		if (found_leftP !=  std::string::npos){
-			assert(found_leftP == 0);        // "(" always 1st character
-			s.erase(0,1);
-		}
-    if (s.find("END") != std::string::npos) break;
-    
-    num_cnt ++;
-		num = str_to_int(s);
-		// llvm::errs() << "Read: " << num;
-
-    switch (num_cnt % 6){ //6  numbers in each line (result.lamp.profile)
-			case 1:
-				i1_id = num;
-				break;
-			case 2:
-				cross_iter = num;
-				break;
-			case 3:
-				loop_id = num;
-				break;
-			case 4:
-				i2_id = num;
-				break;
-			case 5:
-				times = num;
-//				if (cross_iter){  // comment out for 583 hw2
-					if ( IdToInstMap[i1_id] != NULL && IdToInstMap[i2_id] !=NULL  ){
-						std::pair<Instruction*, Instruction*>* dep_inst_pair_ptr = new std::pair<Instruction*, Instruction*>;
-						dep_inst_pair_ptr->first  = IdToInstMap[i1_id];
-						dep_inst_pair_ptr->second = IdToInstMap[i2_id];
-						BB = IdToLoopMap_global[loop_id];
-
-						llvm::errs() << IdToInstMap[i1_id] << "(" << i1_id<< ")" << " " << IdToInstMap[i2_id] << "(" << i2_id<< ")" << ", "  << BB << "(" << loop_id << ") " ;
-						iter = LoopToDepSetMap.find(BB);
-						if (iter == LoopToDepSetMap.end() ){   // newly found loop
-							std::set <std::pair<Instruction*, Instruction*>* >* dep_pair_set_ptr = new std::set <std::pair<Instruction*, Instruction*>* >;
-							dep_pair_set_ptr->insert(dep_inst_pair_ptr);
-							LoopToDepSetMap[BB] = *dep_pair_set_ptr;
-							//llvm::errs() << " X " ;
-						}else{																 // loop already in the map
-							LoopToDepSetMap[BB].insert(dep_inst_pair_ptr);
-							//llvm::errs() << " O " ;
-						}
-						DepToTimesMap[dep_inst_pair_ptr] = times;	
-						llvm::errs() << times << "  " << /*LoopToDepSetMap.size() <<*/  "\n";
-					}
-//				}  // comment out for 583 hw2
-				break;  
-			case 0:
-				break;
-			default:
-				break;
-		}
-	} // end of while(ifs >> s)
+		Instruction *I1 = getInst(R->SrcId);
+		Instruction *I2 = getInst(R->DstId);
+		BasicBlock *BB = IdToLoopMap.lookup(R->LoopId);
+		if (!I1 || !I2 || !BB)
+			continue;
+
+		DEBUG(dbgs() << I1 << "(" << R->SrcId << ")" << " " << I2 << "(" << R->DstId << ")" << ", "  << BB << "(" << R->LoopId << ") " << R->Count << "\n");
+		std::pair<unsigned, unsigned> &Range = LoopToDeps[BB];
+		if (Range.first == Range.second)
+			Range.first = Range.second = Deps.size();
+		++Range.second;
+
+		LAMPDependence D = { I1, I2, R->Count, R->CrossIter != 0 };
+		Deps.push_back(D);
+		DepToTimesMap[LoopDepKey(R->LoopId, InstIdPair(R->SrcId, R->DstId))] += R->Count;
+	}
 
 
 	llvm::errs() << "--------------------------------------------------\n";
 	llvm::errs() << "  Max Dep Count in each Loop\n";
 	llvm::errs() << "--------------------------------------------------\n";
 
-	std::map<BasicBlock*, std::set<std::pair<Instruction*, Instruction*>* > > :: iterator  Liter;
-	std::set<std::pair<Instruction*, Instruction*>* > :: iterator  Siter;
-	unsigned int max_times;
-	unsigned int  Id1=0, Id2=0;
-  //for (int i = lamp_id+1; i< ;i ++ )
-	llvm::errs() << "Num of cross-dep Loops: "<< LoopToDepSetMap.size() << "\n";
-  for (Liter = LoopToDepSetMap.begin();Liter != LoopToDepSetMap.end(); Liter++){
-		max_times = 0;
-		for (Siter = Liter->second.begin();Siter != Liter->second.end(); Siter++){
-			times = DepToTimesMap[*Siter];
-			if (times > max_times){	
-				max_times = times;
-        Id1 = InstToIdMap[(*Siter)->first];
-        Id2 = InstToIdMap[(*Siter)->second];
+	llvm::errs() << "Num of cross-dep Loops: "<< LoopToDeps.size() << "\n";
+	ArrayRef<LAMPLoopIndexEntry> Loops = Reader->getLoops();
+	for (unsigned i = 0, e = Loops.size(); i != e; ++i) {
+		BasicBlock *BB = IdToLoopMap.lookup(Loops[i].LoopId);
+		ArrayRef<LAMPDependence> LoopDeps = getLoopDeps(BB);
+		if (!BB || LoopDeps.empty())
+			continue;
+		uint64_t max_times = 0;
+		unsigned Id1 = 0, Id2 = 0;
+		for (unsigned j = 0, je = LoopDeps.size(); j != je; ++j) {
+			if (LoopDeps[j].Count > max_times) {
+				max_times = LoopDeps[j].Count;
+				Id1 = InstToIdMap[LoopDeps[j].Src];
+				Id2 = InstToIdMap[LoopDeps[j].Dst];
 			}
 		}
-		LoopToMaxDepTimesMap[Liter->first] = max_times;
-    llvm::errs() << LoopToIdMap[Liter->first] << " " << max_times << " ("  << Id1 << "," << Id2 << ")"<< "\n";
+		LoopToMaxDepTimesMap[BB] = max_times;
+		llvm::errs() << Loops[i].LoopId << " " << max_times << " ("  << Id1 << "," << Id2 << ")"<< "\n";
 	}
 
 	return true;
 }
+
+ArrayRef<LAMPDependence>
+LAMPLoadProfile::getLoopDeps(const BasicBlock *Header) const {
+	DenseMap<BasicBlock*, std::pair<unsigned, unsigned> >::const_iterator It =
+		LoopToDeps.find(const_cast<BasicBlock*>(Header));
+	if (It == LoopToDeps.end())
+		return ArrayRef<LAMPDependence>();
+	return ArrayRef<LAMPDependence>(Deps).slice(It->second.first,
+	                                            It->second.second - It->second.first);
+}
+
+uint64_t LAMPLoadProfile::getDepCount(const BasicBlock *Header,
+                                      const Instruction *Src,
+                                      const Instruction *Dst) const {
+	unsigned LoopId = getLoopId(Header);
+	unsigned SrcId = getInstId(Src), DstId = getInstId(Dst);
+	if (LoopId == ~0U || SrcId == ~0U || DstId == ~0U)
+		return 0;
+	return DepToTimesMap.lookup(LoopDepKey(LoopId, InstIdPair(SrcId, DstId)));
+}
@@ -9,9 +9,12 @@
 #include "llvm/Support/Compiler.h"
 
 #include "llvm/Analysis/LoopPass.h"	//TRM 7/21/08
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ProfileInfo.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Analysis/Passes.h"	//TRM 7/21/08
 
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 
 #include "LAMP/LAMPProfiling.h"
@@ -22,6 +25,57 @@
 using namespace llvm;
 using namespace std;
 
+// Sampling mode.  Instead of profiling every iteration, the runtime profiles
+// bursts of LAMPSampleBurst consecutive iterations once every
+// LAMPSamplePeriod iterations of each loop and scales the dependence counts
+// back up when it writes the profile.
+static cl::opt<unsigned>
+LAMPSamplePeriod("lamp-sample-period", cl::init(0),
+                 cl::desc("Profile one burst of iterations every N iterations "
+                          "of each loop (0 profiles every iteration)"));
+
+static cl::opt<unsigned>
+LAMPSampleBurst("lamp-sample-burst", cl::init(1),
+                cl::desc("Number of consecutive iterations profiled in each "
+                         "sampling period"));
+
+// Hot loop mode.  Only memory operations inside loops whose header executed
+// at least LAMPHotLoopThreshold times in the edge profile are instrumented.
+// Instruction and loop ids are still assigned to everything so that the
+// profile lines up with -lamp-load-profile.
+static cl::opt<bool>
+LAMPHotLoopsOnly("lamp-hot-loops-only", cl::init(false),
+                 cl::desc("Only instrument loops that the edge profile "
+                          "marks as hot"));
+
+static cl::opt<unsigned>
+LAMPHotLoopThreshold("lamp-hot-loop-threshold", cl::init(1000),
+                     cl::desc("Minimum header execution count of a hot loop"));
+
+/// isSamplingEnabled - Return true if the runtime should sample iterations.
+static bool isSamplingEnabled() {
+  return LAMPSamplePeriod > 1 && LAMPSampleBurst > 0 &&
+         LAMPSampleBurst < LAMPSamplePeriod;
+}
+
+/// isHotLoop - Return true if L should be profiled in hot loop mode.  Loops
+/// without profile information are treated as hot.
+static bool isHotLoop(const Loop *L, ProfileInfo &PI) {
+  double Count = PI.getExecutionCount(L->getHeader());
+  if (Count == ProfileInfo::MissingValue)
+    return true;
+  return Count >= LAMPHotLoopThreshold;
+}
+
+/// isInHotLoop - Return true if BB belongs to a loop that is hot, or is nested
+/// inside one.
+static bool isInHotLoop(const BasicBlock *BB, LoopInfo &LI, ProfileInfo &PI) {
+  for (const Loop *L = LI.getLoopFor(BB); L; L = L->getParentLoop())
+    if (isHotLoop(L, PI))
+      return true;
+  return false;
+}
+
 // This class is a module pass designed to do no modification or instrumentation but count the number of
 // loads, stores, and calls for the initialization call.  It also tracks the loop counts generated by the
 // loop profiler so they can be accessed by the initializing pass.
@@ -40,6 +94,11 @@ namespace {
 		
 	}	
 	unsigned int getCountInsts() { return num_loads + num_stores + num_calls; }
+	virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      // Counting changes nothing; in particular the edge profile used by
+      // -lamp-hot-loops-only must survive until the loop profiler.
+      AU.setPreservesAll();
+  }
   };
   
 }
@@ -108,6 +167,13 @@ namespace {
 	virtual void getAnalysisUsage(AnalysisUsage &AU) const {
 			AU.addRequired<DataLayout>();
       //AU.addRequired<TargetData>();
+      if (LAMPHotLoopsOnly) {
+        AU.addRequired<LoopInfo>();
+        AU.addRequired<ProfileInfo>();
+        // Only calls are inserted, so the edge profile stays valid for
+        // -insert-lamp-loop-profiling, which runs next.
+        AU.addPreserved<ProfileInfo>();
+      }
   }
 
 	bool doInitialization(Module &M) { return false; }
@@ -189,6 +255,19 @@ bool LAMPProfiler::runOnFunction(Function &F) {
 	{
 		
 		BasicBlock& BB = *IF;
+
+		// In hot loop mode, skip cold code but keep the ids in step with
+		// LdStCallCounter and LAMPLoadProfile.
+		if (LAMPHotLoopsOnly &&
+		    !isInHotLoop(&BB, getAnalysis<LoopInfo>(), getAnalysis<ProfileInfo>()))
+		{
+			for (BasicBlock::iterator I = BB.begin(), E = BB.end(); I != E; ++I)
+				if (isa<LoadInst>(I) || isa<StoreInst>(I) ||
+				    (isa<CallInst>(I) && ( (dyn_cast<CallInst>(I)->getCalledFunction() == NULL) ||
+				      (dyn_cast<CallInst>(I)->getCalledFunction()->isDeclaration()))))
+					++instruction_id;
+			continue;
+		}
 		
 		for (BasicBlock::iterator I = BB.begin(), E = BB.end(); I != E; ++I)
 		{
@@ -374,11 +453,16 @@ bool LAMPInit::runOnModule(Module& M)
 			BasicBlock::iterator InsertPos = entry.begin();
 			while (isa<AllocaInst>(InsertPos)) ++InsertPos;
 
+			// The last two arguments are the sampling period and burst length;
+			// (1, 0) tells the runtime to profile every iteration.
+			uint64_t period = isSamplingEnabled() ? LAMPSamplePeriod : 1;
+			uint64_t burst = isSamplingEnabled() ? LAMPSampleBurst : 0;
+
 			std::vector<Value*> Args(4);
 			Args[0] = ConstantInt::get(llvm::Type::getInt32Ty(M.getContext()), cnt, false);
 			Args[1] = ConstantInt::get(llvm::Type::getInt32Ty(M.getContext()), lps, false);
-			Args[2] = ConstantInt::get(llvm::Type::getInt64Ty(M.getContext()), 1, false);
-			Args[3] = ConstantInt::get(llvm::Type::getInt64Ty(M.getContext()), 0, false);
+			Args[2] = ConstantInt::get(llvm::Type::getInt64Ty(M.getContext()), period, false);
+			Args[3] = ConstantInt::get(llvm::Type::getInt64Ty(M.getContext()), burst, false);
 		
 			CallInst::Create(InitFn, Args, "", InsertPos);														
 			return true;
@@ -395,6 +479,8 @@ namespace {
     
 	  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
       AU.addRequiredTransitive<LdStCallCounter>();
+      if (LAMPHotLoopsOnly)
+        AU.addRequired<ProfileInfo>();
 		  //AU.addRequired<LAMPProfiler>();	For reasons incomprehensible to us, this is not permissible
     }
 
@@ -451,6 +537,13 @@ bool LAMPLoopProfiler::runOnLoop(Loop *Lp, LPPassManager &LPM) {
 	numLoops++;
 	
 	lscnts.num_loops = numLoops;
+
+	// Cold loops keep their id but get no hooks; their accesses are attributed
+	// to the enclosing profiled loops.
+	if (LAMPHotLoopsOnly && !isHotLoop(Lp, getAnalysis<ProfileInfo>())) {
+		++loop_id;
+		return false;
+	}
 	
   // insert invocation function at end of preheader (called once prior to loop)
 	const char* InvocName = "LAMP_loop_invocation";
@@ -27,6 +27,7 @@
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Utils/UnrollLoop.h"
 #include <sstream>
@@ -37,6 +38,9 @@
 #include <iostream>
 #include <fstream>
 #include <climits>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
 
 using namespace llvm;
 using namespace std;
@@ -47,10 +51,73 @@ MyUnrollCount("my-count", cl::init(0), cl::Hidden, cl::desc("Unroll factor"));
 static cl::opt<unsigned>
 MyUnrollDepth("my-depth", cl::init(0), cl::Hidden, cl::desc("Decide the depth of unrolling loops"));
 
+static cl::opt<string>
+MyFeaturesFile("my-features-file", cl::init("loop_features.txt"), cl::Hidden,
+               cl::desc("File the loop features are appended to"));
+
+// The database is written by llvm-unroll-tune: one loop_features.txt line per
+// loop followed by ", Unroll_count: N".
+static cl::opt<string>
+MyCountDB("my-count-db", cl::init(""), cl::Hidden,
+          cl::desc("Per-loop unroll factors overriding -my-count"));
+
+// The model predicts the unroll factor of a loop from its features. It is a
+// text file of whitespace separated tokens, '#' starting a comment:
+//
+//   normalize <mean x 11> <stddev x 11>       optional, applied to the inputs
+//   dense <in> <out> relu|none                one or more layers, in order
+//     <out x in weights, row by row> <out biases>
+//   classes <n> <factor x n>                  optional
+//
+// A linear model is a single "dense 11 1 none" layer. Without "classes" the
+// last layer has one output, rounded to the unroll factor; with it, the last
+// layer has n outputs and the factor of the largest one is used.
+static cl::opt<string>
+MyModel("my-model", cl::init(""), cl::Hidden,
+        cl::desc("Unroll model predicting per-loop factors in place of -my-count"));
+
+static cl::opt<unsigned>
+MyModelMaxCount("my-model-max-count", cl::init(8), cl::Hidden,
+                cl::desc("Largest unroll factor the model may predict"));
+
+// The loop features, in the order they appear in the features file and are
+// fed to the model.
+enum LoopFeature {
+    InstCount, ArithOpsCount, ArrAccessCount, CondInstCount, IntOpsCount,
+    FloatOpsCount, LoadsCount, StoresCount, BBInLoop, BBInFunc, LoopDepth,
+    NumFeatures
+};
+
+static const char *const featureNames[NumFeatures] = {
+    "Inst_count", "Arith_ops_count", "Arr_access_count", "Cond_inst_count",
+    "Int_ops_count", "Float_ops_count", "Loads_count", "Stores_count",
+    "BB_in_Loop", "BB_in_Func", "Loop_depth"
+};
+
 static unsigned ApproximateLoopSize(const Loop*, unsigned&, bool& , const TargetTransformInfo&);
-static void writeFeatures (Loop* L, unsigned long loopID);
+static void computeFeatures (Loop* L, unsigned features[NumFeatures]);
+static void writeFeatures (const unsigned features[NumFeatures], unsigned long loopID);
+static void readCountDB(map<unsigned long, unsigned> &counts);
 
 namespace {
+    // A small feed-forward network read from -my-model, see above.
+    class UnrollModel {
+        struct Layer {
+            unsigned inputs, outputs;
+            bool relu;
+            vector<double> weights; // outputs x inputs
+            vector<double> biases;
+        };
+        vector<double> mean, stddev; // empty if the inputs are not normalized
+        vector<Layer> layers;
+        vector<unsigned> classes;    // empty for a regression model
+        
+    public:
+        bool empty() const { return layers.empty(); }
+        void load(const string &fileName);
+        unsigned predict(const unsigned features[NumFeatures]) const;
+    };
+    
     class MyUnroll : public LoopPass {
         unsigned long moduleHash;
         unsigned long loopIndex = -1;
@@ -59,8 +126,13 @@ namespace {
         bool hookFunctionsSetDone = false;
         Constant *hookFuncRecordStart;
         Constant *hookFuncRecordFinish;
+        Instruction *printInst; // the printFinally call at the end of main
+        
+        map<unsigned long, unsigned> countOverrides; // loop ID -> unroll factor, from -my-count-db
+        UnrollModel model;
+        unsigned getUnrollCount(unsigned long loopID, const unsigned features[NumFeatures]) const;
         
-        bool unrolling(Loop *L, LPPassManager &LPM);
+        bool unrolling(Loop *L, LPPassManager &LPM, unsigned Count);
         
         void runOnEntryBlock(BasicBlock* preheader, unsigned long loop_idx);
         void runOnExitBlock(BasicBlock* exitingBlock, unsigned long loop_idx);
@@ -100,6 +172,10 @@ bool MyUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
     Function *F = L->getHeader()->getParent();
     if (hookFunctionsSetDone == false) {
         setHookFunctions(F->getParent()); // set hook function references, hook at the bottom of main function
+        if (!MyCountDB.empty())
+            readCountDB(countOverrides);
+        if (!MyModel.empty())
+            model.load(MyModel);
         hookFunctionsSetDone = true; // only for once
     }
     
@@ -118,18 +194,36 @@ bool MyUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
     
 
     // -------------- Do something!!
-    writeFeatures(L, moduleHash*100 + loopIndex);
+    unsigned long loopID = moduleHash*100 + loopIndex;
+    unsigned features[NumFeatures];
+    computeFeatures(L, features);
+    writeFeatures(features, loopID);
     
     runOnEntryBlock(preheader, loopIndex);
     runOnExitBlock(exitingBlock, loopIndex);
     
-    if (MyUnrollCount > 1) // if unroll factor is 2 or more
-        return unrolling(L, LPM); // then do the unrolling
+    unsigned Count = getUnrollCount(loopID, features);
+    if (Count > 1) // if unroll factor is 2 or more
+        return unrolling(L, LPM, Count); // then do the unrolling
     else
         return true;
 }
 
-bool MyUnroll::unrolling(Loop *L, LPPassManager &LPM) {
+// A factor tuned for this very loop wins over the model's prediction, which
+// wins over the global -my-count.
+unsigned MyUnroll::getUnrollCount(unsigned long loopID, const unsigned features[NumFeatures]) const {
+    map<unsigned long, unsigned>::const_iterator it = countOverrides.find(loopID);
+    if (it != countOverrides.end())
+        return it->second;
+    if (!model.empty()) {
+        unsigned count = model.predict(features);
+        DEBUG(dbgs() << "  model predicts unroll count " << count << " for loop " << loopID << "\n");
+        return count;
+    }
+    return MyUnrollCount;
+}
+
+bool MyUnroll::unrolling(Loop *L, LPPassManager &LPM, unsigned Count) {
     static bool AllowPartial = true;
     static unsigned Threshold = 150;
     static bool UnrollRuntime = true;
@@ -151,7 +245,6 @@ bool MyUnroll::unrolling(Loop *L, LPPassManager &LPM) {
         TripMultiple = SE->getSmallConstantTripMultiple(L, LatchBlock);
     }
     
-    unsigned Count = MyUnrollCount;
     if (Count == 0)
         return false;
     
@@ -195,6 +288,8 @@ bool MyUnroll::unrolling(Loop *L, LPPassManager &LPM) {
     return true;
 }
 
+// The hooks are implemented by the looptime runtime (runtime/liblooptime); its
+// output is read with llvm-looptime-prof.
 void MyUnroll::setHookFunctions(Module *m) {
     LLVMContext &Ctx = m->getContext();
     FunctionType *funcType = FunctionType::get(Type::getVoidTy(Ctx), Type::getInt64Ty(Ctx), false);
@@ -208,14 +303,15 @@ void MyUnroll::setHookFunctions(Module *m) {
     hash<string> hashFunc;
     moduleHash = hashFunc(m->getModuleIdentifier());
     llvm::Value* argHash []= {llvm::ConstantInt::get(Ctx , llvm::APInt( 64, moduleHash))};
-    Instruction *printInst = CallInst::Create(hookFuncPrint, argHash, "");
+    printInst = CallInst::Create(hookFuncPrint, argHash, "");
     
     llvm::Value* argCount []= {llvm::ConstantInt::get(Ctx , llvm::APInt( 64, MyUnrollCount))};
     Instruction *countInst = CallInst::Create(hookFuncCopyCount, argCount, "");
     
     Function *main = m->getFunction("main");
-    BasicBlock::iterator first = main->begin()->begin();
-    countInst->insertAfter(first);
+    // The entry block may hold nothing but its branch, so insert at the start
+    // of the block rather than after its first instruction.
+    countInst->insertBefore(main->begin()->getFirstInsertionPt());
     
     Function::iterator bit = main->end();
     BasicBlock::iterator iit = (--bit)->end();
@@ -234,17 +330,22 @@ void MyUnroll::runOnExitBlock(BasicBlock* exitingBlock, unsigned long loop_idx)
     LLVMContext &Ctx = exitingBlock->getContext();
     llvm::Value* arg []= {llvm::ConstantInt::get(Ctx , llvm::APInt( 64,loop_idx ))};
     Instruction *newInst = CallInst::Create(hookFuncRecordFinish, arg, "");
+    // A loop exiting into main's return block must record its exit before
+    // printFinally writes out the results.
+    if (printInst->getParent() == exitingBlock) {
+        newInst->insertBefore(printInst);
+        return;
+    }
     BasicBlock::iterator pit = exitingBlock->end();
     newInst->insertBefore(--pit);
 }
 
 /*
- Function writes all features of loops to a file, this file will be used for
- Neural network analysis later.
+ Function computes the features of a loop that are written to the features
+ file and fed to the unroll model. If the loop nests other loops, the features
+ of the nested loops are added to its own.
  */
-void writeFeatures (Loop *L, unsigned long loopID){
-    //setup parameters to get features
-    //if loop nests other loop, it adds the features in the nested loops to itself as well
+void computeFeatures (Loop *L, unsigned features[NumFeatures]){
     unsigned num_instructions = 0; //get number of instructions, substitutes for num_statements
     unsigned num_arithmetic_ops = 0; //number of arithmetic ops in loop
     unsigned num_array_accesses = 0; //number of array accesses in loop
@@ -299,38 +400,146 @@ void writeFeatures (Loop *L, unsigned long loopID){
         }
     }
     Loop::block_iterator ii = L->block_begin();
-    unsigned func_blocks_count = (*ii)->getParent()->getBasicBlockList().size();
-    unsigned loop_blocks_count = L->getNumBlocks();
-    unsigned loop_depth = L->getLoopDepth();
-    
-    //output features to a features file
-    string file_name = "loop_features.txt";
-    const char* f_name = file_name.c_str();
-    std::ofstream fout(f_name, std::ofstream::app );
-    /*
-     ofstream fout(file_name, std::ofstream::app | std::ofstream::binary);
-     fout.write((char*) &loopID, sizeof(unsigned long));
-     fout.write((char*) &num_instructions, sizeof(unsigned));
-     fout.write((char*) &num_arithmetic_ops, sizeof(unsigned));
-     fout.write((char*) &num_array_accesses, sizeof(unsigned));
-     fout.write((char*) &num_conditions, sizeof(unsigned));
-     fout.write((char*) &copyCount, sizeof(unsigned));*/
-    /*
-     fout << "Loop_ID: " << loopID;
-     fout << "\t Instruction count: " << num_instructions;
-     fout << "\t Arithmetic ops count: " << num_arithmetic_ops;
-     fout << "\t Array access count: " << num_array_accesses;
-     fout << "\t Conditional Instruction count: " << num_conditions;
-     //fout << ", Loop Iteration count: " << trip_count;
-     fout << "\t Unroll factor: " << copyCount;*/
-    fout << "Loop_ID: " << loopID << ", Inst_count: " << num_instructions<< ", Arith_ops_count: "
-    << num_arithmetic_ops << ", Arr_access_count: " << num_array_accesses << ", Cond_inst_count: "
-    << num_conditions  << ", Int_ops_count: " << num_int_ops << ", Float_ops_count: " << num_float_ops <<
-    ", Loads_count: " << num_loads << ", Stores_count: " << num_stores<< ", BB_in_Loop: " << loop_blocks_count <<
-    ", BB_in_Func: " << func_blocks_count << ", Loop_depth: " << loop_depth << "\n";
+    
+    features[InstCount] = num_instructions;
+    features[ArithOpsCount] = num_arithmetic_ops;
+    features[ArrAccessCount] = num_array_accesses;
+    features[CondInstCount] = num_conditions;
+    features[IntOpsCount] = num_int_ops;
+    features[FloatOpsCount] = num_float_ops;
+    features[LoadsCount] = num_loads;
+    features[StoresCount] = num_stores;
+    features[BBInLoop] = L->getNumBlocks();
+    features[BBInFunc] = (*ii)->getParent()->getBasicBlockList().size();
+    features[LoopDepth] = L->getLoopDepth();
+}
+
+/*
+ Function writes all features of loops to a file, this file will be used for
+ Neural network analysis later.
+ */
+void writeFeatures (const unsigned features[NumFeatures], unsigned long loopID){
+    std::ofstream fout(MyFeaturesFile.c_str(), std::ofstream::app );
+    fout << "Loop_ID: " << loopID;
+    for (unsigned i = 0; i != NumFeatures; ++i)
+        fout << ", " << featureNames[i] << ": " << features[i];
+    fout << "\n";
     fout.close();
 }
 
+/*
+ Function reads the unroll factors chosen by llvm-unroll-tune. Every line is
+ a line of loop_features.txt with the factor appended; lines without a factor
+ are skipped.
+ */
+void readCountDB(map<unsigned long, unsigned> &counts) {
+    std::ifstream fin(MyCountDB.c_str());
+    if (!fin)
+        report_fatal_error("Could not open unroll count database " + MyCountDB);
+    
+    string line;
+    while (getline(fin, line)) {
+        size_t countPos = line.rfind("Unroll_count: ");
+        if (line.compare(0, 9, "Loop_ID: ") != 0 || countPos == string::npos)
+            continue;
+        unsigned long loopID = strtoul(line.c_str() + 9, NULL, 10);
+        counts[loopID] = strtoul(line.c_str() + countPos + 14, NULL, 10);
+    }
+}
+
+static void modelError(const string &fileName, const string &message) {
+    report_fatal_error("Malformed unroll model " + fileName + ": " + message);
+}
+
+void UnrollModel::load(const string &fileName) {
+    std::ifstream fin(fileName.c_str());
+    if (!fin)
+        report_fatal_error("Could not open unroll model " + fileName);
+    
+    // Drop the comments, then read the file as one stream of tokens.
+    std::stringstream tokens;
+    string line;
+    while (getline(fin, line))
+        tokens << line.substr(0, line.find('#')) << "\n";
+    
+    string keyword;
+    while (tokens >> keyword) {
+        if (keyword == "normalize") {
+            mean.resize(NumFeatures);
+            stddev.resize(NumFeatures);
+            for (unsigned i = 0; i != NumFeatures; ++i)
+                tokens >> mean[i];
+            for (unsigned i = 0; i != NumFeatures; ++i)
+                tokens >> stddev[i];
+        } else if (keyword == "dense") {
+            Layer layer;
+            string activation;
+            tokens >> layer.inputs >> layer.outputs >> activation;
+            if (!tokens || layer.outputs == 0)
+                modelError(fileName, "bad dense layer shape");
+            if (layer.inputs != (layers.empty() ? unsigned(NumFeatures) : layers.back().outputs))
+                modelError(fileName, "dense layer inputs do not match the previous layer");
+            if (activation != "relu" && activation != "none")
+                modelError(fileName, "unknown activation " + activation);
+            layer.relu = activation == "relu";
+            layer.weights.resize(layer.inputs * layer.outputs);
+            layer.biases.resize(layer.outputs);
+            for (unsigned i = 0, e = layer.weights.size(); i != e; ++i)
+                tokens >> layer.weights[i];
+            for (unsigned i = 0; i != layer.outputs; ++i)
+                tokens >> layer.biases[i];
+            layers.push_back(layer);
+        } else if (keyword == "classes") {
+            unsigned n = 0;
+            tokens >> n;
+            classes.resize(n);
+            for (unsigned i = 0; i != n; ++i)
+                tokens >> classes[i];
+        } else {
+            modelError(fileName, "unknown keyword " + keyword);
+        }
+        if (tokens.fail())
+            modelError(fileName, "missing values after " + keyword);
+    }
+    
+    if (layers.empty())
+        modelError(fileName, "no dense layer");
+    if (layers.back().outputs != (classes.empty() ? 1 : classes.size()))
+        modelError(fileName, "the last layer must have one output per class");
+}
+
+unsigned UnrollModel::predict(const unsigned features[NumFeatures]) const {
+    vector<double> values(features, features + NumFeatures);
+    if (!mean.empty())
+        for (unsigned i = 0; i != NumFeatures; ++i) {
+            values[i] -= mean[i];
+            if (stddev[i] != 0)
+                values[i] /= stddev[i];
+        }
+    
+    for (unsigned l = 0, le = layers.size(); l != le; ++l) {
+        const Layer &layer = layers[l];
+        vector<double> out(layer.biases);
+        for (unsigned o = 0; o != layer.outputs; ++o) {
+            const double *row = &layer.weights[o * layer.inputs];
+            for (unsigned i = 0; i != layer.inputs; ++i)
+                out[o] += row[i] * values[i];
+            if (layer.relu && out[o] < 0)
+                out[o] = 0;
+        }
+        values.swap(out);
+    }
+    
+    double count;
+    if (classes.empty())
+        count = floor(values[0] + 0.5);
+    else
+        count = classes[max_element(values.begin(), values.end()) - values.begin()];
+    if (count < 1)
+        return 1;
+    return count > MyModelMaxCount ? unsigned(MyModelMaxCount) : unsigned(count);
+}
+
 /// ApproximateLoopSize - Approximate the size of the loop.
 static unsigned ApproximateLoopSize(const Loop *L, unsigned &NumCalls, bool &NotDuplicatable, const TargetTransformInfo &TTI) {
     CodeMetrics Metrics;
@@ -13,6 +13,10 @@
 #ifndef LAMPLOADPROFILE_H
 #define LAMPLOADPROFILE_H
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include <vector>
+
 namespace llvm {
 
   class ModulePass;
@@ -27,8 +31,8 @@ namespace llvm {
     static bool IdInitFlag;
     
   public:
-    std::map<unsigned int, BasicBlock*> IdToLoopMap;    // LoopID -> headerBB*
-    std::map<BasicBlock*, unsigned int> LoopToIdMap;    // headerBB* -> LoopID
+    DenseMap<unsigned int, BasicBlock*> IdToLoopMap;    // LoopID -> headerBB*
+    DenseMap<BasicBlock*, unsigned int> LoopToIdMap;    // headerBB* -> LoopID
     static char ID;
     LAMPBuildLoopMap() : LoopPass(ID) {}
 
@@ -36,22 +40,70 @@ namespace llvm {
     virtual void getAnalysisUsage(AnalysisUsage &AU) const;
   };  // LLVM Loop Pass can not be required => can not pass analysis info
 
+  /// LAMPDependence - One profiled memory dependence inside a loop.
+  struct LAMPDependence {
+    Instruction *Src;
+    Instruction *Dst;
+    uint64_t Count;
+    bool CrossIter;
+  };
+
   class LAMPLoadProfile : public ModulePass {
+    typedef std::pair<unsigned, unsigned> InstIdPair;   // (SrcId, DstId)
+    typedef std::pair<unsigned, InstIdPair> LoopDepKey; // (LoopId, deps)
+
+    std::vector<Instruction*> IdToInstMap;              // InstID -> Inst*
+    DenseMap<Instruction*, unsigned> InstToIdMap;       // Inst* -> InstID
+    DenseMap<unsigned, BasicBlock*> IdToLoopMap;        // LoopID -> headerBB*
+    DenseMap<BasicBlock*, unsigned> LoopToIdMap;        // headerBB* -> LoopID
+
+    // Dependences grouped by loop; LoopToDeps holds each loop's slice of Deps.
+    std::vector<LAMPDependence> Deps;
+    DenseMap<BasicBlock*, std::pair<unsigned, unsigned> > LoopToDeps;
+    DenseMap<LoopDepKey, uint64_t> DepToTimesMap;
+    DenseMap<BasicBlock*, uint64_t> LoopToMaxDepTimesMap;
+
   public:
-    std::map<unsigned int, Instruction*> IdToInstMap;   // Inst* -> InstId
-    std::map<Instruction*, unsigned int> InstToIdMap;   // InstID -> Inst*
-    std::map<unsigned int, BasicBlock*> IdToLoopMap;    // LoopID -> headerBB*
-    std::map<BasicBlock*, unsigned int> LoopToIdMap;    // headerBB* -> LoopID
-    std::map<std::pair<Instruction*, Instruction*>*, unsigned int> DepToTimesMap; 
-    std::map<BasicBlock*, std::set<std::pair<Instruction*, Instruction*>* > > LoopToDepSetMap;
-    std::map<BasicBlock*, unsigned int> LoopToMaxDepTimesMap;
-
-    static unsigned int lamp_id;
     static char ID;
     LAMPLoadProfile() : ModulePass (ID) {}
 
     virtual bool runOnModule (Module &M);
     virtual void getAnalysisUsage(AnalysisUsage &AU) const;
+
+    /// getInstId - Return the LAMP id of I, or ~0U if I is not profiled.
+    unsigned getInstId(const Instruction *I) const {
+      DenseMap<Instruction*, unsigned>::const_iterator It =
+        InstToIdMap.find(const_cast<Instruction*>(I));
+      return It == InstToIdMap.end() ? ~0U : It->second;
+    }
+
+    /// getInst - Return the instruction with the LAMP id Id, or null.
+    Instruction *getInst(unsigned Id) const {
+      return Id < IdToInstMap.size() ? IdToInstMap[Id] : 0;
+    }
+
+    /// getLoopId - Return the LAMP id of the loop headed by Header, or ~0U.
+    unsigned getLoopId(const BasicBlock *Header) const {
+      DenseMap<BasicBlock*, unsigned>::const_iterator It =
+        LoopToIdMap.find(const_cast<BasicBlock*>(Header));
+      return It == LoopToIdMap.end() ? ~0U : It->second;
+    }
+
+    /// getLoopDeps - The dependences observed in the loop headed by Header.
+    ArrayRef<LAMPDependence> getLoopDeps(const BasicBlock *Header) const;
+
+    /// getDepCount - Number of times the dependence Src -> Dst manifested in
+    /// the loop headed by Header, counting intra- and cross-iteration
+    /// instances together.
+    uint64_t getDepCount(const BasicBlock *Header, const Instruction *Src,
+                         const Instruction *Dst) const;
+
+    /// getMaxDepCount - The largest count of any dependence in the loop.
+    uint64_t getMaxDepCount(const BasicBlock *Header) const {
+      DenseMap<BasicBlock*, uint64_t>::const_iterator It =
+        LoopToMaxDepTimesMap.find(const_cast<BasicBlock*>(Header));
+      return It == LoopToMaxDepTimesMap.end() ? 0 : It->second;
+    }
   };
 }
 #endif 
@@ -40,6 +40,8 @@
 
 #define DEBUG_TYPE "slicm"
 #include "llvm/Transforms/Scalar.h"
+#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/AliasSetTracker.h"
@@ -67,7 +69,15 @@
 // SLICM includes
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include "LAMP/LAMPLoadProfile.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/BranchProbabilityInfo.h"
 #include "llvm/Analysis/ProfileInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpander.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
 #include <sstream>
 
 using namespace llvm;
@@ -78,11 +88,38 @@ STATISTIC(NumHoisted   , "Number of instructions hoisted out of loop");
 STATISTIC(NumMovedLoads, "Number of load insts hoisted or sunk");
 STATISTIC(NumMovedCalls, "Number of call insts hoisted or sunk");
 STATISTIC(NumPromoted  , "Number of memory locations promoted to registers");
+STATISTIC(NumSpeculated, "Number of loads speculatively hoisted");
+STATISTIC(NumSpecRejected, "Number of speculative hoists rejected as unprofitable");
+STATISTIC(NumVersioned , "Number of loops versioned with runtime alias checks");
 
 static cl::opt<bool>
 DisablePromotion("disable-slicm-promotion", cl::Hidden,
                  cl::desc("Disable memory promotion in SLICM pass"));
 
+// Cost model for speculative hoisting.  Costs are in units of simple
+// instructions and are weighted by block frequency.
+static cl::opt<unsigned>
+SpecLoadCost("slicm-load-cost", cl::init(4), cl::Hidden,
+             cl::desc("Cost of a load removed from the loop body by SLICM"));
+
+static cl::opt<unsigned>
+SpecRedoPenalty("slicm-redo-penalty", cl::init(20), cl::Hidden,
+                cl::desc("Extra cost of each trip through a SLICM redo block"));
+
+static cl::opt<unsigned>
+VersionMinSites("slicm-version-min-sites", cl::init(2), cl::Hidden,
+                cl::desc("Minimum number of conflict sites before SLICM "
+                         "versions a loop instead of using flag-and-redo"));
+
+static cl::opt<unsigned>
+VersionMaxChecks("slicm-version-max-checks", cl::init(16), cl::Hidden,
+                 cl::desc("Maximum number of pointer range checks SLICM "
+                          "emits to version a loop"));
+
+static cl::opt<bool>
+SpecRemarks("slicm-remarks", cl::Hidden,
+            cl::desc("Print the SLICM speculation decision for every load"));
+
 namespace {
     struct SLICM : public LoopPass {
         static char ID; // Pass identification, replacement for typeid
@@ -106,6 +143,9 @@ namespace {
             //      AU.addPreservedID(LoopSimplifyID);      // 583 - commented out
             AU.addRequired<TargetLibraryInfo>();
             AU.addRequired<ProfileInfo>();
+            AU.addRequired<BranchProbabilityInfo>();
+            AU.addRequired<BlockFrequencyInfo>();
+            AU.addRequired<ScalarEvolution>();
             AU.addRequired<LAMPLoadProfile>();
         }
         
@@ -113,6 +153,9 @@ namespace {
         
         bool doFinalization() {
             assert(LoopToAliasSetMap.empty() && "Didn't free loop alias sets");
+            VersionedLoops.clear();
+            BlockFreqs.clear();
+            FreqFunction = 0;
             return false;
         }
         
@@ -205,9 +248,45 @@ namespace {
         
         // Added by Jungho Bang
         ProfileInfo* PI;
-        LAMPLoadProfile *LLP;
-        typedef map<pair<Instruction*, Instruction*>*, unsigned int> DTT;
-        DTT DepToTimesMap;
+        LAMPLoadProfile *LLP;    // Queried in place; never copy its tables.
+        BlockFrequencyInfo *BFI;
+        
+        // Block frequencies as of the start of the function, kept up to date
+        // for the blocks SLICM splits (BFI itself is not recomputed).
+        Function *FreqFunction = 0;
+        DenseMap<BasicBlock*, double> BlockFreqs;
+        unsigned NumCandidates = 0, NumLoopSpeculated = 0;
+        
+        double getBlockFreq(BasicBlock *BB);
+        double getConflictRate(LoadInst *LI, const list<StoreInst*> &Aliases);
+        void estimateSpeculation(LoadInst *LI, const list<StoreInst*> &Aliases,
+                                 double &Savings, double &CheckCost,
+                                 double &RedoCost, double &Rate);
+        bool isProfitableToSpeculate(LoadInst *LI,
+                                     const list<StoreInst*> &Aliases);
+        
+        // Loop versioning: one range check in the preheader selects between
+        // the original loop and a clone with the candidate loads hoisted.
+        ScalarEvolution *SE;
+        SmallPtrSet<Loop*, 8> VersionedLoops;
+        
+        /// AccessRange - The bytes [Start, Last + Size) touched by a memory
+        /// access over all iterations of the current loop.
+        struct AccessRange {
+            Value *Ptr;
+            const SCEV *Start, *Last;
+            uint64_t Size;
+        };
+        
+        void collectSpeculationCandidates(SmallVectorImpl<LoadInst*> &Loads);
+        bool getAccessRange(Value *Ptr, Type *AccessTy, AccessRange &R);
+        bool shouldVersionLoop(ArrayRef<LoadInst*> Loads,
+                               SmallVectorImpl<AccessRange> &LoadRanges,
+                               SmallVectorImpl<AccessRange> &StoreRanges);
+        void versionLoop(ArrayRef<LoadInst*> Loads,
+                         ArrayRef<AccessRange> LoadRanges,
+                         ArrayRef<AccessRange> StoreRanges,
+                         LPPassManager &LPM);
         
         set<LoadInst*> *hoistedLoads = new set<LoadInst*>();
         set<BasicBlock*> *redoBBs = new set<BasicBlock*>();
@@ -215,7 +294,7 @@ namespace {
         
         int hoistingCount = 0;
         
-        void HoistRegionSLICM(DomTreeNode *N);
+        void HoistRegionSLICM(DomTreeNode *N, bool Speculate);
         bool isEligibleLoad(Instruction &I);
         list<StoreInst*> findStoreAliases(LoadInst *LI);
         
@@ -264,7 +343,16 @@ bool SLICM::runOnLoop(Loop *L, LPPassManager &LPM) {
     // JB
     PI = &getAnalysis<ProfileInfo>();
     LLP = &getAnalysis<LAMPLoadProfile>();
-    DepToTimesMap = LLP->DepToTimesMap;
+    BFI = &getAnalysis<BlockFrequencyInfo>();
+    SE = &getAnalysis<ScalarEvolution>();
+    if (FreqFunction != L->getHeader()->getParent()) {
+        FreqFunction = L->getHeader()->getParent();
+        BlockFreqs.clear();
+        // Loop objects are freed between functions and their addresses
+        // reused, so the set must not outlive the function.
+        VersionedLoops.clear();
+    }
+    NumCandidates = NumLoopSpeculated = 0;
     
     CurAST = new AliasSetTracker(*AA);
     // Collect Alias info from subloops.
@@ -320,8 +408,24 @@ bool SLICM::runOnLoop(Loop *L, LPPassManager &LPM) {
     //
     if (L->hasDedicatedExits())
         SinkRegion(DT->getNode(L->getHeader()));
-    if (Preheader)
-        HoistRegionSLICM(DT->getNode(L->getHeader()));
+    //
+    // Plain hoisting runs first so that the speculation candidates have their
+    // final, loop invariant operands.  Then either version the loop or fall
+    // back to flag-and-redo for each candidate load.
+    if (Preheader) {
+        HoistRegionSLICM(DT->getNode(L->getHeader()), false);
+        
+        SmallVector<LoadInst*, 8> Candidates;
+        SmallVector<AccessRange, 8> LoadRanges, StoreRanges;
+        if (!VersionedLoops.count(L)) {
+            collectSpeculationCandidates(Candidates);
+            if (!Candidates.empty() &&
+                shouldVersionLoop(Candidates, LoadRanges, StoreRanges))
+                versionLoop(Candidates, LoadRanges, StoreRanges, LPM);
+            else
+                HoistRegionSLICM(DT->getNode(L->getHeader()), true);
+        }
+    }
     
     // Now that all loop invariants have been removed from the loop, promote any
     // memory references to scalars that we can.
@@ -335,6 +439,12 @@ bool SLICM::runOnLoop(Loop *L, LPPassManager &LPM) {
             PromoteAliasSet(*I, ExitBlocks, InsertPts);
     }
     
+    if (SpecRemarks && NumCandidates)
+        errs() << "SLICM: loop '" << L->getHeader()->getName() << "' in '"
+               << L->getHeader()->getParent()->getName() << "': hoisted "
+               << NumLoopSpeculated << " of "
+               << NumCandidates << " candidate loads\n";
+    
     // Clear out loops state information for the next iteration
     CurLoop = 0;
     Preheader = 0;
@@ -401,7 +511,7 @@ void SLICM::SinkRegion(DomTreeNode *N) {
 /// first order w.r.t the DominatorTree.  This allows us to visit definitions
 /// before uses, allowing us to hoist a loop body in one pass without iteration.
 ///
-void SLICM::HoistRegionSLICM(DomTreeNode *N) {
+void SLICM::HoistRegionSLICM(DomTreeNode *N, bool Speculate) {
     assert(N != 0 && "Null dominator tree node?");
     BasicBlock *BB = N->getBlock();
     
@@ -441,7 +551,7 @@ void SLICM::HoistRegionSLICM(DomTreeNode *N) {
             if (CurLoop->hasLoopInvariantOperands(&I) && isSafeToExecuteUnconditionally(I)) {
                 if (canSinkOrHoistInst(I)) { // same situation as the template code
                     hoist(I);
-                } else {
+                } else if (Speculate) {
                     errs() << "Could be hoisted: ";
                     LoadInst *li = dyn_cast<LoadInst>(&I);
                     if (li == NULL) {
@@ -461,6 +571,14 @@ void SLICM::HoistRegionSLICM(DomTreeNode *N) {
         }
         
         for (LoadInst *li : *loadList) {
+            list<StoreInst*> aliases = findStoreAliases(li);
+            ++NumCandidates;
+            if (!isProfitableToSpeculate(li, aliases)) {
+                ++NumSpecRejected;
+                continue;
+            }
+            ++NumSpeculated;
+            ++NumLoopSpeculated;
             hoistingCount++;
             std::ostringstream ss;
             ss << hoistingCount;
@@ -474,6 +592,8 @@ void SLICM::HoistRegionSLICM(DomTreeNode *N) {
             homeBB->setName("HOME_BB" + countStr + "_" + homeBB->getName());
             redoBB->setName("REDO_BB" + countStr);
             restBB->setName("REST_BB" + countStr);
+            BlockFreqs[restBB] = getBlockFreq(homeBB);
+            BlockFreqs[redoBB] = getBlockFreq(homeBB) * getConflictRate(li, aliases);
             
             li->setName("LD" + countStr);
             LoadInst *v = hoistCloneAndStoreToStack(li, NULL, redoBB);
@@ -487,7 +607,7 @@ void SLICM::HoistRegionSLICM(DomTreeNode *N) {
             redoBBs->insert(redoBB);
             
             // For StoreInst that could be dependent
-            for (StoreInst *si : findStoreAliases(li)) {
+            for (StoreInst *si : aliases) {
                 errs() << "Alias: " << *si << "\n";
                 
                 ICmpInst *compare = new ICmpInst(CmpInst::ICMP_EQ, li->getPointerOperand(), si->getPointerOperand());
@@ -521,7 +641,395 @@ void SLICM::HoistRegionSLICM(DomTreeNode *N) {
     // How to skip new BBs (redo, rest)?
     const std::vector<DomTreeNode*> &Children = N->getChildren();
     for (unsigned i = 0, e = Children.size(); i != e; ++i)
-        HoistRegionSLICM(Children[i]);
+        HoistRegionSLICM(Children[i], Speculate);
+}
+
+/// getBlockFreq - Return the frequency of BB relative to the function entry,
+/// for blocks that existed when SLICM started on this function or that it
+/// created by splitting.
+///
+double SLICM::getBlockFreq(BasicBlock *BB) {
+    DenseMap<BasicBlock*, double>::iterator I = BlockFreqs.find(BB);
+    if (I != BlockFreqs.end())
+        return I->second;
+    double Freq = (double)BFI->getBlockFreq(BB).getFrequency() /
+                  BlockFrequency::getEntryFrequency();
+    BlockFreqs[BB] = Freq;
+    return Freq;
+}
+
+/// getConflictRate - Estimate the fraction of loop iterations in which one of
+/// Aliases actually writes the location LI reads, from the LAMP counts and the
+/// header's execution count.
+///
+double SLICM::getConflictRate(LoadInst *LI, const list<StoreInst*> &Aliases) {
+    BasicBlock *Header = CurLoop->getHeader();
+    uint64_t Conflicts = 0;
+    for (StoreInst *si : Aliases)
+        Conflicts += LLP->getDepCount(Header, si, LI);
+    if (Conflicts == 0)
+        return 0.0;
+    
+    // Without an edge profile the counts cannot be normalized; assume the
+    // worst.
+    double Iterations = PI->getExecutionCount(Header);
+    if (Iterations == ProfileInfo::MissingValue || Iterations <= 0.0)
+        return 1.0;
+    return std::min(1.0, Conflicts / Iterations);
+}
+
+/// isProfitableToSpeculate - Weigh the load SLICM would remove from LI's block
+/// against the flag check it leaves there, the flag update after every
+/// aliasing store and the expected trips through the redo block.
+///
+void SLICM::estimateSpeculation(LoadInst *LI, const list<StoreInst*> &Aliases,
+                                double &Savings, double &CheckCost,
+                                double &RedoCost, double &Rate) {
+    double HeaderFreq = getBlockFreq(CurLoop->getHeader());
+    double HomeFreq = getBlockFreq(LI->getParent());
+    
+    Savings = HomeFreq * SpecLoadCost;
+    CheckCost = HomeFreq * 2;               // load of the flag + branch
+    for (StoreInst *si : Aliases)
+        CheckCost += getBlockFreq(si->getParent()) * 2; // compare + flag store
+    Rate = getConflictRate(LI, Aliases);
+    RedoCost = HeaderFreq * Rate * (SpecLoadCost + SpecRedoPenalty);
+}
+
+bool SLICM::isProfitableToSpeculate(LoadInst *LI,
+                                    const list<StoreInst*> &Aliases) {
+    double Savings, CheckCost, RedoCost, Rate;
+    estimateSpeculation(LI, Aliases, Savings, CheckCost, RedoCost, Rate);
+    bool Profitable = Savings > CheckCost + RedoCost;
+    
+    if (SpecRemarks)
+        errs() << "SLICM: " << (Profitable ? "hoisting" : "not hoisting")
+               << " '" << *LI << "' in loop '" << CurLoop->getHeader()->getName()
+               << "': saves " << Savings << ", checks cost " << CheckCost
+               << ", redo costs " << RedoCost << " (" << Aliases.size()
+               << " conflict sites, conflict rate " << Rate << ")\n";
+    return Profitable;
+}
+
+/// collectSpeculationCandidates - Find the loads in the current loop that have
+/// loop invariant operands but are blocked by possibly aliasing stores, which
+/// are the loads flag-and-redo would hoist.
+///
+void SLICM::collectSpeculationCandidates(SmallVectorImpl<LoadInst*> &Loads) {
+    for (Loop::block_iterator I = CurLoop->block_begin(),
+         E = CurLoop->block_end(); I != E; ++I) {
+        if (inSubLoop(*I) || redoBBs->count(*I))
+            continue;
+        for (BasicBlock::iterator II = (*I)->begin(), IE = (*I)->end();
+             II != IE; ++II) {
+            LoadInst *li = dyn_cast<LoadInst>(II);
+            if (li && li->isUnordered() && !hoistedLoads->count(li) &&
+                CurLoop->hasLoopInvariantOperands(li) &&
+                isSafeToExecuteUnconditionally(*li) &&
+                !canSinkOrHoistInst(*li) && isEligibleLoad(*li))
+                Loads.push_back(li);
+        }
+    }
+}
+
+/// getAccessRange - Compute the range of addresses Ptr covers over the whole
+/// current loop.  Only loop invariant pointers and affine recurrences with a
+/// constant stride in a loop with a computable trip count are handled.
+///
+bool SLICM::getAccessRange(Value *Ptr, Type *AccessTy, AccessRange &R) {
+    if (!TD)
+        return false;
+    R.Ptr = Ptr;
+    R.Size = TD->getTypeStoreSize(AccessTy);
+    
+    const SCEV *Sc = SE->getSCEV(Ptr);
+    if (SE->isLoopInvariant(Sc, CurLoop)) {
+        R.Start = R.Last = Sc;
+        return true;
+    }
+    
+    const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(Sc);
+    if (!AR || AR->getLoop() != CurLoop || !AR->isAffine())
+        return false;
+    const SCEVConstant *Step =
+        dyn_cast<SCEVConstant>(AR->getStepRecurrence(*SE));
+    const SCEV *BTC = SE->getBackedgeTakenCount(CurLoop);
+    if (!Step || isa<SCEVCouldNotCompute>(BTC))
+        return false;
+    
+    R.Start = AR->getStart();
+    R.Last = AR->evaluateAtIteration(BTC, *SE);
+    if (Step->getValue()->isNegative())
+        std::swap(R.Start, R.Last);
+    return true;
+}
+
+/// shouldVersionLoop - Decide whether one runtime overlap check in the
+/// preheader beats flag-and-redo for all of Loads.  Versioning pays off when
+/// there are many conflict sites to patch and LAMP saw none of them actually
+/// conflict, since a single overlap sends a whole invocation down the slow
+/// path.
+///
+bool SLICM::shouldVersionLoop(ArrayRef<LoadInst*> Loads,
+                              SmallVectorImpl<AccessRange> &LoadRanges,
+                              SmallVectorImpl<AccessRange> &StoreRanges) {
+    BasicBlock *Header = CurLoop->getHeader();
+    
+    // Versioning clones the loop and its exit blocks; keep to the shape
+    // LoopUnswitch knows how to clone.
+    SmallVector<BasicBlock*, 8> ExitBlocks;
+    CurLoop->getUniqueExitBlocks(ExitBlocks);
+    if (!CurLoop->empty() || !CurLoop->isLoopSimplifyForm() ||
+        !CurLoop->isLCSSAForm(*DT) || !TD)
+        return false;
+    for (unsigned i = 0, e = ExitBlocks.size(); i != e; ++i)
+        if (ExitBlocks[i]->isLandingPad())
+            return false;
+    
+    // The check only covers stores; any other write rules versioning out.
+    SmallPtrSet<StoreInst*, 8> Stores;
+    SmallVector<StoreInst*, 8> StoreList;
+    for (Loop::block_iterator I = CurLoop->block_begin(),
+         E = CurLoop->block_end(); I != E; ++I)
+        for (BasicBlock::iterator II = (*I)->begin(), IE = (*I)->end();
+             II != IE; ++II)
+            if (II->mayWriteToMemory() && !isa<StoreInst>(II))
+                return false;
+    
+    double FlagCost = 0.0, Rate = 0.0;
+    unsigned NumSites = 0;
+    for (unsigned i = 0, e = Loads.size(); i != e; ++i) {
+        list<StoreInst*> Aliases = findStoreAliases(Loads[i]);
+        double Savings, CheckCost, RedoCost, LoadRate;
+        estimateSpeculation(Loads[i], Aliases, Savings, CheckCost, RedoCost,
+                            LoadRate);
+        FlagCost += CheckCost + RedoCost;
+        Rate += LoadRate;
+        NumSites += Aliases.size();
+        for (StoreInst *si : Aliases)
+            if (CurLoop->contains(si) && Stores.insert(si))
+                StoreList.push_back(si);
+    }
+    
+    unsigned NumChecks = Loads.size() * StoreList.size();
+    double VersionCost = getBlockFreq(CurLoop->getLoopPreheader()) * 3 *
+                         NumChecks;
+    bool Version = NumSites >= VersionMinSites && Rate == 0.0 &&
+                   NumChecks <= VersionMaxChecks && VersionCost < FlagCost;
+    
+    if (Version) {
+        for (unsigned i = 0, e = Loads.size(); i != e && Version; ++i) {
+            AccessRange R;
+            Version = getAccessRange(Loads[i]->getPointerOperand(),
+                                     Loads[i]->getType(), R);
+            LoadRanges.push_back(R);
+        }
+        for (unsigned i = 0, e = StoreList.size(); i != e && Version; ++i) {
+            AccessRange R;
+            Version = getAccessRange(StoreList[i]->getPointerOperand(),
+                                     StoreList[i]->getValueOperand()->getType(),
+                                     R);
+            StoreRanges.push_back(R);
+        }
+        // Pointers in different address spaces cannot be compared, so their
+        // overlap cannot be ruled out at run time.
+        for (unsigned i = 0, e = LoadRanges.size(); i != e && Version; ++i)
+            for (unsigned j = 0, je = StoreRanges.size(); j != je; ++j)
+                if (LoadRanges[i].Ptr->getType()->getPointerAddressSpace() !=
+                    StoreRanges[j].Ptr->getType()->getPointerAddressSpace()) {
+                    Version = false;
+                    break;
+                }
+    }
+    
+    if (SpecRemarks)
+        errs() << "SLICM: loop '" << Header->getName() << "': "
+               << (Version ? "versioning" : "using flag-and-redo") << " for "
+               << Loads.size() << " loads (" << NumSites
+               << " conflict sites, flag-and-redo cost " << FlagCost
+               << ", versioning cost " << VersionCost << ", conflict rate "
+               << Rate << ")\n";
+    return Version;
+}
+
+/// versionLoop - Clone the current loop, hoist Loads out of the clone and
+/// branch to it from the preheader when no load range overlaps a store range.
+/// The original loop is left as the fallback.  This follows the way
+/// LoopUnswitch clones loops.
+///
+void SLICM::versionLoop(ArrayRef<LoadInst*> Loads,
+                        ArrayRef<AccessRange> LoadRanges,
+                        ArrayRef<AccessRange> StoreRanges,
+                        LPPassManager &LPM) {
+    Loop *L = CurLoop;
+    BasicBlock *Header = L->getHeader();
+    Function *F = Header->getParent();
+    LLVMContext &Context = F->getContext();
+    
+    // Expand the range checks in the preheader before any block moves.
+    Instruction *CheckPt = Preheader->getTerminator();
+    SCEVExpander Exp(*SE, "slicm");
+    IRBuilder<> Builder(CheckPt);
+    Value *Conflict = 0;
+    for (unsigned i = 0, e = LoadRanges.size(); i != e; ++i) {
+        const AccessRange &LR = LoadRanges[i];
+        Type *LPtrTy = Type::getInt8PtrTy(Context,
+            LR.Ptr->getType()->getPointerAddressSpace());
+        Value *LStart = Exp.expandCodeFor(LR.Start, LPtrTy, CheckPt);
+        Value *LEnd = Builder.CreateConstGEP1_64(
+            Exp.expandCodeFor(LR.Last, LPtrTy, CheckPt), LR.Size, "slicm.end");
+        for (unsigned j = 0, je = StoreRanges.size(); j != je; ++j) {
+            const AccessRange &SR = StoreRanges[j];
+            assert(SR.Ptr->getType()->getPointerAddressSpace() ==
+                   LR.Ptr->getType()->getPointerAddressSpace() &&
+                   "shouldVersionLoop let mixed address spaces through");
+            Value *SStart = Exp.expandCodeFor(SR.Start, LPtrTy, CheckPt);
+            Value *SEnd = Builder.CreateConstGEP1_64(
+                Exp.expandCodeFor(SR.Last, LPtrTy, CheckPt), SR.Size,
+                "slicm.end");
+            Value *Overlap = Builder.CreateAnd(
+                Builder.CreateICmpULT(LStart, SEnd, "slicm.bound0"),
+                Builder.CreateICmpULT(SStart, LEnd, "slicm.bound1"),
+                "slicm.overlap");
+            Conflict = Conflict ? Builder.CreateOr(Conflict, Overlap,
+                                                   "slicm.conflict")
+                                : Overlap;
+        }
+    }
+    if (!Conflict)
+        Conflict = ConstantInt::getFalse(Context);
+    
+    SE->forgetLoop(L);
+    
+    // Split the preheader and the exit edges so that both versions get their
+    // own preheader and exit blocks.
+    SmallVector<BasicBlock*, 16> LoopBlocks;
+    BasicBlock *NewPreheader = SplitEdge(Preheader, Header, this);
+    LoopBlocks.push_back(NewPreheader);
+    LoopBlocks.insert(LoopBlocks.end(), L->block_begin(), L->block_end());
+    
+    SmallVector<BasicBlock*, 8> ExitBlocks;
+    L->getUniqueExitBlocks(ExitBlocks);
+    for (unsigned i = 0, e = ExitBlocks.size(); i != e; ++i) {
+        SmallVector<BasicBlock*, 4> Preds(pred_begin(ExitBlocks[i]),
+                                          pred_end(ExitBlocks[i]));
+        SplitBlockPredecessors(ExitBlocks[i], Preds, ".slicm-lcssa", this);
+    }
+    ExitBlocks.clear();
+    L->getUniqueExitBlocks(ExitBlocks);
+    LoopBlocks.insert(LoopBlocks.end(), ExitBlocks.begin(), ExitBlocks.end());
+    
+    // Clone the blocks and splice them in front of the original preheader.
+    SmallVector<BasicBlock*, 16> NewBlocks;
+    ValueToValueMapTy VMap;
+    for (unsigned i = 0, e = LoopBlocks.size(); i != e; ++i) {
+        BasicBlock *NewBB = CloneBasicBlock(LoopBlocks[i], VMap, ".nalias", F);
+        NewBlocks.push_back(NewBB);
+        VMap[LoopBlocks[i]] = NewBB;
+        LPM.cloneBasicBlockSimpleAnalysis(LoopBlocks[i], NewBB, L);
+    }
+    F->getBasicBlockList().splice(NewPreheader, F->getBasicBlockList(),
+                                  NewBlocks[0], F->end());
+    
+    Loop *ParentLoop = L->getParentLoop();
+    Loop *NewLoop = new Loop();
+    LPM.insertLoop(NewLoop, ParentLoop);
+    for (Loop::block_iterator I = L->block_begin(), E = L->block_end();
+         I != E; ++I)
+        NewLoop->addBasicBlockToLoop(cast<BasicBlock>(VMap[*I]),
+                                     LInfo->getBase());
+    if (ParentLoop)
+        ParentLoop->addBasicBlockToLoop(NewBlocks[0], LInfo->getBase());
+    
+    for (unsigned i = 0, e = ExitBlocks.size(); i != e; ++i) {
+        BasicBlock *NewExit = cast<BasicBlock>(VMap[ExitBlocks[i]]);
+        if (Loop *ExitBBLoop = LInfo->getLoopFor(ExitBlocks[i]))
+            ExitBBLoop->addBasicBlockToLoop(NewExit, LInfo->getBase());
+        
+        BasicBlock *ExitSucc = NewExit->getTerminator()->getSuccessor(0);
+        for (BasicBlock::iterator I = ExitSucc->begin(); isa<PHINode>(I); ++I) {
+            PHINode *PN = cast<PHINode>(I);
+            Value *V = PN->getIncomingValueForBlock(ExitBlocks[i]);
+            ValueToValueMapTy::iterator It = VMap.find(V);
+            if (It != VMap.end()) V = It->second;
+            PN->addIncoming(V, NewExit);
+        }
+    }
+    
+    for (unsigned i = 0, e = NewBlocks.size(); i != e; ++i)
+        for (BasicBlock::iterator I = NewBlocks[i]->begin(),
+             E = NewBlocks[i]->end(); I != E; ++I)
+            RemapInstruction(I, VMap,
+                             RF_NoModuleLevelChanges | RF_IgnoreMissingEntries);
+    
+    // Select the version: the clone runs when no ranges overlap.
+    BranchInst *OldBR = cast<BranchInst>(Preheader->getTerminator());
+    BranchInst::Create(LoopBlocks[0], NewBlocks[0], Conflict, OldBR);
+    LPM.deleteSimpleAnalysisValue(OldBR, L);
+    OldBR->eraseFromParent();
+    
+    // In the clone the candidate loads cannot be clobbered, so hoist them
+    // into its preheader without any fix-up code.
+    Instruction *InsertPt = NewBlocks[0]->getTerminator();
+    for (unsigned i = 0, e = Loads.size(); i != e; ++i) {
+        Instruction *NewLI = cast<Instruction>(VMap[Loads[i]]);
+        NewLI->moveBefore(InsertPt);
+        ++NumHoisted;
+        ++NumMovedLoads;
+    }
+    
+    BlockFreqs[NewBlocks[0]] = getBlockFreq(NewPreheader);
+    for (unsigned i = 1, e = LoopBlocks.size(); i != e; ++i)
+        BlockFreqs[NewBlocks[i]] = getBlockFreq(LoopBlocks[i]);
+    
+    // Update the dominator tree.  The clone mirrors the original blocks below
+    // the old preheader.  Blocks outside the loop that were dominated from
+    // inside it, or that follow an exit, are now reached from both versions.
+    SmallPtrSet<BasicBlock*, 16> Region;
+    Region.insert(LoopBlocks.begin(), LoopBlocks.end());
+    SmallVector<BasicBlock*, 8> Joins;
+    for (unsigned i = 0, e = LoopBlocks.size(); i != e; ++i) {
+        DomTreeNode *N = DT->getNode(LoopBlocks[i]);
+        for (DomTreeNode::iterator I = N->begin(), E = N->end(); I != E; ++I)
+            if (!Region.count((*I)->getBlock()))
+                Joins.push_back((*I)->getBlock());
+    }
+    for (unsigned i = 0, e = ExitBlocks.size(); i != e; ++i) {
+        BasicBlock *ExitSucc = ExitBlocks[i]->getTerminator()->getSuccessor(0);
+        if (std::find(Joins.begin(), Joins.end(), ExitSucc) == Joins.end())
+            Joins.push_back(ExitSucc);
+    }
+    
+    DT->addNewBlock(NewBlocks[0], Preheader);
+    for (df_iterator<DomTreeNode*> I = df_begin(DT->getNode(NewPreheader)),
+         E = df_end(DT->getNode(NewPreheader)); I != E; ++I) {
+        BasicBlock *BB = I->getBlock();
+        if (BB == NewPreheader || !Region.count(BB))
+            continue;
+        DT->addNewBlock(cast<BasicBlock>(VMap[BB]),
+                        cast<BasicBlock>(VMap[I->getIDom()->getBlock()]));
+    }
+    
+    for (unsigned i = 0, e = Joins.size(); i != e; ++i) {
+        BasicBlock *IDom = DT->getNode(Joins[i])->getIDom()->getBlock();
+        BasicBlock *NewIDom = IDom;
+        if (Region.count(IDom))
+            NewIDom = DT->findNearestCommonDominator(
+                NewIDom, cast<BasicBlock>(VMap[IDom]));
+        for (pred_iterator PI = pred_begin(Joins[i]), PE = pred_end(Joins[i]);
+             PI != PE; ++PI)
+            if (std::find(NewBlocks.begin(), NewBlocks.end(), *PI) !=
+                NewBlocks.end())
+                NewIDom = DT->findNearestCommonDominator(NewIDom, *PI);
+        if (NewIDom != IDom)
+            DT->changeImmediateDominator(Joins[i], NewIDom);
+    }
+    
+    Preheader = NewPreheader;
+    VersionedLoops.insert(L);
+    VersionedLoops.insert(NewLoop);
+    ++NumVersioned;
+    Changed = true;
 }
 
 void SLICM::removeUnnecessaryAllocas() {
@@ -18,6 +18,7 @@
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Analysis/Dominators.h"
 #include "llvm/Analysis/InstructionSimplify.h"
+#include "llvm/Analysis/KnownBitsCache.h"
 #include "llvm/Analysis/MemoryBuiltins.h"
 #include "llvm/Analysis/ProfileInfo.h"
 #include "llvm/Analysis/ValueTracking.h"
@@ -773,6 +774,8 @@ static unsigned enforceKnownAlignment(Value *V, unsigned Align,
     if (AI->getAlignment() >= PrefAlign)
       return AI->getAlignment();
     AI->setAlignment(PrefAlign);
+    if (KnownBitsCache *Cache = KnownBitsCache::getActive())
+      Cache->refineUsers(AI);
     return PrefAlign;
   }
 
@@ -791,8 +794,11 @@ static unsigned enforceKnownAlignment(Value *V, unsigned Align,
     // specified or if it is not assigned a section.  If it is assigned a
     // section, the global could be densely packed with other objects in the
     // section, increasing the alignment could cause padding issues.
-    if (!GV->hasSection() || GV->getAlignment() == 0)
+    if (!GV->hasSection() || GV->getAlignment() == 0) {
       GV->setAlignment(PrefAlign);
+      if (KnownBitsCache *Cache = KnownBitsCache::getActive())
+        Cache->refineUsers(GV);
+    }
     return GV->getAlignment();
   }
 
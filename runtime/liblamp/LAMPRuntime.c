@@ -0,0 +1,539 @@
+/*===-- LAMPRuntime.c - Runtime for LAMP memory dependence profiling ------===*\
+|*
+|*                     The LLVM Compiler Infrastructure
+|*
+|* This file is distributed under the University of Illinois Open Source
+|* License. See LICENSE.TXT for details.
+|*
+|*===----------------------------------------------------------------------===*|
+|*
+|* This file implements the call back routines inserted by the LAMP
+|* instrumentation passes (-insert-lamp-profiling, -insert-lamp-loop-profiling
+|* and -insert-lamp-init).
+|*
+|* Every thread owns a private shard of the profiler state: its shadow memory,
+|* its loop stack and its dependence table.  The hooks therefore never take a
+|* lock and never touch a cache line written by another thread.  A thread's
+|* shard is created on its first hook call and pushed onto a lock-free list;
+|* at exit the shards are merged and written out as a binary LAMP profile
+|* (see llvm/Analysis/LAMPProfileDataTypes.h).
+|*
+|* Because shadow memory is per thread, a dependence is only observed between
+|* a store and a load executed by the same thread.  Loop-carried dependences
+|* are a property of one thread's iteration space, so this is what the LAMP
+|* consumers want.
+|*
+|* In sampling mode (-lamp-sample-period) only bursts of SampleBurst
+|* consecutive iterations out of every SamplePeriod iterations of a loop are
+|* profiled.  Accesses in the other iterations cost one branch, and the
+|* dependence counts are scaled by SamplePeriod / SampleBurst on output.
+|*
+|* The output file defaults to result.lamp.profile and can be changed with the
+|* LAMP_PROFILE_OUTPUT environment variable.  Setting LAMP_PROFILE_FORMAT to
+|* "text" writes the legacy text format instead.
+|*
+\*===----------------------------------------------------------------------===*/
+
+#include "llvm/Analysis/LAMPProfileDataTypes.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The hooks find the calling thread's shard through thread-local storage and
+ * publish new shards with a pointer compare-and-swap.  GCC, Clang and MSVC
+ * provide both; other compilers fall back to a pthread key and a mutex, which
+ * is slower but still correct.
+ */
+#if defined(__GNUC__)
+#define LAMP_THREAD_LOCAL __thread
+#define LAMP_CAS_PTR(Ptr, Old, New) __sync_bool_compare_and_swap(Ptr, Old, New)
+#elif defined(_MSC_VER)
+#include <windows.h>
+#define LAMP_THREAD_LOCAL __declspec(thread)
+#define LAMP_CAS_PTR(Ptr, Old, New)                                            \
+  (InterlockedCompareExchangePointer((PVOID volatile *)(Ptr), (New), (Old)) == \
+   (PVOID)(Old))
+#else
+#include <pthread.h>
+#endif
+
+/* Shadow memory is kept at byte granularity in pages of LAMP_PAGE_SIZE
+ * application bytes, found through a per-thread chained hash table.
+ */
+#define LAMP_PAGE_BITS 12
+#define LAMP_PAGE_SIZE (1 << LAMP_PAGE_BITS)
+#define LAMP_PAGE_BUCKETS (1 << 16)
+
+typedef struct LAMPShadowEntry {
+  uint64_t Time;      /* Time stamp of the last store, 0 if never stored. */
+  uint32_t StoreId;   /* LAMP id of the last store to this byte.          */
+  uint32_t Padding;
+} LAMPShadowEntry;
+
+typedef struct LAMPShadowPage {
+  uint64_t PageNumber;
+  struct LAMPShadowPage *Next;
+  LAMPShadowEntry Entries[LAMP_PAGE_SIZE];
+} LAMPShadowPage;
+
+typedef struct LAMPLoopFrame {
+  uint32_t LoopId;
+  uint64_t InvocationStart;
+  uint64_t IterationStart;
+  uint64_t Iteration;        /* Iterations started in this invocation. */
+} LAMPLoopFrame;
+
+typedef struct LAMPThreadState {
+  struct LAMPThreadState *Next;
+
+  /* Every memory access advances Time, so time stamps order accesses within
+   * this thread.
+   */
+  uint64_t Time;
+
+  LAMPShadowPage **Pages;
+  LAMPShadowPage *LastPage;
+
+  LAMPLoopFrame *Loops;
+  unsigned NumLoops;
+  unsigned LoopCapacity;
+
+  /* Sampling state of the innermost loop.  Shadow entries written after the
+   * innermost invocation started but before the current burst may be stale,
+   * since stores in skipped iterations are not recorded.
+   */
+  int Sampled;
+  uint64_t BurstStart;
+
+  /* Open addressed; a Count of zero marks an empty slot. */
+  LAMPDepRecord *Deps;
+  uint64_t NumDeps;
+  uint64_t DepCapacity;
+} LAMPThreadState;
+
+static LAMPThreadState *volatile ThreadList = 0;
+#ifdef LAMP_THREAD_LOCAL
+static LAMP_THREAD_LOCAL LAMPThreadState *CurThread = 0;
+#else
+static pthread_mutex_t ThreadListLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t CurThreadOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t CurThreadKey;
+static void createCurThreadKey(void) { pthread_key_create(&CurThreadKey, 0); }
+#endif
+static int AtExitRegistered = 0;
+
+/* Sampling parameters from LAMP_init; SampleBurst == 0 disables sampling. */
+static uint64_t SamplePeriod = 1;
+static uint64_t SampleBurst = 0;
+
+static void *LAMPAlloc(size_t Size) {
+  void *Mem = calloc(1, Size);
+  if (!Mem) {
+    fprintf(stderr, "LAMP runtime: out of memory\n");
+    exit(1);
+  }
+  return Mem;
+}
+
+/* createThreadState - Allocate the shard for the calling thread and publish
+ * it on ThreadList so the exit handler can find it.
+ */
+static LAMPThreadState *createThreadState(void) {
+  LAMPThreadState *T = (LAMPThreadState *)LAMPAlloc(sizeof(LAMPThreadState));
+  LAMPThreadState *Head;
+  T->Pages = (LAMPShadowPage **)LAMPAlloc(LAMP_PAGE_BUCKETS *
+                                          sizeof(LAMPShadowPage *));
+  T->DepCapacity = 1024;
+  T->Deps = (LAMPDepRecord *)LAMPAlloc(T->DepCapacity * sizeof(LAMPDepRecord));
+  T->Sampled = 1;
+#ifdef LAMP_THREAD_LOCAL
+  do {
+    Head = ThreadList;
+    T->Next = Head;
+  } while (!LAMP_CAS_PTR(&ThreadList, Head, T));
+  CurThread = T;
+#else
+  pthread_mutex_lock(&ThreadListLock);
+  Head = ThreadList;
+  T->Next = Head;
+  ThreadList = T;
+  pthread_mutex_unlock(&ThreadListLock);
+  pthread_setspecific(CurThreadKey, T);
+#endif
+  return T;
+}
+
+static inline LAMPThreadState *getThreadState(void) {
+#ifdef LAMP_THREAD_LOCAL
+  LAMPThreadState *T = CurThread;
+#else
+  LAMPThreadState *T;
+  pthread_once(&CurThreadOnce, createCurThreadKey);
+  T = (LAMPThreadState *)pthread_getspecific(CurThreadKey);
+#endif
+  return T ? T : createThreadState();
+}
+
+/* getShadowPage - Return the shadow page covering PageNumber, creating it if
+ * Create is set.  Returns null if the page does not exist and Create is not
+ * set, meaning nothing on it has been stored to yet.
+ */
+static LAMPShadowPage *getShadowPage(LAMPThreadState *T, uint64_t PageNumber,
+                                     int Create) {
+  LAMPShadowPage **Bucket;
+  LAMPShadowPage *P;
+  if (T->LastPage && T->LastPage->PageNumber == PageNumber)
+    return T->LastPage;
+
+  Bucket = &T->Pages[(PageNumber ^ (PageNumber >> 16)) &
+                     (LAMP_PAGE_BUCKETS - 1)];
+  for (P = *Bucket; P; P = P->Next)
+    if (P->PageNumber == PageNumber)
+      return T->LastPage = P;
+
+  if (!Create)
+    return 0;
+  P = (LAMPShadowPage *)LAMPAlloc(sizeof(LAMPShadowPage));
+  P->PageNumber = PageNumber;
+  P->Next = *Bucket;
+  *Bucket = P;
+  return T->LastPage = P;
+}
+
+static inline uint64_t hashDep(uint32_t LoopId, uint32_t SrcId,
+                               uint32_t DstId, uint32_t CrossIter) {
+  uint64_t H = ((uint64_t)LoopId << 32) ^ ((uint64_t)SrcId << 1) ^ CrossIter;
+  H ^= (uint64_t)DstId * 0x9E3779B97F4A7C15ULL;
+  H ^= H >> 29;
+  H *= 0xBF58476D1CE4E5B9ULL;
+  return H ^ (H >> 32);
+}
+
+static void growDepTable(LAMPThreadState *T) {
+  LAMPDepRecord *Old = T->Deps;
+  uint64_t OldCapacity = T->DepCapacity, i;
+  T->DepCapacity *= 2;
+  T->Deps = (LAMPDepRecord *)LAMPAlloc(T->DepCapacity * sizeof(LAMPDepRecord));
+  for (i = 0; i != OldCapacity; ++i) {
+    LAMPDepRecord *R = &Old[i];
+    uint64_t Slot;
+    if (!R->Count)
+      continue;
+    Slot = hashDep(R->LoopId, R->SrcId, R->DstId, R->CrossIter) &
+           (T->DepCapacity - 1);
+    while (T->Deps[Slot].Count)
+      Slot = (Slot + 1) & (T->DepCapacity - 1);
+    T->Deps[Slot] = *R;
+  }
+  free(Old);
+}
+
+static void addDependence(LAMPThreadState *T, uint32_t LoopId, uint32_t SrcId,
+                          uint32_t DstId, uint32_t CrossIter) {
+  uint64_t Slot = hashDep(LoopId, SrcId, DstId, CrossIter) &
+                  (T->DepCapacity - 1);
+  for (;; Slot = (Slot + 1) & (T->DepCapacity - 1)) {
+    LAMPDepRecord *R = &T->Deps[Slot];
+    if (!R->Count)
+      break;
+    if (R->LoopId == LoopId && R->SrcId == SrcId && R->DstId == DstId &&
+        R->CrossIter == CrossIter) {
+      ++R->Count;
+      return;
+    }
+  }
+
+  /* Keep the table at most half full. */
+  if (2 * (T->NumDeps + 1) > T->DepCapacity) {
+    growDepTable(T);
+    addDependence(T, LoopId, SrcId, DstId, CrossIter);
+    return;
+  }
+  T->Deps[Slot].LoopId = LoopId;
+  T->Deps[Slot].SrcId = SrcId;
+  T->Deps[Slot].DstId = DstId;
+  T->Deps[Slot].CrossIter = CrossIter;
+  T->Deps[Slot].Count = 1;
+  ++T->NumDeps;
+}
+
+/* recordDependence - The load DstId read a byte last written by the store
+ * SrcId at StoreTime.  Every loop on the stack whose current invocation
+ * started before the store carries the dependence; it is loop-carried in
+ * that loop if the store happened in an earlier iteration.
+ */
+static void recordDependence(LAMPThreadState *T, uint32_t SrcId,
+                             uint32_t DstId, uint64_t StoreTime) {
+  unsigned i;
+  for (i = 0; i != T->NumLoops; ++i) {
+    LAMPLoopFrame *F = &T->Loops[i];
+    if (StoreTime < F->InvocationStart)
+      continue;
+    addDependence(T, F->LoopId, SrcId, DstId, StoreTime < F->IterationStart);
+  }
+}
+
+static void profileLoad(uint32_t Id, uint64_t Addr, unsigned Size) {
+  LAMPThreadState *T = getThreadState();
+  uint64_t PrevTime = 0, StaleStart = 0;
+  unsigned i;
+  ++T->Time;
+  if (!T->NumLoops || !T->Sampled)
+    return;
+  if (SampleBurst)
+    StaleStart = T->Loops[T->NumLoops - 1].InvocationStart;
+  for (i = 0; i != Size; ++i) {
+    uint64_t A = Addr + i;
+    LAMPShadowPage *P = getShadowPage(T, A >> LAMP_PAGE_BITS, 0);
+    LAMPShadowEntry *E;
+    if (!P)
+      continue;
+    E = &P->Entries[A & (LAMP_PAGE_SIZE - 1)];
+    /* Bytes written by the same store only count once. */
+    if (!E->Time || E->Time == PrevTime)
+      continue;
+    if (E->Time >= StaleStart && E->Time < T->BurstStart)
+      continue;
+    PrevTime = E->Time;
+    recordDependence(T, E->StoreId, Id, E->Time);
+  }
+}
+
+static void profileStore(uint32_t Id, uint64_t Addr, unsigned Size) {
+  LAMPThreadState *T = getThreadState();
+  uint64_t Time = ++T->Time;
+  unsigned i;
+  if (T->NumLoops && !T->Sampled)
+    return;
+  for (i = 0; i != Size; ++i) {
+    uint64_t A = Addr + i;
+    LAMPShadowEntry *E =
+      &getShadowPage(T, A >> LAMP_PAGE_BITS, 1)->Entries[A & (LAMP_PAGE_SIZE-1)];
+    E->Time = Time;
+    E->StoreId = Id;
+  }
+}
+
+void LAMP_load1(uint32_t Id, uint64_t Addr) { profileLoad(Id, Addr, 1); }
+void LAMP_load2(uint32_t Id, uint64_t Addr) { profileLoad(Id, Addr, 2); }
+void LAMP_load4(uint32_t Id, uint64_t Addr) { profileLoad(Id, Addr, 4); }
+void LAMP_load8(uint32_t Id, uint64_t Addr) { profileLoad(Id, Addr, 8); }
+
+void LAMP_store1(uint32_t Id, uint64_t Addr, uint64_t Value) {
+  profileStore(Id, Addr, 1);
+}
+void LAMP_store2(uint32_t Id, uint64_t Addr, uint64_t Value) {
+  profileStore(Id, Addr, 2);
+}
+void LAMP_store4(uint32_t Id, uint64_t Addr, uint64_t Value) {
+  profileStore(Id, Addr, 4);
+}
+void LAMP_store8(uint32_t Id, uint64_t Addr, uint64_t Value) {
+  profileStore(Id, Addr, 8);
+}
+
+/* LAMP_register - Called before external calls.  Their memory effects are
+ * not visible to the profiler, so there is nothing to record.
+ */
+void LAMP_register(uint32_t Id) {}
+
+void LAMP_loop_invocation(uint32_t LoopId) {
+  LAMPThreadState *T = getThreadState();
+  LAMPLoopFrame *F;
+  if (T->NumLoops == T->LoopCapacity) {
+    T->LoopCapacity = T->LoopCapacity ? 2 * T->LoopCapacity : 16;
+    T->Loops = (LAMPLoopFrame *)realloc(T->Loops, T->LoopCapacity *
+                                                  sizeof(LAMPLoopFrame));
+    if (!T->Loops) {
+      fprintf(stderr, "LAMP runtime: out of memory\n");
+      exit(1);
+    }
+  }
+  F = &T->Loops[T->NumLoops++];
+  F->LoopId = LoopId;
+  F->InvocationStart = F->IterationStart = T->Time + 1;
+  F->Iteration = 0;
+}
+
+/* updateSampling - Decide whether the current iteration of the innermost
+ * loop is profiled.
+ */
+static void updateSampling(LAMPThreadState *T) {
+  LAMPLoopFrame *F;
+  int WasSampled = T->Sampled;
+  if (!SampleBurst)
+    return;
+  if (!T->NumLoops) {
+    T->Sampled = 1;
+    return;
+  }
+  F = &T->Loops[T->NumLoops - 1];
+  T->Sampled = F->Iteration == 0 ||
+               (F->Iteration - 1) % SamplePeriod < SampleBurst;
+  if (T->Sampled && !WasSampled)
+    T->BurstStart = T->Time + 1;
+}
+
+void LAMP_loop_iteration_begin(void) {
+  LAMPThreadState *T = getThreadState();
+  if (!T->NumLoops)
+    return;
+  T->Loops[T->NumLoops - 1].IterationStart = T->Time + 1;
+  ++T->Loops[T->NumLoops - 1].Iteration;
+  updateSampling(T);
+}
+
+void LAMP_loop_iteration_end(void) {}
+
+void LAMP_loop_exit(void) {
+  LAMPThreadState *T = getThreadState();
+  if (T->NumLoops)
+    --T->NumLoops;
+  updateSampling(T);
+}
+
+static int compareRecords(const void *L, const void *R) {
+  const LAMPDepRecord *LHS = (const LAMPDepRecord *)L;
+  const LAMPDepRecord *RHS = (const LAMPDepRecord *)R;
+  if (LHS->LoopId != RHS->LoopId) return LHS->LoopId < RHS->LoopId ? -1 : 1;
+  if (LHS->SrcId != RHS->SrcId) return LHS->SrcId < RHS->SrcId ? -1 : 1;
+  if (LHS->DstId != RHS->DstId) return LHS->DstId < RHS->DstId ? -1 : 1;
+  if (LHS->CrossIter != RHS->CrossIter)
+    return LHS->CrossIter < RHS->CrossIter ? -1 : 1;
+  return 0;
+}
+
+/* mergeThreadStates - Concatenate the dependence tables of all shards, sort
+ * the result and fold records seen by several threads together.
+ */
+static LAMPDepRecord *mergeThreadStates(uint64_t *NumRecords) {
+  LAMPThreadState *T;
+  LAMPDepRecord *Records;
+  uint64_t Total = 0, N = 0, i;
+
+  for (T = ThreadList; T; T = T->Next)
+    Total += T->NumDeps;
+  Records = (LAMPDepRecord *)LAMPAlloc((Total ? Total : 1) *
+                                       sizeof(LAMPDepRecord));
+  for (T = ThreadList; T; T = T->Next)
+    for (i = 0; i != T->DepCapacity; ++i)
+      if (T->Deps[i].Count)
+        Records[N++] = T->Deps[i];
+
+  qsort(Records, N, sizeof(LAMPDepRecord), compareRecords);
+
+  /* Scale sampled counts back to an estimate of the true counts. */
+  if (SampleBurst)
+    for (i = 0; i != N; ++i)
+      Records[i].Count = (Records[i].Count * SamplePeriod + SampleBurst - 1) /
+                         SampleBurst;
+
+  Total = 0;
+  for (i = 0; i != N; ++i) {
+    if (Total && !compareRecords(&Records[Total - 1], &Records[i]))
+      Records[Total - 1].Count += Records[i].Count;
+    else
+      Records[Total++] = Records[i];
+  }
+  *NumRecords = Total;
+  return Records;
+}
+
+static void writeTextProfile(FILE *File, LAMPDepRecord *Records,
+                             uint64_t NumRecords) {
+  uint64_t i;
+  fprintf(File, "%s\n", LAMP_TEXT_PROFILE_BANNER);
+  for (i = 0; i != NumRecords; ++i)
+    fprintf(File, "%u %u %u %u %llu 0\n", Records[i].SrcId,
+            Records[i].CrossIter, Records[i].LoopId, Records[i].DstId,
+            (unsigned long long)Records[i].Count);
+  fprintf(File, "END Memory Profile\n");
+}
+
+static int writeBinaryProfile(FILE *File, LAMPDepRecord *Records,
+                              uint64_t NumRecords) {
+  LAMPProfileHeader Header;
+  LAMPLoopIndexEntry Entry;
+  uint64_t i;
+
+  memset(&Header, 0, sizeof(Header));
+  memcpy(Header.Magic, LAMP_PROFILE_MAGIC, LAMP_PROFILE_MAGIC_SIZE);
+  Header.Version = LAMP_PROFILE_VERSION;
+  Header.HeaderSize = sizeof(LAMPProfileHeader);
+  Header.NumRecords = NumRecords;
+  Header.RecordsOffset = sizeof(LAMPProfileHeader);
+  Header.LoopIndexOffset = Header.RecordsOffset +
+                           NumRecords * sizeof(LAMPDepRecord);
+  for (i = 0; i != NumRecords; ++i)
+    if (!i || Records[i].LoopId != Records[i - 1].LoopId)
+      ++Header.NumLoops;
+
+  if (fwrite(&Header, sizeof(Header), 1, File) != 1 ||
+      fwrite(Records, sizeof(LAMPDepRecord), NumRecords, File) != NumRecords)
+    return -1;
+
+  memset(&Entry, 0, sizeof(Entry));
+  for (i = 0; i != NumRecords; ++i) {
+    if (i && Records[i].LoopId == Entry.LoopId) {
+      ++Entry.NumRecords;
+      continue;
+    }
+    if (i && fwrite(&Entry, sizeof(Entry), 1, File) != 1)
+      return -1;
+    Entry.LoopId = Records[i].LoopId;
+    Entry.FirstRecord = i;
+    Entry.NumRecords = 1;
+  }
+  if (NumRecords && fwrite(&Entry, sizeof(Entry), 1, File) != 1)
+    return -1;
+  return 0;
+}
+
+/* LAMPAtExitHandler - Merge the per-thread shards and write the profile.
+ * Threads that are still running at this point may be updating their shard
+ * while it is read; their most recent dependences can be lost.
+ */
+static void LAMPAtExitHandler(void) {
+  const char *OutputFilename = getenv("LAMP_PROFILE_OUTPUT");
+  const char *Format = getenv("LAMP_PROFILE_FORMAT");
+  int Text = Format && !strcmp(Format, "text");
+  uint64_t NumRecords;
+  LAMPDepRecord *Records = mergeThreadStates(&NumRecords);
+  FILE *File;
+
+  if (!OutputFilename)
+    OutputFilename = "result.lamp.profile";
+  File = fopen(OutputFilename, Text ? "w" : "wb");
+  if (!File) {
+    fprintf(stderr, "LAMP runtime: while opening '%s': ", OutputFilename);
+    perror("");
+    free(Records);
+    return;
+  }
+
+  if (Text)
+    writeTextProfile(File, Records, NumRecords);
+  else if (writeBinaryProfile(File, Records, NumRecords))
+    fprintf(stderr, "LAMP runtime: unable to write to '%s'\n",
+            OutputFilename);
+  fclose(File);
+  free(Records);
+}
+
+/* LAMP_init - Inserted at the start of main by -insert-lamp-init.  The
+ * instruction and loop counts are not needed by the sharded tables, which
+ * grow on demand.  Period and Burst configure sampling; a burst of zero, or
+ * one that covers the whole period, profiles every iteration.
+ */
+void LAMP_init(uint32_t NumInsts, uint32_t NumLoops, uint64_t Period,
+               uint64_t Burst) {
+  if (Period > 1 && Burst && Burst < Period) {
+    SamplePeriod = Period;
+    SampleBurst = Burst;
+  }
+  getThreadState();
+  if (AtExitRegistered)
+    return;
+  AtExitRegistered = 1;
+  atexit(LAMPAtExitHandler);
+}
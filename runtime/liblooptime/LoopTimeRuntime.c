@@ -0,0 +1,350 @@
+/*===-- LoopTimeRuntime.c - Runtime for -myunroll loop timing -------------===*\
+|*
+|*                     The LLVM Compiler Infrastructure
+|*
+|* This file is distributed under the University of Illinois Open Source
+|* License. See LICENSE.TXT for details.
+|*
+|*===----------------------------------------------------------------------===*|
+|*
+|* This file implements the call back routines inserted by -myunroll:
+|* recordEntry and recordExit around every instrumented loop, setCopyCount at
+|* the start of main and printFinally at its end.
+|*
+|* The timer is the time stamp counter on x86, calibrated against
+|* CLOCK_MONOTONIC once, and CLOCK_MONOTONIC elsewhere.  The entry and exit
+|* hooks only read the timer and append an event to the calling thread's ring
+|* buffer; the thread turns its events into per-loop statistics and log2
+|* histograms when the buffer fills up.  No hook takes a lock or writes memory
+|* shared with another thread.
+|*
+|* printFinally merges all threads and appends one block to
+|* loop_exec_time.bin, or to the file named by LOOPTIME_OUTPUT (see
+|* llvm/Analysis/LoopTimeDataTypes.h).  Threads other than the caller must
+|* have finished by then.
+|*
+\*===----------------------------------------------------------------------===*/
+
+#include "llvm/Analysis/LoopTimeDataTypes.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Each thread finds its state through thread-local storage, and new states
+ * are published with a pointer compare-and-swap.  Compilers without the GCC
+ * extensions fall back to a pthread key and a mutex.
+ */
+#if defined(__GNUC__)
+#define LOOPTIME_THREAD_LOCAL __thread
+#define LOOPTIME_CAS_PTR(Ptr, Old, New)                                        \
+  __sync_bool_compare_and_swap(Ptr, Old, New)
+#else
+#include <pthread.h>
+#endif
+
+#define LOOPTIME_RING_SIZE 4096
+#define LOOPTIME_EXIT_BIT 0x80000000u
+
+typedef struct LoopTimeEvent {
+  uint32_t Index;           /* Loop index, LOOPTIME_EXIT_BIT set on exit. */
+  uint32_t Padding;
+  uint64_t Time;
+} LoopTimeEvent;
+
+typedef struct LoopTimeFrame {
+  uint32_t Index;
+  uint64_t Start;
+} LoopTimeFrame;
+
+typedef struct LoopTimeThreadState {
+  struct LoopTimeThreadState *Next;
+
+  /* Written by the owning thread only.  Head - Tail events are pending. */
+  LoopTimeEvent Ring[LOOPTIME_RING_SIZE];
+  uint64_t Head;
+  uint64_t Tail;
+
+  /* Loops currently executing, innermost last. */
+  LoopTimeFrame *Frames;
+  unsigned NumFrames;
+  unsigned FrameCapacity;
+
+  /* Statistics indexed by loop index. */
+  LoopTimeRecord *Loops;
+  uint64_t NumLoops;
+} LoopTimeThreadState;
+
+static LoopTimeThreadState *volatile ThreadList = 0;
+#ifdef LOOPTIME_THREAD_LOCAL
+static LOOPTIME_THREAD_LOCAL LoopTimeThreadState *CurThread = 0;
+#else
+static pthread_mutex_t ThreadListLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t CurThreadOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t CurThreadKey;
+static void createCurThreadKey(void) { pthread_key_create(&CurThreadKey, 0); }
+#endif
+
+static uint64_t CopyCount = 0;
+static uint64_t CyclesPerSecond = 0;
+static uint64_t TimerOverhead = 0;
+
+static void *LoopTimeAlloc(size_t Size) {
+  void *Mem = calloc(1, Size);
+  if (!Mem) {
+    fprintf(stderr, "looptime runtime: out of memory\n");
+    exit(1);
+  }
+  return Mem;
+}
+
+static uint64_t readMonotonicNs(void) {
+  struct timespec TS;
+  clock_gettime(CLOCK_MONOTONIC, &TS);
+  return (uint64_t)TS.tv_sec * 1000000000ULL + TS.tv_nsec;
+}
+
+#if defined(__i386__) || defined(__x86_64__)
+static inline uint64_t readTimer(void) {
+  uint32_t Lo, Hi;
+  __asm__ __volatile__("rdtsc" : "=a"(Lo), "=d"(Hi));
+  return ((uint64_t)Hi << 32) | Lo;
+}
+
+/* calibrateTimer - Measure the TSC frequency against CLOCK_MONOTONIC over
+ * about ten milliseconds.
+ */
+static uint64_t calibrateTimer(void) {
+  uint64_t StartNs = readMonotonicNs(), StartTicks = readTimer();
+  uint64_t EndNs, EndTicks;
+  do
+    EndNs = readMonotonicNs();
+  while (EndNs - StartNs < 10000000ULL);
+  EndTicks = readTimer();
+  return (uint64_t)((double)(EndTicks - StartTicks) * 1e9 /
+                    (double)(EndNs - StartNs));
+}
+#else
+static inline uint64_t readTimer(void) { return readMonotonicNs(); }
+static uint64_t calibrateTimer(void) { return 1000000000ULL; }
+#endif
+
+/* initTimer - Calibrate the timer and measure the cost of two back to back
+ * reads, which is subtracted from every sample.
+ */
+static void initTimer(void) {
+  uint64_t Min = ~0ULL;
+  unsigned i;
+  if (CyclesPerSecond)
+    return;
+  for (i = 0; i != 64; ++i) {
+    uint64_t Start = readTimer();
+    uint64_t Delta = readTimer() - Start;
+    if (Delta < Min)
+      Min = Delta;
+  }
+  TimerOverhead = Min;
+  CyclesPerSecond = calibrateTimer();
+}
+
+static LoopTimeThreadState *createThreadState(void) {
+  LoopTimeThreadState *T =
+    (LoopTimeThreadState *)LoopTimeAlloc(sizeof(LoopTimeThreadState));
+  LoopTimeThreadState *Head;
+#ifdef LOOPTIME_THREAD_LOCAL
+  do {
+    Head = ThreadList;
+    T->Next = Head;
+  } while (!LOOPTIME_CAS_PTR(&ThreadList, Head, T));
+  CurThread = T;
+#else
+  pthread_mutex_lock(&ThreadListLock);
+  Head = ThreadList;
+  T->Next = Head;
+  ThreadList = T;
+  pthread_mutex_unlock(&ThreadListLock);
+  pthread_setspecific(CurThreadKey, T);
+#endif
+  return T;
+}
+
+static inline LoopTimeThreadState *getThreadState(void) {
+#ifdef LOOPTIME_THREAD_LOCAL
+  LoopTimeThreadState *T = CurThread;
+#else
+  LoopTimeThreadState *T;
+  pthread_once(&CurThreadOnce, createCurThreadKey);
+  T = (LoopTimeThreadState *)pthread_getspecific(CurThreadKey);
+#endif
+  return T ? T : createThreadState();
+}
+
+static LoopTimeRecord *getLoopRecord(LoopTimeThreadState *T, uint32_t Index) {
+  if (Index >= T->NumLoops) {
+    uint64_t NewSize = T->NumLoops ? T->NumLoops : 64;
+    LoopTimeRecord *New;
+    while (NewSize <= Index)
+      NewSize *= 2;
+    New = (LoopTimeRecord *)LoopTimeAlloc(NewSize * sizeof(LoopTimeRecord));
+    if (T->NumLoops)
+      memcpy(New, T->Loops, T->NumLoops * sizeof(LoopTimeRecord));
+    free(T->Loops);
+    T->Loops = New;
+    T->NumLoops = NewSize;
+  }
+  return &T->Loops[Index];
+}
+
+static void addSample(LoopTimeRecord *R, uint64_t Ticks) {
+  unsigned Bucket = 0;
+  uint64_t V = Ticks;
+  while (V >>= 1)
+    ++Bucket;
+  if (!R->Invocations || Ticks < R->MinTicks)
+    R->MinTicks = Ticks;
+  if (Ticks > R->MaxTicks)
+    R->MaxTicks = Ticks;
+  ++R->Invocations;
+  R->TotalTicks += Ticks;
+  ++R->Histogram[Bucket];
+}
+
+/* drainEvents - Match the pending entry and exit events of T and fold the
+ * durations into its statistics.  An exit pops frames up to the matching
+ * entry, so loops left without passing their exit hook are dropped.
+ */
+static void drainEvents(LoopTimeThreadState *T) {
+  for (; T->Tail != T->Head; ++T->Tail) {
+    LoopTimeEvent *E = &T->Ring[T->Tail % LOOPTIME_RING_SIZE];
+    uint32_t Index = E->Index & ~LOOPTIME_EXIT_BIT;
+
+    if (!(E->Index & LOOPTIME_EXIT_BIT)) {
+      if (T->NumFrames == T->FrameCapacity) {
+        LoopTimeFrame *New;
+        T->FrameCapacity = T->FrameCapacity ? T->FrameCapacity * 2 : 16;
+        New = (LoopTimeFrame *)LoopTimeAlloc(T->FrameCapacity *
+                                             sizeof(LoopTimeFrame));
+        if (T->NumFrames)
+          memcpy(New, T->Frames, T->NumFrames * sizeof(LoopTimeFrame));
+        free(T->Frames);
+        T->Frames = New;
+      }
+      T->Frames[T->NumFrames].Index = Index;
+      T->Frames[T->NumFrames].Start = E->Time;
+      ++T->NumFrames;
+      continue;
+    }
+
+    {
+      unsigned i = T->NumFrames;
+      uint64_t Ticks;
+      while (i && T->Frames[i - 1].Index != Index)
+        --i;
+      if (!i)
+        continue;
+      T->NumFrames = i - 1;
+      Ticks = E->Time - T->Frames[i - 1].Start;
+      Ticks = Ticks > TimerOverhead ? Ticks - TimerOverhead : 0;
+      addSample(getLoopRecord(T, Index), Ticks);
+    }
+  }
+}
+
+static inline void recordEvent(uint32_t Index) {
+  LoopTimeThreadState *T = getThreadState();
+  LoopTimeEvent *E;
+  if (T->Head - T->Tail == LOOPTIME_RING_SIZE)
+    drainEvents(T);
+  E = &T->Ring[T->Head % LOOPTIME_RING_SIZE];
+  E->Index = Index;
+  E->Time = readTimer();
+  ++T->Head;
+}
+
+void recordEntry(int64_t Index) {
+  recordEvent((uint32_t)Index & ~LOOPTIME_EXIT_BIT);
+}
+
+void recordExit(int64_t Index) {
+  recordEvent((uint32_t)Index | LOOPTIME_EXIT_BIT);
+}
+
+/* setCopyCount - Inserted at the start of main with the unroll factor the
+ * program was compiled with.
+ */
+void setCopyCount(int64_t Count) {
+  CopyCount = Count;
+  initTimer();
+}
+
+/* printFinally - Inserted at the end of main.  Merge every thread's
+ * statistics and append them to the output file.
+ */
+void printFinally(int64_t ProgramId) {
+  LoopTimeThreadState *T;
+  LoopTimeRecord *Merged = 0;
+  uint64_t NumMerged = 0, NumRecords = 0, i;
+  LoopTimeHeader Header;
+  const char *OutputName;
+  FILE *File;
+
+  initTimer();
+  for (T = ThreadList; T; T = T->Next) {
+    drainEvents(T);
+    if (T->NumLoops > NumMerged)
+      NumMerged = T->NumLoops;
+  }
+  if (NumMerged)
+    Merged = (LoopTimeRecord *)LoopTimeAlloc(NumMerged *
+                                             sizeof(LoopTimeRecord));
+  for (T = ThreadList; T; T = T->Next)
+    for (i = 0; i != T->NumLoops; ++i) {
+      LoopTimeRecord *From = &T->Loops[i], *To = &Merged[i];
+      unsigned b;
+      if (!From->Invocations)
+        continue;
+      if (!To->Invocations || From->MinTicks < To->MinTicks)
+        To->MinTicks = From->MinTicks;
+      if (From->MaxTicks > To->MaxTicks)
+        To->MaxTicks = From->MaxTicks;
+      To->Invocations += From->Invocations;
+      To->TotalTicks += From->TotalTicks;
+      for (b = 0; b != LOOPTIME_NUM_BUCKETS; ++b)
+        To->Histogram[b] += From->Histogram[b];
+    }
+
+  /* Compact the loops that ran, numbering them as loop_features.txt does. */
+  for (i = 0; i != NumMerged; ++i)
+    if (Merged[i].Invocations) {
+      Merged[NumRecords] = Merged[i];
+      Merged[NumRecords].LoopId = (uint64_t)ProgramId * 100 + i;
+      ++NumRecords;
+    }
+
+  memset(&Header, 0, sizeof(Header));
+  memcpy(Header.Magic, LOOPTIME_MAGIC, LOOPTIME_MAGIC_SIZE);
+  Header.Version = LOOPTIME_VERSION;
+  Header.HeaderSize = sizeof(LoopTimeHeader);
+  Header.ProgramId = ProgramId;
+  Header.CopyCount = CopyCount;
+  Header.CyclesPerSecond = CyclesPerSecond;
+  Header.TimerOverhead = TimerOverhead;
+  Header.NumRecords = NumRecords;
+
+  OutputName = getenv("LOOPTIME_OUTPUT");
+  if (!OutputName || !*OutputName)
+    OutputName = "loop_exec_time.bin";
+  File = fopen(OutputName, "ab");
+  if (!File) {
+    fprintf(stderr, "looptime runtime: cannot open %s for appending\n",
+            OutputName);
+    free(Merged);
+    return;
+  }
+  if (fwrite(&Header, sizeof(Header), 1, File) != 1 ||
+      (NumRecords &&
+       fwrite(Merged, sizeof(LoopTimeRecord), NumRecords, File) != NumRecords))
+    fprintf(stderr, "looptime runtime: error writing %s\n", OutputName);
+  fclose(File);
+  free(Merged);
+}
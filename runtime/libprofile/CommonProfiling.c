@@ -171,3 +171,21 @@ void write_profiling_data(enum ProfilingType PT, unsigned *Start,
     exit(0);
   }
 }
+
+/* write_profiling_data64 - Write a block of 64-bit counters, see
+ * write_profiling_data.
+ */
+void write_profiling_data64(enum ProfilingType PT, uint64_t *Start,
+                            unsigned NumElements) {
+  int PTy;
+  int outFile = getOutFile();
+
+  /* Write out this record! */
+  PTy = PT;
+  if( write(outFile, &PTy, sizeof(int)) < 0 ||
+      write(outFile, &NumElements, sizeof(unsigned)) < 0 ||
+      write(outFile, Start, NumElements*sizeof(uint64_t)) < 0 ) {
+    fprintf(stderr,"error: unable to write to output file.");
+    exit(0);
+  }
+}
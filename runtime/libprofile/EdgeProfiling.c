@@ -43,3 +43,26 @@ int llvm_start_edge_profiling(int argc, const char **argv,
   atexit(EdgeProfAtExitHandler);
   return Ret;
 }
+
+static uint64_t *ArrayStart64;
+static unsigned NumElements64;
+
+/* EdgeProfAtExitHandler64 - Write out the 64-bit counters, including
+ * those of the threads that are still running.
+ */
+static void EdgeProfAtExitHandler64(void) {
+  merge_thread_counters();
+  write_profiling_data64(EdgeInfo64, ArrayStart64, NumElements64);
+}
+
+/* llvm_start_edge_profiling64 - The entry point of edge profiling with
+ * 64-bit counters, selected by -profile-counter-mode.
+ */
+int llvm_start_edge_profiling64(int argc, const char **argv,
+                                uint64_t *arrayStart, unsigned numElements) {
+  int Ret = save_arguments(argc, argv);
+  ArrayStart64 = arrayStart;
+  NumElements64 = numElements;
+  atexit(EdgeProfAtExitHandler64);
+  return Ret;
+}
@@ -43,3 +43,27 @@ int llvm_start_opt_edge_profiling(int argc, const char **argv,
   atexit(OptEdgeProfAtExitHandler);
   return Ret;
 }
+
+static uint64_t *ArrayStart64;
+static unsigned NumElements64;
+
+/* OptEdgeProfAtExitHandler64 - Write out the 64-bit counters, including
+ * those of the threads that are still running.
+ */
+static void OptEdgeProfAtExitHandler64(void) {
+  merge_thread_counters();
+  write_profiling_data64(OptEdgeInfo64, ArrayStart64, NumElements64);
+}
+
+/* llvm_start_opt_edge_profiling64 - The entry point of optimal edge profiling
+ * with 64-bit counters, selected by -profile-counter-mode.
+ */
+int llvm_start_opt_edge_profiling64(int argc, const char **argv,
+                                    uint64_t *arrayStart,
+                                    unsigned numElements) {
+  int Ret = save_arguments(argc, argv);
+  ArrayStart64 = arrayStart;
+  NumElements64 = numElements;
+  atexit(OptEdgeProfAtExitHandler64);
+  return Ret;
+}
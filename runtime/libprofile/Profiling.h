@@ -16,6 +16,7 @@
 #define PROFILING_H
 
 #include "llvm/Analysis/ProfileDataTypes.h" /* for enum ProfilingType */
+#include "llvm/Support/DataTypes.h"
 
 /* save_arguments - Save argc and argv as passed into the program for the file
  * we output.
@@ -33,4 +34,15 @@ int getOutFile();
 void write_profiling_data(enum ProfilingType PT, unsigned *Start,
                           unsigned NumElements);
 
+/* write_profiling_data64 - Like write_profiling_data, for 64-bit counters.
+ */
+void write_profiling_data64(enum ProfilingType PT, uint64_t *Start,
+                            unsigned NumElements);
+
+/* merge_thread_counters - Add the per-thread counters of the threads that are
+ * still running to the global counters.  Called before the counters are
+ * written out.
+ */
+void merge_thread_counters(void);
+
 #endif
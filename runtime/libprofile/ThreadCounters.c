@@ -0,0 +1,124 @@
+/*===-- ThreadCounters.c - Per-thread profiling counters ------------------===*\
+|*
+|*                     The LLVM Compiler Infrastructure
+|*
+|* This file is distributed under the University of Illinois Open Source
+|* License. See LICENSE.TXT for details.
+|*
+|*===----------------------------------------------------------------------===*|
+|*
+|* This file implements the per-thread counter mode of the profiling
+|* instrumentation (-profile-counter-mode=per-thread).  Every thread increments
+|* its own thread local copy of a counter array and registers the copy the
+|* first time it runs an instrumented function.  The copy is added to the
+|* global array when the thread exits, and the copies of the threads that are
+|* still running when the program exits are added before the profile is
+|* written.
+|*
+\*===----------------------------------------------------------------------===*/
+
+#include "Profiling.h"
+#include <stdio.h>
+#include <stdlib.h>
+#if !defined(_MSC_VER) && !defined(__MINGW32__)
+#include <pthread.h>
+#define HAVE_THREAD_EXIT_HOOK 1
+#endif
+
+typedef struct ThreadCounters {
+  struct ThreadCounters *Next;          /* In LiveCounters.                */
+  struct ThreadCounters *NextOfThread;  /* The owner's other arrays.       */
+  uint64_t *Counters;                   /* The owner's thread local copy.  */
+  uint64_t *Totals;                     /* The global array.               */
+  unsigned NumElements;
+} ThreadCounters;
+
+/* The copies of the threads that have not exited yet. */
+static ThreadCounters *LiveCounters = 0;
+
+#ifdef HAVE_THREAD_EXIT_HOOK
+static pthread_mutex_t CountersLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t KeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t ThreadKey;
+
+static void lockCounters(void) { pthread_mutex_lock(&CountersLock); }
+static void unlockCounters(void) { pthread_mutex_unlock(&CountersLock); }
+#else
+static void lockCounters(void) {}
+static void unlockCounters(void) {}
+#endif
+
+/* foldCounters - Add the copy to the global array and clear it, so that
+ * folding it again adds nothing.
+ */
+static void foldCounters(ThreadCounters *TC) {
+  unsigned i;
+  for (i = 0; i != TC->NumElements; ++i) {
+    TC->Totals[i] += TC->Counters[i];
+    TC->Counters[i] = 0;
+  }
+}
+
+#ifdef HAVE_THREAD_EXIT_HOOK
+/* threadExit - Fold the arrays of an exiting thread while its thread local
+ * storage is still valid.
+ */
+static void threadExit(void *Arg) {
+  ThreadCounters *TC = (ThreadCounters *)Arg, *Next;
+  lockCounters();
+  for (; TC; TC = Next) {
+    ThreadCounters **I = &LiveCounters;
+    Next = TC->NextOfThread;
+    foldCounters(TC);
+    while (*I != TC)
+      I = &(*I)->Next;
+    *I = TC->Next;
+    free(TC);
+  }
+  unlockCounters();
+}
+
+static void createThreadKey(void) {
+  pthread_key_create(&ThreadKey, threadExit);
+}
+#endif
+
+/* llvm_profile_register_thread_counters - Called by instrumented code the
+ * first time a thread runs a function that increments Counters, the thread's
+ * copy of the NumElements counters in Totals.
+ */
+void llvm_profile_register_thread_counters(uint64_t *Counters,
+                                           uint64_t *Totals,
+                                           unsigned NumElements) {
+  ThreadCounters *TC = (ThreadCounters *)malloc(sizeof(ThreadCounters));
+  if (!TC) {
+    fprintf(stderr, "LLVM profiling runtime: out of memory\n");
+    exit(1);
+  }
+  TC->Counters = Counters;
+  TC->Totals = Totals;
+  TC->NumElements = NumElements;
+  TC->NextOfThread = 0;
+
+#ifdef HAVE_THREAD_EXIT_HOOK
+  pthread_once(&KeyOnce, createThreadKey);
+  TC->NextOfThread = (ThreadCounters *)pthread_getspecific(ThreadKey);
+  pthread_setspecific(ThreadKey, TC);
+#endif
+
+  lockCounters();
+  TC->Next = LiveCounters;
+  LiveCounters = TC;
+  unlockCounters();
+}
+
+/* merge_thread_counters - Fold the copies of the threads that are still
+ * running.  Their increments made while this runs may be lost.
+ */
+void merge_thread_counters(void) {
+  ThreadCounters *TC;
+  lockCounters();
+  for (TC = LiveCounters; TC; TC = TC->Next)
+    foldCounters(TC);
+  unlockCounters();
+}
@@ -0,0 +1,43 @@
+; RUN: opt < %s -basicaa -basicaa-result-cache -aa-eval -print-all-alias-modref-info -gvn -aa-eval -disable-output 2>&1 | FileCheck %s
+; RUN: opt < %s -basicaa -basicaa-result-cache=false -aa-eval -print-all-alias-modref-info -gvn -aa-eval -disable-output 2>&1 | FileCheck %s
+
+; With -basicaa-result-cache, BasicAA remembers the results of queries on a
+; function between queries.  GVN replaces and deletes %q2, which must drop its
+; results before the second run of -aa-eval asks again.
+
+target datalayout = "e-p:64:64:64-i32:32:32-i64:64:64"
+
+; CHECK: Function: f: 4 pointers, 0 call sites
+; CHECK: NoAlias:      i32* %a, i32* %p
+; CHECK: PartialAlias: i32* %p, i32* %q
+; CHECK: MustAlias:    i32* %q, i32* %q2
+; CHECK: Function: f: 3 pointers, 0 call sites
+; CHECK: NoAlias:      i32* %a, i32* %p
+; CHECK: PartialAlias: i32* %p, i32* %q
+; CHECK-NOT: %q2
+define void @f(i32* %a, i64 %i) {
+entry:
+  %p = getelementptr i32* %a, i64 1
+  %q = getelementptr i32* %a, i64 %i
+  %q2 = getelementptr i32* %a, i64 %i
+  store i32 0, i32* %p
+  store i32 1, i32* %q
+  store i32 2, i32* %q2
+  ret void
+}
+
+; A local object that does not escape is not aliased by a pointer loaded from
+; memory; that result depends on all the uses of the object.
+; CHECK: Function: g: 3 pointers, 0 call sites
+; CHECK: NoAlias:      i32* %l, i32* %x
+; CHECK: Function: g: 3 pointers, 0 call sites
+; CHECK: NoAlias:      i32* %l, i32* %x
+define i32 @g(i32** %pp) {
+entry:
+  %x = alloca i32
+  %l = load i32** %pp
+  store i32 0, i32* %x
+  store i32 1, i32* %l
+  %v = load i32* %x
+  ret i32 %v
+}
@@ -0,0 +1,83 @@
+; RUN: opt < %s -basicaa -memoryssa -analyze | FileCheck %s
+
+target datalayout = "e-p:64:64:64-i32:32:32-i64:64:64"
+
+declare void @g()
+declare i32 @h(i32*) readonly
+
+; The phi at the join merges the stores of both sides.
+; CHECK: define i32 @diamond
+; CHECK: 1 = MemoryDef(liveOnEntry)
+; CHECK-NEXT: store i32 0, i32* %p
+; CHECK: 2 = MemoryDef(1)
+; CHECK-NEXT: store i32 1, i32* %q
+; CHECK: MemoryUse(1)
+; CHECK-NEXT: %r = load i32* %q
+; CHECK: join:
+; CHECK-NEXT: 3 = MemoryPhi({%right,1},{%left,2})
+; CHECK-NEXT: MemoryUse(3)
+; CHECK-NEXT: %v = load i32* %p
+define i32 @diamond(i32* %p, i32* %q, i1 %c) {
+entry:
+  store i32 0, i32* %p
+  br i1 %c, label %left, label %right
+left:
+  store i32 1, i32* %q
+  br label %join
+right:
+  %r = load i32* %q
+  br label %join
+join:
+  %v = load i32* %p
+  ret i32 %v
+}
+
+; A join whose sides write nothing needs no phi.  A readonly call is a use
+; and a volatile load is a def.
+; CHECK: define i32 @nophi
+; CHECK: join:
+; CHECK-NOT: MemoryPhi
+; CHECK: MemoryUse(liveOnEntry)
+; CHECK-NEXT: %v = load i32* %p
+; CHECK: MemoryUse(liveOnEntry)
+; CHECK-NEXT: %w = call i32 @h(i32* %p)
+; CHECK: 1 = MemoryDef(liveOnEntry)
+; CHECK-NEXT: %x = load volatile i32* %p
+; CHECK: 2 = MemoryDef(1)
+; CHECK-NEXT: call void @g()
+define i32 @nophi(i32* %p, i1 %c) {
+entry:
+  br i1 %c, label %left, label %join
+left:
+  br label %join
+join:
+  %v = load i32* %p
+  %w = call i32 @h(i32* %p)
+  %x = load volatile i32* %p
+  call void @g()
+  %s = add i32 %v, %w
+  %t = add i32 %s, %x
+  ret i32 %t
+}
+
+; CHECK: define i32 @loop
+; CHECK: body:
+; CHECK-NEXT: 2 = MemoryPhi({%body,3},{%entry,1})
+; CHECK: 3 = MemoryDef(2)
+; CHECK-NEXT: store i32 %i, i32* %q
+; CHECK: MemoryUse(3)
+; CHECK-NEXT: %v = load i32* %p
+define i32 @loop(i32* noalias %p, i32* noalias %q, i32 %n) {
+entry:
+  store i32 5, i32* %p
+  br label %body
+body:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %body ]
+  store i32 %i, i32* %q
+  %v = load i32* %p
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %body
+exit:
+  ret i32 %v
+}
@@ -0,0 +1,53 @@
+; Test the counter update strategies of the edge profiling instrumentation.
+; RUN: opt < %s -insert-edge-profiling -profile-counter-mode=atomic -S | FileCheck -check-prefix=ATOMIC %s
+; RUN: opt < %s -insert-edge-profiling -profile-counter-mode=per-thread -S | FileCheck -check-prefix=THREAD %s
+; RUN: opt < %s -insert-edge-profiling -profile-counter-mode=promote -S | FileCheck -check-prefix=PROMOTE %s
+
+; ATOMIC: @EdgeProfCounters = internal global [5 x i64] zeroinitializer
+; THREAD: @EdgeProfCounters = internal global [5 x i64] zeroinitializer
+; THREAD: @EdgeProfCounters.thread = internal thread_local global [5 x i64] zeroinitializer
+; THREAD: @EdgeProfCounters.registered = internal thread_local global i1 false
+; PROMOTE: @EdgeProfCounters = internal global [5 x i64] zeroinitializer
+
+define void @loop(i32 %n) nounwind {
+entry:
+; ATOMIC: entry:
+; ATOMIC: atomicrmw add i64* getelementptr inbounds ([5 x i64]* @EdgeProfCounters, i32 0, i32 0), i64 1 monotonic
+
+; THREAD: entry:
+; THREAD-NEXT: %profile.registered = load i1* @EdgeProfCounters.registered
+; THREAD-NEXT: br i1 %profile.registered, label %profile.body, label %profile.register
+; THREAD: profile.register:
+; THREAD-NEXT: call void @llvm_profile_register_thread_counters(i64* getelementptr inbounds ([5 x i64]* @EdgeProfCounters.thread, i32 0, i32 0), i64* getelementptr inbounds ([5 x i64]* @EdgeProfCounters, i32 0, i32 0), i32 5)
+; THREAD-NEXT: store i1 true, i1* @EdgeProfCounters.registered
+; THREAD: profile.body:
+; THREAD: load i64* getelementptr inbounds ([5 x i64]* @EdgeProfCounters.thread, i32 0, i32 0)
+  br label %header
+
+header:
+; PROMOTE: header:
+; PROMOTE-NEXT: %profile.local.0 = phi i64 [ 0, %entry ], [ %NewFuncCounter, %header.header_crit_edge ]
+  %i = phi i32 [ 0, %entry ], [ %next, %header ]
+  %next = add i32 %i, 1
+  %done = icmp eq i32 %next, %n
+  br i1 %done, label %exit, label %header
+
+; The backedge counter is kept in a register and added on the loop exit.
+; PROMOTE: header.header_crit_edge:
+; PROMOTE-NOT: atomicrmw
+; PROMOTE: %NewFuncCounter = add i64 %profile.local.0, 1
+; PROMOTE: exit:
+; PROMOTE-NEXT: atomicrmw add i64* getelementptr inbounds ([5 x i64]* @EdgeProfCounters, i32 0, i32 3), i64 %profile.local.0 monotonic
+; PROMOTE-NEXT: atomicrmw add i64* getelementptr inbounds ([5 x i64]* @EdgeProfCounters, i32 0, i32 2), i64 1 monotonic
+exit:
+  ret void
+}
+
+define i32 @main(i32 %argc, i8** %argv) nounwind {
+entry:
+; ATOMIC: call i32 @llvm_start_edge_profiling64(i32 %argc, i8** %argv, i64* getelementptr inbounds ([5 x i64]* @EdgeProfCounters, i32 0, i32 0), i32 5)
+; THREAD: call i32 @llvm_start_edge_profiling64(
+; PROMOTE: call i32 @llvm_start_edge_profiling64(
+  call void @loop(i32 100)
+  ret i32 0
+}
@@ -0,0 +1,48 @@
+; RUN: opt < %s -analyze -scalar-evolution -scev-sparse | FileCheck %s
+; RUN: opt < %s -indvars -scev-sparse -scev-report-footprint -disable-output 2>&1 | FileCheck %s -check-prefix=NESTS
+; RUN: opt < %s -indvars -scev-sparse -scev-cache-limit=0 -scev-report-footprint -disable-output 2>&1 | FileCheck %s -check-prefix=RESET
+
+; With -scev-sparse, values that neither are in a loop, feed one, nor use
+; one are left opaque.
+
+; CHECK: @test
+; CHECK: %unrelated = add i32 %a, 1
+; CHECK-NEXT: -->  %unrelated
+; CHECK: %start = add i32 %a, 2
+; CHECK-NEXT: -->  (2 + %a)
+; CHECK: %i.next = add i32 %i, 1
+; CHECK-NEXT: -->  {(3 + %a),+,1}<%loop>
+; CHECK: %exit = mul i32 %i.next, 2
+; CHECK-NEXT: -->  {(6 + (2 * %a)),+,2}<%loop>
+; CHECK: %j = phi i32
+; CHECK-NEXT: -->  {0,+,1}<nuw><nsw><%loop2>
+
+; NESTS: SCEV footprint of 'test': peak {{[0-9]+}} KB, 2 loop nests released, 0 cache resets
+; RESET: SCEV footprint of 'test': peak {{[0-9]+}} KB, 2 loop nests released, 2 cache resets
+
+define i32 @test(i32 %a, i32 %n, i32* %p) {
+entry:
+  %unrelated = add i32 %a, 1
+  store i32 %unrelated, i32* %p
+  %start = add i32 %a, 2
+  br label %loop
+
+loop:
+  %i = phi i32 [ %start, %entry ], [ %i.next, %loop ]
+  %i.next = add i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %mid
+
+mid:
+  %exit = mul i32 %i.next, 2
+  br label %loop2
+
+loop2:
+  %j = phi i32 [ 0, %mid ], [ %j.next, %loop2 ]
+  %j.next = add nsw i32 %j, 1
+  %c2 = icmp slt i32 %j.next, 100
+  br i1 %c2, label %loop2, label %done
+
+done:
+  ret i32 %exit
+}
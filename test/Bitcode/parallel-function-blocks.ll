@@ -0,0 +1,61 @@
+; RUN: llvm-as < %s > %t.serial.bc
+; RUN: llvm-as -bitcode-writer-threads=4 < %s > %t.parallel.bc
+; RUN: cmp %t.serial.bc %t.parallel.bc
+; RUN: llvm-dis < %t.parallel.bc | FileCheck %s
+
+; With -bitcode-writer-threads the function blocks are encoded on several
+; threads and spliced into the module block; the file must be the same as
+; when they are written one at a time.
+
+@str = private constant [6 x i8] c"hello\00"
+
+; CHECK: define void @jumps(i8** %p)
+; CHECK: store i8* blockaddress(@target, %other), i8** %p
+define void @jumps(i8** %p) {
+  store i8* blockaddress(@target, %other), i8** %p
+  ret void
+}
+
+; CHECK: define void @target(i8* %dest)
+define void @target(i8* %dest) {
+entry:
+  indirectbr i8* %dest, [label %other]
+other:
+  ret void
+}
+
+; Function-local constants, metadata and debug locations.
+; CHECK: define i32 @loop(i32 %n)
+; CHECK: %i = phi i32 [ 0, %entry ], [ %next, %body ]
+; CHECK: call void @llvm.dbg.value(metadata !{i32 %i}, i64 0, metadata !0), !dbg !1
+; CHECK: %next = add i32 %i, 1234567, !dbg !2
+; CHECK: store i8 %c, i8* getelementptr inbounds ([6 x i8]* @str, i32 0, i32 0)
+define i32 @loop(i32 %n) {
+entry:
+  br label %body
+body:
+  %i = phi i32 [ 0, %entry ], [ %next, %body ]
+  call void @llvm.dbg.value(metadata !{i32 %i}, i64 0, metadata !0), !dbg !1
+  %next = add i32 %i, 1234567, !dbg !2
+  %c = trunc i32 %next to i8
+  store i8 %c, i8* getelementptr inbounds ([6 x i8]* @str, i32 0, i32 0)
+  %done = icmp eq i32 %next, %n
+  br i1 %done, label %"exit block", label %body
+"exit block":
+  ret i32 %next
+}
+
+; CHECK: define double @float(double %x)
+; CHECK: fmul double %x, 2.500000e+00
+define double @float(double %x) {
+  %y = fmul double %x, 2.5
+  ret double %y
+}
+
+declare void @llvm.dbg.value(metadata, i64, metadata) nounwind readnone
+
+!llvm.named = !{!0}
+
+!0 = metadata !{metadata !"variable"}
+!1 = metadata !{i32 7, i32 3, metadata !0, null}
+!2 = metadata !{i32 8, i32 5, metadata !0, null}
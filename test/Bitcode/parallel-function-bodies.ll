@@ -0,0 +1,69 @@
+; RUN: llvm-as < %s > %t.bc
+; RUN: llvm-dis < %t.bc > %t.serial.ll
+; RUN: llvm-dis -bitcode-threads=4 < %t.bc > %t.parallel.ll
+; RUN: diff %t.serial.ll %t.parallel.ll
+; RUN: FileCheck %s < %t.parallel.ll
+; RUN: llvm-link -S %t.bc -o %t.link.serial.ll
+; RUN: llvm-link -S -bitcode-threads=4 %t.bc -o %t.link.parallel.ll
+; RUN: diff %t.link.serial.ll %t.link.parallel.ll
+
+; With -bitcode-threads the function bodies are read on several threads; the
+; module must come out as it does when they are read one at a time.
+
+@table = global i8* blockaddress(@target, %second)
+
+; Block addresses of a function that another thread may be reading.
+; CHECK: define void @early(i8** %p)
+; CHECK: store i8* blockaddress(@target, %first), i8** %p
+; CHECK: store i8* blockaddress(@late, %exit), i8** %p
+define void @early(i8** %p) {
+  store i8* blockaddress(@target, %first), i8** %p
+  store i8* blockaddress(@late, %exit), i8** %p
+  ret void
+}
+
+; CHECK: define void @target(i8* %dest)
+; CHECK: indirectbr i8* blockaddress(@target, %second)
+define void @target(i8* %dest) {
+entry:
+  indirectbr i8* blockaddress(@target, %second), [label %first, label %second]
+first:
+  ret void
+second:
+  indirectbr i8* %dest, [label %first]
+}
+
+; Forward references, local metadata and an intrinsic that is upgraded.
+; CHECK: define i32 @loop(i32 %n)
+; CHECK: %i = phi i32 [ 0, %entry ], [ %next, %body ]
+; CHECK: call i32 @llvm.ctlz.i32(i32 %i, i1 false)
+; CHECK: call void @llvm.dbg.value(metadata !{i32 %i}, i64 0, metadata !0), !dbg !1
+define i32 @loop(i32 %n) {
+entry:
+  br label %body
+body:
+  %i = phi i32 [ 0, %entry ], [ %next, %body ]
+  %z = call i32 @llvm.ctlz.i32(i32 %i)
+  call void @llvm.dbg.value(metadata !{i32 %i}, i64 0, metadata !0), !dbg !1
+  %next = add i32 %i, %z
+  %done = icmp eq i32 %next, %n
+  br i1 %done, label %exit, label %body
+exit:
+  ret i32 %next
+}
+
+; CHECK: define void @late()
+define void @late() {
+entry:
+  br label %exit
+exit:
+  ret void
+}
+
+declare i32 @llvm.ctlz.i32(i32)
+declare void @llvm.dbg.value(metadata, i64, metadata) nounwind readnone
+
+!llvm.named = !{!0}
+
+!0 = metadata !{metadata !"variable"}
+!1 = metadata !{i32 7, i32 3, metadata !0, null}
@@ -0,0 +1,28 @@
+; RUN: llvm-as < %s | llvm-bcanalyzer -dump | FileCheck %s
+
+; Value symbol table entries are written in value order, blocks last, rather
+; than in the order of the symbol table's hash buckets.
+
+; CHECK: <FUNCTION_BLOCK
+; CHECK: <VALUE_SYMTAB
+; CHECK-NEXT: <ENTRY {{.*}}op0=1 
+; CHECK-NEXT: <ENTRY {{.*}}op0=2 
+; CHECK-NEXT: <ENTRY {{.*}}op0=3 
+; CHECK-NEXT: <ENTRY {{.*}}op0=4 
+; CHECK-NEXT: <ENTRY {{.*}}op0=5 
+; CHECK-NEXT: <ENTRY {{.*}}op0=6 
+; CHECK-NEXT: <BBENTRY {{.*}}op0=0 
+; CHECK-NEXT: <BBENTRY {{.*}}op0=1 
+; CHECK-NEXT: </VALUE_SYMTAB>
+
+define i32 @f(i32 %zeta, i32 %alpha) {
+start:
+  %gamma = add i32 %zeta, %alpha
+  %delta = mul i32 %gamma, %zeta
+  %omega = sub i32 %delta, %alpha
+  %kappa = xor i32 %omega, %gamma
+  br label %finish
+
+finish:
+  ret i32 %kappa
+}
@@ -0,0 +1,63 @@
+; RUN: opt < %s -S -profile-loader -profile-info-file=%S/Inputs/hot-loops.llvmprof \
+; RUN:   -insert-lamp-profiling -insert-lamp-loop-profiling -lamp-hot-loops-only \
+; RUN:   -lamp-hot-loop-threshold=100 | FileCheck %s
+; RUN: opt < %s -S -profile-loader -profile-info-file=%S/Inputs/hot-loops.llvmprof \
+; RUN:   -insert-lamp-profiling -insert-lamp-loop-profiling \
+; RUN:   | FileCheck %s -check-prefix=ALL
+
+; The edge profile runs the outer loop header 10 times and the inner one 1000
+; times.  With a threshold of 100 only the inner loop is instrumented, but the
+; ids stay those of the fully instrumented function.
+
+target datalayout = "e-p:64:64:64-i32:32:32-i64:64:64-n32:64"
+
+define void @nest(i32* %p, i32* %q, i64 %n) {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  store i32 0, i32* %p
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %v = load i32* %q
+  %j.next = add i64 %j, 1
+  %c.inner = icmp ult i64 %j.next, %n
+  br i1 %c.inner, label %inner, label %outer.latch
+
+outer.latch:
+  %i.next = add i64 %i, 1
+  %c.outer = icmp ult i64 %i.next, %n
+  br i1 %c.outer, label %outer, label %exit
+
+exit:
+  ret void
+}
+
+; CHECK: entry:
+; CHECK-NOT: call void @LAMP_
+; CHECK: outer:
+; CHECK-NOT: call void @LAMP_store4
+; CHECK: store i32 0, i32* %p
+; CHECK-NEXT: call void @LAMP_loop_invocation(i32 [[INNER:[0-9]+]])
+; CHECK: inner:
+; CHECK: call void @LAMP_loop_iteration_begin()
+; CHECK: call void @LAMP_load4(i32 1,
+; CHECK: outer.latch:
+; CHECK: call void @LAMP_loop_exit()
+; CHECK-NOT: call void @LAMP_
+; CHECK: exit:
+; CHECK-NEXT: ret void
+
+; ALL: entry:
+; ALL-NEXT: call void @LAMP_loop_invocation(i32 [[OUTER:[0-9]+]])
+; ALL: outer:
+; ALL: call void @LAMP_store4(i32 0,
+; ALL: call void @LAMP_loop_invocation(i32 [[INNER:[0-9]+]])
+; ALL: inner:
+; ALL: call void @LAMP_load4(i32 1,
+; ALL: exit:
+; ALL-NEXT: call void @LAMP_loop_iteration_end()
+; ALL-NEXT: call void @LAMP_loop_exit()
@@ -0,0 +1,46 @@
+; RUN: opt < %s -S -insert-lamp-profiling -insert-lamp-loop-profiling \
+; RUN:   -insert-lamp-init | FileCheck %s -check-prefix=FULL
+; RUN: opt < %s -S -insert-lamp-profiling -insert-lamp-loop-profiling \
+; RUN:   -insert-lamp-init -lamp-sample-period=8 -lamp-sample-burst=2 \
+; RUN:   | FileCheck %s -check-prefix=SAMPLE
+; A burst that covers the whole period profiles every iteration.
+; RUN: opt < %s -S -insert-lamp-profiling -insert-lamp-loop-profiling \
+; RUN:   -insert-lamp-init -lamp-sample-period=4 -lamp-sample-burst=4 \
+; RUN:   | FileCheck %s -check-prefix=FULL
+
+; The sampling parameters reach the runtime through the last two LAMP_init
+; arguments.  The accesses are instrumented the same way in both modes.
+
+target datalayout = "e-p:64:64:64-i32:32:32-i64:64:64-n32:64"
+
+define i32 @main() {
+entry:
+  %a = alloca [16 x i32]
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr [16 x i32]* %a, i64 0, i64 %i
+  %v = load i32* %p
+  store i32 %v, i32* %p
+  %i.next = add i64 %i, 1
+  %c = icmp ult i64 %i.next, 16
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 0
+}
+
+; FULL: entry:
+; FULL: call void @LAMP_init(i32 {{[0-9]+}}, i32 {{[0-9]+}}, i64 1, i64 0)
+; FULL: loop:
+; FULL: call void @LAMP_loop_iteration_begin()
+; FULL: call void @LAMP_load4(i32 0,
+; FULL: call void @LAMP_store4(i32 1,
+
+; SAMPLE: entry:
+; SAMPLE: call void @LAMP_init(i32 {{[0-9]+}}, i32 {{[0-9]+}}, i64 8, i64 2)
+; SAMPLE: loop:
+; SAMPLE: call void @LAMP_loop_iteration_begin()
+; SAMPLE: call void @LAMP_load4(i32 0,
+; SAMPLE: call void @LAMP_store4(i32 1,
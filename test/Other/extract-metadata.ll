@@ -0,0 +1,30 @@
+; RUN: llvm-as < %s > %t
+; RUN: llvm-extract -func foo -S %t | FileCheck %s
+; RUN: llvm-extract -func foo -S %t -lazy-bitcode-metadata=false | FileCheck %s
+
+; llvm-extract reads the metadata of a bitcode file lazily.  The metadata of
+; the extracted function and the named metadata must still come through.
+
+; CHECK: define void @foo() {
+; CHECK:   ret void, !foo [[FOO:![0-9]+]]
+; CHECK-NOT: define
+; CHECK: !named = !{[[NAMED:![0-9]+]]}
+; CHECK: [[NAMED]] = metadata !{metadata !"named"}
+; CHECK: [[FOO]] = metadata !{metadata [[CYCLE:![0-9]+]], metadata !"foo"}
+; CHECK: [[CYCLE]] = metadata !{metadata [[FOO]]}
+; CHECK-NOT: metadata !"bar"
+
+define void @foo() {
+  ret void, !foo !0
+}
+
+define void @bar() {
+  ret void, !bar !2
+}
+
+!named = !{!3}
+
+!0 = metadata !{metadata !1, metadata !"foo"}
+!1 = metadata !{metadata !0}
+!2 = metadata !{metadata !"bar"}
+!3 = metadata !{metadata !"named"}
@@ -0,0 +1,78 @@
+; RUN: rm -rf %t.cache
+; RUN: opt -instcombine -simplifycfg %s -o %t.plain.bc
+; RUN: opt -instcombine -simplifycfg -function-cache-dir %t.cache %s -o %t.cold.bc \
+; RUN:   -debug-pass=Executions 2>&1 | FileCheck %s -check-prefix=COLD
+; RUN: opt -instcombine -simplifycfg -function-cache-dir %t.cache %s -o %t.warm.bc \
+; RUN:   -debug-pass=Executions 2>&1 | FileCheck %s -check-prefix=WARM
+; RUN: cmp %t.plain.bc %t.cold.bc
+; RUN: cmp %t.plain.bc %t.warm.bc
+; RUN: llvm-dis < %t.warm.bc | FileCheck %s
+; RUN: opt -O1 -function-cache-dir %t.cache %s -disable-output 2>&1 \
+; RUN:   | FileCheck %s -check-prefix=IGNORED
+
+; With -function-cache-dir, opt reuses the result of the function passes on
+; functions it has optimized before.  The module must come out the same.
+
+target datalayout = "e-p:64:64:64-i32:32:32-i64:64:64-f64:64:64"
+
+%FILE = type opaque
+%pair = type { i32, i32 }
+
+@hello = constant [7 x i8] c"hello\0A\00"
+@counter = global i32 0
+@0 = global i32 0
+
+declare i32 @fputs(i8*, %FILE*)
+
+; The struct types of a cached function are renamed on the way back in.
+; CHECK: define i32 @sum(%pair* %p)
+; CHECK-NEXT: entry:
+; CHECK-NEXT: %a = getelementptr %pair* %p, i64 0, i32 0
+define i32 @sum(%pair* %p) {
+entry:
+  %a = getelementptr %pair* %p, i32 0, i32 0
+  %b = getelementptr %pair* %p, i32 0, i32 1
+  %x = load i32* %a
+  %y = load i32* %b
+  %s = add i32 %x, %y
+  %t = add i32 %s, 0
+  ret i32 %t
+}
+
+; The declaration of fwrite that instcombine adds comes back with the body.
+; CHECK: define void @greet(%FILE* %fp)
+; CHECK: call i64 @fwrite
+define void @greet(%FILE* %fp) {
+  %str = getelementptr [7 x i8]* @hello, i32 0, i32 0
+  call i32 @fputs(i8* %str, %FILE* %fp)
+  ret void
+}
+
+; CHECK: define void @bump()
+define void @bump() {
+  %v = load i32* @counter
+  %w = add i32 %v, 1
+  store i32 %w, i32* @counter
+  br label %exit
+exit:
+  ret void
+}
+
+; Unnamed globals cannot be found again by name, so this one always runs.
+; CHECK: define void @unnamed()
+define void @unnamed() {
+  store i32 1, i32* @0
+  ret void
+}
+
+; CHECK: declare i64 @fwrite
+
+; COLD: Executing Pass 'Combine redundant instructions' on Function 'sum'
+; COLD: Executing Pass 'Combine redundant instructions' on Function 'greet'
+
+; WARM-NOT: on Function 'sum'
+; WARM-NOT: on Function 'greet'
+; WARM-NOT: on Function 'bump'
+; WARM: Executing Pass 'Combine redundant instructions' on Function 'unnamed'
+
+; IGNORED: warning: -function-cache-dir only applies to function passes
@@ -0,0 +1,135 @@
+; RUN: opt -S -instcombine -gvn -simplifycfg %s -o %t.serial
+; RUN: opt -S -instcombine -gvn -simplifycfg -pass-threads=4 %s -o %t.parallel
+; RUN: diff %t.serial %t.parallel
+; RUN: opt -S -instcombine -gvn -simplifycfg -pass-threads=3 %s | diff %t.serial -
+; RUN: FileCheck %s < %t.parallel
+; RUN: opt -instcombine -gvn -simplifycfg %s -o %t.serial.bc
+; RUN: opt -instcombine -gvn -simplifycfg -pass-threads=4 %s -o %t.parallel.bc
+; RUN: cmp %t.serial.bc %t.parallel.bc
+
+; The function passes run on several threads with -pass-threads; the result
+; must not differ from a serial run.
+
+target datalayout = "e-p:64:64:64-i32:32:32-i64:64:64-f64:64:64"
+
+@G = global [4 x i32] zeroinitializer
+@S = private constant [6 x i8] c"hello\00"
+@A = private constant [2 x i8] c"a\00"
+@HI = private constant [4 x i8] c"hi\0A\00"
+@BYE = private constant [5 x i8] c"bye\0A\00"
+
+; The printf calls below become calls to putchar and puts, and the strings
+; for puts become new globals.  They must be added in function order, as in
+; a serial run, which is also what decides the names of the strings.
+; CHECK: @str = private unnamed_addr constant [3 x i8] c"hi\00"
+; CHECK-NEXT: @str1 = private unnamed_addr constant [4 x i8] c"bye\00"
+
+declare i32 @llvm.ctpop.i32(i32)
+declare i32 @printf(i8*, ...)
+
+; CHECK: define i32 @fold_add
+; CHECK-NEXT: entry:
+; CHECK-NEXT: ret i32 42
+define i32 @fold_add() {
+entry:
+  %a = add i32 40, 1
+  %b = add i32 %a, 1
+  ret i32 %b
+}
+
+; CHECK: define i32 @redundant_load
+; CHECK: load i32* getelementptr inbounds ([4 x i32]* @G, i64 0, i64 1)
+; CHECK-NOT: load
+; CHECK: ret i32
+define i32 @redundant_load(i32 %x) {
+entry:
+  %p = getelementptr [4 x i32]* @G, i64 0, i64 1
+  %v1 = load i32* %p, !tbaa !0
+  %v2 = load i32* %p, !tbaa !0
+  %s = add i32 %v1, %v2
+  %c = call i32 @llvm.ctpop.i32(i32 %x)
+  %r = add i32 %s, %c
+  ret i32 %r
+}
+
+; CHECK: define i32 @dead_branch
+; CHECK-NOT: br
+; CHECK: ret i32 7
+define i32 @dead_branch() {
+entry:
+  br i1 true, label %t, label %f
+t:
+  br label %join
+f:
+  br label %join
+join:
+  %p = phi i32 [ 7, %t ], [ 9, %f ]
+  ret i32 %p
+}
+
+; CHECK: define i8 @first_char
+; CHECK-NEXT: entry:
+; CHECK-NEXT: ret i8 104
+define i8 @first_char() {
+entry:
+  %p = getelementptr [6 x i8]* @S, i64 0, i64 0
+  %c = load i8* %p
+  ret i8 %c
+}
+
+; CHECK: define i64 @store_forward
+; CHECK-NOT: load
+; CHECK: ret i64 %x
+define i64 @store_forward(i64* %q, i64 %x) {
+entry:
+  store i64 %x, i64* %q
+  %v = load i64* %q
+  ret i64 %v
+}
+
+; CHECK: define i32 @select_zero
+; CHECK-NEXT: entry:
+; CHECK-NEXT: ret i32 %y
+define i32 @select_zero(i32 %y) {
+entry:
+  %c = icmp eq i32 %y, %y
+  %s = select i1 %c, i32 %y, i32 0
+  ret i32 %s
+}
+
+; CHECK: define void @print_char
+; CHECK-NEXT: entry:
+; CHECK-NEXT: call i32 @putchar(i32 97)
+define void @print_char() {
+entry:
+  %p = getelementptr [2 x i8]* @A, i64 0, i64 0
+  %r = call i32 (i8*, ...)* @printf(i8* %p)
+  ret void
+}
+
+; CHECK: define void @print_hi
+; CHECK-NEXT: entry:
+; CHECK-NEXT: call i32 @puts({{.*}} @str,
+define void @print_hi() {
+entry:
+  %p = getelementptr [4 x i8]* @HI, i64 0, i64 0
+  %r = call i32 (i8*, ...)* @printf(i8* %p)
+  ret void
+}
+
+; CHECK: define void @print_bye
+; CHECK-NEXT: entry:
+; CHECK-NEXT: call i32 @puts({{.*}} @str1,
+define void @print_bye() {
+entry:
+  %p = getelementptr [5 x i8]* @BYE, i64 0, i64 0
+  %r = call i32 (i8*, ...)* @printf(i8* %p)
+  ret void
+}
+
+; CHECK: declare i32 @putchar(i32)
+; CHECK: declare i32 @puts(i8* nocapture)
+
+!0 = metadata !{metadata !"int", metadata !1}
+!1 = metadata !{metadata !"omnipotent char", metadata !2}
+!2 = metadata !{metadata !"Simple C/C++ TBAA"}
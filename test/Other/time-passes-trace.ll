@@ -0,0 +1,19 @@
+; RUN: opt -instcombine -time-passes-trace=%t.json -disable-output %s
+; RUN: FileCheck %s < %t.json
+
+; CHECK: {"traceEvents": [
+; CHECK: {"name": "Combine redundant instructions", "cat": "function", "ph": "X"
+; CHECK: "args": {"function": "f", "instructions_before": 3, "instructions_after": 1,
+; CHECK: "args": {"function": "g\"q", "instructions_before": 1, "instructions_after": 1,
+; CHECK: {"name": "Function Pass Manager", "cat": "module"
+; CHECK: ], "displayTimeUnit": "ms"}
+
+define i32 @f(i32 %x) {
+  %a = add i32 %x, 0
+  %b = mul i32 %a, 1
+  ret i32 %b
+}
+
+define i32 @"g\22q"() {
+  ret i32 0
+}
@@ -199,3 +199,45 @@ out:
 next:
   ret void
 }
+
+; The cases are decided on every incoming edge: 4 and 5 never fire, while
+; 1, 2 and 3 each fire on one edge only.
+define i32 @switch_preds(i32 %s) {
+; CHECK: @switch_preds
+entry:
+  switch i32 %s, label %out [
+    i32 1, label %a
+    i32 2, label %b
+    i32 3, label %c
+  ]
+
+a:
+  br label %merge
+
+b:
+  br label %merge
+
+c:
+  br label %merge
+
+merge:
+; CHECK: merge:
+  switch i32 %s, label %out [
+; CHECK-NEXT: switch i32 %s, label %out
+    i32 1, label %next
+; CHECK-NEXT: i32 1, label %next
+    i32 2, label %next
+; CHECK-NEXT: i32 2, label %next
+    i32 3, label %next
+; CHECK-NEXT: i32 3, label %next
+    i32 4, label %out
+    i32 5, label %next
+; CHECK-NEXT: ]
+  ]
+
+out:
+  ret i32 0
+
+next:
+  ret i32 1
+}
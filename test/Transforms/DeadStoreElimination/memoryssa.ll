@@ -0,0 +1,78 @@
+; RUN: opt < %s -basicaa -dse -enable-dse-memoryssa -S | FileCheck %s
+; RUN: opt < %s -basicaa -dse -S | FileCheck %s
+
+; With -enable-dse-memoryssa, DSE walks MemorySSA to find the store a store
+; overwrites; the results must be those MemDep gives.
+
+target datalayout = "e-p:64:64:64-i32:32:32-i64:64:64"
+
+; A store to a pointer that does not alias %p is not in the way.
+; CHECK: @past_noalias
+; CHECK-NEXT: store i32 1, i32* %q
+; CHECK-NEXT: store i32 2, i32* %p
+; CHECK-NEXT: ret void
+define void @past_noalias(i32* noalias %p, i32* noalias %q) {
+  store i32 0, i32* %p
+  store i32 1, i32* %q
+  store i32 2, i32* %p
+  ret void
+}
+
+; A load that may read the first store keeps it.
+; CHECK: @past_read
+; CHECK-NEXT: store i32 0, i32* %p
+; CHECK-NEXT: %v = load i32* %q
+; CHECK-NEXT: store i32 2, i32* %p
+define i32 @past_read(i32* %p, i32* %q) {
+  store i32 0, i32* %p
+  %v = load i32* %q
+  store i32 2, i32* %p
+  ret i32 %v
+}
+
+; Storing back the value just loaded does nothing, even past a store that
+; does not alias; the load goes with it.
+; CHECK: @store_of_load
+; CHECK-NEXT: store i32 1, i32* %q
+; CHECK-NEXT: ret void
+define void @store_of_load(i32* noalias %p, i32* noalias %q) {
+  %v = load i32* %p
+  store i32 1, i32* %q
+  store i32 %v, i32* %p
+  ret void
+}
+
+; Unless something in between may have written %p.
+; CHECK: @store_of_load_clobbered
+; CHECK: store i32 %v, i32* %p
+define void @store_of_load_clobbered(i32* %p, i32* %q) {
+  %v = load i32* %p
+  store i32 1, i32* %q
+  store i32 %v, i32* %p
+  ret void
+}
+
+; A volatile store neither dies nor kills.
+; CHECK: @volatile
+; CHECK-NEXT: store i32 0, i32* %p
+; CHECK-NEXT: store volatile i32 1, i32* %p
+; CHECK-NEXT: ret void
+define void @volatile(i32* %p) {
+  store i32 0, i32* %p
+  store volatile i32 1, i32* %p
+  ret void
+}
+
+; A store to an object that is then freed is dead.
+; CHECK: @before_free
+; CHECK-NOT: store i32 0
+; CHECK: call void @free
+define void @before_free(i32* noalias %p, i32* noalias %q) {
+  store i32 0, i32* %p
+  store i32 1, i32* %q
+  %b = bitcast i32* %p to i8*
+  call void @free(i8* %b)
+  ret void
+}
+
+declare void @free(i8*)
@@ -0,0 +1,133 @@
+; RUN: opt < %s -basicaa -gvn -enable-gvn-memoryssa -S | FileCheck %s
+; RUN: opt < %s -basicaa -gvn -S | FileCheck %s
+
+; With -enable-gvn-memoryssa, GVN finds the values of loads by walking
+; MemorySSA; the results must be those MemDep gives.
+
+target datalayout = "e-p:64:64:64-i32:32:32-i64:64:64"
+
+; The store in the loop does not clobber %p.
+; CHECK: @loop
+; CHECK-NOT: load
+; CHECK: ret i32 5
+define i32 @loop(i32* noalias %p, i32* noalias %q, i32 %n) {
+entry:
+  store i32 5, i32* %p
+  br label %body
+body:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %body ]
+  store i32 %i, i32* %q
+  %v = load i32* %p
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %body
+exit:
+  ret i32 %v
+}
+
+; A load of the same pointer with the same clobber has the same value.
+; CHECK: @reload
+; CHECK: %a = load i32* %p
+; CHECK-NOT: load
+; CHECK: add i32 %a, %a
+define i32 @reload(i32* noalias %p, i32* noalias %q, i1 %c) {
+entry:
+  %a = load i32* %p
+  br i1 %c, label %left, label %join
+left:
+  store i32 1, i32* %q
+  br label %join
+join:
+  %b = load i32* %p
+  %s = add i32 %a, %b
+  ret i32 %s
+}
+
+; The stores on the two sides may write %p, so the load is partially
+; redundant and load PRE still applies.
+; CHECK: @diamond
+; CHECK: left:
+; CHECK: %v.pre = load i32* %p
+; CHECK: join:
+; CHECK-NEXT: %v = phi i32 [ 0, %right ], [ %v.pre, %left ]
+define i32 @diamond(i32* %p, i32* %q, i1 %c) {
+entry:
+  store i32 0, i32* %p
+  br i1 %c, label %left, label %right
+left:
+  store i32 1, i32* %q
+  br label %join
+right:
+  br label %join
+join:
+  %v = load i32* %p
+  ret i32 %v
+}
+
+; A store that may alias %p keeps the second load; a wider store to the same
+; address is forwarded.
+; CHECK: @clobber
+; CHECK: %b = load i32* %p
+; CHECK: trunc i64 %x to i32
+; CHECK: add i32 %a, %b
+define i32 @clobber(i32* %p, i32* %q, i64 %x) {
+entry:
+  %a = load i32* %p
+  store i32 1, i32* %q
+  %b = load i32* %p
+  %p64 = bitcast i32* %p to i64*
+  store i64 %x, i64* %p64
+  %c = load i32* %p
+  %s = add i32 %a, %b
+  %t = add i32 %s, %c
+  ret i32 %t
+}
+
+; Nothing writes the alloca before the load.
+; CHECK: @fresh
+; CHECK-NOT: load
+; CHECK: ret i32 undef
+define i32 @fresh(i32* %q, i1 %c) {
+entry:
+  %s = alloca i32
+  store i32 1, i32* %q
+  br i1 %c, label %left, label %join
+left:
+  call void @g()
+  br label %join
+join:
+  %v = load i32* %s
+  ret i32 %v
+}
+
+; A load of the same location through another pointer type is forwarded.
+; CHECK: @coerce
+; CHECK: %a = load i32* %p
+; CHECK-NOT: load
+; CHECK: ret i32
+define i32 @coerce(i32* %p) {
+entry:
+  %a = load i32* %p
+  %f = bitcast i32* %p to float*
+  %b = load float* %f
+  %c = bitcast float %b to i32
+  %r = add i32 %a, %c
+  ret i32 %r
+}
+
+; A call before the alloca escapes cannot write it.
+; CHECK: @escape_after_call
+; CHECK-NOT: load
+; CHECK: call void @h(i32* %s, i32 7)
+define void @escape_after_call() {
+entry:
+  %s = alloca i32
+  store i32 7, i32* %s
+  call void @g()
+  %v = load i32* %s
+  call void @h(i32* %s, i32 %v)
+  ret void
+}
+
+declare void @g()
+declare void @h(i32*, i32)
@@ -0,0 +1,73 @@
+; RUN: opt < %s -instcombine -instcombine-known-bits-cache -S | FileCheck %s
+
+; The sign bits of %x8 make the trunc and sext a no-op, but finding that out
+; takes looking nine instructions deep.
+define i32 @deep_sign_bits(i32 %a, i32 %b, i32 %c, i32 %d, i32 %e) {
+; CHECK: @deep_sign_bits
+; CHECK-NOT: trunc
+; CHECK: ret i32 %x8
+  %sa = ashr i32 %a, 24
+  %sb = ashr i32 %b, 25
+  %sc = ashr i32 %c, 26
+  %sd = ashr i32 %d, 27
+  %se = ashr i32 %e, 28
+  %x1 = xor i32 %sa, %sb
+  %x2 = xor i32 %x1, %sc
+  %x3 = xor i32 %x2, %sd
+  %x4 = xor i32 %x3, %se
+  %x5 = xor i32 %x4, %sa
+  %x6 = and i32 %x5, %sc
+  %x7 = or i32 %x6, %sb
+  %x8 = xor i32 %x7, %sd
+  %t = trunc i32 %x8 to i8
+  %r = sext i8 %t to i32
+  ret i32 %r
+}
+
+; %p and %q are 16 on every iteration, which only shows when the loop is
+; analyzed as a whole.
+define i16 @loop_phis(i16 %a) {
+; CHECK: @loop_phis
+; CHECK-NOT: phi i16
+; CHECK: or i16 %a, 16
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %p = phi i16 [ 16, %entry ], [ %pq, %loop ]
+  %q = phi i16 [ 16, %entry ], [ %p, %loop ]
+  %pq = and i16 %p, %q
+  %i.next = add i32 %i, 1
+  %c = icmp ult i32 %i.next, 5
+  br i1 %c, label %loop, label %exit
+
+exit:
+  %r = or i16 %q, %a
+  ret i16 %r
+}
+
+; Both steps keep the low bit of %j clear.  There are two latches, so %j is
+; not a simple recurrence.
+define i32 @stride(i1 %cc, i1 %c) {
+; CHECK: @stride
+; CHECK: ret i32 0
+entry:
+  br label %loop
+
+loop:
+  %j = phi i32 [ 0, %entry ], [ %j.a, %latch.a ], [ %j.b, %latch.b ]
+  br i1 %cc, label %latch.a, label %latch.b
+
+latch.a:
+  %j.a = add i32 %j, 2
+  br label %loop
+
+latch.b:
+  %j.b = add i32 %j, 4
+  br i1 %c, label %loop, label %exit
+
+exit:
+  %r = and i32 %j.b, 1
+  ret i32 %r
+}
@@ -0,0 +1,70 @@
+; RUN: rm -f %t.features
+; RUN: opt < %s -S -myunroll -my-count=2 -my-features-file=%t.features \
+; RUN:   | FileCheck %s -check-prefix=NONE
+; RUN: opt < %s -S -myunroll -my-depth=1 -my-count=2 \
+; RUN:   -my-features-file=%t.features | FileCheck %s -check-prefix=OUTER
+; RUN: opt < %s -S -myunroll -my-depth=2 -my-count=2 \
+; RUN:   -my-features-file=%t.features | FileCheck %s -check-prefix=INNER
+; RUN: opt < %s -S -myunroll -my-depth=2 \
+; RUN:   -my-model=%S/Inputs/constant-two.model \
+; RUN:   -my-features-file=%t.features | FileCheck %s -check-prefix=INNER
+
+; -myunroll only instruments and unrolls the loops at depth -my-depth.  The
+; default of 0 matches no loop.  Loop indices count every loop visited,
+; innermost first, so the outer loop is loop 1.
+
+target datalayout = "e-p:64:64:64-i32:32:32-i64:64:64-n32:64"
+
+@a = global [16 x [16 x i32]] zeroinitializer
+
+define i32 @main() {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %arrayidx = getelementptr [16 x [16 x i32]]* @a, i64 0, i64 %i, i64 %j
+  %v = load i32* %arrayidx
+  %v.inc = add i32 %v, 1
+  store i32 %v.inc, i32* %arrayidx
+  %j.next = add i64 %j, 1
+  %c.inner = icmp ult i64 %j.next, 16
+  br i1 %c.inner, label %inner, label %outer.latch
+
+outer.latch:
+  %i.next = add i64 %i, 1
+  %c.outer = icmp ult i64 %i.next, 16
+  br i1 %c.outer, label %outer, label %exit
+
+exit:
+  ret i32 0
+}
+
+; NONE-NOT: call void @recordEntry
+; NONE-NOT: .1 =
+; NONE: ret i32 0
+
+; OUTER: entry:
+; OUTER-NEXT: call void @setCopyCount(i64 2)
+; OUTER-NEXT: call void @recordEntry(i64 1)
+; OUTER: inner:
+; OUTER-NOT: %v.1
+; OUTER: exit:
+; OUTER-NEXT: call void @recordExit(i64 1)
+; OUTER: inner.1:
+; OUTER: %v.1 = load i32* %arrayidx.1
+; OUTER-NOT: %v.2
+
+; INNER: outer:
+; INNER: call void @recordEntry(i64 0)
+; INNER: inner:
+; INNER: %v = load i32* %arrayidx
+; INNER: %v.1 = load i32* %arrayidx.1
+; INNER-NOT: %v.2
+; INNER: br i1 %c.inner.1, label %inner, label %outer.latch
+; INNER: outer.latch:
+; INNER: call void @recordExit(i64 0)
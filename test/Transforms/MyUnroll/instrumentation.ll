@@ -0,0 +1,55 @@
+; RUN: rm -f %t.features
+; RUN: opt < %s -S -myunroll -my-depth=1 -my-count=3 -my-features-file=%t.features \
+; RUN:   | FileCheck %s
+; RUN: FileCheck %s -check-prefix=FEATURES < %t.features
+
+; Per-loop factors from -my-count-db override -my-count.  The database lines
+; are the features lines with the factor appended.
+; RUN: sed -e 's/$/, Unroll_count: 4/' %t.features > %t.db
+; RUN: opt < %s -S -myunroll -my-depth=1 -my-count-db=%t.db \
+; RUN:   -my-features-file=%t.features | FileCheck %s -check-prefix=DB
+
+; The entry block of main holds nothing but its branch.  setCopyCount must
+; still come first in it, and the loop exiting into main's return block must
+; record its exit before printFinally runs.
+
+target datalayout = "e-p:64:64:64-i32:32:32-i64:64:64-n32:64"
+
+@a = global [16 x i32] zeroinitializer
+
+define i32 @main() {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %arrayidx = getelementptr [16 x i32]* @a, i64 0, i64 %i
+  %v = load i32* %arrayidx
+  %v.inc = add i32 %v, 1
+  store i32 %v.inc, i32* %arrayidx
+  %i.next = add i64 %i, 1
+  %c = icmp ult i64 %i.next, 16
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 0
+}
+
+; CHECK: entry:
+; CHECK-NEXT: call void @setCopyCount(i64 3)
+; CHECK-NEXT: call void @recordEntry(i64 0)
+; CHECK-NEXT: br label %loop
+; CHECK: exit:
+; CHECK-NEXT: call void @recordExit(i64 0)
+; CHECK-NEXT: call void @printFinally(i64 {{-?[0-9]+}})
+; CHECK-NEXT: ret i32 0
+
+; FEATURES: Loop_ID: {{[0-9]+}}, Inst_count: 8, Arith_ops_count: 3, Arr_access_count: 2, Cond_inst_count: 1, Int_ops_count: 3, Float_ops_count: 0, Loads_count: 1, Stores_count: 1, BB_in_Loop: 1, BB_in_Func: 3, Loop_depth: 1
+
+; The database factor of 4 wins over the default -my-count of 0.
+; DB: entry:
+; DB-NEXT: call void @setCopyCount(i64 0)
+; DB: loop:
+; DB: %v.3 = load i32* %arrayidx.3
+; DB-NOT: %v.4
+; DB: exit:
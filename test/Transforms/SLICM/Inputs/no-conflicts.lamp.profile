@@ -0,0 +1,2 @@
+BEGIN Memory Profile
+END Memory Profile
@@ -0,0 +1,3 @@
+BEGIN Memory Profile
+1 1 2 0 2 0
+END Memory Profile
@@ -0,0 +1,76 @@
+; RUN: opt < %s -lamp-map-loop -lamp-profile-file=%S/Inputs/no-conflicts.lamp.profile \
+; RUN:   -slicm -slicm-remarks -disable-output 2>&1 | FileCheck %s -check-prefix=HOIST
+; RUN: opt < %s -lamp-map-loop -lamp-profile-file=%S/Inputs/no-conflicts.lamp.profile \
+; RUN:   -slicm -S 2>/dev/null | FileCheck %s -check-prefix=IR
+; RUN: opt < %s -lamp-map-loop -lamp-profile-file=%S/Inputs/no-conflicts.lamp.profile \
+; RUN:   -slicm -slicm-remarks -slicm-load-cost=2 -disable-output 2>&1 \
+; RUN:   | FileCheck %s -check-prefix=CHEAP
+; RUN: opt < %s -lamp-map-loop -lamp-profile-file=%S/Inputs/conflicts.lamp.profile \
+; RUN:   -slicm -slicm-remarks -disable-output 2>&1 \
+; RUN:   | FileCheck %s -check-prefix=NOEDGE
+; RUN: opt < %s -lamp-map-loop -lamp-profile-file=%S/Inputs/conflicts.lamp.profile \
+; RUN:   -profile-loader -profile-info-file=%S/Inputs/cond-store.llvmprof \
+; RUN:   -slicm -slicm-remarks -disable-output 2>&1 \
+; RUN:   | FileCheck %s -check-prefix=FREQUENT
+; RUN: opt < %s -lamp-map-loop -lamp-profile-file=%S/Inputs/rare-conflicts.lamp.profile \
+; RUN:   -profile-loader -profile-info-file=%S/Inputs/cond-store.llvmprof \
+; RUN:   -slicm -slicm-remarks -disable-output 2>&1 | FileCheck %s -check-prefix=RARE
+
+; The load of %p is blocked by the store to %q, which runs in half of the
+; iterations.  The header has frequency 32, so the load saves 4 * 32, the flag
+; check costs 2 * 32 and the flag update after the store 2 * 16.
+;
+; The LAMP profiles make the store feed the load 0, 20 or 2 times.  The edge
+; profile runs the header 100 times; without it any conflict counts as one
+; in every iteration.
+
+target datalayout = "e-p:64:64:64-i32:32:32-i64:64:64-n32:64"
+
+define i32 @cond_store(i32* %p, i32* %q, i1 %c, i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %latch ]
+  %v = load i32* %p
+  %s.next = add i32 %s, %v
+  br i1 %c, label %store, label %latch
+
+store:
+  store i32 %s.next, i32* %q
+  br label %latch
+
+latch:
+  %i.next = add i64 %i, 1
+  %cmp = icmp ult i64 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret i32 %s.next
+}
+
+; HOIST: SLICM: hoisting '  %v = load i32* %p' in loop 'loop': saves 1.280000e+02, checks cost 9.600000e+01, redo costs 0.000000e+00 (1 conflict sites, conflict rate 0.000000e+00)
+; HOIST: SLICM: loop 'HOME_BB1_loop' in 'cond_store': hoisted 1 of 1 candidate loads
+
+; IR: entry:
+; IR: %LD1 = load i32* %p
+; IR: store i1 false, i1* %FLAG1
+; IR: HOME_BB1_loop:
+; IR: %load_FLAG1 = load i1* %FLAG1
+; IR-NEXT: br i1 %load_FLAG1, label %REDO_BB1, label %REST_BB1
+; IR: REDO_BB1:
+; IR-NEXT: %LD1_cl = load i32* %p
+; IR: store:
+; IR-NEXT: store i32 %s.next, i32* %q
+; IR-NEXT: %COMPARE1 = icmp eq i32* %p, %q
+; IR-NEXT: store i1 %COMPARE1, i1* %FLAG1
+
+; CHEAP: SLICM: not hoisting '  %v = load i32* %p' in loop 'loop': saves 6.400000e+01, checks cost 9.600000e+01, redo costs 0.000000e+00
+; CHEAP: SLICM: loop 'loop' in 'cond_store': hoisted 0 of 1 candidate loads
+
+; NOEDGE: SLICM: not hoisting '  %v = load i32* %p' in loop 'loop': saves 1.280000e+02, checks cost 9.600000e+01, redo costs 7.680000e+02 (1 conflict sites, conflict rate 1.000000e+00)
+
+; FREQUENT: SLICM: not hoisting '  %v = load i32* %p' in loop 'loop': saves 1.280000e+02, checks cost 9.600000e+01, redo costs 1.536000e+02 (1 conflict sites, conflict rate 2.000000e-01)
+
+; RARE: SLICM: hoisting '  %v = load i32* %p' in loop 'loop': saves 1.280000e+02, checks cost 9.600000e+01, redo costs 1.536000e+01 (1 conflict sites, conflict rate 2.000000e-02)
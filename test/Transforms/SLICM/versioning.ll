@@ -0,0 +1,136 @@
+; RUN: opt < %s -lamp-map-loop -lamp-profile-file=%S/Inputs/no-conflicts.lamp.profile \
+; RUN:   -slicm -S 2>/dev/null | FileCheck %s
+; RUN: opt < %s -lamp-map-loop -lamp-profile-file=%S/Inputs/no-conflicts.lamp.profile \
+; RUN:   -slicm -slicm-remarks -disable-output 2>&1 | FileCheck %s -check-prefix=REMARK
+
+; The load of %p is blocked by two stores that LAMP never saw conflict with
+; it, so SLICM versions the loop on an overlap check of the accessed ranges.
+
+target datalayout = "e-p:64:64:64-i32:32:32-i64:64:64-n32:64"
+
+; CHECK: define void @version(
+; CHECK: entry:
+; CHECK: %slicm.end = getelementptr i8* %p1, i64 4
+; CHECK: %scevgep = getelementptr i32* %q, i64 %1
+; CHECK: %slicm.end4 = getelementptr i8* %scevgep3, i64 4
+; CHECK: %slicm.bound1 = icmp ult i8* %q2, %slicm.end
+; CHECK: %slicm.bound0 = icmp ult i8* %p1, %slicm.end4
+; CHECK: %slicm.overlap = and i1 %slicm.bound0, %slicm.bound1
+; CHECK: %slicm.overlap11 = and i1
+; CHECK: %slicm.conflict = or i1 %slicm.overlap, %slicm.overlap11
+; CHECK: br i1 %slicm.conflict, label %entry.split, label %entry.split.nalias
+; CHECK: entry.split.nalias:
+; CHECK-NEXT: %v.nalias = load i32* %p
+; CHECK-NEXT: br label %loop.nalias
+; CHECK: loop.nalias:
+; CHECK-NOT: load
+; CHECK: br i1 %cmp.nalias, label %loop.nalias, label %exit.slicm-lcssa.nalias
+; CHECK: exit.slicm-lcssa.nalias:
+; CHECK-NEXT: br label %exit
+; CHECK: entry.split:
+; CHECK-NEXT: br label %loop
+; CHECK: loop:
+; CHECK: %v = load i32* %p
+; CHECK: exit: {{.*}} preds = %exit.slicm-lcssa.nalias, %exit.slicm-lcssa
+; REMARK: SLICM: loop 'loop': versioning for 1 loads (2 conflict sites
+
+define void @version(i32* %p, i32* %q, i32* %r, i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %v = load i32* %p
+  %q.i = getelementptr i32* %q, i64 %i
+  store i32 %v, i32* %q.i
+  %r.i = getelementptr i32* %r, i64 %i
+  store i32 %v, i32* %r.i
+  %i.next = add i64 %i, 1
+  %cmp = icmp ult i64 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; The versioned loop is nested.  When SLICM then processes the outer loop, it
+; walks the dominator tree it updated in place and hoists the overlap check
+; and the clone's invariant compare.
+
+; CHECK: define void @nested(
+; CHECK: entry:
+; CHECK: %slicm.conflict = or i1
+; CHECK-NEXT: br label %outer
+; CHECK: outer:
+; CHECK-NEXT: %j = phi i64
+; CHECK-NEXT: br i1 %slicm.conflict, label %outer.split, label %outer.split.nalias
+; CHECK: outer.split.nalias:
+; CHECK-NEXT: %v.nalias = load i32* %p
+; CHECK-NEXT: %c1.nalias = icmp eq i32 %v.nalias, 7
+; CHECK-NEXT: br label %loop.nalias
+; CHECK: normal: {{.*}} preds = %normal.slicm-lcssa.nalias, %normal.slicm-lcssa
+; REMARK: SLICM: loop 'loop': versioning for 1 loads (2 conflict sites
+
+define void @nested(i32* %p, i32* %q, i32* %r, i64 %n) {
+entry:
+  br label %outer
+
+outer:
+  %j = phi i64 [ 0, %entry ], [ %j.next, %normal ]
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %outer ], [ %i.next, %latch ]
+  %v = load i32* %p
+  %q.i = getelementptr i32* %q, i64 %i
+  store i32 %v, i32* %q.i
+  %c1 = icmp eq i32 %v, 7
+  br i1 %c1, label %then, label %latch
+
+then:
+  %r.i = getelementptr i32* %r, i64 %i
+  store i32 %v, i32* %r.i
+  br label %latch
+
+latch:
+  %i.next = add i64 %i, 1
+  %cmp = icmp ult i64 %i.next, %n
+  br i1 %cmp, label %loop, label %normal
+
+normal:
+  %j.next = add i64 %j, 1
+  %cmpj = icmp ult i64 %j.next, %n
+  br i1 %cmpj, label %outer, label %exit
+
+exit:
+  ret void
+}
+
+; Pointers in different address spaces cannot be compared, so SLICM falls
+; back to flag-and-redo, which rejects the load here.
+
+; CHECK: define void @addrspace(
+; CHECK-NOT: slicm.conflict
+; CHECK-NOT: nalias
+; CHECK: ret void
+; REMARK: SLICM: loop 'loop': using flag-and-redo for 1 loads (2 conflict sites
+; REMARK: SLICM: not hoisting '  %v = load i32 addrspace(1)* %p'
+
+define void @addrspace(i32 addrspace(1)* %p, i32* %q, i32* %r, i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %v = load i32 addrspace(1)* %p
+  %q.i = getelementptr i32* %q, i64 %i
+  store i32 %v, i32* %q.i
+  %r.i = getelementptr i32* %r, i64 %i
+  store i32 %v, i32* %r.i
+  %i.next = add i64 %i, 1
+  %cmp = icmp ult i64 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret void
+}
@@ -0,0 +1,6 @@
+BEGIN Memory Profile
+12 1 40 7 250 0
+3 0 41 5 9 0
+3 1 40 7 11 0
+(2 1 40 9 4 1)
+END Memory Profile
@@ -251,6 +251,13 @@ int main(int argc, char **argv) {
     }
   }
 
+  // The module flags and debug info roots go to the output as well.
+  std::string ErrInfo;
+  if (M->MaterializeMetadata(&ErrInfo)) {
+    errs() << argv[0] << ": error reading input: " << ErrInfo << "\n";
+    return 1;
+  }
+
   // In addition to deleting all other functions, we also want to spiff it
   // up a little bit.  Do this now.
   PassManager Passes;
@@ -0,0 +1,198 @@
+//===- llvm-ir-mem-bench.cpp - Measure the memory footprint of the IR -----===//
+//
+//                      The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This tool loads each input file into its own LLVMContext and reports how
+// much heap memory the resulting module holds, per instruction and per
+// operand.  The figure covers everything the load leaves behind: the
+// instructions and their operands, the blocks, functions and globals, the
+// names, and the constants, types and metadata uniqued in the context.  It
+// also reports how long it took to load the module and to free it again, and
+// at the end the peak resident memory of the process.
+//
+// With -lazy, bitcode is loaded the way the linker and llvm-extract load it:
+// only the function bodies picked by -materialize are read, along with the
+// metadata they refer to.
+//
+// Large bitcode files give the most stable figures; llvm-stress can make
+// them.  The numbers come from malloc, so they include its per-allocation
+// overhead.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+using namespace llvm;
+
+namespace {
+  cl::list<std::string>
+  InputFilenames(cl::Positional, cl::OneOrMore,
+                 cl::desc("<input bitcode or assembly files>"));
+
+  cl::opt<bool>
+  ShowSizes("sizes", cl::desc("Also print the size of the core IR classes"));
+
+  cl::opt<bool>
+  Lazy("lazy", cl::desc("Load function bodies on demand"));
+
+  cl::opt<unsigned>
+  MaterializePercent("materialize", cl::init(100),
+                     cl::desc("With -lazy, the percentage of function bodies "
+                              "to read (default 100)"),
+                     cl::value_desc("percent"));
+}
+
+namespace {
+/// IRCounts - What a module holds, to scale the memory it takes.
+struct IRCounts {
+  uint64_t Functions, Blocks, Instructions, Operands;
+
+  IRCounts() : Functions(0), Blocks(0), Instructions(0), Operands(0) {}
+
+  void add(const Module &M) {
+    for (Module::const_iterator F = M.begin(), FE = M.end(); F != FE; ++F) {
+      if (F->isDeclaration())
+        continue;
+      ++Functions;
+      for (Function::const_iterator BB = F->begin(), BE = F->end(); BB != BE;
+           ++BB) {
+        ++Blocks;
+        for (BasicBlock::const_iterator I = BB->begin(), IE = BB->end();
+             I != IE; ++I) {
+          ++Instructions;
+          Operands += I->getNumOperands();
+        }
+      }
+    }
+  }
+};
+}
+
+static void printSize(const char *Name, size_t Size) {
+  outs() << format("  %-20s %4u\n", Name, unsigned(Size));
+}
+
+/// materializeSome - Read the bodies of MaterializePercent percent of the
+/// functions of M, spread evenly over the module.  Return true on error.
+static bool materializeSome(Module &M, std::string &ErrInfo) {
+  unsigned Seen = 0, Read = 0;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    if (!F->isMaterializable())
+      continue;
+    ++Seen;
+    if (Read * 100 >= Seen * MaterializePercent)
+      continue;
+    ++Read;
+    if (F->Materialize(&ErrInfo))
+      return true;
+  }
+  return false;
+}
+
+int main(int argc, char **argv) {
+  // Print a stack trace if we signal out.
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+  llvm_shutdown_obj Y;  // Call llvm_shutdown() on exit.
+
+  cl::ParseCommandLineOptions(argc, argv, "IR memory footprint benchmark\n");
+
+  if (ShowSizes) {
+    outs() << "class sizes:\n";
+    printSize("Value", sizeof(Value));
+    printSize("User", sizeof(User));
+    printSize("Use", sizeof(Use));
+    printSize("Instruction", sizeof(Instruction));
+    printSize("BinaryOperator", sizeof(BinaryOperator));
+    printSize("LoadInst", sizeof(LoadInst));
+    printSize("GetElementPtrInst", sizeof(GetElementPtrInst));
+    printSize("PHINode", sizeof(PHINode));
+    printSize("ConstantInt", sizeof(ConstantInt));
+    printSize("ConstantExpr", sizeof(ConstantExpr));
+  }
+
+  IRCounts Total;
+  uint64_t TotalBytes = 0;
+  double TotalLoadTime = 0, TotalFreeTime = 0;
+  for (unsigned i = 0, e = InputFilenames.size(); i != e; ++i) {
+    size_t Before = sys::Process::GetMallocUsage();
+    double LoadStart = TimeRecord::getCurrentTime(true).getWallTime();
+    LLVMContext *Context = new LLVMContext();
+    SMDiagnostic Err;
+    Module *M = Lazy ? getLazyIRFileModule(InputFilenames[i], Err, *Context)
+                     : ParseIRFile(InputFilenames[i], Err, *Context);
+    if (!M) {
+      Err.print(argv[0], errs());
+      return 1;
+    }
+    std::string ErrInfo;
+    if (Lazy && materializeSome(*M, ErrInfo)) {
+      errs() << argv[0] << ": " << InputFilenames[i] << ": " << ErrInfo
+             << "\n";
+      return 1;
+    }
+    double LoadTime = TimeRecord::getCurrentTime(false).getWallTime() -
+                      LoadStart;
+    size_t After = sys::Process::GetMallocUsage();
+    uint64_t Bytes = After > Before ? After - Before : 0;
+
+    IRCounts Counts;
+    Counts.add(*M);
+    outs() << InputFilenames[i] << ": " << Counts.Instructions
+           << " instructions, " << Counts.Operands << " operands in "
+           << Counts.Blocks << " blocks of " << Counts.Functions
+           << " functions\n";
+    if (Counts.Instructions)
+      outs() << format("  %.1f KB, %.1f bytes/instruction, "
+                       "%.1f bytes/operand\n", Bytes / 1024.0,
+                       double(Bytes) / Counts.Instructions,
+                       Counts.Operands ? double(Bytes) / Counts.Operands : 0.0);
+
+    Total.Functions += Counts.Functions;
+    Total.Blocks += Counts.Blocks;
+    Total.Instructions += Counts.Instructions;
+    Total.Operands += Counts.Operands;
+    TotalBytes += Bytes;
+
+    double FreeStart = TimeRecord::getCurrentTime(true).getWallTime();
+    delete M;
+    delete Context;
+    double FreeTime = TimeRecord::getCurrentTime(false).getWallTime() -
+                      FreeStart;
+    outs() << format("  loaded in %.1f ms, freed in %.1f ms\n",
+                     LoadTime * 1000, FreeTime * 1000);
+    TotalLoadTime += LoadTime;
+    TotalFreeTime += FreeTime;
+  }
+
+  if (InputFilenames.size() > 1 && Total.Instructions)
+    outs() << format("total: %.1f KB, %.1f bytes/instruction, "
+                     "%.1f bytes/operand\n", TotalBytes / 1024.0,
+                     double(TotalBytes) / Total.Instructions,
+                     Total.Operands ? double(TotalBytes) / Total.Operands
+                                    : 0.0);
+  if (InputFilenames.size() > 1)
+    outs() << format("total: loaded in %.1f ms, freed in %.1f ms\n",
+                     TotalLoadTime * 1000, TotalFreeTime * 1000);
+  if (size_t Peak = sys::Process::GetPeakMemoryUsage())
+    outs() << format("peak resident memory: %.1f MB\n",
+                     Peak / (1024.0 * 1024.0));
+  return 0;
+}
@@ -0,0 +1,100 @@
+//===- llvm-lamp-prof.cpp - Convert and inspect LAMP profiles -------------===//
+//
+//                      The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This tool reads a LAMP memory dependence profile in either the binary or
+// the legacy text format and writes it back out in the requested format.  The
+// text output is meant for debugging; the binary output is what the
+// LAMPLoadProfile pass maps directly.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Analysis/LAMPProfileReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+using namespace llvm;
+
+namespace {
+  enum OutputFormatTy { Binary, Text };
+
+  cl::opt<std::string>
+  InputFilename(cl::Positional, cl::desc("<LAMP profile>"),
+                cl::init("result.lamp.profile"));
+
+  cl::opt<std::string>
+  OutputFilename("o", cl::desc("Output filename"), cl::value_desc("filename"),
+                 cl::init("-"));
+
+  cl::opt<OutputFormatTy>
+  OutputFormat("format", cl::desc("Output format"), cl::init(Binary),
+               cl::values(clEnumValN(Binary, "binary", "Binary LAMP profile"),
+                          clEnumValN(Text, "text", "Legacy text profile"),
+                          clEnumValEnd));
+
+  cl::opt<bool>
+  PrintSummary("summary",
+               cl::desc("Print the number of dependences per loop instead"));
+}
+
+static void printSummary(const LAMPProfileReader &Reader, raw_ostream &OS) {
+  ArrayRef<LAMPLoopIndexEntry> Loops = Reader.getLoops();
+  OS << "LAMP profile: " << Reader.getRecords().size() << " dependences in "
+     << Loops.size() << " loops ("
+     << (Reader.isBinary() ? "binary" : "text") << ")\n";
+  for (unsigned i = 0, e = Loops.size(); i != e; ++i) {
+    ArrayRef<LAMPDepRecord> Deps = Reader.getLoopRecords(Loops[i].LoopId);
+    uint64_t MaxCount = 0;
+    for (unsigned j = 0, je = Deps.size(); j != je; ++j)
+      MaxCount = std::max(MaxCount, Deps[j].Count);
+    OS << "  loop " << Loops[i].LoopId << ": " << Deps.size()
+       << " dependences, max count " << MaxCount << '\n';
+  }
+}
+
+int main(int argc, char **argv) {
+  // Print a stack trace if we signal out.
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+  llvm_shutdown_obj Y;  // Call llvm_shutdown() on exit.
+
+  cl::ParseCommandLineOptions(argc, argv, "LAMP profile converter\n");
+
+  std::string ErrorMessage;
+  OwningPtr<LAMPProfileReader> Reader(
+    LAMPProfileReader::Create(InputFilename, ErrorMessage));
+  if (!Reader) {
+    errs() << argv[0] << ": " << ErrorMessage << '\n';
+    return 1;
+  }
+
+  bool IsBinary = !PrintSummary && OutputFormat == Binary;
+  std::string ErrorInfo;
+  OwningPtr<tool_output_file> Out
+  (new tool_output_file(OutputFilename.c_str(), ErrorInfo,
+                        IsBinary ? raw_fd_ostream::F_Binary : 0));
+  if (!ErrorInfo.empty()) {
+    errs() << ErrorInfo << '\n';
+    return 1;
+  }
+
+  if (PrintSummary)
+    printSummary(*Reader, Out->os());
+  else if (IsBinary)
+    WriteLAMPBinaryProfile(Out->os(), Reader->getRecords());
+  else
+    WriteLAMPTextProfile(Out->os(), Reader->getRecords());
+
+  Out->keep();
+  return 0;
+}
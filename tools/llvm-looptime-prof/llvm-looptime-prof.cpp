@@ -0,0 +1,87 @@
+//===- llvm-looptime-prof.cpp - Print loop timing profiles ----------------===//
+//
+//                      The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This tool prints the loop timing profile written by the looptime runtime
+// for programs instrumented with -myunroll: one section per run with the
+// invocation count and the mean, minimum and maximum time of every loop.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Analysis/LoopTimeProfileReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/raw_ostream.h"
+using namespace llvm;
+
+namespace {
+  cl::opt<std::string>
+  InputFilename(cl::Positional, cl::desc("<loop timing profile>"),
+                cl::init("loop_exec_time.bin"));
+
+  cl::opt<bool>
+  PrintHistogram("histogram",
+                 cl::desc("Print the duration histogram of every loop"));
+}
+
+static void printTime(raw_ostream &OS, double Seconds) {
+  OS << format("%.1f", Seconds * 1e9) << " ns";
+}
+
+static void printRun(const LoopTimeRun &Run, raw_ostream &OS) {
+  const LoopTimeHeader &H = Run.Header;
+  OS << "Run of program " << H.ProgramId << " with unroll factor "
+     << H.CopyCount << ": " << Run.Records.size() << " loops, timer "
+     << H.CyclesPerSecond << " Hz, overhead " << H.TimerOverhead
+     << " ticks\n";
+
+  for (unsigned i = 0, e = Run.Records.size(); i != e; ++i) {
+    const LoopTimeRecord &R = Run.Records[i];
+    OS << "  loop " << R.LoopId << ": " << R.Invocations
+       << " invocations, mean ";
+    printTime(OS, Run.getSeconds(R.TotalTicks) / R.Invocations);
+    OS << ", min ";
+    printTime(OS, Run.getSeconds(R.MinTicks));
+    OS << ", max ";
+    printTime(OS, Run.getSeconds(R.MaxTicks));
+    OS << '\n';
+
+    if (!PrintHistogram)
+      continue;
+    for (unsigned b = 0; b != LOOPTIME_NUM_BUCKETS; ++b)
+      if (R.Histogram[b])
+        OS << "    [2^" << b << ", 2^" << b + 1 << ") ticks: "
+           << R.Histogram[b] << '\n';
+  }
+}
+
+int main(int argc, char **argv) {
+  // Print a stack trace if we signal out.
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+  llvm_shutdown_obj Y;  // Call llvm_shutdown() on exit.
+
+  cl::ParseCommandLineOptions(argc, argv, "loop timing profile printer\n");
+
+  std::string ErrorMessage;
+  OwningPtr<LoopTimeProfileReader> Reader(
+    LoopTimeProfileReader::Create(InputFilename, ErrorMessage));
+  if (!Reader) {
+    errs() << argv[0] << ": " << ErrorMessage << '\n';
+    return 1;
+  }
+
+  ArrayRef<LoopTimeRun> Runs = Reader->getRuns();
+  for (unsigned i = 0, e = Runs.size(); i != e; ++i)
+    printRun(Runs[i], outs());
+  return 0;
+}
@@ -0,0 +1,330 @@
+//===- llvm-memssa-bench.cpp - Compare MemDep and MemorySSA query times ---===//
+//
+//                      The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This tool builds a function with -ops memory operations and asks for the
+// dependence of every load and store in it, once through
+// MemoryDependenceAnalysis the way GVN and DSE do and once through MemorySSA.
+// The times include building each analysis and the alias queries made for
+// it.
+//
+// The loads and stores go to constant offsets from a few noalias pointers,
+// so most pairs of them are independent and the answers are far away.  This
+// is the case MemDep handles worst: every query scans back over the
+// instructions in between, and gives up after 100 of them.  The tool also
+// reports how many queries each analysis answered with a write that may
+// produce the value, to show what the scan limit costs.
+//
+// With -o, the function is also written out as bitcode, so that passes can
+// be timed on it, e.g. with opt -time-passes -gvn -enable-gvn-memoryssa.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/MemoryDependenceAnalysis.h"
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/Analysis/Passes.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/PassManager.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetLibraryInfo.h"
+#include <algorithm>
+#include <vector>
+using namespace llvm;
+
+namespace {
+  cl::opt<unsigned>
+  NumOps("ops", cl::desc("Number of loads and stores in the function"),
+         cl::init(12000));
+
+  cl::opt<unsigned>
+  NumBlocks("blocks", cl::desc("Number of blocks they are spread over"),
+            cl::init(300));
+
+  cl::opt<unsigned>
+  NumPointers("pointers", cl::desc("Number of noalias pointer arguments"),
+              cl::init(4));
+
+  cl::opt<unsigned>
+  NumOffsets("offsets", cl::desc("Number of offsets used off each pointer"),
+             cl::init(16));
+
+  cl::opt<unsigned>
+  StorePercent("stores", cl::desc("Percentage of stores among the operations"),
+               cl::init(40));
+
+  cl::opt<unsigned>
+  Seed("seed", cl::desc("Seed of the random choices"), cl::init(0));
+
+  cl::opt<std::string>
+  OutputFilename("o", cl::desc("Write the function as bitcode to this file"),
+                 cl::value_desc("filename"));
+}
+
+namespace {
+/// Random - The linear congruential generator llvm-stress uses, so that the
+/// function is the same on every host.
+class Random {
+  uint64_t Seed;
+
+public:
+  explicit Random(unsigned S) : Seed(S) {}
+
+  unsigned next(unsigned Max) {
+    Seed = (Seed * 0x5DEECE66DULL + 0xB) & ((1ULL << 48) - 1);
+    return unsigned(Seed >> 16) % Max;
+  }
+};
+}
+
+/// buildFunction - Create the function to query in M.  The blocks form a
+/// chain of diamonds, so that half of them start with a memory phi.
+static Function *buildFunction(Module &M) {
+  LLVMContext &C = M.getContext();
+  Type *I32 = Type::getInt32Ty(C);
+  std::vector<Type*> Params(NumPointers, I32->getPointerTo());
+  Params.push_back(Type::getInt1Ty(C));
+  Function *F = Function::Create(FunctionType::get(I32, Params, false),
+                                 GlobalValue::ExternalLinkage, "bench", &M);
+  Random R(Seed);
+
+  unsigned NumDiamonds = std::max(NumBlocks / 2, 1u);
+  std::vector<BasicBlock*> Heads, Sides;
+  for (unsigned i = 0; i != NumDiamonds; ++i) {
+    Heads.push_back(BasicBlock::Create(C, "head", F));
+    Sides.push_back(BasicBlock::Create(C, "side", F));
+  }
+  BasicBlock *Exit = BasicBlock::Create(C, "exit", F);
+
+  // Every address is computed up front in the entry block.
+  IRBuilder<> B(Heads[0]);
+  std::vector<Value*> Addrs;
+  Function::arg_iterator AI = F->arg_begin();
+  for (unsigned i = 0; i != NumPointers; ++i, ++AI) {
+    AI->setName("p");
+    F->setDoesNotAlias(i + 1);
+    for (unsigned j = 0; j != NumOffsets; ++j)
+      Addrs.push_back(B.CreateConstInBoundsGEP1_32(AI, j));
+  }
+  Value *Cond = AI;
+  Cond->setName("c");
+
+  Value *Sum = ConstantInt::get(I32, 0);
+  unsigned OpsLeft = NumOps;
+  for (unsigned i = 0; i != NumDiamonds; ++i) {
+    BasicBlock *Next = i + 1 != NumDiamonds ? Heads[i + 1] : Exit;
+    for (unsigned k = 0; k != 2; ++k) {
+      B.SetInsertPoint(k ? Sides[i] : Heads[i]);
+      unsigned BlocksLeft = 2 * (NumDiamonds - i) - k;
+      unsigned Ops = OpsLeft / BlocksLeft;
+      OpsLeft -= Ops;
+      for (unsigned j = 0; j != Ops; ++j) {
+        Value *Addr = Addrs[R.next(Addrs.size())];
+        if (R.next(100) < StorePercent)
+          B.CreateStore(ConstantInt::get(I32, R.next(1000)), Addr);
+        else if (k)
+          B.CreateLoad(Addr);
+        else
+          Sum = B.CreateAdd(Sum, B.CreateLoad(Addr));
+      }
+      if (k)
+        B.CreateBr(Next);
+      else
+        B.CreateCondBr(Cond, Sides[i], Next);
+    }
+  }
+  B.SetInsertPoint(Exit);
+  B.CreateRet(Sum);
+  return F;
+}
+
+namespace {
+/// QueryCounts - How the queries of one analysis were answered.
+struct QueryCounts {
+  unsigned Queries, Found, LiveOnEntry, GaveUp;
+
+  QueryCounts() : Queries(0), Found(0), LiveOnEntry(0), GaveUp(0) {}
+};
+
+/// MemDepQuery - Ask MemDep for the dependence of every load and store.  A
+/// load with no dependence in its block gets a non-local query, like the
+/// ones GVN makes.
+struct MemDepQuery : public FunctionPass {
+  static char ID;
+  QueryCounts &Counts;
+
+  explicit MemDepQuery(QueryCounts &QC) : FunctionPass(ID), Counts(QC) {}
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.setPreservesAll();
+    AU.addRequired<AliasAnalysis>();
+    AU.addRequired<MemoryDependenceAnalysis>();
+  }
+
+  /// count - Count a query by its results in the blocks it reached.  One
+  /// that gave up anywhere counts as given up.
+  void count(ArrayRef<MemDepResult> Deps) {
+    bool Found = false, LiveOnEntry = false;
+    for (unsigned i = 0, e = Deps.size(); i != e; ++i) {
+      if (Deps[i].isUnknown()) {
+        ++Counts.GaveUp;
+        return;
+      }
+      Found |= Deps[i].isDef() || Deps[i].isClobber();
+      LiveOnEntry |= Deps[i].isNonFuncLocal();
+    }
+    if (Found)
+      ++Counts.Found;
+    else if (LiveOnEntry)
+      ++Counts.LiveOnEntry;
+  }
+
+  virtual bool runOnFunction(Function &F) {
+    AliasAnalysis &AA = getAnalysis<AliasAnalysis>();
+    MemoryDependenceAnalysis &MD = getAnalysis<MemoryDependenceAnalysis>();
+    SmallVector<NonLocalDepResult, 64> Deps;
+    SmallVector<MemDepResult, 64> Results;
+    for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+      for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE;
+           ++I) {
+        if (!isa<LoadInst>(I) && !isa<StoreInst>(I))
+          continue;
+        ++Counts.Queries;
+        MemDepResult Dep = MD.getDependency(I);
+        LoadInst *LI = dyn_cast<LoadInst>(I);
+        if (!Dep.isNonLocal() || !LI) {
+          count(Dep);
+          continue;
+        }
+        Deps.clear();
+        Results.clear();
+        MD.getNonLocalPointerDependency(AA.getLocation(LI), true, BB, Deps);
+        for (unsigned i = 0, e = Deps.size(); i != e; ++i)
+          Results.push_back(Deps[i].getResult());
+        count(Results);
+      }
+    return false;
+  }
+};
+
+/// MemorySSAQuery - Ask MemorySSA for the clobber of every load and store.
+struct MemorySSAQuery : public FunctionPass {
+  static char ID;
+  QueryCounts &Counts;
+
+  explicit MemorySSAQuery(QueryCounts &QC) : FunctionPass(ID), Counts(QC) {}
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.setPreservesAll();
+    AU.addRequired<MemorySSA>();
+  }
+
+  virtual bool runOnFunction(Function &F) {
+    MemorySSA &MSSA = getAnalysis<MemorySSA>();
+    for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+      for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE;
+           ++I) {
+        if (!isa<LoadInst>(I) && !isa<StoreInst>(I))
+          continue;
+        ++Counts.Queries;
+        MemoryAccess *Clobber = MSSA.getClobberingMemoryAccess(I);
+        if (MSSA.isLiveOnEntryDef(Clobber))
+          ++Counts.LiveOnEntry;
+        else if (isa<MemoryDef>(Clobber))
+          ++Counts.Found;
+      }
+    return false;
+  }
+};
+}
+
+char MemDepQuery::ID = 0;
+char MemorySSAQuery::ID = 0;
+
+/// runQueries - Run P over M after alias analysis and report how long it
+/// took and what it found.
+static void runQueries(Module &M, const char *Name, FunctionPass *P,
+                       const QueryCounts &Counts) {
+  PassManager PM;
+  PM.add(new TargetLibraryInfo(Triple(M.getTargetTriple())));
+  PM.add(new DataLayout(&M));
+  PM.add(createBasicAliasAnalysisPass());
+  PM.add(P);
+
+  double Start = TimeRecord::getCurrentTime(true).getWallTime();
+  PM.run(M);
+  double Time = TimeRecord::getCurrentTime(false).getWallTime() - Start;
+
+  outs() << format("%-10s %9.1f ms  %8u queries  %8u found  "
+                   "%8u live on entry", Name, Time * 1000, Counts.Queries,
+                   Counts.Found, Counts.LiveOnEntry);
+  if (Counts.GaveUp)
+    outs() << format("  %8u gave up", Counts.GaveUp);
+  outs() << '\n';
+}
+
+int main(int argc, char **argv) {
+  // Print a stack trace if we signal out.
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+  llvm_shutdown_obj Y;  // Call llvm_shutdown() on exit.
+
+  PassRegistry &Registry = *PassRegistry::getPassRegistry();
+  initializeCore(Registry);
+  initializeAnalysis(Registry);
+  initializeTarget(Registry);
+
+  cl::ParseCommandLineOptions(argc, argv,
+                              "MemDep and MemorySSA query benchmark\n");
+
+  if (NumPointers == 0 || NumOffsets == 0) {
+    errs() << argv[0] << ": -pointers and -offsets must be positive\n";
+    return 1;
+  }
+
+  LLVMContext Context;
+  Module M("memssa-bench", Context);
+  M.setDataLayout("e-p:64:64:64-i32:32:32-i64:64:64");
+  Function *F = buildFunction(M);
+  outs() << "@bench: " << NumOps << " loads and stores in " << F->size()
+         << " blocks\n";
+
+  if (!OutputFilename.empty()) {
+    std::string ErrorInfo;
+    tool_output_file Out(OutputFilename.c_str(), ErrorInfo,
+                         raw_fd_ostream::F_Binary);
+    if (!ErrorInfo.empty()) {
+      errs() << ErrorInfo << '\n';
+      return 1;
+    }
+    WriteBitcodeToFile(&M, Out.os());
+    Out.keep();
+  }
+
+  QueryCounts MemDepCounts, MemorySSACounts;
+  runQueries(M, "MemDep", new MemDepQuery(MemDepCounts), MemDepCounts);
+  runQueries(M, "MemorySSA", new MemorySSAQuery(MemorySSACounts),
+             MemorySSACounts);
+  return 0;
+}
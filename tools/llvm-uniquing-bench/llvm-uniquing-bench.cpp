@@ -0,0 +1,190 @@
+//===- llvm-uniquing-bench.cpp - Measure constant and type uniquing -------===//
+//
+//                      The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This tool measures the cost of the get() methods that unique constants and
+// types in an LLVMContext.  Every thread repeatedly asks for -keys different
+// integer, floating point, expression, data array, pointer and array values,
+// so after the first round almost every lookup hits an existing entry.
+//
+// With -threads=1 and -multithreaded LLVM is multithreaded but the context is
+// not shared, as in the serial parts of opt -pass-threads, which shows what
+// the uniquing locks still cost on a single thread; compare with a run
+// without -multithreaded.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Support/raw_ostream.h"
+#include <vector>
+using namespace llvm;
+
+namespace {
+  cl::opt<unsigned>
+  NumThreads("threads", cl::desc("Number of threads doing lookups"),
+             cl::init(1));
+
+  cl::opt<unsigned>
+  NumIterations("iterations", cl::desc("Rounds over the keys per thread"),
+                cl::init(200));
+
+  cl::opt<unsigned>
+  NumKeys("keys", cl::desc("Number of distinct values of each kind"),
+          cl::init(1000));
+
+  cl::opt<bool>
+  Multithreaded("multithreaded",
+                cl::desc("Make LLVM multithreaded even with one thread"));
+}
+
+namespace {
+/// BenchKind - One kind of value that is looked up.
+enum BenchKind {
+  BK_Int, BK_FP, BK_Expr, BK_Data, BK_Pointer, BK_Array, BK_NumKinds
+};
+
+const char *const KindNames[BK_NumKinds] = {
+  "ConstantInt", "ConstantFP", "ConstantExpr", "ConstantDataArray",
+  "PointerType", "ArrayType"
+};
+
+/// BenchThread - The work and the timings of one thread.
+struct BenchThread {
+  LLVMContext *Context;
+  uint64_t Nanos[BK_NumKinds];
+  unsigned Sink;  // Keeps the lookups from being optimized away.
+
+  explicit BenchThread(LLVMContext &C) : Context(&C), Sink(0) {
+    for (unsigned i = 0; i != BK_NumKinds; ++i)
+      Nanos[i] = 0;
+  }
+
+  static uint64_t elapsed(const sys::TimeValue &Start) {
+    sys::TimeValue Diff = sys::TimeValue::now() - Start;
+    return uint64_t(Diff.seconds()) * 1000000000ULL + Diff.nanoseconds();
+  }
+
+  void lookup(BenchKind Kind) {
+    LLVMContext &C = *Context;
+    Type *I8 = Type::getInt8Ty(C);
+    IntegerType *I64 = Type::getInt64Ty(C);
+    sys::TimeValue Start = sys::TimeValue::now();
+    for (unsigned It = 0; It != NumIterations; ++It) {
+      for (unsigned Key = 0; Key != NumKeys; ++Key) {
+        void *V = 0;
+        switch (Kind) {
+        case BK_Int:
+          V = ConstantInt::get(I64, Key);
+          break;
+        case BK_FP:
+          V = ConstantFP::get(C, APFloat(double(Key)));
+          break;
+        case BK_Expr:
+          V = ConstantExpr::getAdd(ConstantInt::get(I64, Key),
+                                   ConstantExpr::getPtrToInt(
+                                     ConstantPointerNull::get(
+                                       Type::getInt8PtrTy(C)), I64));
+          break;
+        case BK_Data: {
+          uint32_t Elts[2] = { Key, ~Key };
+          V = ConstantDataArray::get(C, Elts);
+          break;
+        }
+        case BK_Pointer:
+          V = PointerType::get(I8, Key % 256);
+          break;
+        case BK_Array:
+          V = ArrayType::get(I8, Key);
+          break;
+        case BK_NumKinds:
+          llvm_unreachable("Not a benchmark kind");
+        }
+        Sink += uintptr_t(V) & 1;
+      }
+    }
+    Nanos[Kind] += elapsed(Start);
+  }
+
+  static void run(void *Arg) {
+    BenchThread *T = static_cast<BenchThread *>(Arg);
+    for (unsigned Kind = 0; Kind != BK_NumKinds; ++Kind)
+      T->lookup(BenchKind(Kind));
+  }
+};
+}
+
+int main(int argc, char **argv) {
+  // Print a stack trace if we signal out.
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+  llvm_shutdown_obj Y;  // Call llvm_shutdown() on exit.
+
+  cl::ParseCommandLineOptions(argc, argv, "constant and type uniquing "
+                              "benchmark\n");
+
+  if (NumThreads == 0)
+    NumThreads = 1;
+  if ((NumThreads > 1 || Multithreaded) && !llvm_start_multithreaded()) {
+    errs() << argv[0] << ": LLVM was built without thread support\n";
+    return 1;
+  }
+
+  LLVMContext Context;
+  std::vector<BenchThread> Threads(NumThreads, BenchThread(Context));
+
+  // Fill the tables once so that the timed rounds measure lookups that hit.
+  {
+    unsigned SavedIterations = NumIterations;
+    NumIterations = 1;
+    BenchThread Warmup(Context);
+    BenchThread::run(&Warmup);
+    NumIterations = SavedIterations;
+  }
+
+  sys::TimeValue Start = sys::TimeValue::now();
+  {
+    OwningPtr<LLVMContext::SharedScope> Shared;
+    if (NumThreads > 1)
+      Shared.reset(new LLVMContext::SharedScope(Context));
+    ThreadPool Pool(NumThreads);
+    for (unsigned i = 0; i != NumThreads; ++i)
+      Pool.async(BenchThread::run, &Threads[i]);
+    Pool.wait();
+  }
+  uint64_t WallNanos = BenchThread::elapsed(Start);
+
+  double OpsPerKind = double(NumIterations) * NumKeys * NumThreads;
+  outs() << "threads: " << NumThreads << ", keys: " << NumKeys
+         << ", iterations: " << NumIterations << ", locks "
+         << (llvm_is_multithreaded() ? "engaged" : "not engaged") << '\n';
+  for (unsigned Kind = 0; Kind != BK_NumKinds; ++Kind) {
+    uint64_t Nanos = 0;
+    for (unsigned i = 0; i != NumThreads; ++i)
+      Nanos += Threads[i].Nanos[Kind];
+    outs() << format("%-18s %8.1f ns/op\n", KindNames[Kind],
+                     Nanos / OpsPerKind);
+  }
+  outs() << format("throughput         %8.1f Mops/s\n",
+                   OpsPerKind * BK_NumKinds / (WallNanos / 1000.0));
+
+  if (Multithreaded || NumThreads > 1)
+    llvm_stop_multithreaded();
+  return 0;
+}
@@ -0,0 +1,400 @@
+//===- llvm-unroll-tune.cpp - Search the best unroll factor per loop ------===//
+//
+//                      The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This tool automates the unroll factor sweep of -myunroll.  For every factor
+// in -counts it compiles a variant of the input with
+//
+//   opt <pre-passes> -myunroll -my-depth=D -my-count=N
+//
+// running the compiles in parallel, then runs each variant under lli with the
+// looptime runtime loaded.  The variants run one at a time so that they do not
+// disturb each other's timings.  The factor with the lowest mean time is
+// chosen for every loop and written, together with the loop's features, to a
+// database that -myunroll -my-count-db reads back as per-loop overrides.
+//
+// Loop IDs are derived from the module identifier, which opt takes from the
+// input file name: the database only applies to later runs of opt on the
+// same file name.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Analysis/LoopTimeProfileReader.h"
+#include "llvm/Config/config.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/SystemUtils.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#if LLVM_ENABLE_THREADS != 0 && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#endif
+using namespace llvm;
+
+namespace {
+  cl::opt<std::string>
+  InputFilename(cl::Positional, cl::desc("<input bitcode>"), cl::Required);
+
+  cl::list<std::string>
+  ProgramArgs("args", cl::Positional, cl::desc("<program arguments>..."),
+              cl::ZeroOrMore, cl::PositionalEatsArgs);
+
+  cl::opt<std::string>
+  OutputFilename("o", cl::desc("Unroll factor database to update"),
+                 cl::value_desc("filename"), cl::init("unroll_counts.txt"));
+
+  cl::list<unsigned>
+  Counts("counts", cl::CommaSeparated,
+         cl::desc("Unroll factors to try (default 1,2,4,8)"));
+
+  cl::opt<unsigned>
+  Depth("depth", cl::desc("Depth of the loops to tune"), cl::init(1));
+
+  cl::opt<unsigned>
+  Runs("runs", cl::desc("Number of timed runs of every variant"),
+       cl::init(3));
+
+  cl::opt<unsigned>
+  Jobs("j", cl::desc("Number of variants compiled in parallel "
+                     "(default: all of them)"), cl::init(0));
+
+  cl::opt<unsigned>
+  Timeout("timeout", cl::desc("Seconds a variant may run (default: no limit)"),
+          cl::init(0));
+
+  cl::opt<std::string>
+  PrePasses("pre-passes", cl::desc("Passes run before -myunroll"),
+            cl::init("-loop-simplify -loop-rotate -mem2reg"));
+
+  cl::opt<std::string>
+  OptPath("opt", cl::desc("Path to opt (default: next to this tool)"));
+
+  cl::opt<std::string>
+  LLIPath("lli", cl::desc("Path to lli (default: next to this tool)"));
+
+  cl::opt<std::string>
+  RuntimePath("runtime", cl::desc("Path to the looptime runtime library "
+                                  "(default: ../lib next to this tool)"));
+
+  cl::opt<bool>
+  SaveTemps("save-temps", cl::desc("Keep the variants and their profiles"));
+}
+
+static const char *ToolName;
+
+namespace {
+  /// Variant - One unroll factor: the command that builds it and its result.
+  struct Variant {
+    unsigned Count;
+    std::vector<std::string> OptArgs;
+    sys::Path Bitcode;
+    sys::Path Features;
+    int Result;
+    std::string ErrMsg;
+  };
+
+  /// CompileQueue - The variants still to be compiled, shared by the workers.
+  struct CompileQueue {
+    sys::Path Opt;
+    std::vector<Variant> &Variants;
+    unsigned Next;
+    sys::Mutex Lock;
+
+    CompileQueue(const sys::Path &Opt, std::vector<Variant> &Variants)
+      : Opt(Opt), Variants(Variants), Next(0) {}
+  };
+
+  /// LoopTime - The accumulated time of one loop under one unroll factor.
+  struct LoopTime {
+    double Seconds;
+    uint64_t Invocations;
+    LoopTime() : Seconds(0), Invocations(0) {}
+  };
+}
+
+static int runProgram(const sys::Path &Program,
+                      const std::vector<std::string> &Args,
+                      const sys::Path **Redirects, unsigned SecondsToWait,
+                      std::string &ErrMsg) {
+  std::vector<const char *> Argv;
+  Argv.push_back(Program.c_str());
+  for (unsigned i = 0, e = Args.size(); i != e; ++i)
+    Argv.push_back(Args[i].c_str());
+  Argv.push_back(0);
+  return sys::Program::ExecuteAndWait(Program, &Argv[0], 0, Redirects,
+                                      SecondsToWait, 0, &ErrMsg);
+}
+
+static void *compileWorker(void *Arg) {
+  CompileQueue &Q = *static_cast<CompileQueue *>(Arg);
+  for (;;) {
+    Variant *V;
+    {
+      sys::ScopedLock Guard(Q.Lock);
+      if (Q.Next == Q.Variants.size())
+        return 0;
+      V = &Q.Variants[Q.Next++];
+    }
+    V->Result = runProgram(Q.Opt, V->OptArgs, 0, 0, V->ErrMsg);
+  }
+}
+
+/// compileVariants - Run opt for every variant, using up to NumJobs threads.
+static void compileVariants(const sys::Path &Opt,
+                            std::vector<Variant> &Variants, unsigned NumJobs) {
+  CompileQueue Q(Opt, Variants);
+#if LLVM_ENABLE_THREADS != 0 && defined(HAVE_PTHREAD_H)
+  std::vector<pthread_t> Threads;
+  for (unsigned i = 1; i < NumJobs; ++i) {
+    pthread_t Thread;
+    if (::pthread_create(&Thread, 0, compileWorker, &Q))
+      break;
+    Threads.push_back(Thread);
+  }
+  compileWorker(&Q);
+  for (unsigned i = 0, e = Threads.size(); i != e; ++i)
+    ::pthread_join(Threads[i], 0);
+#else
+  (void)NumJobs;
+  compileWorker(&Q);
+#endif
+}
+
+static sys::Path findTool(const std::string &Option, const char *Name,
+                          const char *Argv0) {
+  if (!Option.empty())
+    return sys::Path(Option);
+  sys::Path Path =
+    PrependMainExecutablePath(Name, Argv0, (void *)(intptr_t)&findTool);
+  if (Path.canExecute())
+    return Path;
+  return sys::Program::FindProgramByName(Name);
+}
+
+static sys::Path findRuntime(const char *Argv0) {
+  if (!RuntimePath.empty())
+    return sys::Path(RuntimePath);
+  sys::Path Path =
+    sys::Path::GetMainExecutable(Argv0, (void *)(intptr_t)&findRuntime);
+  Path.eraseComponent();
+  Path.eraseComponent();
+  Path.appendComponent("lib");
+  Path.appendComponent("liblooptime_rt");
+  Path.appendSuffix(sys::Path::GetDLLSuffix());
+  return Path;
+}
+
+/// readLines - Index the "Loop_ID: N, ..." lines of Filename by loop ID.  The
+/// first line of a loop wins unless Replace is set.
+static bool readLines(StringRef Filename, bool Replace,
+                      std::map<uint64_t, std::string> &Lines) {
+  OwningPtr<MemoryBuffer> Buffer;
+  if (MemoryBuffer::getFile(Filename, Buffer))
+    return true;
+
+  SmallVector<StringRef, 64> FileLines;
+  SplitString(Buffer->getBuffer(), FileLines, "\r\n");
+  for (unsigned i = 0, e = FileLines.size(); i != e; ++i) {
+    StringRef Line = FileLines[i];
+    uint64_t LoopId;
+    if (!Line.startswith("Loop_ID: ") ||
+        Line.substr(9).split(',').first.getAsInteger(10, LoopId))
+      continue;
+    if (Replace || !Lines.count(LoopId))
+      Lines[LoopId] = Line.str();
+  }
+  return false;
+}
+
+static void cleanup(sys::Path &TempDir) {
+  if (!SaveTemps)
+    TempDir.eraseFromDisk(true);
+  else
+    errs() << ToolName << ": temporary files kept in " << TempDir.str()
+           << '\n';
+}
+
+static int error(sys::Path &TempDir, const Twine &Message) {
+  errs() << ToolName << ": " << Message << '\n';
+  cleanup(TempDir);
+  return 1;
+}
+
+int main(int argc, char **argv) {
+  // Print a stack trace if we signal out.
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+  llvm_shutdown_obj Y;  // Call llvm_shutdown() on exit.
+
+  cl::ParseCommandLineOptions(argc, argv, "per-loop unroll factor tuner\n");
+  ToolName = argv[0];
+
+  std::vector<unsigned> Factors(Counts.begin(), Counts.end());
+  if (Factors.empty())
+    for (unsigned N = 1; N <= 8; N *= 2)
+      Factors.push_back(N);
+  std::sort(Factors.begin(), Factors.end());
+  Factors.erase(std::unique(Factors.begin(), Factors.end()), Factors.end());
+  if (Factors[0] == 0) {
+    errs() << ToolName << ": unroll factors must be at least 1\n";
+    return 1;
+  }
+
+  sys::Path Opt = findTool(OptPath, "opt", argv[0]);
+  sys::Path LLI = findTool(LLIPath, "lli", argv[0]);
+  sys::Path Runtime = findRuntime(argv[0]);
+  if (Opt.isEmpty() || LLI.isEmpty()) {
+    errs() << ToolName << ": cannot find "
+           << (Opt.isEmpty() ? "opt" : "lli") << '\n';
+    return 1;
+  }
+  if (!sys::fs::exists(Runtime.str())) {
+    errs() << ToolName << ": cannot find the looptime runtime at "
+           << Runtime.str() << "; use -runtime\n";
+    return 1;
+  }
+
+  std::string ErrMsg;
+  sys::Path TempDir = sys::Path::GetTemporaryDirectory(&ErrMsg);
+  if (TempDir.isEmpty()) {
+    errs() << ToolName << ": " << ErrMsg << '\n';
+    return 1;
+  }
+
+  // Compile every variant.
+  std::vector<Variant> Variants(Factors.size());
+  for (unsigned i = 0, e = Factors.size(); i != e; ++i) {
+    Variant &V = Variants[i];
+    V.Count = Factors[i];
+    V.Bitcode = V.Features = TempDir;
+    V.Bitcode.appendComponent("unroll-" + utostr(V.Count) + ".bc");
+    V.Features.appendComponent("features-" + utostr(V.Count) + ".txt");
+
+    SmallVector<StringRef, 8> Passes;
+    SplitString(PrePasses, Passes);
+    for (unsigned j = 0, je = Passes.size(); j != je; ++j)
+      V.OptArgs.push_back(Passes[j]);
+    V.OptArgs.push_back("-myunroll");
+    V.OptArgs.push_back("-my-depth=" + utostr(Depth));
+    V.OptArgs.push_back("-my-count=" + utostr(V.Count));
+    V.OptArgs.push_back("-my-features-file=" + V.Features.str());
+    V.OptArgs.push_back(InputFilename);
+    V.OptArgs.push_back("-o");
+    V.OptArgs.push_back(V.Bitcode.str());
+  }
+  compileVariants(Opt, Variants, Jobs ? Jobs : Variants.size());
+  for (unsigned i = 0, e = Variants.size(); i != e; ++i)
+    if (Variants[i].Result)
+      return error(TempDir, "compiling with unroll factor " +
+                   Twine(Variants[i].Count) + " failed" +
+                   (Variants[i].ErrMsg.empty() ? "" : ": ") +
+                   Variants[i].ErrMsg);
+
+  // Time every variant.  All runs append to one profile; every block records
+  // the unroll factor it was compiled with.
+  sys::Path Profile = TempDir;
+  Profile.appendComponent("looptime.bin");
+  if (::setenv("LOOPTIME_OUTPUT", Profile.c_str(), 1))
+    return error(TempDir, "cannot set LOOPTIME_OUTPUT");
+
+  sys::Path DevNull;
+  const sys::Path *Redirects[] = { 0, &DevNull, 0 };
+  for (unsigned i = 0, e = Variants.size(); i != e; ++i) {
+    std::vector<std::string> Args;
+    Args.push_back("-load=" + Runtime.str());
+    Args.push_back(Variants[i].Bitcode.str());
+    Args.insert(Args.end(), ProgramArgs.begin(), ProgramArgs.end());
+    for (unsigned r = 0; r != Runs; ++r)
+      if (runProgram(LLI, Args, Redirects, Timeout, ErrMsg))
+        return error(TempDir, "running unroll factor " +
+                     Twine(Variants[i].Count) + " failed" +
+                     (ErrMsg.empty() ? "" : ": ") + ErrMsg);
+  }
+
+  OwningPtr<LoopTimeProfileReader> Reader(
+    LoopTimeProfileReader::Create(Profile.str(), ErrMsg));
+  if (!Reader)
+    return error(TempDir, ErrMsg);
+
+  std::map<uint64_t, std::map<uint64_t, LoopTime> > Times;
+  ArrayRef<LoopTimeRun> TimedRuns = Reader->getRuns();
+  for (unsigned i = 0, e = TimedRuns.size(); i != e; ++i) {
+    const LoopTimeRun &Run = TimedRuns[i];
+    for (unsigned j = 0, je = Run.Records.size(); j != je; ++j) {
+      const LoopTimeRecord &R = Run.Records[j];
+      LoopTime &T = Times[R.LoopId][Run.Header.CopyCount];
+      T.Seconds += Run.getSeconds(R.TotalTicks);
+      T.Invocations += R.Invocations;
+    }
+  }
+
+  // Every variant instruments the same loops; take the features of the first.
+  std::map<uint64_t, std::string> Features;
+  if (readLines(Variants[0].Features.str(), false, Features))
+    return error(TempDir, "no loops of depth " + Twine(Depth) + " in " +
+                 InputFilename);
+
+  std::map<uint64_t, std::string> Database;
+  readLines(OutputFilename, true, Database);
+
+  unsigned NumTuned = 0;
+  for (std::map<uint64_t, std::string>::iterator I = Features.begin(),
+       E = Features.end(); I != E; ++I) {
+    std::map<uint64_t, LoopTime> &LoopTimes = Times[I->first];
+    unsigned Best = 0;
+    double BestMean = 0;
+    outs() << "loop " << I->first << ':';
+    for (unsigned i = 0, e = Factors.size(); i != e; ++i) {
+      std::map<uint64_t, LoopTime>::iterator T = LoopTimes.find(Factors[i]);
+      if (T == LoopTimes.end() || !T->second.Invocations)
+        continue;
+      double Mean = T->second.Seconds / T->second.Invocations;
+      outs() << ' ' << Factors[i] << '=' << format("%.1f", Mean * 1e9) << "ns";
+      // Factors are sorted, so a tie keeps the smaller factor.
+      if (!Best || Mean < BestMean) {
+        Best = Factors[i];
+        BestMean = Mean;
+      }
+    }
+    if (!Best) {
+      outs() << " not executed\n";
+      continue;
+    }
+    outs() << " -> " << Best << '\n';
+    Database[I->first] = I->second + ", Unroll_count: " + utostr(Best);
+    ++NumTuned;
+  }
+
+  std::string ErrorInfo;
+  tool_output_file Out(OutputFilename.c_str(), ErrorInfo);
+  if (!ErrorInfo.empty())
+    return error(TempDir, ErrorInfo);
+  for (std::map<uint64_t, std::string>::iterator I = Database.begin(),
+       E = Database.end(); I != E; ++I)
+    Out.os() << I->second << '\n';
+  Out.keep();
+
+  outs() << NumTuned << " loops tuned, " << Database.size() << " loops in "
+         << OutputFilename << '\n';
+  cleanup(TempDir);
+  return 0;
+}
@@ -0,0 +1,487 @@
+//===- FunctionCache.cpp - On-disk cache of optimized functions -----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// An entry is read into the context of the module being optimized, so that
+// the cached body can be cloned into the function it replaces.  Reading it
+// renames the named struct types it shares with the module ("%T" becomes
+// "%T.0"); the entry records the original names so they can be mapped back.
+// It also records a hash of each global the cached body refers to, which must
+// match the module before the body is used.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "function-cache"
+#include "FunctionCache.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/StructuralHash.h"
+#include "llvm/IR/TypeFinder.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+using namespace llvm;
+
+STATISTIC(NumHits, "Number of functions restored from the cache");
+STATISTIC(NumMisses, "Number of functions not found in the cache");
+STATISTIC(NumStored, "Number of functions stored in the cache");
+
+namespace {
+
+/// GlobalCollector - Find the globals a function refers to, and whether the
+/// function can be cached at all.
+class GlobalCollector {
+  // The values visited from instructions and from metadata.
+  SmallPtrSet<const Value *, 32> Visited[2];
+
+public:
+  SmallPtrSet<const GlobalValue *, 16> Globals;
+
+  /// addFunction - Collect the globals F refers to.  Returns false if F
+  /// cannot be cached.
+  bool addFunction(const Function &F);
+
+private:
+  bool addValue(const Value *V, bool InMetadata);
+};
+
+/// EntryTypeMapper - Map the types of an entry to those of the module.
+class EntryTypeMapper : public ValueMapTypeRemapper {
+  DenseMap<Type *, Type *> Map;
+
+public:
+  void addStruct(StructType *From, StructType *To) { Map[From] = To; }
+  virtual Type *remapType(Type *Ty);
+};
+
+}
+
+bool GlobalCollector::addFunction(const Function &F) {
+  if (!F.hasName())
+    return false;
+
+  SmallVector<std::pair<unsigned, MDNode *>, 4> MDs;
+  for (Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
+    // Replacing the body would break the block addresses.
+    if (BB->hasAddressTaken())
+      return false;
+
+    for (BasicBlock::const_iterator I = BB->begin(), IE = BB->end(); I != IE;
+         ++I) {
+      for (unsigned i = 0, e = I->getNumOperands(); i != e; ++i)
+        if (const Value *Op = I->getOperand(i))
+          if (!addValue(Op, false))
+            return false;
+
+      I->getAllMetadata(MDs);
+      for (unsigned i = 0, e = MDs.size(); i != e; ++i)
+        if (!addValue(MDs[i].second, true))
+          return false;
+    }
+  }
+  return true;
+}
+
+bool GlobalCollector::addValue(const Value *V, bool InMetadata) {
+  if (isa<Instruction>(V) || isa<Argument>(V) || isa<BasicBlock>(V) ||
+      isa<MDString>(V) || isa<InlineAsm>(V))
+    return true;
+  if (!Visited[InMetadata].insert(V))
+    return true;
+
+  if (const GlobalValue *GV = dyn_cast<GlobalValue>(V)) {
+    // Globals are found again by name, which aliases do not keep to
+    // themselves.  Cloning does not map the globals that debug info refers
+    // to.
+    if (InMetadata || !GV->hasName() || isa<GlobalAlias>(GV))
+      return false;
+    Globals.insert(GV);
+    return true;
+  }
+
+  // The bitcode reader turns undef metadata into an empty node.
+  if (isa<BlockAddress>(V) ||
+      (isa<UndefValue>(V) && V->getType()->isMetadataTy()))
+    return false;
+
+  if (const MDNode *N = dyn_cast<MDNode>(V)) {
+    for (unsigned i = 0, e = N->getNumOperands(); i != e; ++i)
+      if (const Value *Op = N->getOperand(i))
+        if (!addValue(Op, true))
+          return false;
+    return true;
+  }
+
+  const Constant *C = cast<Constant>(V);
+  for (unsigned i = 0, e = C->getNumOperands(); i != e; ++i)
+    if (!addValue(C->getOperand(i), InMetadata))
+      return false;
+  return true;
+}
+
+Type *EntryTypeMapper::remapType(Type *Ty) {
+  DenseMap<Type *, Type *>::iterator I = Map.find(Ty);
+  if (I != Map.end())
+    return I->second;
+
+  // The named structs the module does not know about keep their name.
+  if (StructType *STy = dyn_cast<StructType>(Ty))
+    if (!STy->isLiteral())
+      return Map[Ty] = Ty;
+
+  SmallVector<Type *, 8> Elts;
+  bool Changed = false;
+  for (Type::subtype_iterator SI = Ty->subtype_begin(),
+       SE = Ty->subtype_end(); SI != SE; ++SI) {
+    Elts.push_back(remapType(*SI));
+    Changed |= Elts.back() != *SI;
+  }
+
+  Type *Result = Ty;
+  if (Changed) {
+    switch (Ty->getTypeID()) {
+    default: llvm_unreachable("Unknown derived type");
+    case Type::PointerTyID:
+      Result = PointerType::get(Elts[0],
+                                cast<PointerType>(Ty)->getAddressSpace());
+      break;
+    case Type::ArrayTyID:
+      Result = ArrayType::get(Elts[0], cast<ArrayType>(Ty)->getNumElements());
+      break;
+    case Type::VectorTyID:
+      Result = VectorType::get(Elts[0], cast<VectorType>(Ty)->getNumElements());
+      break;
+    case Type::FunctionTyID:
+      Result = FunctionType::get(Elts[0], makeArrayRef(Elts).slice(1),
+                                 cast<FunctionType>(Ty)->isVarArg());
+      break;
+    case Type::StructTyID:
+      Result = StructType::get(Ty->getContext(), Elts,
+                               cast<StructType>(Ty)->isPacked());
+      break;
+    }
+  }
+  return Map[Ty] = Result;
+}
+
+/// getDeclarationHash - Set Str to the hash of the declaration of GV.
+static void getDeclarationHash(const GlobalValue &GV, SmallString<32> &Str) {
+  MD5 Hash;
+  hashGlobalDeclaration(GV, Hash);
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  MD5::stringifyResult(Result, Str);
+}
+
+/// describeGlobal - Return the record of GV kept in an entry: its name and
+/// the hash of its declaration.
+static MDNode *describeGlobal(const GlobalValue &GV) {
+  SmallString<32> Str;
+  getDeclarationHash(GV, Str);
+  LLVMContext &Context = GV.getContext();
+  Value *Ops[] = { MDString::get(Context, GV.getName()),
+                   MDString::get(Context, Str) };
+  return MDNode::get(Context, Ops);
+}
+
+/// getDeclarationLinkage - The linkage of the declaration of GV in an entry.
+static GlobalValue::LinkageTypes getDeclarationLinkage(const GlobalValue &GV) {
+  return GV.isDeclaration() ? GV.getLinkage() : GlobalValue::ExternalLinkage;
+}
+
+/// mapEntryGlobals - Map the globals of Entry other than CF to those of M,
+/// declaring the functions M lacks and adding them to Created.  Returns false
+/// if a global is missing or differs from when the entry was stored.
+static bool mapEntryGlobals(Module &M, Module &Entry, Function *CF,
+                            EntryTypeMapper &Types, ValueToValueMapTy &VMap,
+                            SmallVectorImpl<Function *> &Created) {
+  for (Module::global_iterator I = Entry.global_begin(),
+       E = Entry.global_end(); I != E; ++I) {
+    GlobalValue *GV = M.getNamedValue(I->getName());
+    if (!GV || !isa<GlobalVariable>(GV) ||
+        GV->getType() != Types.remapType(I->getType()))
+      return false;
+    VMap[I] = GV;
+  }
+
+  for (Module::iterator I = Entry.begin(), E = Entry.end(); I != E; ++I) {
+    if (&*I == CF)
+      continue;
+    Type *Ty = Types.remapType(I->getType());
+    GlobalValue *GV = M.getNamedValue(I->getName());
+    if (!GV) {
+      // A declaration the passes added.
+      Function *F = Function::Create(cast<FunctionType>(
+                                       Types.remapType(I->getFunctionType())),
+                                     I->getLinkage(), I->getName(), &M);
+      F->copyAttributesFrom(I);
+      Created.push_back(F);
+      GV = F;
+    }
+    if (!isa<Function>(GV) || GV->getType() != Ty)
+      return false;
+    VMap[I] = GV;
+  }
+
+  NamedMDNode *Globals = Entry.getNamedMetadata("llvm.function.cache.globals");
+  if (!Globals)
+    return false;
+  for (unsigned i = 0, e = Globals->getNumOperands(); i != e; ++i) {
+    MDNode *Record = Globals->getOperand(i);
+    MDString *Name = dyn_cast_or_null<MDString>(Record->getOperand(0));
+    MDString *Hash = dyn_cast_or_null<MDString>(Record->getOperand(1));
+    if (!Name || !Hash)
+      return false;
+    GlobalValue *GV = M.getNamedValue(Name->getString());
+    if (!GV)
+      return false;
+    SmallString<32> Str;
+    getDeclarationHash(*GV, Str);
+    if (Str != Hash->getString())
+      return false;
+  }
+  return true;
+}
+
+/// restoreFunction - Replace the body of F by its counterpart in Entry.
+static bool restoreFunction(Function &F, Module &Entry) {
+  Module &M = *F.getParent();
+  Function *CF = Entry.getFunction(F.getName());
+  if (!CF || CF->isDeclaration())
+    return false;
+
+  EntryTypeMapper Types;
+  if (NamedMDNode *Structs =
+        Entry.getNamedMetadata("llvm.function.cache.types"))
+    for (unsigned i = 0, e = Structs->getNumOperands(); i != e; ++i) {
+      MDNode *Record = Structs->getOperand(i);
+      MDString *Name = dyn_cast_or_null<MDString>(Record->getOperand(0));
+      Value *Witness = Record->getOperand(1);
+      if (!Name || !Witness || !Witness->getType()->isPointerTy())
+        return false;
+      StructType *From = dyn_cast<StructType>(
+        cast<PointerType>(Witness->getType())->getElementType());
+      if (!From)
+        return false;
+      if (StructType *To = M.getTypeByName(Name->getString()))
+        Types.addStruct(From, To);
+    }
+  if (Types.remapType(CF->getType()) != F.getType())
+    return false;
+
+  ValueToValueMapTy VMap;
+  SmallVector<Function *, 4> Created;
+  if (!mapEntryGlobals(M, Entry, CF, Types, VMap, Created)) {
+    for (unsigned i = 0, e = Created.size(); i != e; ++i)
+      Created[i]->eraseFromParent();
+    return false;
+  }
+
+  GlobalValue::LinkageTypes Linkage = F.getLinkage();
+  F.deleteBody();
+  F.setLinkage(Linkage);
+  VMap[CF] = &F;
+
+  for (Function::arg_iterator I = F.arg_begin(), E = F.arg_end(); I != E; ++I)
+    I->setName("");
+  Function::arg_iterator DestI = F.arg_begin();
+  for (Function::arg_iterator I = CF->arg_begin(), E = CF->arg_end(); I != E;
+       ++I, ++DestI) {
+    DestI->setName(I->getName());
+    VMap[I] = DestI;
+  }
+
+  SmallVector<ReturnInst *, 8> Returns;
+  CloneFunctionInto(&F, CF, VMap, /*ModuleLevelChanges=*/true, Returns, "", 0,
+                    &Types);
+  F.copyAttributesFrom(CF);
+  return true;
+}
+
+FunctionCache::FunctionCache(StringRef Dir, StringRef Salt)
+  : Dir(Dir), Salt(Salt), Missed(0), LastFunction(0), LastGlobal(0) {
+  bool Existed;
+  sys::fs::create_directories(Dir, Existed);
+}
+
+bool FunctionCache::getKey(const Function &F, std::string &Key) const {
+  GlobalCollector Collector;
+  if (!Collector.addFunction(F))
+    return false;
+
+  const Module &M = *F.getParent();
+  MD5 Hash;
+  Hash.update(Salt);
+  Hash.update(StringRef("", 1));
+  Hash.update(M.getTargetTriple());
+  Hash.update(StringRef("", 1));
+  Hash.update(M.getDataLayout());
+  Hash.update(StringRef("", 1));
+  hashFunction(F, Hash);
+
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  SmallString<32> Str;
+  MD5::stringifyResult(Result, Str);
+  Key = Str.str();
+  return true;
+}
+
+bool FunctionCache::restore(Function &F, StringRef Key) {
+  SmallString<128> Path(Dir);
+  sys::path::append(Path, Key + ".bc");
+
+  OwningPtr<MemoryBuffer> Buffer;
+  if (!MemoryBuffer::getFile(Path.str(), Buffer)) {
+    OwningPtr<Module> Entry(ParseBitcodeFile(Buffer.get(), F.getContext()));
+    if (Entry && restoreFunction(F, *Entry)) {
+      ++NumHits;
+      return true;
+    }
+  }
+  ++NumMisses;
+  Module &M = *F.getParent();
+  Missed = &F;
+  LastFunction = &M.getFunctionList().back();
+  LastGlobal = M.global_empty() ? 0 : &M.getGlobalList().back();
+  return false;
+}
+
+void FunctionCache::store(const Function &F, StringRef Key) {
+  GlobalCollector Collector;
+  if (!Collector.addFunction(F))
+    return;
+
+  const Module &M = *F.getParent();
+  if (Missed == &F) {
+    // Passes may leave behind declarations F no longer refers to, which
+    // restore must add as well.  Globals they add cannot be declared.
+    Module::const_global_iterator GI =
+      LastGlobal ? Module::const_global_iterator(LastGlobal) : M.global_end();
+    if (LastGlobal ? ++GI != M.global_end() : !M.global_empty())
+      return;
+    for (Module::const_iterator I = llvm::next(Module::const_iterator(
+           LastFunction)), E = M.end(); I != E; ++I) {
+      if (!I->isDeclaration() || !I->hasName())
+        return;
+      Collector.Globals.insert(I);
+    }
+  }
+
+  LLVMContext &Context = F.getContext();
+  OwningPtr<Module> Entry(new Module(F.getName(), Context));
+  NamedMDNode *Globals =
+    Entry->getOrInsertNamedMetadata("llvm.function.cache.globals");
+  ValueToValueMapTy VMap;
+
+  // Declare the globals F refers to in the order of M, which is also the
+  // order in which restore declares the functions M lacks.
+  for (Module::const_global_iterator I = M.global_begin(),
+       E = M.global_end(); I != E; ++I) {
+    if (!Collector.Globals.count(I))
+      continue;
+    GlobalVariable *GV =
+      new GlobalVariable(*Entry, I->getType()->getElementType(),
+                         I->isConstant(), getDeclarationLinkage(*I), 0,
+                         I->getName(), 0, I->getThreadLocalMode(),
+                         I->getType()->getAddressSpace(),
+                         I->isExternallyInitialized());
+    GV->copyAttributesFrom(I);
+    GV->setThreadLocalMode(I->getThreadLocalMode());
+    Globals->addOperand(describeGlobal(*I));
+    VMap[I] = GV;
+  }
+
+  Function *NewF = 0;
+  for (Module::const_iterator I = M.begin(), E = M.end(); I != E; ++I) {
+    if (&*I == &F) {
+      NewF = Function::Create(F.getFunctionType(), F.getLinkage(),
+                              F.getName(), Entry.get());
+      NewF->copyAttributesFrom(&F);
+      VMap[&F] = NewF;
+    } else if (Collector.Globals.count(I)) {
+      Function *Decl = Function::Create(I->getFunctionType(),
+                                        getDeclarationLinkage(*I),
+                                        I->getName(), Entry.get());
+      Decl->copyAttributesFrom(I);
+      Globals->addOperand(describeGlobal(*I));
+      VMap[I] = Decl;
+    }
+  }
+
+  Function::arg_iterator DestI = NewF->arg_begin();
+  for (Function::const_arg_iterator I = F.arg_begin(), E = F.arg_end();
+       I != E; ++I, ++DestI) {
+    DestI->setName(I->getName());
+    VMap[I] = DestI;
+  }
+  SmallVector<ReturnInst *, 8> Returns;
+  CloneFunctionInto(NewF, &F, VMap, /*ModuleLevelChanges=*/true, Returns);
+
+  // Record the names of the named structs, which reading the entry back
+  // into the same context changes.  Unnamed ones cannot be found again.
+  TypeFinder Structs;
+  Structs.run(*Entry, false);
+  NamedMDNode *StructNames =
+    Entry->getOrInsertNamedMetadata("llvm.function.cache.types");
+  for (TypeFinder::iterator I = Structs.begin(), E = Structs.end(); I != E;
+       ++I) {
+    if ((*I)->isLiteral())
+      continue;
+    if (!(*I)->hasName())
+      return;
+    Value *Ops[] = { MDString::get(Context, (*I)->getName()),
+                     UndefValue::get(PointerType::getUnqual(*I)) };
+    StructNames->addOperand(MDNode::get(Context, Ops));
+  }
+
+  // Write to a file of our own and move it into place, so that concurrent
+  // runs never see part of an entry.
+  SmallString<128> Model(Dir);
+  sys::path::append(Model, Key + "-%%%%%%.tmp");
+  SmallString<128> TempPath;
+  int FD;
+  if (sys::fs::unique_file(Model.str(), FD, TempPath, /*makeAbsolute=*/false))
+    return;
+
+  bool Existed;
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    WriteBitcodeToFile(Entry.get(), OS);
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      sys::fs::remove(TempPath.str(), Existed);
+      return;
+    }
+  }
+
+  SmallString<128> Path(Dir);
+  sys::path::append(Path, Key + ".bc");
+  if (sys::fs::rename(TempPath.str(), Path.str()))
+    sys::fs::remove(TempPath.str(), Existed);
+  else
+    ++NumStored;
+}
@@ -0,0 +1,64 @@
+//===- FunctionCache.h - On-disk cache of optimized functions ---*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the FunctionCache class, which opt uses to reuse the
+// result of a function pass pipeline on a function it has optimized before.
+// Each entry is a bitcode file named after the structural hash of the input
+// function, holding the optimized function and declarations of the globals it
+// refers to.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef OPT_FUNCTIONCACHE_H
+#define OPT_FUNCTIONCACHE_H
+
+#include "llvm/ADT/StringRef.h"
+#include <string>
+
+namespace llvm {
+
+class Function;
+class GlobalVariable;
+
+class FunctionCache {
+  std::string Dir;
+  std::string Salt;
+
+  // The function restore last failed to find, and the last function and
+  // global of its module at the time, to tell what the passes add.
+  const Function *Missed;
+  const Function *LastFunction;
+  const GlobalVariable *LastGlobal;
+
+public:
+  /// FunctionCache - Keep the entries in Dir.  Salt should describe what the
+  /// entries depend on besides the input function: the passes and their
+  /// options, and the optimizer itself.
+  FunctionCache(StringRef Dir, StringRef Salt);
+
+  /// getKey - Set Key to the name of the entry for F as it is now.  Returns
+  /// false if F cannot be cached, because it refers to globals that cannot be
+  /// found again by name, has debug info or has its address taken blocks.
+  bool getKey(const Function &F, std::string &Key) const;
+
+  /// restore - Replace the body of F by the one stored under Key, declaring
+  /// the functions it calls that are missing.  Returns false and leaves F
+  /// alone if there is no entry, or if it does not fit the module.
+  bool restore(Function &F, StringRef Key);
+
+  /// store - Store F under Key.  If restore just failed to find F, the entry
+  /// also declares the functions added to the module since, so that restoring
+  /// it later gives the same module.  Failures to write the entry are
+  /// ignored; they only make a later run slower.
+  void store(const Function &F, StringRef Key);
+};
+
+} // End llvm namespace
+
+#endif
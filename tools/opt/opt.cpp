@@ -13,6 +13,8 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/IR/LLVMContext.h"
+#include "FunctionCache.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/Analysis/CallGraph.h"
@@ -34,6 +36,7 @@
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/PassNameParser.h"
+#include "llvm/Support/PathV1.h"
 #include "llvm/Support/PluginLoader.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
@@ -157,6 +160,12 @@ DefaultDataLayout("default-data-layout",
           cl::desc("data layout string to use if not specified by module"),
           cl::value_desc("layout-string"), cl::init(""));
 
+static cl::opt<std::string>
+FunctionCacheDir("function-cache-dir",
+                 cl::desc("Reuse the result of the function passes on "
+                          "functions optimized before, keeping it in <dir>"),
+                 cl::value_desc("dir"), cl::init(""));
+
 // ---------- Define Printers for module and function passes ------------
 namespace {
 
@@ -483,6 +492,65 @@ static void AddStandardLinkPasses(PassManagerBase &PM) {
                                  /*RunInliner=*/ !DisableInline);
 }
 
+/// CanCacheFunctions - Return true if the passes requested run on one function
+/// at a time, so that -function-cache-dir can run them through a
+/// FunctionCache.
+static bool CanCacheFunctions() {
+  if (OptLevelO1 || OptLevelO2 || OptLevelOs || OptLevelOz || OptLevelO3 ||
+      StandardCompileOpts || StandardLinkOpts || StripDebug || AnalyzeOnly ||
+      PrintEachXForm || PrintBreakpoints)
+    return false;
+
+  for (unsigned i = 0; i < PassList.size(); ++i) {
+    const PassInfo *PassInf = PassList[i];
+    if (!PassInf->getNormalCtor())
+      return false;
+    Pass *P = PassInf->getNormalCtor()();
+    PassKind Kind = P->getPassKind();
+    bool OnFunctions = Kind == PT_BasicBlock || Kind == PT_Region ||
+                       Kind == PT_Loop || Kind == PT_Function ||
+                       P->getAsImmutablePass();
+    delete P;
+    if (!OnFunctions)
+      return false;
+  }
+  return true;
+}
+
+/// GetFunctionCacheSalt - Return what the result of the passes depends on
+/// besides the function: the command line without the files, and the opt
+/// executable.
+static std::string GetFunctionCacheSalt(int argc, char **argv) {
+  std::string Salt;
+  bool SkippedInput = false;
+  for (int i = 1; i < argc; ++i) {
+    StringRef Arg = argv[i];
+    if (!SkippedInput && Arg == InputFilename) {
+      SkippedInput = true;
+      continue;
+    }
+    if (Arg == "-o" || Arg == "-function-cache-dir" ||
+        Arg == "--function-cache-dir") {
+      ++i;
+      continue;
+    }
+    if (Arg.startswith("-o=") || Arg.startswith("-function-cache-dir=") ||
+        Arg.startswith("--function-cache-dir="))
+      continue;
+    Salt += Arg;
+    Salt += '\0';
+  }
+
+  sys::PathWithStatus Executable(
+    sys::Path::GetMainExecutable(argv[0], (void *)(intptr_t)
+                                 GetFunctionCacheSalt).str());
+  Salt += Executable.str();
+  if (const sys::FileStatus *Status = Executable.getFileStatus())
+    Salt += utostr(Status->getTimestamp().toEpochTime()) + ':' +
+            utostr(Status->getSize());
+  return Salt;
+}
+
 //===----------------------------------------------------------------------===//
 // CodeGen-related helper functions.
 //
@@ -662,6 +730,27 @@ int main(int argc, char **argv) {
   if (TM.get())
     TM->addAnalysisPasses(Passes);
 
+  // With -function-cache-dir, the passes from the command line run on each
+  // function in turn, unless the cache has the result.
+  OwningPtr<FunctionPassManager> CachedFPasses;
+  if (!FunctionCacheDir.empty()) {
+    if (CanCacheFunctions()) {
+      CachedFPasses.reset(new FunctionPassManager(M.get()));
+      TargetLibraryInfo *FTLI =
+        new TargetLibraryInfo(Triple(M->getTargetTriple()));
+      if (DisableSimplifyLibCalls)
+        FTLI->disableAllFunctions();
+      CachedFPasses->add(FTLI);
+      if (TD)
+        CachedFPasses->add(new DataLayout(*TD));
+      if (TM.get())
+        TM->addAnalysisPasses(*CachedFPasses);
+    } else {
+      errs() << argv[0] << ": warning: -function-cache-dir only applies to "
+             << "function passes, ignoring it\n";
+    }
+  }
+
   OwningPtr<FunctionPassManager> FPasses;
   if (OptLevelO1 || OptLevelO2 || OptLevelOs || OptLevelOz || OptLevelO3) {
     FPasses.reset(new FunctionPassManager(M.get()));
@@ -742,7 +831,10 @@ int main(int argc, char **argv) {
              << PassInf->getPassName() << "\n";
     if (P) {
       PassKind Kind = P->getPassKind();
-      addPass(Passes, P);
+      if (CachedFPasses)
+        addPass(*CachedFPasses, P);
+      else
+        addPass(Passes, P);
 
       if (AnalyzeOnly) {
         switch (Kind) {
@@ -805,6 +897,23 @@ int main(int argc, char **argv) {
     FPasses->doFinalization();
   }
 
+  if (CachedFPasses) {
+    FunctionCache Cache(FunctionCacheDir, GetFunctionCacheSalt(argc, argv));
+    CachedFPasses->doInitialization();
+    for (Module::iterator F = M->begin(), E = M->end(); F != E; ++F) {
+      if (F->isDeclaration())
+        continue;
+      std::string Key;
+      bool Cacheable = Cache.getKey(*F, Key);
+      if (Cacheable && Cache.restore(*F, Key))
+        continue;
+      CachedFPasses->run(*F);
+      if (Cacheable)
+        Cache.store(*F, Key);
+    }
+    CachedFPasses->doFinalization();
+  }
+
   // Check that the module is well formed on completion of optimization
   if (!NoVerify && !VerifyEach)
     Passes.add(createVerifierPass());
@@ -0,0 +1,157 @@
+//===- BasicAliasAnalysisTest.cpp - BasicAliasAnalysis unit tests ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/Passes.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/PassManager.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/InstIterator.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace llvm {
+void initializeAliasQueryPass(PassRegistry &);
+
+namespace {
+
+/// AliasQuery - Asks the alias analysis whether the loads of the first and
+/// the second load instruction of the function may alias.
+struct AliasQuery : public FunctionPass {
+  static char ID;
+  AliasAnalysis::AliasResult *Result;
+
+  explicit AliasQuery(AliasAnalysis::AliasResult *Result = 0)
+    : FunctionPass(ID), Result(Result) {
+    initializeAliasQueryPass(*PassRegistry::getPassRegistry());
+  }
+
+  virtual bool runOnFunction(Function &F) {
+    SmallVector<LoadInst *, 2> Loads;
+    for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I)
+      if (LoadInst *LI = dyn_cast<LoadInst>(&*I))
+        Loads.push_back(LI);
+    *Result = getAnalysis<AliasAnalysis>().alias(
+      AliasAnalysis::Location(Loads[0]->getPointerOperand(), 4),
+      AliasAnalysis::Location(Loads[1]->getPointerOperand(), 4));
+    return false;
+  }
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.setPreservesAll();
+    AU.addRequired<AliasAnalysis>();
+  }
+};
+char AliasQuery::ID = 0;
+
+/// SetOperand - Points operand OpNo of the instruction Inst at NewOp, in
+/// place.
+struct SetOperand : public FunctionPass {
+  static char ID;
+  User *Inst;
+  unsigned OpNo;
+  Value *NewOp;
+
+  SetOperand(User *Inst, unsigned OpNo, Value *NewOp)
+    : FunctionPass(ID), Inst(Inst), OpNo(OpNo), NewOp(NewOp) {}
+
+  virtual bool runOnFunction(Function &F) {
+    Inst->setOperand(OpNo, NewOp);
+    return true;
+  }
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.setPreservesAll();
+  }
+};
+char SetOperand::ID = 0;
+
+class BasicAliasAnalysisTest : public testing::Test {
+protected:
+  BasicAliasAnalysisTest() : M("", Context) {
+    // The result cache is what these tests are about; it is off by default.
+    StringMap<cl::Option *> Options;
+    cl::getRegisteredOptions(Options);
+    static_cast<cl::opt<bool> *>(Options["basicaa-result-cache"])
+      ->setValue(true);
+    FunctionType *FTy = FunctionType::get(Type::getVoidTy(Context),
+                                          Type::getInt1Ty(Context), false);
+    F = Function::Create(FTy, GlobalValue::ExternalLinkage, "f", &M);
+    Entry = BasicBlock::Create(Context, "entry", F);
+    Type *Int32Ty = Type::getInt32Ty(Context);
+    A = new AllocaInst(Int32Ty, "a", Entry);
+    B = new AllocaInst(Int32Ty, "b", Entry);
+    X = new AllocaInst(Int32Ty, "x", Entry);
+  }
+
+  /// run - Query the alias analysis on the function, change it with Change
+  /// and query again.
+  void run(Pass *Change, AliasAnalysis::AliasResult &Before,
+           AliasAnalysis::AliasResult &After) {
+    PassManager PM;
+    PM.add(createBasicAliasAnalysisPass());
+    PM.add(new AliasQuery(&Before));
+    PM.add(Change);
+    PM.add(new AliasQuery(&After));
+    PM.run(M);
+  }
+
+  LLVMContext Context;
+  Module M;
+  Function *F;
+  BasicBlock *Entry;
+  AllocaInst *A, *B, *X;
+};
+
+// Redirecting a PHI in place must not leave the earlier NoAlias behind.
+TEST_F(BasicAliasAnalysisTest, PHIChangedBetweenQueries) {
+  BasicBlock *Left = BasicBlock::Create(Context, "left", F);
+  BasicBlock *Right = BasicBlock::Create(Context, "right", F);
+  BasicBlock *Join = BasicBlock::Create(Context, "join", F);
+  BranchInst::Create(Left, Right, F->arg_begin(), Entry);
+  BranchInst::Create(Join, Left);
+  BranchInst::Create(Join, Right);
+  PHINode *P = PHINode::Create(A->getType(), 2, "p", Join);
+  P->addIncoming(A, Left);
+  P->addIncoming(X, Right);
+  new LoadInst(P, "", Join);
+  new LoadInst(B, "", Join);
+  ReturnInst::Create(Context, Join);
+
+  AliasAnalysis::AliasResult Before, After;
+  run(new SetOperand(P, 1, B), Before, After);
+  EXPECT_EQ(AliasAnalysis::NoAlias, Before);
+  EXPECT_EQ(AliasAnalysis::MayAlias, After);
+}
+
+// So must a constant GEP whose base changes, which the cache does remember.
+TEST_F(BasicAliasAnalysisTest, GEPChangedBetweenQueries) {
+  GetElementPtrInst *G = GetElementPtrInst::Create(
+    A, ConstantInt::get(Type::getInt64Ty(Context), 0), "g", Entry);
+  new LoadInst(G, "", Entry);
+  new LoadInst(B, "", Entry);
+  ReturnInst::Create(Context, Entry);
+
+  AliasAnalysis::AliasResult Before, After;
+  run(new SetOperand(G, 0, B), Before, After);
+  EXPECT_EQ(AliasAnalysis::NoAlias, Before);
+  EXPECT_EQ(AliasAnalysis::MustAlias, After);
+}
+
+} // end anonymous namespace
+} // end namespace llvm
+
+INITIALIZE_PASS_BEGIN(AliasQuery, "aliasquery", "aliasquery", false, false)
+INITIALIZE_AG_DEPENDENCY(AliasAnalysis)
+INITIALIZE_PASS_END(AliasQuery, "aliasquery", "aliasquery", false, false)
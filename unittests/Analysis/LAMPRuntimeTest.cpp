@@ -0,0 +1,102 @@
+//===- LAMPRuntimeTest.cpp - LAMP profiling runtime unit tests ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/LAMPProfileReader.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Config/config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/ThreadPool.h"
+#include "gtest/gtest.h"
+#include <cstdlib>
+
+#ifdef LLVM_ON_UNIX
+#include <unistd.h>
+#endif
+
+// The hooks called by LAMP instrumented code, see runtime/liblamp.
+extern "C" {
+void LAMP_init(uint32_t NumInsts, uint32_t NumLoops, uint64_t Period,
+               uint64_t Burst);
+void LAMP_load4(uint32_t Id, uint64_t Addr);
+void LAMP_store4(uint32_t Id, uint64_t Addr, uint64_t Value);
+void LAMP_loop_invocation(uint32_t LoopId);
+void LAMP_loop_iteration_begin(void);
+void LAMP_loop_exit(void);
+}
+
+using namespace llvm;
+
+namespace {
+
+#if GTEST_HAS_DEATH_TEST && defined(LLVM_ON_UNIX) && LLVM_ENABLE_THREADS
+
+const unsigned NumThreads = 4;
+const unsigned NumIterations = 100;
+
+// Every thread walks the same array, so the threads' accesses only stay
+// apart if each of them profiles into its own shard.
+uint32_t SharedArray[NumIterations];
+
+// Profile "for (i = 1; i < N; ++i) A[i] = A[i-1];" as loop 1, with the store
+// as instruction 1 and the load as instruction 2.
+void runProfiledLoop(void *) {
+  LAMP_loop_invocation(1);
+  for (unsigned i = 0; i != NumIterations; ++i) {
+    LAMP_loop_iteration_begin();
+    if (i)
+      LAMP_load4(2, (uint64_t)(uintptr_t)&SharedArray[i - 1]);
+    LAMP_store4(1, (uint64_t)(uintptr_t)&SharedArray[i], i);
+  }
+  LAMP_loop_exit();
+}
+
+// Run the loop on several threads at once and exit, which makes the runtime
+// merge the shards and write the profile.
+void runThreadsAndExit(const char *OutputFilename) {
+  setenv("LAMP_PROFILE_OUTPUT", OutputFilename, 1);
+  LAMP_init(2, 1, 0, 0);
+  {
+    ThreadPool Pool(NumThreads);
+    for (unsigned i = 0; i != NumThreads; ++i)
+      Pool.async(runProfiledLoop, 0);
+  }
+  exit(0);
+}
+
+TEST(LAMPRuntimeTest, MergesThreadShards) {
+  int FD;
+  SmallString<128> Path;
+  ASSERT_FALSE(sys::fs::unique_file("lamp-runtime-test-%%%%%%.profile", FD,
+                                    Path));
+  ::close(FD);
+
+  EXPECT_EXIT(runThreadsAndExit(Path.c_str()),
+              ::testing::ExitedWithCode(0), "");
+
+  std::string ErrMsg;
+  OwningPtr<LAMPProfileReader> Reader(LAMPProfileReader::Create(Path, ErrMsg));
+  bool Existed;
+  sys::fs::remove(Path.str(), Existed);
+  ASSERT_TRUE(Reader.get() != 0) << ErrMsg;
+  EXPECT_TRUE(Reader->isBinary());
+
+  // Each thread observes the loop-carried dependence from the store to the
+  // load NumIterations - 1 times, and nothing else.
+  ArrayRef<LAMPDepRecord> Records = Reader->getLoopRecords(1);
+  ASSERT_EQ(1u, Records.size());
+  EXPECT_EQ(1u, Records[0].SrcId);
+  EXPECT_EQ(2u, Records[0].DstId);
+  EXPECT_NE(0u, Records[0].CrossIter);
+  EXPECT_EQ(uint64_t(NumThreads * (NumIterations - 1)), Records[0].Count);
+}
+
+#endif
+
+} // end anonymous namespace
@@ -9,6 +9,7 @@
 
 #include "llvm/ADT/SmallString.h"
 #include "llvm/Analysis/Verifier.h"
+#include "llvm/Assembly/Parser.h"
 #include "llvm/Bitcode/BitstreamWriter.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/IR/Constants.h"
@@ -17,6 +18,8 @@
 #include "llvm/IR/Module.h"
 #include "llvm/PassManager.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
 #include "gtest/gtest.h"
 
 namespace llvm {
@@ -61,5 +64,92 @@ TEST(BitReaderTest, MaterializeFunctionsForBlockAddr) { // PR11677
   passes.run(*m);
 }
 
+// @f refers to a cycle of two nodes and to the head of a chain of nodes longer
+// than the reader follows on the stack; @g and the named metadata refer to a
+// node each.
+static void writeMetadataModuleToBuffer(LLVMContext &Context,
+                                        SmallVectorImpl<char> &Buffer) {
+  std::string Asm;
+  raw_string_ostream AsmOS(Asm);
+  AsmOS << "define void @f() {\n"
+        << "  ret void, !cycle !0, !chain !10\n"
+        << "}\n"
+        << "define void @g() {\n"
+        << "  ret void, !g !2\n"
+        << "}\n"
+        << "!named = !{!3}\n"
+        << "!0 = metadata !{metadata !1, i32 0}\n"
+        << "!1 = metadata !{metadata !0, metadata !\"cycle\"}\n"
+        << "!2 = metadata !{metadata !\"g\"}\n"
+        << "!3 = metadata !{metadata !\"named\"}\n";
+  for (unsigned i = 10; i != 110; ++i)
+    AsmOS << "!" << i << " = metadata !{metadata !" << i + 1 << "}\n";
+  AsmOS << "!110 = metadata !{metadata !\"end\"}\n";
+  AsmOS.flush();
+
+  SMDiagnostic Err;
+  OwningPtr<Module> Mod(ParseAssemblyString(Asm.c_str(), 0, Err, Context));
+  ASSERT_TRUE(Mod);
+  raw_svector_ostream OS(Buffer);
+  WriteBitcodeToFile(Mod.get(), OS);
+}
+
+static MDNode *getRetMetadata(Function *F, StringRef Kind) {
+  return F->getEntryBlock().getTerminator()->getMetadata(Kind);
+}
+
+TEST(BitReaderTest, LazyMetadata) {
+  LLVMContext Context;
+  SmallString<4096> Mem;
+  writeMetadataModuleToBuffer(Context, Mem);
+  MemoryBuffer *Buffer = MemoryBuffer::getMemBuffer(Mem.str(), "test", false);
+  std::string ErrMsg;
+  OwningPtr<Module> M(getLazyBitcodeModule(Buffer, Context, &ErrMsg));
+  ASSERT_TRUE(M);
+
+  // The named metadata is only read on request.
+  EXPECT_EQ((NamedMDNode *)0, M->getNamedMetadata("named"));
+
+  Function *F = M->getFunction("f");
+  ASSERT_FALSE(F->Materialize(&ErrMsg));
+
+  MDNode *Cycle = getRetMetadata(F, "cycle");
+  ASSERT_TRUE(Cycle);
+  ASSERT_EQ(2U, Cycle->getNumOperands());
+  MDNode *Other = dyn_cast<MDNode>(Cycle->getOperand(0));
+  ASSERT_TRUE(Other);
+  ASSERT_EQ(2U, Other->getNumOperands());
+  EXPECT_EQ(Cycle, Other->getOperand(0));
+  EXPECT_EQ(MDString::get(Context, "cycle"), Other->getOperand(1));
+
+  // Every link of the chain must have been resolved.
+  MDNode *Link = getRetMetadata(F, "chain");
+  unsigned Length = 0;
+  while (Link && Link->getNumOperands() == 1 &&
+         isa<MDNode>(Link->getOperand(0))) {
+    Link = cast<MDNode>(Link->getOperand(0));
+    ++Length;
+  }
+  EXPECT_EQ(100U, Length);
+  ASSERT_TRUE(Link && Link->getNumOperands() == 1);
+  EXPECT_EQ(MDString::get(Context, "end"), Link->getOperand(0));
+
+  ASSERT_FALSE(M->MaterializeMetadata(&ErrMsg));
+  NamedMDNode *Named = M->getNamedMetadata("named");
+  ASSERT_TRUE(Named);
+  ASSERT_EQ(1U, Named->getNumOperands());
+  EXPECT_EQ(MDString::get(Context, "named"),
+            Named->getOperand(0)->getOperand(0));
+
+  Function *G = M->getFunction("g");
+  ASSERT_FALSE(G->Materialize(&ErrMsg));
+  MDNode *GNode = getRetMetadata(G, "g");
+  ASSERT_TRUE(GNode);
+  EXPECT_EQ(MDString::get(Context, "g"), GNode->getOperand(0));
+
+  ASSERT_FALSE(M->MaterializeAllPermanently(&ErrMsg));
+  EXPECT_FALSE(verifyModule(*M, ReturnStatusAction));
+}
+
 }
 }
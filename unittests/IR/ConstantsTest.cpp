@@ -13,6 +13,8 @@
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "gtest/gtest.h"
 
 namespace llvm {
@@ -256,5 +258,51 @@ TEST(ConstantsTest, AsInstructionsTest) {
 
 #undef CHECK
 
+struct UniquingThread {
+  LLVMContext *Context;
+  std::vector<Constant *> Values;
+
+  static void run(void *Arg) {
+    UniquingThread *T = static_cast<UniquingThread *>(Arg);
+    LLVMContext &C = *T->Context;
+    for (unsigned i = 0; i != 256; ++i) {
+      Type *ArrTy = ArrayType::get(Type::getInt16Ty(C), i);
+      T->Values.push_back(ConstantInt::get(Type::getInt32Ty(C), i));
+      T->Values.push_back(ConstantFP::get(Type::getDoubleTy(C), i));
+      T->Values.push_back(UndefValue::get(PointerType::getUnqual(ArrTy)));
+      T->Values.push_back(ConstantAggregateZero::get(ArrTy));
+      T->Values.push_back(ConstantExpr::getAdd(T->Values[T->Values.size() - 4],
+                                               T->Values[0]));
+      T->Values.push_back(ConstantInt::get(Type::getInt1Ty(C), i & 1));
+    }
+  }
+};
+
+TEST(ConstantsTest, UniquingAcrossThreads) {
+  if (!llvm_start_multithreaded())
+    return;
+
+  {
+    LLVMContext C;
+    UniquingThread Threads[4];
+    {
+      LLVMContext::SharedScope Shared(C);
+      ThreadPool Pool(4);
+      for (unsigned i = 0; i != 4; ++i) {
+        Threads[i].Context = &C;
+        Pool.async(UniquingThread::run, &Threads[i]);
+      }
+      Pool.wait();
+    }
+
+    for (unsigned i = 1; i != 4; ++i)
+      EXPECT_TRUE(Threads[i].Values == Threads[0].Values);
+    EXPECT_EQ(ConstantInt::getFalse(C), Threads[0].Values[5]);
+    EXPECT_EQ(ConstantInt::getTrue(C), Threads[0].Values[11]);
+  }
+
+  llvm_stop_multithreaded();
+}
+
 }  // end anonymous namespace
 }  // end namespace llvm
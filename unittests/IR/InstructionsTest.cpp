@@ -288,5 +288,62 @@ TEST(InstructionsTest, isEliminableCastPair) {
             0U);
 }
 
+TEST(InstructionsTest, CoAllocatedOperands) {
+  LLVMContext &C(getGlobalContext());
+  Constant *One = ConstantInt::get(Type::getInt32Ty(C), 1);
+  Constant *Two = ConstantInt::get(Type::getInt32Ty(C), 2);
+
+  // The operands of a fixed arity instruction end where it begins.
+  BinaryOperator *Add = BinaryOperator::CreateAdd(One, Two);
+  EXPECT_EQ(reinterpret_cast<Use *>(Add), Add->op_end());
+  EXPECT_EQ(2U, Add->getNumOperands());
+  EXPECT_EQ(Two, Add->getOperand(1));
+  EXPECT_EQ(Add, Add->getOperandUse(0).getUser());
+
+  Add->setOperand(0, Two);
+  EXPECT_EQ(Two, Add->getOperand(0));
+  EXPECT_EQ(Add, *Two->use_begin());
+  delete Add;
+}
+
+TEST(InstructionsTest, HungOffOperands) {
+  LLVMContext &C(getGlobalContext());
+  Type *Int32Ty = Type::getInt32Ty(C);
+  BasicBlock *BB = BasicBlock::Create(C);
+
+  // Grow the operands of a phi well past its reservation.
+  PHINode *PN = PHINode::Create(Int32Ty, 1);
+  for (unsigned i = 0; i != 10; ++i)
+    PN->addIncoming(ConstantInt::get(Int32Ty, i), BB);
+  EXPECT_EQ(10U, PN->getNumIncomingValues());
+  for (unsigned i = 0; i != 10; ++i) {
+    EXPECT_EQ(ConstantInt::get(Int32Ty, i), PN->getIncomingValue(i));
+    EXPECT_EQ(PN, PN->getOperandUse(i).getUser());
+  }
+
+  PN->removeIncomingValue(0u, false);
+  EXPECT_EQ(9U, PN->getNumIncomingValues());
+  EXPECT_EQ(ConstantInt::get(Int32Ty, 1), PN->getIncomingValue(0));
+
+  PHINode *Clone = cast<PHINode>(PN->clone());
+  EXPECT_EQ(9U, Clone->getNumIncomingValues());
+  EXPECT_EQ(ConstantInt::get(Int32Ty, 9), Clone->getIncomingValue(8));
+  EXPECT_EQ(Clone, Clone->getOperandUse(8).getUser());
+  delete Clone;
+  delete PN;
+
+  // Same for the cases of a switch.
+  SwitchInst *SI = SwitchInst::Create(ConstantInt::get(Int32Ty, 0), BB, 0);
+  for (unsigned i = 0; i != 10; ++i)
+    SI->addCase(ConstantInt::get(cast<IntegerType>(Int32Ty), i), BB);
+  EXPECT_EQ(10U, SI->getNumCases());
+  SwitchInst *SIClone = cast<SwitchInst>(SI->clone());
+  EXPECT_EQ(22U, SIClone->getNumOperands());
+  EXPECT_EQ(SIClone, SIClone->getOperandUse(21).getUser());
+  delete SIClone;
+  delete SI;
+  delete BB;
+}
+
 }  // end anonymous namespace
 }  // end namespace llvm
@@ -38,6 +38,8 @@ namespace llvm {
   void initializeCGPassPass(PassRegistry&);
   void initializeLPassPass(PassRegistry&);
   void initializeBPassPass(PassRegistry&);
+  void initializeCountedAnalysisPass(PassRegistry&);
+  void initializeCountedAnalysisUserPass(PassRegistry&);
 
   namespace {
     // ND = no deps
@@ -337,6 +339,82 @@ namespace llvm {
 
     Module* makeLLVMModule();
 
+    struct CountedAnalysis : public FunctionPass {
+      static char ID;
+      static int run;
+      CountedAnalysis() : FunctionPass(ID) {
+        initializeCountedAnalysisPass(*PassRegistry::getPassRegistry());
+      }
+      virtual bool runOnFunction(Function &F) {
+        run++;
+        return false;
+      }
+      virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+        AU.setPreservesAll();
+      }
+    };
+    char CountedAnalysis::ID=0;
+    int CountedAnalysis::run=0;
+
+    struct CountedAnalysisUser : public FunctionPass {
+      static char ID;
+      CountedAnalysisUser() : FunctionPass(ID) {
+        initializeCountedAnalysisUserPass(*PassRegistry::getPassRegistry());
+      }
+      virtual bool runOnFunction(Function &F) {
+        EXPECT_TRUE(&getAnalysis<CountedAnalysis>() != 0);
+        return false;
+      }
+      virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+        AU.addRequired<CountedAnalysis>();
+        AU.setPreservesAll();
+      }
+    };
+    char CountedAnalysisUser::ID=0;
+
+    TEST(PassManager, AnalysisCaching) {
+      OwningPtr<Module> M(makeLLVMModule());
+      CountedAnalysis::run = 0;
+
+      PassManager Passes;
+      Passes.setAnalysisCaching(true);
+      Passes.add(new DataLayout(M.get()));
+      Passes.add(new CountedAnalysisUser());
+
+      Passes.run(*M);
+      EXPECT_EQ(4, CountedAnalysis::run);
+
+      // Nothing changed, every function reuses its result.
+      Passes.run(*M);
+      EXPECT_EQ(4, CountedAnalysis::run);
+
+      // An explicitly invalidated function is analyzed again.
+      M->getFunction("test1")->markModified();
+      Passes.run(*M);
+      EXPECT_EQ(5, CountedAnalysis::run);
+
+      // So is a function that gained an instruction.
+      BasicBlock &Entry = M->getFunction("test4")->getEntryBlock();
+      Constant *One = ConstantInt::get(Type::getInt32Ty(M->getContext()), 1);
+      BinaryOperator::CreateAdd(One, One, "", Entry.getTerminator());
+      Passes.run(*M);
+      EXPECT_EQ(6, CountedAnalysis::run);
+      Passes.run(*M);
+      EXPECT_EQ(6, CountedAnalysis::run);
+    }
+
+    TEST(PassManager, AnalysisCachingDisabled) {
+      OwningPtr<Module> M(makeLLVMModule());
+      CountedAnalysis::run = 0;
+
+      PassManager Passes;
+      Passes.add(new DataLayout(M.get()));
+      Passes.add(new CountedAnalysisUser());
+      Passes.run(*M);
+      Passes.run(*M);
+      EXPECT_EQ(8, CountedAnalysis::run);
+    }
+
     template<typename T>
     void MemoryTestHelper(int run) {
       OwningPtr<Module> M(makeLLVMModule());
@@ -550,3 +628,10 @@ INITIALIZE_PASS_BEGIN(LPass, "lp","lp", false, false)
 INITIALIZE_PASS_DEPENDENCY(LoopInfo)
 INITIALIZE_PASS_END(LPass, "lp","lp", false, false)
 INITIALIZE_PASS(BPass, "bp","bp", false, false)
+INITIALIZE_PASS(CountedAnalysis, "counted-analysis", "counted-analysis", false,
+                true)
+INITIALIZE_PASS_BEGIN(CountedAnalysisUser, "counted-analysis-user",
+                      "counted-analysis-user", false, false)
+INITIALIZE_PASS_DEPENDENCY(CountedAnalysis)
+INITIALIZE_PASS_END(CountedAnalysisUser, "counted-analysis-user",
+                    "counted-analysis-user", false, false)
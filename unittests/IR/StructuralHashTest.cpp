@@ -0,0 +1,119 @@
+//===- llvm/unittest/IR/StructuralHashTest.cpp - StructuralHash tests -----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/IR/StructuralHash.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Assembly/Parser.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/SourceMgr.h"
+#include "gtest/gtest.h"
+using namespace llvm;
+
+namespace {
+
+std::string hashOf(const GlobalValue *GV) {
+  MD5 Hash;
+  if (const Function *F = dyn_cast<Function>(GV))
+    hashFunction(*F, Hash);
+  else
+    hashGlobalDeclaration(*GV, Hash);
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  SmallString<32> Str;
+  MD5::stringifyResult(Result, Str);
+  return Str.str();
+}
+
+class StructuralHashTest : public testing::Test {
+protected:
+  LLVMContext C;
+
+  Module *parse(const char *Source) {
+    SMDiagnostic Err;
+    Module *M = ParseAssemblyString(Source, NULL, Err, C);
+    EXPECT_TRUE(M != 0);
+    return M;
+  }
+};
+
+const char *Loop =
+  "@g = constant i32 7\n"
+  "define i32 @f(i32 %n) {\n"
+  "entry:\n"
+  "  %k = load i32* @g\n"
+  "  br label %loop\n"
+  "loop:\n"
+  "  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]\n"
+  "  %i.next = add nsw i32 %i, %k\n"
+  "  %c = icmp slt i32 %i.next, %n\n"
+  "  br i1 %c, label %loop, label %exit\n"
+  "exit:\n"
+  "  ret i32 %i.next\n"
+  "}\n";
+
+TEST_F(StructuralHashTest, SameAcrossModules) {
+  OwningPtr<Module> M1(parse(Loop));
+  std::string Other = std::string(
+    "%T = type { i64, i8* }\n"
+    "@unrelated = global i32 0\n"
+    "define void @h() {\n"
+    "  ret void\n"
+    "}\n") + Loop;
+  OwningPtr<Module> M2(parse(Other.c_str()));
+
+  EXPECT_EQ(hashOf(M1->getFunction("f")), hashOf(M2->getFunction("f")));
+  EXPECT_NE(hashOf(M1->getFunction("f")), hashOf(M2->getFunction("h")));
+}
+
+TEST_F(StructuralHashTest, ChangesWithFunction) {
+  OwningPtr<Module> M(parse(Loop));
+  std::string Hash = hashOf(M->getFunction("f"));
+
+  // The initializer of a constant the function loads from.
+  std::string Source = Loop;
+  Source.replace(Source.find("i32 7"), 5, "i32 8");
+  OwningPtr<Module> Initializer(parse(Source.c_str()));
+  EXPECT_NE(Hash, hashOf(Initializer->getFunction("f")));
+
+  // A local name, which the output of the cached function would show.
+  Source = Loop;
+  Source.replace(Source.find("%k"), 2, "%j");
+  Source.replace(Source.find("%k"), 2, "%j");
+  OwningPtr<Module> Name(parse(Source.c_str()));
+  EXPECT_NE(Hash, hashOf(Name->getFunction("f")));
+
+  // A flag of an instruction.
+  Source = Loop;
+  Source.replace(Source.find(" nsw"), 4, "");
+  OwningPtr<Module> Flag(parse(Source.c_str()));
+  EXPECT_NE(Hash, hashOf(Flag->getFunction("f")));
+}
+
+TEST_F(StructuralHashTest, GlobalDeclaration) {
+  OwningPtr<Module> M(parse(
+    "@a = constant i32 1\n"
+    "@b = global i32 1\n"
+    "@pa = constant i32* @a\n"));
+  OwningPtr<Module> N(parse(
+    "@a = constant i32 2\n"
+    "@b = global i32 2\n"
+    "@pa = constant i32* @a\n"));
+
+  // Only the initializers of constants matter, including those reached
+  // through other initializers.
+  EXPECT_NE(hashOf(M->getNamedGlobal("a")), hashOf(N->getNamedGlobal("a")));
+  EXPECT_EQ(hashOf(M->getNamedGlobal("b")), hashOf(N->getNamedGlobal("b")));
+  EXPECT_NE(hashOf(M->getNamedGlobal("pa")), hashOf(N->getNamedGlobal("pa")));
+}
+
+} // end anonymous namespace
@@ -0,0 +1,60 @@
+//===- llvm/unittest/Support/MD5Test.cpp - MD5 tests ----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/MD5.h"
+#include "gtest/gtest.h"
+#include <string>
+
+using namespace llvm;
+
+namespace {
+
+std::string digest(StringRef Str) {
+  MD5 Hash;
+  Hash.update(Str);
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  SmallString<32> Hex;
+  MD5::stringifyResult(Result, Hex);
+  return Hex.str();
+}
+
+TEST(MD5Test, RFC1321) {
+  EXPECT_EQ("d41d8cd98f00b204e9800998ecf8427e", digest(""));
+  EXPECT_EQ("0cc175b9c0f1b6a831c399e269772661", digest("a"));
+  EXPECT_EQ("900150983cd24fb0d6963f7d28e17f72", digest("abc"));
+  EXPECT_EQ("f96b697d7cb7938d525a2f31aaf161d0", digest("message digest"));
+  EXPECT_EQ("c3fcd3d76192e4007dfb496cca67e13b",
+            digest("abcdefghijklmnopqrstuvwxyz"));
+  EXPECT_EQ("57edf4a22be3c955ac49da2e2107b67a",
+            digest("1234567890123456789012345678901234567890"
+                   "1234567890123456789012345678901234567890"));
+}
+
+TEST(MD5Test, Incremental) {
+  // Splitting the message anywhere, including across block boundaries, must
+  // give the digest of the whole.
+  std::string Message;
+  for (unsigned i = 0; i != 200; ++i)
+    Message += char('a' + i % 26);
+  std::string Whole = digest(Message);
+
+  for (unsigned Split = 0; Split <= Message.size(); Split += 7) {
+    MD5 Hash;
+    Hash.update(StringRef(Message).substr(0, Split));
+    Hash.update(StringRef(Message).substr(Split));
+    MD5::MD5Result Result;
+    Hash.final(Result);
+    SmallString<32> Hex;
+    MD5::stringifyResult(Result, Hex);
+    EXPECT_EQ(Whole, Hex.str().str());
+  }
+}
+
+}